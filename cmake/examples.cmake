@@ -1,4 +1,5 @@
 function(add_example example_name)
+    cmake_parse_arguments(example "CONSOLE" "" "" ${ARGN})
     set(example_dir "${CMAKE_CURRENT_SOURCE_DIR}/examples/${example_name}")
 
     file(GLOB example_sources CONFIGURE_DEPENDS "${example_dir}/*.c" "${example_dir}/*.h")
@@ -11,20 +12,23 @@ function(add_example example_name)
     add_executable(${example_name} ${example_sources})
     target_link_libraries(${example_name} PRIVATE libadikted::adikted)
     target_include_directories(${example_name} PRIVATE "${example_dir}")
-    target_compile_definitions(${example_name} PRIVATE ENTRY_CONFIG_USE_SDL)
-
-    find_package(SDL REQUIRED)
-    if(TARGET SDL::SDL)
-        target_link_libraries(${example_name} PRIVATE SDL::SDL)
-    else()
-        target_include_directories(${example_name} PRIVATE ${SDL_INCLUDE_DIR})
-        target_link_libraries(${example_name} PRIVATE ${SDL_LIBRARY})
-    endif()
 
-    if(UNIX AND NOT APPLE)
-        find_package(X11 QUIET)
-        if(X11_FOUND)
-            target_link_libraries(${example_name} PRIVATE X11::X11)
+    if(NOT example_CONSOLE)
+        target_compile_definitions(${example_name} PRIVATE ENTRY_CONFIG_USE_SDL)
+
+        find_package(SDL REQUIRED)
+        if(TARGET SDL::SDL)
+            target_link_libraries(${example_name} PRIVATE SDL::SDL)
+        else()
+            target_include_directories(${example_name} PRIVATE ${SDL_INCLUDE_DIR})
+            target_link_libraries(${example_name} PRIVATE ${SDL_LIBRARY})
+        endif()
+
+        if(UNIX AND NOT APPLE)
+            find_package(X11 QUIET)
+            if(X11_FOUND)
+                target_link_libraries(${example_name} PRIVATE X11::X11)
+            endif()
         endif()
     endif()
 
@@ -0,0 +1,248 @@
+/******************************************************************************/
+/** @file blendbench.c
+ * ADiKtEd library sprite blending benchmark.
+ * @par Purpose:
+ *     Composites the whole thing sprite set on a map-sized buffer at every
+ *     rescale, once with premultiplied colours (the SSE2 blend, if compiled
+ *     in) and once through the palette, pixel by pixel. Checks that both
+ *     buffers are identical, and shows how long each took.
+ * @par Comment:
+ *     Console program, doesn't need SDL. Without parameters, it uses
+ *     generated sprites; given the game data path, it uses the icons
+ *     and palette of the game, like load_draw_data() does.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libadikted/adikted.h"
+
+#define BENCH_RESCALE_MAX 5
+#define BENCH_PASSES 3
+#define BENCH_SPRITES 256
+
+// Generates a sprite set similar to thing icons: opaque shapes with
+// semi-transparent edges, on transparent background
+static short generate_sprites(struct IMAGELIST *images,short large)
+{
+  unsigned int size_min=large?16:8;
+  unsigned int size_rand=large?33:17;
+  unsigned int widths[BENCH_SPRITES];
+  unsigned int heights[BENCH_SPRITES];
+  unsigned long pixels=0;
+  unsigned long picnum;
+  for (picnum=0; picnum<BENCH_SPRITES; picnum++)
+  {
+    widths[picnum]=size_min+rng_rand()%size_rand;
+    heights[picnum]=size_min+rng_rand()%size_rand;
+    pixels+=widths[picnum]*heights[picnum];
+  }
+  images->count=BENCH_SPRITES;
+  images->premul_arena=NULL;
+  images->items=(struct IMAGEITEM *)calloc(BENCH_SPRITES,sizeof(struct IMAGEITEM));
+  if (images->items==NULL)
+    return false;
+  if (alloc_images_arena(images,pixels)!=XTABDAT8_OK)
+  {
+    free(images->items);
+    images->items=NULL;
+    return false;
+  }
+  for (picnum=0; picnum<BENCH_SPRITES; picnum++)
+  {
+    struct IMAGEITEM *item=&(images->items[picnum]);
+    item->width=widths[picnum];
+    item->height=heights[picnum];
+    item->data=images->arena+images->arena_used;
+    item->alpha=images->arena+images->arena_size+images->arena_used;
+    images->arena_used+=item->width*item->height;
+    int cx=item->width/2,cy=item->height/2;
+    int r2=cx*cy;
+    int x,y;
+    for (y=0; y<(int)item->height; y++)
+      for (x=0; x<(int)item->width; x++)
+      {
+        int d2=(x-cx)*(x-cx)+(y-cy)*(y-cy);
+        unsigned long i=y*item->width+x;
+        item->data[i]=rng_rand()&255;
+        if (d2<r2/2)
+          item->alpha[i]=0;
+        else
+        if (d2<r2)
+          item->alpha[i]=rng_rand()&255;
+        else
+          item->alpha[i]=255;
+      }
+  }
+  return true;
+}
+
+// Loads the thing icons used at given rescale, as load_draw_data() does
+static short load_sprites(struct IMAGELIST *images,const char *data_path,short large)
+{
+  char *datfname=NULL;
+  char *tabfname=NULL;
+  short result;
+  format_data_fname(&datfname,data_path,"GUI%d-%d-%d.DAT",2,0,large);
+  format_data_fname(&tabfname,data_path,"GUI%d-%d-%d.TAB",2,0,large);
+  result=(create_images_dattab_idx(images,datfname,tabfname,0)==ERR_NONE);
+  if (!result)
+    printf("cannot load \"%s\"\n",datfname);
+  free(datfname);
+  free(tabfname);
+  return result;
+}
+
+// Places every sprite of the set, in turn, at centres of all subtiles
+static void composite_sprites(unsigned char *dest,const struct IPOINT_2D dest_size,
+    const struct PALETTE_ENTRY *pal,const struct IMAGEITEM *items,unsigned long count)
+{
+  unsigned int sx,sy;
+  unsigned long picnum=0;
+  struct IPOINT_2D pos;
+  for (sy=0; sy<MAP_SIZE_DKSTD_Y*MAP_SUBNUM_Y; sy++)
+    for (sx=0; sx<MAP_SIZE_DKSTD_X*MAP_SUBNUM_X; sx++)
+    {
+      if (items[picnum].data!=NULL)
+      {
+        pos.x=((2*sx+1)*dest_size.x)/(2*MAP_SIZE_DKSTD_X*MAP_SUBNUM_X);
+        pos.y=((2*sy+1)*dest_size.y)/(2*MAP_SIZE_DKSTD_Y*MAP_SUBNUM_Y);
+        place_sprite_cntr_on_buf_rgb(dest,pos,dest_size,3*dest_size.x,pal,&items[picnum]);
+      }
+      picnum++;
+      if (picnum>=count) picnum=0;
+    }
+}
+
+// Blends the sprite set at given rescale both ways; returns number of errors
+static int bench_rescale(short rescale,struct IMAGELIST *images,const struct PALETTE_ENTRY *pal)
+{
+  struct IPOINT_2D dest_size;
+  unsigned char *dest_premul;
+  unsigned char *dest_plain;
+  struct IMAGEITEM *plain_items;
+  clock_t premul_time=0,plain_time=0,start;
+  unsigned long i;
+  int pass;
+  dest_size.x=MAP_SIZE_DKSTD_X*(TEXTURE_SIZE_X>>rescale);
+  dest_size.y=MAP_SIZE_DKSTD_Y*(TEXTURE_SIZE_Y>>rescale);
+  unsigned long dest_len=3*dest_size.x*dest_size.y;
+  if (premultiply_sprites_rgb(images,pal)!=ERR_NONE)
+  {
+    printf("rescale %d: cannot premultiply sprites\n",rescale);
+    return 1;
+  }
+  dest_premul=(unsigned char *)malloc(dest_len);
+  dest_plain=(unsigned char *)malloc(dest_len);
+  plain_items=(struct IMAGEITEM *)malloc(images->count*sizeof(struct IMAGEITEM));
+  if ((dest_premul==NULL)||(dest_plain==NULL)||(plain_items==NULL))
+  {
+    printf("rescale %d: cannot allocate buffers\n",rescale);
+    free(dest_premul);
+    free(dest_plain);
+    free(plain_items);
+    return 1;
+  }
+  // Same sprites, but without premultiplied colours, are drawn through palette
+  for (i=0; i<images->count; i++)
+  {
+    plain_items[i]=images->items[i];
+    plain_items[i].premul=NULL;
+    plain_items[i].premul_alpha=NULL;
+  }
+  for (i=0; i<dest_len; i++)
+    dest_premul[i]=rng_rand()&255;
+  memcpy(dest_plain,dest_premul,dest_len);
+  for (pass=0; pass<BENCH_PASSES; pass++)
+  {
+    start=clock();
+    composite_sprites(dest_premul,dest_size,pal,images->items,images->count);
+    premul_time+=clock()-start;
+    start=clock();
+    composite_sprites(dest_plain,dest_size,pal,plain_items,images->count);
+    plain_time+=clock()-start;
+  }
+  int errors=(memcmp(dest_premul,dest_plain,dest_len)!=0);
+  printf("rescale %d: %4dx%-4d %3lu sprites, premultiplied %7.2f ms, palette %7.2f ms%s\n",
+      rescale,dest_size.x,dest_size.y,images->count,
+      (1000.0*premul_time)/(CLOCKS_PER_SEC*BENCH_PASSES),
+      (1000.0*plain_time)/(CLOCKS_PER_SEC*BENCH_PASSES),
+      errors?", buffers differ":"");
+  free(dest_premul);
+  free(dest_plain);
+  free(plain_items);
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  struct PALETTE_ENTRY pal[256];
+  struct IMAGELIST images[2];
+  const char *data_path=NULL;
+  int errors=0;
+  short rescale;
+  int i;
+
+  init_messages();
+  rng_srand(1);
+  if (argc>1)
+    data_path=argv[1];
+  printf("\nblendbench: blending %s sprites\n\n",(data_path!=NULL)?"game":"generated");
+
+  if (data_path!=NULL)
+  {
+    char *fname=NULL;
+    format_data_fname(&fname,data_path,"PALETTE.DAT");
+    if (load_palette(pal,fname)!=ERR_NONE)
+    {
+      printf("cannot load \"%s\"\n",fname);
+      errors++;
+    }
+    free(fname);
+  } else
+  {
+    for (i=0; i<256; i++)
+    {
+      pal[i].r=rng_rand()&63;
+      pal[i].g=rng_rand()&63;
+      pal[i].b=rng_rand()&63;
+      pal[i].o=0;
+    }
+  }
+  // Small icons are used from rescale 3, same as in load_draw_data()
+  memset(images,0,sizeof(images));
+  for (i=0; (i<2)&&(errors==0); i++)
+  {
+    short loaded;
+    if (data_path!=NULL)
+      loaded=load_sprites(&images[i],data_path,i);
+    else
+      loaded=generate_sprites(&images[i],i);
+    if (!loaded)
+      errors++;
+  }
+
+  for (rescale=0; (rescale<=BENCH_RESCALE_MAX)&&(errors==0); rescale++)
+    errors+=bench_rescale(rescale,&images[(rescale<3)?1:0],pal);
+
+  for (i=0; i<2; i++)
+    free_dattab_images(&images[i]);
+
+  if (errors!=0)
+    printf("blendbench finished with %d errors\n",errors);
+  else
+    printf("blendbench finished successfully\n");
+
+  // This command should be always last function used from library
+  free_messages();
+  return (errors!=0);
+}
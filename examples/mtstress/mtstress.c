@@ -0,0 +1,423 @@
+/******************************************************************************/
+/** @file mtstress.c
+ * ADiKtEd library multithreading stress test.
+ * @par Purpose:
+ *     Processes separate levels on many threads at the same time:
+ *     generates, saves (plain and packed), loads, verifies and parses
+ *     scripts. Levels are saved from snapshots, while the level itself
+ *     is being replaced; the snapshots must stay unchanged. Every thread
+ *     also draws its maps, and checks that the reloaded map looks the same.
+ *     Checks that every thread got correct results; build it with
+ *     ThreadSanitizer (-fsanitize=thread) to also catch data races.
+ * @par Comment:
+ *     Console program, doesn't need SDL nor game data; the maps are drawn
+ *     with generated textures and sprites.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "libadikted/adikted.h"
+#include "libadikted/lbthread.h"
+#include "libadikted/enrnc.h"
+
+#define STRESS_THREADS_MAX 32
+#define STRESS_ROUNDS 2
+#define STRESS_RESCALE 3
+#define STRESS_CUBES 512
+#define STRESS_SPRITES 512
+
+struct STRESS_THREAD {
+    int num;
+    unsigned int first_rand;
+    int errors;
+  };
+
+// Compares the slabs, owners and columns of two levels
+static int compare_levels(const struct LEVEL *lvl1,const struct LEVEL *lvl2)
+{
+  int diffs=0;
+  unsigned int tx,ty,sx,sy;
+  for (ty=0; ty<MAP_SIZE_DKSTD_Y; ty++)
+    for (tx=0; tx<MAP_SIZE_DKSTD_X; tx++)
+    {
+      if (get_tile_slab(lvl1,tx,ty)!=get_tile_slab(lvl2,tx,ty))
+        diffs++;
+      if (get_tile_owner(lvl1,tx,ty)!=get_tile_owner(lvl2,tx,ty))
+        diffs++;
+    }
+  for (sy=0; sy<MAP_SIZE_DKSTD_Y*MAP_SUBNUM_Y; sy++)
+    for (sx=0; sx<MAP_SIZE_DKSTD_X*MAP_SUBNUM_X; sx++)
+    {
+      if (get_dat_val(lvl1,sx,sy)!=get_dat_val(lvl2,sx,sy))
+        diffs++;
+      if (get_thing_subnums(lvl1,sx,sy)!=get_thing_subnums(lvl2,sx,sy))
+        diffs++;
+    }
+  return diffs;
+}
+
+// Computes a digest of slabs, owners, columns and things of a level
+static unsigned long level_digest(const struct LEVEL *lvl)
+{
+  unsigned long digest=2166136261UL;
+  unsigned int tx,ty,sx,sy;
+  for (ty=0; ty<MAP_SIZE_DKSTD_Y; ty++)
+    for (tx=0; tx<MAP_SIZE_DKSTD_X; tx++)
+    {
+      digest=(digest^get_tile_slab(lvl,tx,ty))*16777619UL;
+      digest=(digest^get_tile_owner(lvl,tx,ty))*16777619UL;
+    }
+  for (sy=0; sy<MAP_SIZE_DKSTD_Y*MAP_SUBNUM_Y; sy++)
+    for (sx=0; sx<MAP_SIZE_DKSTD_X*MAP_SUBNUM_X; sx++)
+    {
+      digest=(digest^get_dat_val(lvl,sx,sy))*16777619UL;
+      digest=(digest^get_thing_subnums(lvl,sx,sy))*16777619UL;
+    }
+  return digest&0xffffffffUL;
+}
+
+struct SNAPSHOT_SAVE {
+    struct LEVEL *snap;
+    short result;
+  };
+
+// Saves a level snapshot, like editors do while the level is edited
+static void snapshot_save_thread(void *arg)
+{
+  struct SNAPSHOT_SAVE *save=(struct SNAPSHOT_SAVE *)arg;
+  save->result=save_dk1_map(save->snap);
+  message_thread_end();
+}
+
+// Tokenizes script lines, nesting the per-thread and reentrant tokenizers
+static int parse_script_words(void)
+{
+  const char *line="IF(PLAYER0,GAME_TURN >= 1200)";
+  const char *inner_text=NULL;
+  int words=0;
+  char *word;
+  word=script_strword(line,false);
+  while (word!=NULL)
+  {
+    char *inner=script_strword_r(word,false,&inner_text);
+    if ((inner==NULL)||(strcmp(inner,word)!=0))
+      words=-100;
+    free(inner);
+    free(word);
+    words++;
+    word=script_strword(NULL,false);
+  }
+  return words;
+}
+
+// Generates thing sprites, with semi-transparent edges
+static short generate_draw_sprites(struct IMAGELIST *images)
+{
+  unsigned long pixels=0;
+  unsigned long picnum;
+  images->count=STRESS_SPRITES;
+  images->premul_arena=NULL;
+  images->items=(struct IMAGEITEM *)calloc(STRESS_SPRITES,sizeof(struct IMAGEITEM));
+  if (images->items==NULL)
+    return false;
+  for (picnum=0; picnum<STRESS_SPRITES; picnum++)
+  {
+    images->items[picnum].width=8+rng_rand()%9;
+    images->items[picnum].height=8+rng_rand()%9;
+    pixels+=images->items[picnum].width*images->items[picnum].height;
+  }
+  if (alloc_images_arena(images,pixels)!=XTABDAT8_OK)
+    return false;
+  for (picnum=0; picnum<STRESS_SPRITES; picnum++)
+  {
+    struct IMAGEITEM *item=&(images->items[picnum]);
+    unsigned long i,len=item->width*item->height;
+    item->data=images->arena+images->arena_used;
+    item->alpha=images->arena+images->arena_size+images->arena_used;
+    images->arena_used+=len;
+    for (i=0; i<len; i++)
+    {
+      unsigned int x=i%item->width,y=i/item->width;
+      item->data[i]=rng_rand()&255;
+      if ((x==0)||(y==0)||(x+1==item->width)||(y+1==item->height))
+        item->alpha[i]=rng_rand()&255;
+      else
+        item->alpha[i]=0;
+    }
+  }
+  return true;
+}
+
+// Prepares drawing data like load_draw_data() does, but with generated
+// palette, cubes, texture and sprites instead of the game files
+static short create_draw_data(struct MAPDRAW_DATA **draw_data,const struct UPOINT_2D *subtl)
+{
+  struct MAPDRAW_DATA *dd;
+  unsigned long texture_len=(TEXTURE_SIZE_X*TEXTURE_COUNT_X)*(TEXTURE_SIZE_Y*TEXTURE_COUNT_Y);
+  unsigned long i;
+  dd=(struct MAPDRAW_DATA *)calloc(1,sizeof(struct MAPDRAW_DATA));
+  (*draw_data)=dd;
+  if (dd==NULL)
+    return false;
+  dd->subsize.x=subtl->x;
+  dd->subsize.y=subtl->y;
+  dd->tngflags=TNGFLG_SHOW_CIRCLES;
+  dd->cubes=(struct CUBES_DATA *)calloc(1,sizeof(struct CUBES_DATA));
+  dd->palette=(struct PALETTE_ENTRY *)malloc(256*sizeof(struct PALETTE_ENTRY));
+  dd->images=(struct IMAGELIST *)calloc(1,sizeof(struct IMAGELIST));
+  dd->texture=(unsigned char *)malloc(texture_len);
+  dd->rand_size=dd->subsize.x*dd->subsize.y*sizeof(int);
+  dd->rand_pool=(unsigned char *)malloc(dd->rand_size);
+  if ((dd->cubes==NULL)||(dd->palette==NULL)||(dd->images==NULL)||
+      (dd->texture==NULL)||(dd->rand_pool==NULL))
+    return false;
+  if (alloc_cubedata(dd->cubes,STRESS_CUBES)!=ERR_NONE)
+    return false;
+  for (i=0; i<STRESS_CUBES; i++)
+  {
+    struct CUBE_TEXTURES *cube=&(dd->cubes->data[i]);
+    cube->n=rng_rand()%(TEXTURE_COUNT_X*TEXTURE_COUNT_Y);
+    cube->s=rng_rand()%(TEXTURE_COUNT_X*TEXTURE_COUNT_Y);
+    cube->w=rng_rand()%(TEXTURE_COUNT_X*TEXTURE_COUNT_Y);
+    cube->e=rng_rand()%(TEXTURE_COUNT_X*TEXTURE_COUNT_Y);
+    cube->t=rng_rand()%(TEXTURE_COUNT_X*TEXTURE_COUNT_Y);
+    cube->b=rng_rand()%(TEXTURE_COUNT_X*TEXTURE_COUNT_Y);
+  }
+  for (i=0; i<256; i++)
+  {
+    dd->palette[i].r=rng_rand()&63;
+    dd->palette[i].g=rng_rand()&63;
+    dd->palette[i].b=rng_rand()&63;
+    dd->palette[i].o=0;
+  }
+  for (i=0; i<texture_len; i++)
+    dd->texture[i]=rng_rand()&255;
+  for (i=0; i<dd->rand_size/sizeof(int); i++)
+    ((int *)dd->rand_pool)[i]=rng_rand();
+  if (!generate_draw_sprites(dd->images))
+    return false;
+  premultiply_sprites_rgb(dd->images,dd->palette);
+  for (i=0; i<SIN_ACOS_SIZE; i++)
+    dd->sin_acos[i]=sin(acos(((float)i)/SIN_ACOS_SIZE))*0x10000L;
+  set_draw_data_rect(dd,0,0,dd->subsize.x*(TEXTURE_SIZE_X>>STRESS_RESCALE)-1,
+      dd->subsize.y*(TEXTURE_SIZE_Y>>STRESS_RESCALE)-1,
+      3*dd->subsize.x*(TEXTURE_SIZE_X>>STRESS_RESCALE),STRESS_RESCALE);
+  return true;
+}
+
+// Draws the level with its things on given buffer
+static short draw_level(unsigned char *dest,const struct LEVEL *lvl,struct MAPDRAW_DATA *draw_data)
+{
+  if (draw_map_on_buffer((char *)dest,lvl,draw_data,0)!=ERR_NONE)
+    return false;
+  return (draw_things_on_buffer((char *)dest,lvl,draw_data)==ERR_NONE);
+}
+
+static void stress_thread(void *arg)
+{
+  struct STRESS_THREAD *thr=(struct STRESS_THREAD *)arg;
+  struct LEVEL *lvl;
+  struct LEVEL *lvl_load;
+  struct MAPDRAW_DATA *draw_data;
+  unsigned char *draw_snap;
+  unsigned char *draw_load;
+  unsigned long draw_len;
+  char fname[64];
+  int round;
+  thr->first_rand=rng_rand();
+  sprintf(fname,"mtstress%02d",thr->num);
+  struct UPOINT_2D subtl={MAP_SIZE_DKSTD_X*MAP_SUBNUM_X,MAP_SIZE_DKSTD_Y*MAP_SUBNUM_Y};
+  draw_len=3*(subtl.x*(TEXTURE_SIZE_X>>STRESS_RESCALE))*(subtl.y*(TEXTURE_SIZE_Y>>STRESS_RESCALE));
+  draw_snap=(unsigned char *)malloc(draw_len);
+  draw_load=(unsigned char *)malloc(draw_len);
+  if ((!create_draw_data(&draw_data,&subtl))||(draw_snap==NULL)||(draw_load==NULL))
+  {
+    message_log("thread %d: cannot prepare drawing data",thr->num);
+    thr->errors++;
+    free_draw_data(draw_data);
+    free(draw_snap);
+    free(draw_load);
+    message_thread_end();
+    return;
+  }
+  for (round=0; round<STRESS_ROUNDS; round++)
+  {
+    if (!level_init(&lvl,MFV_DKGOLD,NULL))
+    {
+      thr->errors++;
+      break;
+    }
+    if (!level_init(&lvl_load,MFV_DKGOLD,NULL))
+    {
+      level_deinit(&lvl);
+      thr->errors++;
+      break;
+    }
+    level_rng_seed(lvl,thr->num*STRESS_ROUNDS+round);
+    generate_random_map(lvl);
+    update_datclm_for_whole_map(lvl);
+    set_lvl_savfname(lvl,fname);
+    // Every second round is saved with RNC packed files
+    if ((round&1)!=0)
+      set_lvl_packed_files(lvl,LCF_ALL,RNC_PACK_LEVEL_DEFAULT);
+    // The snapshot is saved on another thread, while the level is
+    // replaced by a new map; the snapshot must stay unchanged
+    struct SNAPSHOT_SAVE save;
+    struct LB_THREAD *save_thread;
+    save.snap=level_snapshot_create(lvl);
+    save.result=ERR_INTERNAL;
+    if (save.snap==NULL)
+    {
+      message_log("thread %d: cannot create snapshot",thr->num);
+      thr->errors++;
+      level_free(lvl_load);
+      level_deinit(&lvl_load);
+      level_free(lvl);
+      level_deinit(&lvl);
+      break;
+    }
+    unsigned long snap_digest=level_digest(save.snap);
+    if (snap_digest!=level_digest(lvl))
+    {
+      message_log("thread %d: snapshot differs from the level",thr->num);
+      thr->errors++;
+    }
+    save_thread=lb_thread_start(snapshot_save_thread,&save);
+    // The snapshot is drawn while the other thread saves it
+    memset(draw_snap,0,draw_len);
+    if (!draw_level(draw_snap,save.snap,draw_data))
+    {
+      message_log("thread %d: cannot draw snapshot",thr->num);
+      thr->errors++;
+    }
+    level_rng_seed(lvl,STRESS_THREADS_MAX*STRESS_ROUNDS+thr->num);
+    generate_random_map(lvl);
+    update_datclm_for_whole_map(lvl);
+    if (save_thread!=NULL)
+      lb_thread_join(&save_thread);
+    else
+      snapshot_save_thread(&save);
+    if (save.result!=ERR_NONE)
+    {
+      message_log("thread %d: cannot save map",thr->num);
+      thr->errors++;
+    }
+    if (level_digest(save.snap)!=snap_digest)
+    {
+      message_log("thread %d: snapshot changed after editing the level",thr->num);
+      thr->errors++;
+    }
+    if (compare_levels(lvl,save.snap)==0)
+    {
+      message_log("thread %d: editing the level didn't change it",thr->num);
+      thr->errors++;
+    }
+    set_lvl_fname(lvl_load,fname);
+    if (load_dk1_map(lvl_load)!=ERR_NONE)
+    {
+      message_log("thread %d: cannot load map",thr->num);
+      thr->errors++;
+    } else
+    {
+      int diffs=compare_levels(save.snap,lvl_load);
+      if (diffs!=0)
+      {
+        message_log("thread %d: %d differences after reload",thr->num,diffs);
+        thr->errors++;
+      }
+      memset(draw_load,0,draw_len);
+      if (!draw_level(draw_load,lvl_load,draw_data))
+      {
+        message_log("thread %d: cannot draw reloaded map",thr->num);
+        thr->errors++;
+      } else
+      if (memcmp(draw_snap,draw_load,draw_len)!=0)
+      {
+        message_log("thread %d: reloaded map looks different",thr->num);
+        thr->errors++;
+      }
+    }
+    level_snapshot_saved(lvl,save.snap);
+    level_snapshot_free(&save.snap);
+    struct IPOINT_2D errpt={-1,-1};
+    level_verify(lvl_load,"stress",&errpt);
+    message_release();
+    if (parse_script_words()!=5)
+    {
+      message_log("thread %d: script words mismatch",thr->num);
+      thr->errors++;
+    }
+    level_free(lvl_load);
+    level_deinit(&lvl_load);
+    level_free(lvl);
+    level_deinit(&lvl);
+  }
+  free_draw_data(draw_data);
+  free(draw_snap);
+  free(draw_load);
+  message_thread_end();
+}
+
+int main(int argc, char *argv[])
+{
+  struct STRESS_THREAD thr_data[STRESS_THREADS_MAX];
+  struct LB_THREAD *threads[STRESS_THREADS_MAX];
+  int threads_num=4;
+  int errors=0;
+  int i,k;
+
+  init_messages();
+  set_msglog_fname("mtstress.log");
+  rng_srand(1);
+
+  if (argc>1)
+    threads_num=atoi(argv[1]);
+  if ((threads_num<1)||(threads_num>STRESS_THREADS_MAX))
+    threads_num=4;
+  printf("\nmtstress: processing levels on %d threads\n\n",threads_num);
+
+  for (i=0; i<threads_num; i++)
+  {
+    memset(&thr_data[i],0,sizeof(struct STRESS_THREAD));
+    thr_data[i].num=i;
+    threads[i]=lb_thread_start(stress_thread,&thr_data[i]);
+    if (threads[i]==NULL)
+    {
+      printf("cannot start thread %d\n",i);
+      errors++;
+    }
+  }
+  for (i=0; i<threads_num; i++)
+  {
+    lb_thread_join(&threads[i]);
+    errors+=thr_data[i].errors;
+  }
+
+  // Threads which didn't seed the generator shouldn't repeat each other
+  for (i=0; i<threads_num; i++)
+    for (k=i+1; k<threads_num; k++)
+      if (thr_data[i].first_rand==thr_data[k].first_rand)
+      {
+        printf("threads %d and %d got the same random numbers\n",i,k);
+        errors++;
+      }
+
+  if (errors!=0)
+    printf("mtstress finished with %d errors\n",errors);
+  else
+    printf("mtstress finished successfully\n");
+
+  // This command should be always last function used from library
+  free_messages();
+  return (errors!=0);
+}
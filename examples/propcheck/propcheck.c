@@ -0,0 +1,55 @@
+/******************************************************************************/
+/** @file propcheck.c
+ * ADiKtEd library property tables check.
+ * @par Purpose:
+ *     Checks that the constant slab, cube and item property tables
+ *     agree with the slabs_*, cube and items_* arrays.
+ * @par Comment:
+ *     Console program, doesn't need SDL nor game data.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libadikted/adikted.h"
+
+int main(void)
+{
+  char err_msg[LINEMSG_SIZE];
+  int errors=0;
+
+  init_messages();
+  printf("\npropcheck: checking property tables\n\n");
+
+  if (slab_props_verify(err_msg)!=VERIF_OK)
+  {
+    printf("slabs: %s\n",err_msg);
+    errors++;
+  }
+  if (cube_props_verify(err_msg)!=VERIF_OK)
+  {
+    printf("cubes: %s\n",err_msg);
+    errors++;
+  }
+  if (item_props_verify(err_msg)!=VERIF_OK)
+  {
+    printf("items: %s\n",err_msg);
+    errors++;
+  }
+
+  if (errors!=0)
+    printf("propcheck finished with %d errors\n",errors);
+  else
+    printf("propcheck finished successfully\n");
+
+  // This command should be always last function used from library
+  free_messages();
+  return (errors!=0);
+}
@@ -4,7 +4,13 @@
  * @par Purpose:
  *     Header file. Defines exported routines from the whole library.
  * @par Comment:
- *     None.
+ *     Thread safety: different LEVEL structures, with their own MAPDRAW_DATA,
+ *     may be loaded, regenerated, verified and drawn on different threads
+ *     at the same time. There is no context object; state which the library
+ *     kept in globals is kept per thread instead, and functions which use
+ *     such state describe it. The examples/mtstress program checks this.
+ *     Random maps and columns are generated from the level's own random
+ *     stream; level_rng_seed() makes them reproducible on any thread.
  * @author   Tomasz Lis
  * @date     20 Jul 2008 - 29 Jul 2008
  * @par  Copying and copyrights:
@@ -23,7 +29,11 @@
 #include "lev_column.h"
 #include "lev_files.h"
 #include "lev_script.h"
+#include "lev_reach.h"
+#include "lev_regions.h"
+#include "lev_snapshot.h"
 #include "lev_things.h"
+#include "lev_undo.h"
 #include "obj_actnpts.h"
 #include "obj_column.h"
 #include "obj_column_def.h"
@@ -284,3 +284,208 @@ int arr_ushort_pos(const unsigned short *arr,unsigned short arr_item,int array_c
       if (arr[i]==arr_item) return i;
     return -1;
 }
+
+/**
+ * Creates empty objects lookup.
+ * @param rows,cols Size of the indexed grid.
+ * @return Returns the new lookup, or NULL on error.
+ */
+struct OBJECTS_LOOKUP *objlookup_create(unsigned int rows,unsigned int cols)
+{
+    struct OBJECTS_LOOKUP *olkp;
+    olkp=(struct OBJECTS_LOOKUP *)malloc(sizeof(struct OBJECTS_LOOKUP));
+    if (olkp==NULL)
+      return NULL;
+    olkp->rows=rows;
+    olkp->cols=cols;
+    olkp->count=0;
+    olkp->start=(unsigned short **)calloc(rows,sizeof(unsigned short *));
+    olkp->items=(unsigned char ***)calloc(rows,sizeof(unsigned char **));
+    olkp->capacity=(unsigned int *)calloc(rows,sizeof(unsigned int));
+    if ((olkp->start==NULL)||(olkp->items==NULL)||(olkp->capacity==NULL))
+    {
+      objlookup_free(&olkp);
+      return NULL;
+    }
+    return olkp;
+}
+
+/**
+ * Frees objects lookup. The objects aren't freed.
+ * @param olkp_ptr Double pointer to the lookup; the pointer is cleared.
+ */
+void objlookup_free(struct OBJECTS_LOOKUP **olkp_ptr)
+{
+    if ((olkp_ptr==NULL)||((*olkp_ptr)==NULL))
+      return;
+    struct OBJECTS_LOOKUP *olkp=(*olkp_ptr);
+    if ((olkp->start!=NULL)&&(olkp->items!=NULL)&&(olkp->capacity!=NULL))
+      objlookup_clear(olkp);
+    free(olkp->start);
+    free(olkp->items);
+    free(olkp->capacity);
+    free(olkp);
+    (*olkp_ptr)=NULL;
+}
+
+/**
+ * Removes all objects from the lookup. Drops the object pointers
+ * without deallocating them.
+ * @param olkp Pointer to the objects lookup.
+ */
+void objlookup_clear(struct OBJECTS_LOOKUP *olkp)
+{
+    unsigned int row;
+    for (row=0; row<olkp->rows; row++)
+    {
+      free(olkp->start[row]);
+      free(olkp->items[row]);
+      olkp->start[row]=NULL;
+      olkp->items[row]=NULL;
+      olkp->capacity[row]=0;
+    }
+    olkp->count=0;
+}
+
+/**
+ * Gives amount of objects on given subtile.
+ * @param olkp Pointer to the objects lookup.
+ * @param row,col The subtile; must be inside the grid.
+ * @return Returns amount of objects.
+ */
+unsigned int objlookup_subnums(const struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col)
+{
+    const unsigned short *start=olkp->start[row];
+    if (start==NULL)
+      return 0;
+    return start[col+1]-start[col];
+}
+
+/**
+ * Returns object with given index from a subtile.
+ * @param olkp Pointer to the objects lookup.
+ * @param row,col The subtile; must be inside the grid.
+ * @param num Index of the object on the subtile.
+ * @return Returns the object, or NULL if there's no such object.
+ */
+unsigned char *objlookup_get(const struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col,unsigned int num)
+{
+    const unsigned short *start=olkp->start[row];
+    if (start==NULL)
+      return NULL;
+    if (num >= start[col+1]-start[col])
+      return NULL;
+    return olkp->items[row][start[col]+num];
+}
+
+/**
+ * Adds object after all other objects on a subtile.
+ * @param olkp Pointer to the objects lookup.
+ * @param row,col The subtile; must be inside the grid.
+ * @param obj The object to add.
+ * @return Returns index of the object on the subtile, or -1 on error.
+ */
+int objlookup_add(struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col,unsigned char *obj)
+{
+    unsigned short *start=olkp->start[row];
+    if (start==NULL)
+    {
+      start=(unsigned short *)calloc(olkp->cols+1,sizeof(unsigned short));
+      if (start==NULL)
+        return -1;
+      olkp->start[row]=start;
+    }
+    unsigned int row_count=start[olkp->cols];
+    if (row_count >= USHRT_MAX)
+      return -1;
+    unsigned char **items=olkp->items[row];
+    if (row_count >= olkp->capacity[row])
+    {
+      /* Growing geometrically, so that loading many objects isn't quadratic */
+      unsigned int capacity=2*olkp->capacity[row];
+      if (capacity<8) capacity=8;
+      if (capacity>USHRT_MAX) capacity=USHRT_MAX;
+      items=(unsigned char **)realloc(items,capacity*sizeof(unsigned char *));
+      if (items==NULL)
+        return -1;
+      olkp->items[row]=items;
+      olkp->capacity[row]=capacity;
+    }
+    unsigned int pos=start[col+1];
+    memmove(items+pos+1,items+pos,(row_count-pos)*sizeof(unsigned char *));
+    items[pos]=obj;
+    unsigned int i;
+    for (i=col+1; i<=olkp->cols; i++)
+      start[i]++;
+    olkp->count++;
+    return pos-start[col];
+}
+
+/**
+ * Removes object with given index from a subtile. Other objects on the
+ * subtile are moved to fill the gap. The object isn't freed.
+ * @param olkp Pointer to the objects lookup.
+ * @param row,col The subtile; must be inside the grid.
+ * @param num Index of the object on the subtile.
+ * @return Returns the removed object, or NULL if there's no such object.
+ */
+unsigned char *objlookup_remove(struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col,unsigned int num)
+{
+    unsigned short *start=olkp->start[row];
+    if (start==NULL)
+      return NULL;
+    if (num >= start[col+1]-start[col])
+      return NULL;
+    unsigned char **items=olkp->items[row];
+    unsigned int row_count=start[olkp->cols];
+    unsigned int pos=start[col]+num;
+    unsigned char *obj=items[pos];
+    memmove(items+pos,items+pos+1,(row_count-pos-1)*sizeof(unsigned char *));
+    unsigned int i;
+    for (i=col+1; i<=olkp->cols; i++)
+      start[i]--;
+    olkp->count--;
+    row_count--;
+    if (row_count==0)
+    {
+      /* Empty rows take no memory */
+      free(start);
+      free(items);
+      olkp->start[row]=NULL;
+      olkp->items[row]=NULL;
+      olkp->capacity[row]=0;
+    } else
+    if (row_count < olkp->capacity[row]/4)
+    {
+      unsigned int capacity=olkp->capacity[row]/2;
+      items=(unsigned char **)realloc(items,capacity*sizeof(unsigned char *));
+      if (items!=NULL)
+      {
+        olkp->items[row]=items;
+        olkp->capacity[row]=capacity;
+      }
+    }
+    return obj;
+}
+
+/**
+ * Computes amount of memory used by the lookup, without the objects.
+ * @param olkp Pointer to the objects lookup.
+ * @return Returns the size, in bytes.
+ */
+unsigned long objlookup_memory(const struct OBJECTS_LOOKUP *olkp)
+{
+    if (olkp==NULL)
+      return 0;
+    unsigned long size=sizeof(struct OBJECTS_LOOKUP);
+    size+=olkp->rows*(sizeof(unsigned short *)+sizeof(unsigned char **)+sizeof(unsigned int));
+    unsigned int row;
+    for (row=0; row<olkp->rows; row++)
+    {
+      if (olkp->start[row]==NULL)
+        continue;
+      size+=(olkp->cols+1)*sizeof(unsigned short);
+      size+=olkp->capacity[row]*sizeof(unsigned char *);
+    }
+    return size;
+}
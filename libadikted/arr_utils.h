@@ -31,4 +31,34 @@ DLLIMPORT short format_data_fname(char **fullname, const char *data_path, const
 
 int arr_ushort_pos(const unsigned short *arr,unsigned short arr_item,int array_count);
 
+/**
+ * Objects of one kind, indexed by subtile. Objects from every row
+ * are kept in one array, ordered by subtile, and the row stores offset
+ * of the first object of every subtile (compressed sparse row).
+ * Rows with no objects have no arrays allocated; the items arrays
+ * grow geometrically, so that adding objects is cheap.
+ */
+struct OBJECTS_LOOKUP {
+    /* Number of rows, and number of subtiles in every row */
+    unsigned int rows;
+    unsigned int cols;
+    /* Offsets of objects of every subtile; objects of subtile (row,col) */
+    /* are items[row][start[row][col]] up to items[row][start[row][col+1]-1] */
+    unsigned short **start;
+    unsigned char ***items;
+    /* Amount of items allocated in every row */
+    unsigned int *capacity;
+    /* Number of objects in total */
+    unsigned int count;
+  };
+
+DLLIMPORT struct OBJECTS_LOOKUP *objlookup_create(unsigned int rows,unsigned int cols);
+DLLIMPORT void objlookup_free(struct OBJECTS_LOOKUP **olkp_ptr);
+DLLIMPORT void objlookup_clear(struct OBJECTS_LOOKUP *olkp);
+DLLIMPORT unsigned int objlookup_subnums(const struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col);
+DLLIMPORT unsigned char *objlookup_get(const struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col,unsigned int num);
+DLLIMPORT int objlookup_add(struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col,unsigned char *obj);
+DLLIMPORT unsigned char *objlookup_remove(struct OBJECTS_LOOKUP *olkp,unsigned int row,unsigned int col,unsigned int num);
+DLLIMPORT unsigned long objlookup_memory(const struct OBJECTS_LOOKUP *olkp);
+
 #endif /* BULL_ARRUTILS_H */
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "lbfileio.h"
 
 #include "bulcommn.h"
@@ -237,6 +238,42 @@ int read_palette_rgb(unsigned char *palette, const char *fname, unsigned int nCo
     return 0;
 }
 
+/**
+ * Converts time into local calendar time. Unlike localtime(),
+ * stores the result in given buffer instead of a shared one.
+ * @param timer The time to convert.
+ * @param result Buffer for the calendar time.
+ * @return Returns result, or NULL on error.
+ */
+struct tm *local_time_r(const time_t *timer,struct tm *result)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    if (localtime_s(result,timer)!=0)
+      return NULL;
+    return result;
+#else
+    return localtime_r(timer,result);
+#endif
+}
+
+/**
+ * Converts time into UTC calendar time. Unlike gmtime(),
+ * stores the result in given buffer instead of a shared one.
+ * @param timer The time to convert.
+ * @param result Buffer for the calendar time.
+ * @return Returns result, or NULL on error.
+ */
+struct tm *utc_time_r(const time_t *timer,struct tm *result)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    if (gmtime_s(result,timer)!=0)
+      return NULL;
+    return result;
+#else
+    return gmtime_r(timer,result);
+#endif
+}
+
 /**
  * Returns a random number within given range.
  */
@@ -23,6 +23,8 @@
 /* Routines */
 
 DLLIMPORT unsigned int rnd(const unsigned int range);
+DLLIMPORT struct tm *local_time_r(const time_t *timer,struct tm *result);
+DLLIMPORT struct tm *utc_time_r(const time_t *timer,struct tm *result);
 
 DLLIMPORT short write_bmp_fn_idx (const char *fname, int width, int height, const unsigned char *pal, 
 		const char *data, int red, int green, int blue, int mult);
@@ -48,6 +48,7 @@ long rnc_crc (const void *data, unsigned long len);
 #define RNC_UNPACKED_CRC_ERROR -5
 #define RNC_HEADER_VAL_ERROR   -6
 #define RNC_HUF_EXCEEDS_RANGE  -7
+#define RNC_MALLOC_ERROR       -8
 
 /**
  * Flags to ignore errors.
@@ -39,6 +39,10 @@
 #include "lev_things.h"
 #include "rng.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /**
  * Intensified player colors array.
  * This array containing color intensity added to bitmap
@@ -173,14 +177,11 @@ const char *palette_fname="PALETTE.DAT";
 const char *cube_fname="CUBE.DAT";
 const char *tmapanim_fname="TMAPANIM.DAT";
 
-struct MAPDRAW_DATA *glb_draw_data;
-
 void mdrand_setpos(struct MAPDRAW_DATA *draw_data,int sx,int sy)
 {
     draw_data->rand_subtl.x=sx;
     draw_data->rand_subtl.y=sy;
     draw_data->rand_count=0;
-    glb_draw_data=draw_data;
 }
 
 unsigned int mdrand_t8(struct MAPDRAW_DATA *draw_data,int tx,int ty,const unsigned int range)
@@ -190,7 +191,6 @@ unsigned int mdrand_t8(struct MAPDRAW_DATA *draw_data,int tx,int ty,const unsign
         draw_data->rand_subtl.x=tx*MAP_SUBNUM_X;
         draw_data->rand_subtl.y=ty*MAP_SUBNUM_Y;
         draw_data->rand_count=0;
-        glb_draw_data=draw_data;
     }
     int idx=((ty*MAP_SUBNUM_Y)*draw_data->subsize.x + tx*MAP_SUBNUM_X)*sizeof(int)+draw_data->rand_count;
     draw_data->rand_count++;
@@ -204,7 +204,6 @@ unsigned int mdrand_s8(struct MAPDRAW_DATA *draw_data,int sx,int sy,const unsign
         draw_data->rand_subtl.x=sx;
         draw_data->rand_subtl.y=sy;
         draw_data->rand_count=0;
-        glb_draw_data=draw_data;
     }
     int idx=((sy)*draw_data->subsize.x + sx)*sizeof(int)+draw_data->rand_count;
     draw_data->rand_count++;
@@ -218,16 +217,9 @@ unsigned int mdrand_nx8(struct MAPDRAW_DATA *draw_data,const unsigned int range)
     return (draw_data->rand_pool[idx%draw_data->rand_size]%range);
 }
 
-unsigned int mdrand_g8(const unsigned int range)
-{
-    int idx=((glb_draw_data->rand_subtl.y)*glb_draw_data->subsize.x + glb_draw_data->rand_subtl.x)*sizeof(int)+glb_draw_data->rand_count;
-    glb_draw_data->rand_count++;
-    return (glb_draw_data->rand_pool[idx%glb_draw_data->rand_size]%range);
-}
-
-void mdrand_g8_waste(const unsigned int num)
+void mdrand_waste(struct MAPDRAW_DATA *draw_data,const unsigned int num)
 {
-    glb_draw_data->rand_count+=num;
+    draw_data->rand_count+=num;
 }
 
 
@@ -240,7 +232,7 @@ void mdrand_g8_waste(const unsigned int num)
  */
 short load_palette(struct PALETTE_ENTRY *pal,char *fname)
 {
-    message_log(" load_palette: Starting");
+    message_log_lvl(MSGLOG_TRACE," load_palette: Starting");
     /* Reading file */
     struct MEMORY_FILE *mem;
     short result;
@@ -264,7 +256,7 @@ short load_palette(struct PALETTE_ENTRY *pal,char *fname)
         pal[i].o=0;
     }
     memfile_free(&mem);
-    message_log(" load_palette: Finished");
+    message_log_lvl(MSGLOG_TRACE," load_palette: Finished");
     return ERR_NONE;
 }
 
@@ -326,6 +318,7 @@ void draw_pixel_x4walpha_offs(unsigned char *dest,
 
 /**
  * Draws filled circle on given buffer.
+ * @param draw_data Map drawing data.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the circle center.
  * @param dest_size Dimensions of destination buffer.
@@ -334,7 +327,7 @@ void draw_pixel_x4walpha_offs(unsigned char *dest,
  * @param fcolor Fill color.
  * @param radius Circle radius.
  */
-void draw_circle_fill(unsigned char *dest,const struct IPOINT_2D dest_pos,
+void draw_circle_fill(const struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size,const unsigned int dest_scanln,
     const struct PALETTE_ENTRY *bcolor,const struct PALETTE_ENTRY *fcolor,
     int radius)
@@ -438,13 +431,14 @@ void draw_circle_fill(unsigned char *dest,const struct IPOINT_2D dest_pos,
         dx++;
         n+=invradius;
         if ((n>>6)>=SIN_ACOS_SIZE) break;
-        dy = (int)((radius * (glb_draw_data->sin_acos[(int)(n>>6)])) >> 16);
+        dy = (int)((radius * (draw_data->sin_acos[(int)(n>>6)])) >> 16);
       }
   }
 } 
 
 /**
  * Draws filled circle on given buffer by multiplying current pixel values.
+ * @param draw_data Map drawing data.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the circle center.
  * @param dest_size Dimensions of destination buffer.
@@ -453,7 +447,7 @@ void draw_circle_fill(unsigned char *dest,const struct IPOINT_2D dest_pos,
  * @param fcolor Fill color factors.
  * @param radius Circle radius.
  */
-void draw_circle_mul(unsigned char *dest,const struct IPOINT_2D dest_pos,
+void draw_circle_mul(const struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size,const unsigned int dest_scanln,
     const struct PALETTE_ENTRY *bcolor,const struct PALETTE_ENTRY *fcolor,
     int radius)
@@ -557,11 +551,94 @@ void draw_circle_mul(unsigned char *dest,const struct IPOINT_2D dest_pos,
         dx++;
         n+=invradius;
         if ((n>>6)>=SIN_ACOS_SIZE) break;
-        dy = (int)((radius * (glb_draw_data->sin_acos[(int)(n>>6)])) >> 16);
+        dy = (int)((radius * (draw_data->sin_acos[(int)(n>>6)])) >> 16);
       }
   }
 } 
 
+/**
+ * Places a row of premultiplied sprite pixels on RGB buffer.
+ * Gives the same result as draw_pixel_x4walpha_offs() for every pixel;
+ * with SSE2, eight bytes are blended at once on 16-bit values.
+ * @param dest The destination buffer, at first pixel of the row.
+ * @param premul Premultiplied colours, in buffer order.
+ * @param alpha Alpha values, repeated for every colour.
+ * @param count Number of bytes in the row (3 for every pixel).
+ */
+static void blend_premul_span_rgb(unsigned char *dest,
+    const unsigned short *premul,const unsigned char *alpha,int count)
+{
+    int i=0;
+#if defined(__SSE2__)
+    const __m128i zero=_mm_setzero_si128();
+    for (;i+8<=count;i+=8)
+    {
+      __m128i dst=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(dest+i)),zero);
+      __m128i alp=_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(alpha+i)),zero);
+      __m128i pre=_mm_loadu_si128((const __m128i *)(premul+i));
+      /* The sums never exceed 255*255, so they fit in 16 bits */
+      dst=_mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dst,alp),pre),8);
+      _mm_storel_epi64((__m128i *)(dest+i),_mm_packus_epi16(dst,dst));
+    }
+#endif
+    for (;i<count;i++)
+      dest[i]=(alpha[i]*dest[i]+premul[i])>>8;
+}
+
+/**
+ * Prepares premultiplied colours of all sprites in the list, so that
+ * placing a sprite on buffer doesn't need palette lookups.
+ * The colours are stored as the (255-alpha)*colour factors used by
+ * draw_pixel_x4walpha_offs(), so drawing results are identical.
+ * @param images The sprites list, decoded into a single buffer.
+ * @param pal Sprites palette.
+ * @return Returns ERR_NONE on success, error code on failure.
+ */
+short premultiply_sprites_rgb(struct IMAGELIST *images,const struct PALETTE_ENTRY *pal)
+{
+    if (images->arena==NULL)
+        return 1;
+    free(images->premul_arena);
+    /* Allocating at least one entry, so that NULL means error */
+    images->premul_arena=(unsigned char *)malloc(images->arena_used*3*(sizeof(unsigned short)+1)+1);
+    if (images->premul_arena==NULL)
+    {
+        message_error("premultiply_sprites_rgb: Cannot allocate memory.");
+        return 2;
+    }
+    unsigned short *premul=(unsigned short *)images->premul_arena;
+    unsigned char *alpha=images->premul_arena+images->arena_used*3*sizeof(unsigned short);
+    unsigned long picnum;
+    for (picnum=0;picnum<images->count;picnum++)
+    {
+        struct IMAGEITEM *item=&(images->items[picnum]);
+        if (item->data==NULL)
+        {
+            item->premul=NULL;
+            item->premul_alpha=NULL;
+            continue;
+        }
+        item->premul=premul;
+        item->premul_alpha=alpha;
+        unsigned long i;
+        unsigned long imgsize=item->width*item->height;
+        for (i=0;i<imgsize;i++)
+        {
+            const struct PALETTE_ENTRY *color=&pal[item->data[i]];
+            unsigned short opacity=255-item->alpha[i];
+            premul[0]=opacity*(color->b<<2);
+            premul[1]=opacity*(color->g<<2);
+            premul[2]=opacity*(color->r<<2);
+            alpha[0]=item->alpha[i];
+            alpha[1]=item->alpha[i];
+            alpha[2]=item->alpha[i];
+            premul+=3;
+            alpha+=3;
+        }
+    }
+    return ERR_NONE;
+}
+
 /**
  * Places given sprite on RGB buffer, centered on given position.
  * @param dest The destination buffer.
@@ -589,22 +666,38 @@ short place_sprite_cntr_on_buf_rgb(unsigned char *dest,const struct IPOINT_2D de
       dest_idx+=dest_scanln;
       src_idx+=spr->width;
     }
+    /* Clipping the columns once for the whole sprite */
+    long dest_sidx=dest_startx;
+    int w_start=0;
+    if (dest_sidx<0)
+    {
+      w_start=(-dest_sidx+2)/3;
+      if (w_start>spr->width) w_start=spr->width;
+      dest_sidx+=3*w_start;
+    }
+    int w_end=w_start;
+    if ((w_start<spr->width)&&(dest_sidx<=dest_maxidx))
+    {
+      w_end=w_start+(dest_maxidx-dest_sidx)/3+1;
+      if (w_end>spr->width) w_end=spr->width;
+    }
     for (;h<spr->height;h++)
     {
       if (dest_idx>=dest_fullsize) break;
-      long dest_sidx=dest_startx;
-      for (w=0;w<spr->width;w++)
+      if (spr->premul!=NULL)
       {
-          if (dest_sidx>=0) break;
-          dest_sidx+=3;
-      }
-      for (;w<spr->width;w++)
+          blend_premul_span_rgb(dest+dest_idx+dest_sidx,spr->premul+3*(src_idx+w_start),
+              spr->premul_alpha+3*(src_idx+w_start),3*(w_end-w_start));
+      } else
       {
-          if (dest_sidx>dest_maxidx) continue;
-          /* Using multiplication to place colour on the pixel */
-          draw_pixel_x4walpha_offs(dest,dest_idx+dest_sidx,
-              spr->alpha[src_idx+w],&pal[spr->data[src_idx+w]]);
-          dest_sidx+=3;
+          long dest_pidx=dest_idx+dest_sidx;
+          for (w=w_start;w<w_end;w++)
+          {
+            /* Using multiplication to place colour on the pixel */
+            draw_pixel_x4walpha_offs(dest,dest_pidx,
+                spr->alpha[src_idx+w],&pal[spr->data[src_idx+w]]);
+            dest_pidx+=3;
+          }
       }
       dest_idx+=dest_scanln;
       src_idx+=spr->width;
@@ -702,6 +795,7 @@ short draw_rect_sum_on_buffer(unsigned char *dest,const struct IPOINT_2D dest_po
 /**
  * Draws given texture on RGB buffer. Optimized for highly rescaled textures.
  * Requires the scale factor to be at least 8 (otherwise the picture may be blurred).
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -714,7 +808,7 @@ short draw_rect_sum_on_buffer(unsigned char *dest,const struct IPOINT_2D dest_po
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_avg4(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_avg4(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -736,13 +830,13 @@ short draw_texture_on_buffer_avg4(unsigned char *dest,const struct IPOINT_2D des
             src_idx+=src_size.x;
             continue;
         }
-        unsigned short ridy=mdrand_g8(scale.x);
+        unsigned short ridy=mdrand_nx8(draw_data,scale.x);
         for (i=0;i<rect_size.x;i++)
           if ((i%scale.x)==(ridy))
           {
               i+=scale.x-ridy-1;
-              ridy=mdrand_g8(scale.x);
-              mdrand_g8_waste(2);
+              ridy=mdrand_nx8(draw_data,scale.x);
+              mdrand_waste(draw_data,2);
           }
         dest_idx+=dest_scanln;
         src_idx+=src_size.x;
@@ -756,7 +850,7 @@ short draw_texture_on_buffer_avg4(unsigned char *dest,const struct IPOINT_2D des
       }
       if (dest_idx>=dest_fullsize) break;
       if (src_idx>=src_fullsize) break;
-      unsigned short ridy=mdrand_g8(scale.x);
+      unsigned short ridy=mdrand_nx8(draw_data,scale.x);
       /* Determine if we won't be out of source bounds for max value of src_add */
       if (src_idx+(scale.y-1)*src_size.x>=src_fullsize) break;
       unsigned long dest_sidx=dest_startx;
@@ -765,11 +859,11 @@ short draw_texture_on_buffer_avg4(unsigned char *dest,const struct IPOINT_2D des
           if ((i%scale.x)!=(ridy)) continue;
           int src_xfinal=src_pos.x+i;
           i+=scale.x-ridy-1;
-          ridy=mdrand_g8(scale.x);
+          ridy=mdrand_nx8(draw_data,scale.x);
           /* Select two source lines */
           int scaley_half=scale.y>>1;
-          int src_add1=(mdrand_g8(scaley_half))*src_size.x;
-          int src_add2=(mdrand_g8(scaley_half)+scaley_half)*src_size.x;
+          int src_add1=(mdrand_nx8(draw_data,scaley_half))*src_size.x;
+          int src_add2=(mdrand_nx8(draw_data,scaley_half)+scaley_half)*src_size.x;
           if (dest_sidx>dest_maxidx) continue;
           if (src_xfinal>=src_size.x) continue;
           /* Getting pixels for the average */
@@ -806,6 +900,7 @@ short draw_texture_on_buffer_avg4(unsigned char *dest,const struct IPOINT_2D des
  * Requires the scale factor to be at least 8 (otherwise the picture may be blurred).
  * Unsafe version - won't check if dest buffer is our of bounds.
  * Do not use it for partially displayed slabs, or it'll crash!
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -818,7 +913,7 @@ short draw_texture_on_buffer_avg4(unsigned char *dest,const struct IPOINT_2D des
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_avg4_unsafe(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_avg4_unsafe(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     __attribute__((unused)) const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -833,7 +928,7 @@ short draw_texture_on_buffer_avg4_unsafe(unsigned char *dest,const struct IPOINT
           src_idx+=src_size.x;
           continue;
       }
-      unsigned short ridy=mdrand_g8(scale.x);
+      unsigned short ridy=mdrand_nx8(draw_data,scale.x);
       /* Determine if we won't be out of source bounds for max value of src_add */
       for (i=0;i<rect_size.x;i++)
       {
@@ -841,11 +936,11 @@ short draw_texture_on_buffer_avg4_unsafe(unsigned char *dest,const struct IPOINT
           int src_xfinal=src_pos.x+i;
           i+=scale.x-ridy-1;
           unsigned long dest_sidx=dest_pos.x+(i/scale.x);
-          ridy=mdrand_g8(scale.x);
+          ridy=mdrand_nx8(draw_data,scale.x);
           /* Select two source lines */
           int scaley_half=scale.y>>1;
-          int src_add1=(mdrand_g8(scaley_half))*src_size.x;
-          int src_add2=(mdrand_g8(scaley_half)+scaley_half)*src_size.x;
+          int src_add1=(mdrand_nx8(draw_data,scaley_half))*src_size.x;
+          int src_add2=(mdrand_nx8(draw_data,scaley_half)+scaley_half)*src_size.x;
           src_add1+=src_idx+src_xfinal;
           src_add2+=src_idx+src_xfinal;
           /* Getting pixels for the average */
@@ -872,6 +967,7 @@ short draw_texture_on_buffer_avg4_unsafe(unsigned char *dest,const struct IPOINT
 /**
  * Draws given texture on RGB buffer. Optimized for medium rescaled textures.
  * Requires the scale factor to be at least 4 (otherwise the picture may be blurred).
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -884,7 +980,7 @@ short draw_texture_on_buffer_avg4_unsafe(unsigned char *dest,const struct IPOINT
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_avg2(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_avg2(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -903,13 +999,13 @@ short draw_texture_on_buffer_avg2(unsigned char *dest,const struct IPOINT_2D des
             src_idx+=src_size.x;
             continue;
         }
-        unsigned short ridy=mdrand_g8(scale.x);
+        unsigned short ridy=mdrand_nx8(draw_data,scale.x);
         for (i=0;i<rect_size.x;i++)
           if ((i%scale.x)==(ridy))
           {
               i+=scale.x-ridy-1;
-              ridy=mdrand_g8(scale.x);
-              mdrand_g8_waste(1);
+              ridy=mdrand_nx8(draw_data,scale.x);
+              mdrand_waste(draw_data,1);
           }
         dest_idx+=dest_scanln;
         src_idx+=src_size.x;
@@ -923,7 +1019,7 @@ short draw_texture_on_buffer_avg2(unsigned char *dest,const struct IPOINT_2D des
       }
       if (dest_idx>=dest_fullsize) break;
       if (src_idx>=src_fullsize) break;
-      unsigned short ridy=mdrand_g8(scale.x);
+      unsigned short ridy=mdrand_nx8(draw_data,scale.x);
       /* Determine if we won't be out of source bounds for max value of src_add */
       if (src_idx+(scale.y-1)*src_size.x>=src_fullsize) break;
       for (i=0;i<rect_size.x;i++)
@@ -932,8 +1028,8 @@ short draw_texture_on_buffer_avg2(unsigned char *dest,const struct IPOINT_2D des
           int src_xfinal=src_pos.x+i;
           i+=scale.x-ridy-1;
           unsigned long dest_sidx=dest_pos.x+(i/scale.x);
-          ridy=mdrand_g8(scale.x);
-          int src_add=mdrand_g8(scale.y)*src_size.x;
+          ridy=mdrand_nx8(draw_data,scale.x);
+          int src_add=mdrand_nx8(draw_data,scale.y)*src_size.x;
           if (dest_sidx>=dest_size.x) continue;
           if ((src_pos.x+i)>=src_size.x) continue;
           struct PALETTE_ENTRY *pxdata1;
@@ -962,6 +1058,7 @@ short draw_texture_on_buffer_avg2(unsigned char *dest,const struct IPOINT_2D des
 /**
  * Draws given texture on RGB buffer. Fast version, optimized for medium rescaled textures.
  * Requires the scale factor to be at least 4 (otherwise the picture may be blurred).
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -974,7 +1071,7 @@ short draw_texture_on_buffer_avg2(unsigned char *dest,const struct IPOINT_2D des
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-FASTCALL short draw_texture_on_buffer_avg2_fast(unsigned char *dest,const struct IPOINT_2D dest_pos,
+FASTCALL short draw_texture_on_buffer_avg2_fast(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -992,9 +1089,9 @@ FASTCALL short draw_texture_on_buffer_avg2_fast(unsigned char *dest,const struct
             src_idx+=src_size.x;
             continue;
         }
-        unsigned short ridy=mdrand_g8(scale.x);
+        unsigned short ridy=mdrand_nx8(draw_data,scale.x);
         for (i=0;i<rect_size.x;i++)
-          if ((i%scale.x)==(ridy)) mdrand_g8_waste(1);
+          if ((i%scale.x)==(ridy)) mdrand_waste(draw_data,1);
         dest_idx+=dest_scanln;
         src_idx+=src_size.x;
     }
@@ -1006,19 +1103,19 @@ FASTCALL short draw_texture_on_buffer_avg2_fast(unsigned char *dest,const struct
           continue;
       }
       if (dest_idx>=dest_fullsize) break;
-      unsigned short ridy=mdrand_g8(scale.x);
+      unsigned short ridy=mdrand_nx8(draw_data,scale.x);
       long dest_sidx=3*dest_pos.x;
       for (i=0;i<rect_size.x;i++)
       {
           if (dest_sidx>=0) break;
           if ((i%scale.x)!=(ridy)) continue;
-          mdrand_g8_waste(1);
+          mdrand_waste(draw_data,1);
           dest_sidx+=3;
       }
       for (;i<rect_size.x;i++)
       {
           if ((i%scale.x)!=(ridy)) continue;
-          int src_add=mdrand_g8(scale.y)*src_size.x;
+          int src_add=mdrand_nx8(draw_data,scale.y)*src_size.x;
           if (dest_sidx+2>=dest_scanln) continue;
           src_add+=src_idx+src_pos.x+i;
           struct PALETTE_ENTRY *pxdata1;
@@ -1041,6 +1138,7 @@ FASTCALL short draw_texture_on_buffer_avg2_fast(unsigned char *dest,const struct
  * Requires the scale factor to be at least 4 (otherwise the picture may be blurred).
  * Unsafe version - won't check if dest buffer is our of bounds.
  * Do not use it for partially displayed slabs, or it'll crash!
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1053,7 +1151,7 @@ FASTCALL short draw_texture_on_buffer_avg2_fast(unsigned char *dest,const struct
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-FASTCALL short draw_texture_on_buffer_avg2_fast_unsafe(unsigned char *dest,const struct IPOINT_2D dest_pos,
+FASTCALL short draw_texture_on_buffer_avg2_fast_unsafe(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     __attribute__((unused)) const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -1068,12 +1166,12 @@ FASTCALL short draw_texture_on_buffer_avg2_fast_unsafe(unsigned char *dest,const
           src_idx+=src_size.x;
           continue;
       }
-      unsigned short ridy=mdrand_g8(scale.x);
+      unsigned short ridy=mdrand_nx8(draw_data,scale.x);
       long dest_sidx=3*dest_pos.x;
       for (i=0;i<rect_size.x;i++)
       {
           if ((i%scale.x)!=(ridy)) continue;
-          int src_add=mdrand_g8(scale.y)*src_size.x;
+          int src_add=mdrand_nx8(draw_data,scale.y)*src_size.x;
           src_add+=src_idx+src_pos.x+i;
           struct PALETTE_ENTRY *pxdata1;
           struct PALETTE_ENTRY *pxdata2;
@@ -1092,6 +1190,7 @@ FASTCALL short draw_texture_on_buffer_avg2_fast_unsafe(unsigned char *dest,const
 
 /**
  * Draws given texture on RGB buffer. Optimized for low rescaled textures.
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1104,7 +1203,7 @@ FASTCALL short draw_texture_on_buffer_avg2_fast_unsafe(unsigned char *dest,const
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_noavg(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -1125,14 +1224,14 @@ short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D de
             src_idx+=src_size.x;
             continue;
         }
-        unsigned short ridy=mdrand_g8(scale.x);
+        unsigned short ridy=mdrand_nx8(draw_data,scale.x);
         for (i=0;i<rect_size.x;i++)
         {
             if ((i%scale.x)==(ridy))
             {
                 i+=scale.x-ridy-1;
-                ridy=mdrand_g8(scale.x);
-                mdrand_g8_waste(1);
+                ridy=mdrand_nx8(draw_data,scale.x);
+                mdrand_waste(draw_data,1);
             }
         }        
         dest_idx+=dest_scanln;
@@ -1145,7 +1244,7 @@ short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D de
             src_idx+=src_size.x;
             continue;
         }
-        unsigned short ridy=mdrand_g8(scale.x);
+        unsigned short ridy=mdrand_nx8(draw_data,scale.x);
         /* The bound conditions are rarely true - this is why they are here, not before */
         if (dest_idx >= dest_fullsize) break;
         if (src_idx+(scale.y-1)*src_size.x >= src_fullsize) break;
@@ -1156,8 +1255,8 @@ short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D de
             if ((i%scale.x)==(ridy))
             {
               i+=scale.x-ridy-1;
-              ridy=mdrand_g8(scale.x);
-              mdrand_g8_waste(1);
+              ridy=mdrand_nx8(draw_data,scale.x);
+              mdrand_waste(draw_data,1);
               dest_sidx+=3;
             }
         }
@@ -1166,8 +1265,8 @@ short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D de
             if ((i%scale.x)!=(ridy)) continue;
             int src_xfinal=src_pos.x+i;
             i+=scale.x-ridy-1;
-            ridy=mdrand_g8(scale.x);
-            int src_add=src_idx+mdrand_g8(scale.y)*src_size.x;
+            ridy=mdrand_nx8(draw_data,scale.x);
+            int src_add=src_idx+mdrand_nx8(draw_data,scale.y)*src_size.x;
             if (dest_sidx>dest_maxidx) continue;
             if (src_xfinal>=src_size.x) continue;
             struct PALETTE_ENTRY *pxdata=&pal[src[src_add+src_xfinal]];
@@ -1186,6 +1285,7 @@ short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D de
  * Draws given texture on RGB buffer. Optimized for low rescaled textures.
  * Unsafe version - won't check if dest buffer is our of bounds.
  * Do not use it for partially displayed slabs, or it'll crash!
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1198,7 +1298,7 @@ short draw_texture_on_buffer_noavg(unsigned char *dest,const struct IPOINT_2D de
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_noavg_unsafe(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_noavg_unsafe(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     __attribute__((unused)) const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
@@ -1214,7 +1314,7 @@ short draw_texture_on_buffer_noavg_unsafe(unsigned char *dest,const struct IPOIN
             src_idx+=src_size.x;
             continue;
         }
-        unsigned short ridy=mdrand_g8(scale.x);
+        unsigned short ridy=mdrand_nx8(draw_data,scale.x);
         long dest_sidx=3*dest_pos.x;
         /* Danger - We asume that dest_sidx is not less than zero here! */
         for (i=0;i<rect_size.x;i++)
@@ -1222,8 +1322,8 @@ short draw_texture_on_buffer_noavg_unsafe(unsigned char *dest,const struct IPOIN
             if ((i%scale.x)!=(ridy)) continue;
             int src_add=src_pos.x+i;
             i+=scale.x-ridy-1;
-            ridy=mdrand_g8(scale.x);
-            src_add+=src_idx+mdrand_g8(scale.y)*src_size.x;
+            ridy=mdrand_nx8(draw_data,scale.x);
+            src_add+=src_idx+mdrand_nx8(draw_data,scale.y)*src_size.x;
             /* Danger - we assume that dest_sidx is less than scanline length,
                and src_pos.x+i is less or equal src_size.x here! */
             struct PALETTE_ENTRY *pxdata=&pal[src[src_add]];
@@ -1293,6 +1393,7 @@ short draw_texture_on_buffer_noscale(unsigned char *dest,const struct IPOINT_2D
 /**
  * Draws given texture on RGB buffer.
  * Select best quality drawing method based on scale parameter.
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1305,24 +1406,24 @@ short draw_texture_on_buffer_noscale(unsigned char *dest,const struct IPOINT_2D
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
 {
     if (scale.x>7)
-        return draw_texture_on_buffer_avg4(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_avg4(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
     else
     if (scale.x>3)
-        return draw_texture_on_buffer_avg2(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_avg2(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
     else
     if ((scale.x==1)&&(scale.y==1))
         return draw_texture_on_buffer_noscale(dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal);
     else
-        return draw_texture_on_buffer_noavg(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_noavg(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
 }
 
@@ -1331,6 +1432,7 @@ short draw_texture_on_buffer(unsigned char *dest,const struct IPOINT_2D dest_pos
  * Select best quality drawing method based on scale parameter.
  * Unsafe version - won't check if dest buffer is our of bounds.
  * Do not use it for partially displayed slabs, or it'll crash!
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1343,30 +1445,31 @@ short draw_texture_on_buffer(unsigned char *dest,const struct IPOINT_2D dest_pos
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_unsafe(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_unsafe(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
 {
     if (scale.x>7)
-        return draw_texture_on_buffer_avg4_unsafe(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_avg4_unsafe(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
     else
     if (scale.x>3)
-        return draw_texture_on_buffer_avg2(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_avg2(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
     else
     if ((scale.x==1)&&(scale.y==1))
         return draw_texture_on_buffer_noscale(dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal);
     else
-        return draw_texture_on_buffer_noavg_unsafe(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_noavg_unsafe(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
 }
 
 /**
  * Draws given texture on RGB buffer.
  * Selects best speed drawing method based on scale parameter.
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1379,20 +1482,20 @@ short draw_texture_on_buffer_unsafe(unsigned char *dest,const struct IPOINT_2D d
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_fast(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_fast(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
 {
     if (scale.x>7)
-        return draw_texture_on_buffer_avg2_fast(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_avg2_fast(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
     else
     if ((scale.x==1)&&(scale.y==1))
         return draw_texture_on_buffer_noscale(dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal);
     else
-        return draw_texture_on_buffer_noavg(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_noavg(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
 }
 
@@ -1401,6 +1504,7 @@ short draw_texture_on_buffer_fast(unsigned char *dest,const struct IPOINT_2D des
  * Selects best speed drawing method based on scale parameter.
  * Unsafe version - won't check if dest buffer is our of bounds.
  * Do not use it for partially displayed slabs, or it'll crash!
+ * @param draw_data Map drawing data, used as source of random values.
  * @param dest The destination buffer.
  * @param dest_pos Position in destination buffer of the texture top left.
  * @param dest_size Dimensions of destination buffer.
@@ -1413,32 +1517,33 @@ short draw_texture_on_buffer_fast(unsigned char *dest,const struct IPOINT_2D des
  * @param scale Destination buffer scale.
  * @return Returns ERR_NONE on success, error code on failure.
  */
-short draw_texture_on_buffer_fast_unsafe(unsigned char *dest,const struct IPOINT_2D dest_pos,
+short draw_texture_on_buffer_fast_unsafe(struct MAPDRAW_DATA *draw_data,unsigned char *dest,const struct IPOINT_2D dest_pos,
     const struct IPOINT_2D dest_size, const unsigned int dest_scanln,
     const unsigned char *src,const struct IPOINT_2D src_pos,const struct IPOINT_2D src_size,
     const struct IPOINT_2D rect_size,struct PALETTE_ENTRY *pal,const struct IPOINT_2D scale)
 {
     if (scale.x>7)
-        return draw_texture_on_buffer_avg2_fast_unsafe(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_avg2_fast_unsafe(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
     else
     if ((scale.x==1)&&(scale.y==1))
         return draw_texture_on_buffer_noscale(dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal);
     else
-        return draw_texture_on_buffer_noavg_unsafe(dest,dest_pos,dest_size,
+        return draw_texture_on_buffer_noavg_unsafe(draw_data,dest,dest_pos,dest_size,
             dest_scanln,src,src_pos,src_size,rect_size,pal,scale);
 }
 
 /**
  * Gives texture coords for given texture index.
+ * @param draw_data Map drawing data, used as source of random values.
  * @param texture_pos Destination point for storing coordinates.
  * @param cubes The CUBES_DATA structure.
  * @param textr_idx Index of the texture.
  * @param anim_frame Number of the animation frame.
  * @return Returns ERR_NONE on success, and texture coords in texture_pos parameter.
  */
-short texture_index_to_texture_pos(struct IPOINT_2D *texture_pos,
+short texture_index_to_texture_pos(struct MAPDRAW_DATA *draw_data,struct IPOINT_2D *texture_pos,
     const struct CUBES_DATA *cubes,unsigned short textr_idx,unsigned int anim_frame)
 {
     short result=ERR_NONE;
@@ -1451,22 +1556,22 @@ short texture_index_to_texture_pos(struct IPOINT_2D *texture_pos,
             int frame;
             if ((textr_idx<12)||(textr_idx>37))
             {
-                frame=anim_frame+mdrand_g8(8);
+                frame=anim_frame+mdrand_nx8(draw_data,8);
             } else
             {
                 frame=anim_frame;
-                mdrand_g8_waste(1);
+                mdrand_waste(draw_data,1);
             }
             textr_idx=cubes->anitx[textr_idx].data[frame%8];
         } else
         {
             textr_idx=1;
-            mdrand_g8_waste(1);
+            mdrand_waste(draw_data,1);
             result=ERR_DRAW_BADTXTR;
         }
     } else
     {
-        mdrand_g8_waste(1);
+        mdrand_waste(draw_data,1);
     }
     texture_pos->x=(textr_idx&7)*TEXTURE_SIZE_X;
     texture_pos->y=((textr_idx>>3)&127)*TEXTURE_SIZE_Y;
@@ -1475,6 +1580,7 @@ short texture_index_to_texture_pos(struct IPOINT_2D *texture_pos,
 
 /**
  * Gives texture coords for top of the cube with given index.
+ * @param draw_data Map drawing data, used as source of random values.
  * @param texture_pos Destination point for storing coordinates.
  * @param cubes The CUBES_DATA structure.
  * @param cube_idx Index of the source cube.
@@ -1482,7 +1588,7 @@ short texture_index_to_texture_pos(struct IPOINT_2D *texture_pos,
  * @return Returns ERR_NONE on success, and texture coords for top of the cube
  *     in texture_pos parameter.
  */
-short get_top_texture_pos(struct IPOINT_2D *texture_pos,
+short get_top_texture_pos(struct MAPDRAW_DATA *draw_data,struct IPOINT_2D *texture_pos,
     const struct CUBES_DATA *cubes,unsigned short cube_idx,unsigned int anim)
 {
     /* Retrieving texture top index */
@@ -1495,7 +1601,7 @@ short get_top_texture_pos(struct IPOINT_2D *texture_pos,
     {
         textr_top=1;
     }
-    result=texture_index_to_texture_pos(texture_pos,cubes,textr_top,anim);
+    result=texture_index_to_texture_pos(draw_data,texture_pos,cubes,textr_top,anim);
     if (textr_top==1)
         return ERR_DRAW_BADCUBE;
     return result;
@@ -1503,6 +1609,8 @@ short get_top_texture_pos(struct IPOINT_2D *texture_pos,
 
 /**
  * Draws given LEVEL on given buffer, using graphics and options from MAPDRAW_DATA.
+ * The level is only read, so it may be drawn while other threads read it,
+ * but not while it is changed.
  * @param dest The destination buffer.
  * @param lvl Source level to draw.
  * @param draw_data Graphics textures, sprites and options.
@@ -1541,12 +1649,12 @@ short draw_map_on_buffer(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
           dest_pos.x=i*(scaled_txtr_size.x)-(draw_data->start.x%scaled_txtr_size.x);
-          draw_texture_on_buffer(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
       }
     }
@@ -1561,12 +1669,12 @@ short draw_map_on_buffer(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
           dest_pos.x=-(draw_data->start.x%scaled_txtr_size.x);
-          draw_texture_on_buffer(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
       }
       for (i=1; i<stile_count.x; i++)
@@ -1575,12 +1683,12 @@ short draw_map_on_buffer(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
           dest_pos.x=i*(scaled_txtr_size.x)-(draw_data->start.x%scaled_txtr_size.x);
-          draw_texture_on_buffer_unsafe(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer_unsafe(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
       }
       { /* i=stile_count.x */
@@ -1588,12 +1696,12 @@ short draw_map_on_buffer(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
           dest_pos.x=i*(scaled_txtr_size.x)-(draw_data->start.x%scaled_txtr_size.x);
-          draw_texture_on_buffer(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
       }
     }
@@ -1607,12 +1715,12 @@ short draw_map_on_buffer(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
           dest_pos.x=i*(scaled_txtr_size.x)-(draw_data->start.x%scaled_txtr_size.x);
-          draw_texture_on_buffer(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
       }
     }
@@ -1691,11 +1799,11 @@ short draw_map_on_buffer_fast(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
-          draw_texture_on_buffer_fast(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer_fast(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
           dest_pos.x+=scaled_txtr_size.x;
       }
@@ -1713,11 +1821,11 @@ short draw_map_on_buffer_fast(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
-          draw_texture_on_buffer_fast(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer_fast(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
           dest_pos.x+=scaled_txtr_size.x;
       }
@@ -1729,11 +1837,11 @@ short draw_map_on_buffer_fast(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
-          draw_texture_on_buffer_fast_unsafe(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer_fast_unsafe(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
           dest_pos.x+=scaled_txtr_size.x;
       }
@@ -1744,11 +1852,11 @@ short draw_map_on_buffer_fast(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
-          draw_texture_on_buffer_fast(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer_fast(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
           dest_pos.x+=scaled_txtr_size.x;
       }
@@ -1764,11 +1872,11 @@ short draw_map_on_buffer_fast(char *dest,const struct LEVEL *lvl,
           clmentry=get_subtile_column(lvl,start.x+i,start.y+j);
           cube_idx=get_clm_entry_topcube(clmentry);
           if (cube_idx>0)
-              get_top_texture_pos(&texture_pos,draw_data->cubes,cube_idx,anim);
+              get_top_texture_pos(draw_data,&texture_pos,draw_data->cubes,cube_idx,anim);
           else
-              texture_index_to_texture_pos(&texture_pos,draw_data->cubes,
+              texture_index_to_texture_pos(draw_data,&texture_pos,draw_data->cubes,
                   get_clm_entry_base(clmentry),anim);
-          draw_texture_on_buffer_fast(dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
+          draw_texture_on_buffer_fast(draw_data,dest,dest_pos,dest_size,draw_data->dest_scanln,draw_data->texture,
               texture_pos,texture_size,single_txtr_size,draw_data->palette,scale);
           dest_pos.x+=scaled_txtr_size.x;
       }
@@ -1854,7 +1962,7 @@ short draw_things_on_buffer(char *dest,const struct LEVEL *lvl,struct MAPDRAW_DA
             if (is_gold(thing))
             {
               /* Show only some of the gold on large scaling */
-              if ((draw_data->rescale<4)||(mdrand_g8(7)==0))
+              if ((draw_data->rescale<4)||(mdrand_nx8(draw_data,7)==0))
                 spr_idx=510;
             } else
             if (is_food(thing))
@@ -1952,11 +2060,11 @@ short draw_things_on_buffer(char *dest,const struct LEVEL *lvl,struct MAPDRAW_DA
               fcolor=&thingcircle_palette_weak[type_idx%THINGCIRCLE_PALETTE_SIZE];
               radius=get_objcircle_ranged_radius(scaled_txtr_size,
                   get_thing_range_adv(obj),0);
-              draw_circle_mul(dest,dest_pos,dest_scaled_size,
+              draw_circle_mul(draw_data,dest,dest_pos,dest_scaled_size,
                   draw_data->dest_scanln,bcolor,fcolor,radius);
             } else
             {
-              draw_circle_fill(dest,dest_pos,dest_scaled_size,
+              draw_circle_fill(draw_data,dest,dest_pos,dest_scaled_size,
                   draw_data->dest_scanln,bcolor,&ecolor,tngradius);
             }
           }
@@ -1972,7 +2080,7 @@ short draw_things_on_buffer(char *dest,const struct LEVEL *lvl,struct MAPDRAW_DA
             dest_pos.y+=((unsigned int)get_stlight_subtpos_y(obj)*scaled_txtr_size.y)>>8;
             radius=get_objcircle_ranged_radius(scaled_txtr_size,
                 get_stlight_range_adv(obj),1);
-            draw_circle_mul(dest,dest_pos,dest_scaled_size,
+            draw_circle_mul(draw_data,dest,dest_pos,dest_scaled_size,
                 draw_data->dest_scanln,bcolor,fcolor,radius);
           }
           last_obj=get_actnpt_subnums(lvl,start.x+i,start.y+j)-1;
@@ -1987,7 +2095,7 @@ short draw_things_on_buffer(char *dest,const struct LEVEL *lvl,struct MAPDRAW_DA
             dest_pos.y+=((unsigned int)get_actnpt_subtpos_y(obj)*scaled_txtr_size.y)>>8;
             radius=get_objcircle_ranged_radius(scaled_txtr_size,
                 get_actnpt_range_adv(obj),0);
-            draw_circle_mul(dest,dest_pos,dest_scaled_size,
+            draw_circle_mul(draw_data,dest,dest_pos,dest_scaled_size,
                 draw_data->dest_scanln,bcolor,fcolor,radius);
           }
         }
@@ -2043,7 +2151,7 @@ short draw_text_on_buffer(char *dest,const int px,const int py,
  */
 short write_bitmap_rgb(const char *fname,const unsigned char *data,const struct IPOINT_2D size)
 {
-  message_log("  write_bitmap_rgb: Starting");
+  message_log_lvl(MSGLOG_TRACE,"  write_bitmap_rgb: Starting");
   if ((fname==NULL)||(data==NULL))
   {
       message_error("Internal error - null poiner detected in write_bitmap_rgb");
@@ -2061,7 +2169,7 @@ short write_bitmap_rgb(const char *fname,const unsigned char *data,const struct
   short result;
   result=write_bmp_fp_24b(out,size.x,size.y,data);
   fclose(out);
-  message_log("  write_bitmap_rgb: Finished");
+  message_log_lvl(MSGLOG_TRACE,"  write_bitmap_rgb: Finished");
   return result;
 }
 
@@ -2148,6 +2256,8 @@ short set_draw_data_rect_sl4(struct MAPDRAW_DATA *draw_data,
  * Allocates and fills the MAPDRAW_DATA structure.
  * Loads all data files needed to draw the map.
  * Sets drawing rectangle from (0,0) to bmp_size.
+ * Drawing keeps its random position inside MAPDRAW_DATA, so every
+ * thread which draws needs its own structure.
  * @param draw_data Destination structure.
  * @param opts Drawing options.
  * @param subtl Size of the map, in subtiles.
@@ -2175,6 +2285,8 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     (*draw_data)->images=malloc(sizeof(struct IMAGELIST));
     (*draw_data)->images->items = NULL;                                 /* prevents double free (crash) in case of error */
     (*draw_data)->images->count = 0;                                    /* prevents segfault in case of error */
+    (*draw_data)->images->arena = NULL;
+    (*draw_data)->images->premul_arena = NULL;
     (*draw_data)->rand_size=total_subtiles*sizeof(int);
     (*draw_data)->rand_pool=malloc((*draw_data)->rand_size);
     if ((*draw_data)->cubes != NULL)
@@ -2218,7 +2330,7 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     result=true;
     if (result)
     {
-      message_log(" load_draw_data: Loading \"%s\"",palette_fname);
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading \"%s\"",palette_fname);
       fnames=NULL;
       result = format_data_fname(&fnames,opts->data_path,palette_fname);
       if (result)
@@ -2229,7 +2341,7 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     }
     if (result)
     {
-      message_log(" load_draw_data: Loading \"%s\"",cube_fname);
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading \"%s\"",cube_fname);
       fnames=NULL;
       format_data_fname(&fnames,opts->data_path,cube_fname);
       result = (load_cubedata((*draw_data)->cubes,fnames)==ERR_NONE);
@@ -2239,7 +2351,7 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     }
     if (result)
     {
-      message_log(" load_draw_data: Loading \"%s\"",tmapanim_fname);
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading \"%s\"",tmapanim_fname);
       fnames=NULL;
       format_data_fname(&fnames,opts->data_path,tmapanim_fname);
       result = (load_textureanim((*draw_data)->cubes,fnames)==ERR_NONE);
@@ -2249,13 +2361,13 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     }
     if (result)
     {
-      message_log(" load_draw_data: Loading texture");
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading texture");
       result = (change_draw_data_texture(*draw_data,opts,textr_idx)==ERR_NONE);
     }
     /* Reading DAT,TAB and extracting images */
     if (result)
     {
-      message_log(" load_draw_data: Loading gui2-0 icons");
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading gui2-0 icons");
       char *tabfname;
       fnames=NULL;
       tabfname=NULL;
@@ -2271,7 +2383,7 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     /* Reading font0 DAT,TAB and extracting images */
     if ((result)&&(opts->bmfonts&BMFONT_LOAD_SMALL))
     {
-      message_log(" load_draw_data: Loading small font");
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading small font");
       char *tabfname;
       fnames=NULL;
       tabfname=NULL;
@@ -2287,7 +2399,7 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
     /* Reading font1 DAT,TAB and extracting images */
     if ((result)&&(opts->bmfonts&BMFONT_LOAD_LARGE))
     {
-      message_log(" load_draw_data: Loading large font");
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Loading large font");
       char *tabfname;
       fnames=NULL;
       tabfname=NULL;
@@ -2300,10 +2412,21 @@ short load_draw_data(struct MAPDRAW_DATA **draw_data,const struct MAPDRAW_OPTION
       free(fnames);
       free(tabfname);
     }
+    /* Sprites are blended with premultiplied colours; */
+    /* if these can't be prepared, palette is used when drawing */
+    if (result)
+    {
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Premultiplying sprites");
+      premultiply_sprites_rgb((*draw_data)->images,(*draw_data)->palette);
+      if (opts->bmfonts&BMFONT_LOAD_SMALL)
+        premultiply_sprites_rgb((*draw_data)->font0,(*draw_data)->palette);
+      if (opts->bmfonts&BMFONT_LOAD_LARGE)
+        premultiply_sprites_rgb((*draw_data)->font1,(*draw_data)->palette);
+    }
     /* Preparing constant arrays */
     if (result)
     {
-      message_log(" load_draw_data: Preparing constant arrays");
+      message_log_lvl(MSGLOG_TRACE," load_draw_data: Preparing constant arrays");
       for(i=0;i<SIN_ACOS_SIZE;i++)                 /* create the sin(arccos(x)) table. */
       {
         (*draw_data)->sin_acos[i]=sin(acos(((float)i)/SIN_ACOS_SIZE))*0x10000L;
@@ -37,6 +37,7 @@ enum TNGFLG_OPTIONS {
 struct LEVEL;
 struct CUBES_DATA;
 struct IMAGELIST;
+struct IMAGEITEM;
 
 #define SIN_ACOS_SIZE 1024
 
@@ -98,6 +99,12 @@ DLLIMPORT short draw_text_on_buffer(char *dest,const int px,const int py,
 
 /* Helper functions */
 
+DLLIMPORT short load_palette(struct PALETTE_ENTRY *pal,char *fname);
+DLLIMPORT short premultiply_sprites_rgb(struct IMAGELIST *images,const struct PALETTE_ENTRY *pal);
+DLLIMPORT short place_sprite_cntr_on_buf_rgb(unsigned char *dest,const struct IPOINT_2D dest_pos,
+    const struct IPOINT_2D dest_size,const unsigned int dest_scanln,
+    const struct PALETTE_ENTRY *pal,const struct IMAGEITEM *spr);
+
 DLLIMPORT short change_draw_data_texture(struct MAPDRAW_DATA *draw_data,
     const struct MAPDRAW_OPTIONS *opts,const int textr_idx);
 DLLIMPORT short set_draw_data_rect(struct MAPDRAW_DATA *draw_data,
@@ -0,0 +1,921 @@
+/******************************************************************************/
+/** @file enrnc.c
+ * RNC compression support.
+ * @par Purpose:
+ *   Compiled normally, this file is a re-entrant code module exporting
+ *   `rnc_pack' and `rnc_pack_bound'. It creates RNC method 1 packed data,
+ *   which can be unpacked by `rnc_unpack' from dernc.c.
+ *   Compiled with MAIN_ENRNC defined, it's a standalone program which will
+ *   pack or unpack files, or test packing on given files. It has to be
+ *   linked with dernc.c and lbfileio.c.
+ * @par Comment:
+ *   Matches are found with hash chains; Huffman tables are built
+ *   separately for every chunk of packed data.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAIN_ENRNC
+# include <stdio.h>
+# include <time.h>
+#endif
+
+#define INTERNAL
+#include "lbfileio.h"
+#include "dernc.h"
+#include "enrnc.h"
+
+/**
+ * Amount of input bytes covered by a single chunk, each chunk
+ * has its own Huffman tables.
+ */
+#define RNC_CHUNK_SIZE   0x3000
+/**
+ * Max. distance of a match; also size of the hash chain ring buffer.
+ */
+#define RNC_WINDOW_SIZE  0x8000
+#define RNC_WINDOW_MASK  (RNC_WINDOW_SIZE-1)
+#define RNC_MIN_MATCH    2
+#define RNC_MAX_MATCH    255
+/**
+ * Length-2 matches are only worth it at a short distance.
+ */
+#define RNC_MAX_OFFSET_MATCH2 256
+#define RNC_HASH_SIZE    0x10000
+#define RNC_HUF_SYMBOLS  16
+/**
+ * Packed data is followed by zero padding, because the unpacker
+ * requires a few bytes to be available at start of each chunk.
+ */
+#define RNC_PACK_PADDING 6
+
+#ifdef MAIN_ENRNC
+int main_pack (char *pname, char *iname, char *oname, int level);
+int main_unpack (char *pname, char *iname, char *oname);
+int main_test (char *pname, char *iname);
+int read_whole_file (char *iname, unsigned char **buf, unsigned long *len);
+int write_whole_file (char *oname, unsigned char *buf, unsigned long len);
+
+/**
+ * Shows usage if building stand-alone RNC tool.
+ * @param fname Name of the executable file.
+ * @return Returns 1 on success.
+ */
+short show_usage(char *fname)
+{
+    printf("usage:\n");
+    printf("    %s p [-l<level>] <infile> <outfile>\n", fname);
+    printf("    %s u <infile> <outfile>\n", fname);
+    printf("    %s t <files>\n", fname);
+    printf("commands:\n");
+    printf("    p - pack the file, level %d-%d (default %d)\n",
+        RNC_PACK_LEVEL_MIN,RNC_PACK_LEVEL_MAX,RNC_PACK_LEVEL_DEFAULT);
+    printf("    u - unpack the file\n");
+    printf("    t - test pack/unpack round trip on all levels\n");
+    return 1;
+}
+
+/**
+ * Main function if building stand-alone RNC tool.
+ * @param argc Command line arguments count.
+ * @param argv Command line arguments vector.
+ * @return Returns 0 on success.
+ */
+int main(int argc, char **argv)
+{
+    int level=RNC_PACK_LEVEL_DEFAULT;
+    int i;
+
+    printf("\nPRO-PACK's alternate RNC files packer\n");
+    printf("-------------------------------\n");
+
+    if (argc<3)
+    {
+        show_usage(*argv);
+        return 1;
+    }
+    switch (argv[1][0])
+    {
+      case 'p':
+        i=2;
+        if (strncmp(argv[i],"-l",2)==0)
+        {
+            level=atoi(argv[i]+2);
+            i++;
+        }
+        if (argc-i != 2)
+        {
+            show_usage(*argv);
+            return 1;
+        }
+        printf("Packing %s to %s...\n",argv[i],argv[i+1]);
+        return main_pack (*argv, argv[i], argv[i+1], level);
+      case 'u':
+        if (argc != 4)
+        {
+            show_usage(*argv);
+            return 1;
+        }
+        printf("Extracting %s to %s...\n",argv[2],argv[3]);
+        return main_unpack (*argv, argv[2], argv[3]);
+      case 't':
+        for (i=2; i < argc; i++)
+        {
+            if (main_test (*argv, argv[i]))
+                return 1;
+        }
+        return 0;
+      default:
+        show_usage(*argv);
+        return 1;
+    }
+}
+
+/**
+ * Reads whole file into newly allocated buffer, with 8 safety bytes at end.
+ * @param iname Source file name.
+ * @param buf Output - the allocated buffer.
+ * @param len Output - file length.
+ * @return Returns 0 on success. On error prints a message
+ *     and returns nonzero value.
+ */
+int read_whole_file (char *iname, unsigned char **buf, unsigned long *len)
+{
+    FILE *ifp;
+    long flen;
+    ifp = fopen(iname, "rb");
+    if (!ifp)
+    {
+        perror(iname);
+        return 1;
+    }
+    fseek (ifp, 0L, SEEK_END);
+    flen = ftell (ifp);
+    rewind (ifp);
+    if (flen < 0)
+    {
+        fclose(ifp);
+        perror(iname);
+        return 1;
+    }
+    *buf = malloc(flen+8);
+    if (*buf==NULL)
+    {
+        fclose(ifp);
+        fprintf (stderr, "Out of memory.\n");
+        return 1;
+    }
+    memset(*buf,0,flen+8);
+    *len=fread (*buf, 1, flen, ifp);
+    fclose(ifp);
+    return 0;
+}
+
+/**
+ * Writes a buffer into file.
+ * @param oname Destination file name.
+ * @param buf The buffer to write.
+ * @param len Buffer length.
+ * @return Returns 0 on success. On error prints a message
+ *     and returns nonzero value.
+ */
+int write_whole_file (char *oname, unsigned char *buf, unsigned long len)
+{
+    FILE *ofp;
+    ofp = fopen(oname, "wb");
+    if (!ofp)
+    {
+        perror(oname);
+        return 1;
+    }
+    if ((fwrite (buf, 1, len, ofp) != len) || (fclose (ofp) != 0))
+    {
+        perror(oname);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Packs single file if building stand-alone RNC tool.
+ * @param pname Name of the program executable.
+ * @param iname File name of the input file.
+ * @param oname File name of the packed output.
+ * @param level Compression level.
+ * @return Returns 0 on success. On error prints a message
+ *     and returns nonzero value.
+ */
+int main_pack (char *pname, char *iname, char *oname, int level)
+{
+    unsigned char *unpacked, *packed;
+    unsigned long ulen;
+    long plen;
+    if (read_whole_file(iname, &unpacked, &ulen))
+        return 1;
+    packed = malloc(rnc_pack_bound(ulen));
+    if (packed==NULL)
+    {
+        free(unpacked);
+        perror(pname);
+        return 1;
+    }
+    plen = rnc_pack(unpacked, ulen, packed, level);
+    free(unpacked);
+    if (plen < 0)
+    {
+        free(packed);
+        printf("Error: %s\n", rnc_error (plen));
+        return 1;
+    }
+    printf("Packed %lu bytes into %ld bytes.\n",ulen,plen);
+    if (write_whole_file(oname, packed, plen))
+    {
+        free(packed);
+        return 1;
+    }
+    free(packed);
+    return 0;
+}
+
+/**
+ * Unpacks single file if building stand-alone RNC tool.
+ * @param pname Name of the program executable.
+ * @param iname File name of the compressed input file.
+ * @param oname File name of the decompressed output.
+ * @return Returns 0 on success. On error prints a message
+ *     and returns nonzero value.
+ */
+int main_unpack (char *pname, char *iname, char *oname)
+{
+    unsigned char *unpacked, *packed;
+    unsigned long plen;
+    long ulen;
+    if (read_whole_file(iname, &packed, &plen))
+        return 1;
+    if (plen < SIZEOF_RNC_HEADER)
+    {
+        free(packed);
+        printf("Error: %s\n", rnc_error (RNC_FILE_IS_NOT_RNC));
+        return 1;
+    }
+    ulen = rnc_ulen (packed);
+    if (ulen < 0)
+    {
+        free(packed);
+        printf("Error: %s\n", rnc_error (ulen));
+        return 1;
+    }
+    unpacked = malloc(ulen+8);
+    if (unpacked==NULL)
+    {
+        free(packed);
+        perror(pname);
+        return 1;
+    }
+    ulen = rnc_unpack (packed, unpacked, RNC_IGNORE_NONE);
+    free(packed);
+    if (ulen < 0)
+    {
+        free(unpacked);
+        printf("Error: %s\n", rnc_error (ulen));
+        return 1;
+    }
+    if (write_whole_file(oname, unpacked, ulen))
+    {
+        free(unpacked);
+        return 1;
+    }
+    free(unpacked);
+    return 0;
+}
+
+/**
+ * Tests packing single file on all levels, if building stand-alone RNC tool.
+ * Every packed buffer is unpacked with rnc_unpack() and compared with
+ * the original. Packed sizes and packing speed are reported.
+ * @param pname Name of the program executable.
+ * @param iname File name of the input file.
+ * @return Returns 0 on success. On error prints a message
+ *     and returns nonzero value.
+ */
+int main_test (char *pname, char *iname)
+{
+    unsigned char *unpacked, *packed, *restored;
+    unsigned long ulen;
+    int level;
+    if (read_whole_file(iname, &unpacked, &ulen))
+        return 1;
+    packed = malloc(rnc_pack_bound(ulen)+8);
+    restored = malloc(ulen+8);
+    if ((packed==NULL)||(restored==NULL))
+    {
+        free(unpacked);
+        free(packed);
+        perror(pname);
+        return 1;
+    }
+    printf("%s, %lu bytes:\n",iname,ulen);
+    for (level=RNC_PACK_LEVEL_MIN; level<=RNC_PACK_LEVEL_MAX; level++)
+    {
+        clock_t start;
+        double secs;
+        long plen, rlen;
+        start = clock();
+        plen = rnc_pack(unpacked, ulen, packed, level);
+        secs = (double)(clock()-start)/CLOCKS_PER_SEC;
+        if (plen < 0)
+        {
+            printf("  level %d: pack error: %s\n", level, rnc_error (plen));
+            break;
+        }
+        memset(packed+plen,0,8);
+        rlen = rnc_unpack (packed, restored, RNC_IGNORE_NONE);
+        if (rlen < 0)
+        {
+            printf("  level %d: unpack error: %s\n", level, rnc_error (rlen));
+            break;
+        }
+        if ((rlen != (long)ulen) || (memcmp(unpacked,restored,ulen) != 0))
+        {
+            printf("  level %d: unpacked data differs from original\n", level);
+            break;
+        }
+        printf("  level %d: %8ld bytes, %6.2f%%, %8.2f MB/s\n", level, plen,
+            (ulen>0)?(100.0*plen/ulen):0.0,
+            (secs>0)?(ulen/secs/1048576.0):0.0);
+    }
+    free(unpacked);
+    free(packed);
+    free(restored);
+    return (level<=RNC_PACK_LEVEL_MAX);
+}
+
+#endif
+
+/**
+ * Writes bits into packed buffer. The bits are stored in 16-bit little
+ * endian words; literal bytes are put between the words, right after
+ * the word which is currently filled.
+ */
+typedef struct {
+    unsigned char *out;         /* start of packed data */
+    unsigned long len;          /* bytes used in packed data */
+    unsigned long bitpos;       /* position of the word being filled */
+    int bitcount;               /* bits used in the word being filled */
+} bit_writer;
+
+/**
+ * Huffman table, used for compression.
+ */
+typedef struct {
+    int num;                    /* amount of entries written */
+    unsigned long freq[RNC_HUF_SYMBOLS];
+    unsigned long code[RNC_HUF_SYMBOLS];
+    int codelen[RNC_HUF_SYMBOLS];
+} huf_ctable;
+
+/**
+ * Single element of a chunk - literals run followed by a match.
+ * The last element in chunk has no match.
+ */
+typedef struct {
+    unsigned long lit_pos;
+    unsigned long lit_len;
+    unsigned long offset;
+    unsigned long length;
+} pack_item;
+
+/**
+ * Compressor state.
+ */
+typedef struct {
+    const unsigned char *input;
+    unsigned long ulen;
+    long *head;                 /* last position of every 2-byte hash */
+    long *prev;                 /* previous position with the same hash */
+    int max_chain;
+    unsigned long nice_len;     /* match length which stops the search */
+    short lazy;
+    pack_item *items;
+    unsigned long items_count;
+} pack_state;
+
+/**
+ * Returns amount of bytes which can be required for packing
+ * given amount of data. Output buffer given to rnc_pack()
+ * should have this size.
+ * @param ulen Unpacked data length.
+ * @return Returns max. size of the packed data, with header.
+ */
+unsigned long rnc_pack_bound(unsigned long ulen)
+{
+    return SIZEOF_RNC_HEADER + ulen + (ulen/RNC_CHUNK_SIZE+1)*24 + RNC_PACK_PADDING;
+}
+
+/**
+ * Writes n lowest bits of given value into the bit stream.
+ */
+static void bit_write (bit_writer *bw, unsigned long val, int n)
+{
+    while (n > 0)
+    {
+        int k;
+        unsigned long word;
+        if (bw->bitcount >= 16)
+        {
+            bw->bitpos = bw->len;
+            bw->out[bw->len++] = 0;
+            bw->out[bw->len++] = 0;
+            bw->bitcount = 0;
+        }
+        k = 16 - bw->bitcount;
+        if (k > n) k = n;
+        word = read_int16_le_buf(bw->out+bw->bitpos);
+        word |= (val & ((1UL<<k)-1)) << bw->bitcount;
+        write_int16_le_buf(bw->out+bw->bitpos, word);
+        bw->bitcount += k;
+        val >>= k;
+        n -= k;
+    }
+}
+
+/**
+ * Returns Huffman symbol used for storing given value.
+ * Values 0 and 1 have their own symbols, larger ones are stored
+ * as highest bit index, followed by remaining bits.
+ */
+static int huf_symbol (unsigned long val)
+{
+    int sym;
+    if (val < 2)
+        return val;
+    sym = 0;
+    while (val)
+    {
+        sym++;
+        val >>= 1;
+    }
+    return sym;
+}
+
+/**
+ * Returns amount of bits used to store a value with given Huffman table.
+ */
+static unsigned long huf_value_bits (const huf_ctable *h, unsigned long val)
+{
+    int sym = huf_symbol(val);
+    return h->codelen[sym] + ((sym >= 2) ? (sym - 1) : 0);
+}
+
+/**
+ * Writes a value into the bit stream, using given Huffman table.
+ */
+static void huf_write (bit_writer *bw, const huf_ctable *h, unsigned long val)
+{
+    int sym = huf_symbol(val);
+    bit_write (bw, h->code[sym], h->codelen[sym]);
+    if (sym >= 2)
+        bit_write (bw, val - (1UL<<(sym-1)), sym-1);
+}
+
+/**
+ * Mirror the bottom n bits of x.
+ */
+static unsigned long pack_mirror (unsigned long x, int n)
+{
+    unsigned long res = 0;
+    while (n-- > 0)
+    {
+        res = (res << 1) | (x & 1);
+        x >>= 1;
+    }
+    return res;
+}
+
+/**
+ * Builds Huffman code lengths and codes from symbol frequencies.
+ * There are only 16 symbols, so the code lengths never exceed 15,
+ * which is the max. length the table can store.
+ */
+static void huf_build (huf_ctable *h)
+{
+    unsigned long weight[RNC_HUF_SYMBOLS];
+    int parent[RNC_HUF_SYMBOLS];
+    int i, j, used;
+    h->num = 0;
+    used = 0;
+    for (i=0; i<RNC_HUF_SYMBOLS; i++)
+    {
+        h->codelen[i] = 0;
+        h->code[i] = 0;
+        parent[i] = -1;
+        weight[i] = h->freq[i];
+        if (h->freq[i] > 0)
+        {
+            h->num = i+1;
+            used++;
+        }
+    }
+    if (used == 0)
+        return;
+    if (used == 1)
+    {
+        h->codelen[h->num-1] = 1;
+    } else
+    {
+        /* Merging two lightest groups until one is left; every symbol
+         * in merged groups gets one bit longer. Groups are identified
+         * by their lowest symbol, other symbols point at it. */
+        int groups = used;
+        while (groups > 1)
+        {
+            int a = -1, b = -1;
+            for (i=0; i<RNC_HUF_SYMBOLS; i++)
+            {
+                if ((h->freq[i] == 0) || (parent[i] >= 0))
+                    continue;
+                if ((a < 0) || (weight[i] < weight[a]))
+                {
+                    b = a;
+                    a = i;
+                } else
+                if ((b < 0) || (weight[i] < weight[b]))
+                {
+                    b = i;
+                }
+            }
+            for (j=0; j<RNC_HUF_SYMBOLS; j++)
+            {
+                if (h->freq[j] == 0)
+                    continue;
+                if ((j == a) || (j == b) || (parent[j] == a) || (parent[j] == b))
+                    h->codelen[j]++;
+            }
+            if (b < a)
+            {
+                int tmp = a;
+                a = b;
+                b = tmp;
+            }
+            for (j=0; j<RNC_HUF_SYMBOLS; j++)
+            {
+                if ((parent[j] == b) || (j == b))
+                    parent[j] = a;
+            }
+            weight[a] += weight[b];
+            groups--;
+        }
+    }
+    /* Canonical codes, in the order used by read_huftable() */
+    {
+        unsigned long codeb = 0;
+        for (i=1; i<=15; i++)
+        {
+            for (j=0; j<h->num; j++)
+            {
+                if (h->codelen[j] == i)
+                {
+                    h->code[j] = pack_mirror(codeb, i);
+                    codeb++;
+                }
+            }
+            codeb <<= 1;
+        }
+    }
+}
+
+/**
+ * Returns amount of bits used to store given Huffman table.
+ */
+static unsigned long huf_table_bits (const huf_ctable *h)
+{
+    return 5 + 4*h->num;
+}
+
+/**
+ * Writes Huffman table into the bit stream.
+ */
+static void huf_table_write (bit_writer *bw, const huf_ctable *h)
+{
+    int i;
+    bit_write (bw, h->num, 5);
+    for (i=0; i<h->num; i++)
+        bit_write (bw, h->codelen[i], 4);
+}
+
+/**
+ * Adds position to the hash chains.
+ */
+static void hash_insert (pack_state *st, unsigned long pos)
+{
+    unsigned int hash;
+    if (pos+1 >= st->ulen)
+        return;
+    hash = (st->input[pos] << 8) | st->input[pos+1];
+    st->prev[pos & RNC_WINDOW_MASK] = st->head[hash];
+    st->head[hash] = pos;
+}
+
+/**
+ * Finds longest match for given position. The position itself
+ * must not be in the hash chains yet.
+ * @return Returns match length, or 0 if no usable match was found.
+ */
+static unsigned long find_match (pack_state *st, unsigned long pos, unsigned long *offset)
+{
+    unsigned long best_len = 0;
+    unsigned long max_len;
+    long cand;
+    int chain;
+    if (pos+RNC_MIN_MATCH > st->ulen)
+        return 0;
+    max_len = st->ulen - pos;
+    if (max_len > RNC_MAX_MATCH)
+        max_len = RNC_MAX_MATCH;
+    cand = st->head[(st->input[pos] << 8) | st->input[pos+1]];
+    chain = st->max_chain;
+    while ((cand >= 0) && (chain-- > 0))
+    {
+        unsigned long dist = pos - cand;
+        unsigned long len;
+        long next;
+        if ((dist > RNC_WINDOW_SIZE) || (dist == 0))
+            break;
+        if (st->input[cand+best_len] == st->input[pos+best_len])
+        {
+            const unsigned char *a = st->input + cand;
+            const unsigned char *b = st->input + pos;
+            len = 0;
+            while ((len < max_len) && (a[len] == b[len]))
+                len++;
+            if ((len > best_len) &&
+                ((len > RNC_MIN_MATCH) || (dist <= RNC_MAX_OFFSET_MATCH2)))
+            {
+                best_len = len;
+                *offset = dist;
+                if ((len >= max_len) || (len >= st->nice_len))
+                    break;
+            }
+        }
+        next = st->prev[cand & RNC_WINDOW_MASK];
+        if (next >= cand)
+            break;
+        cand = next;
+    }
+    if (best_len < RNC_MIN_MATCH)
+        return 0;
+    return best_len;
+}
+
+/**
+ * Splits input data, starting at given position, into literals
+ * and matches. Fills items array of the state.
+ * @return Returns position after the last byte covered by the items.
+ */
+static unsigned long parse_chunk (pack_state *st, unsigned long pos)
+{
+    unsigned long chunk_end = pos + RNC_CHUNK_SIZE;
+    unsigned long lit_pos = pos;
+    pack_item *item;
+    if (chunk_end > st->ulen)
+        chunk_end = st->ulen;
+    st->items_count = 0;
+    while (pos < chunk_end)
+    {
+        unsigned long offset = 0;
+        unsigned long len, i;
+        len = find_match(st, pos, &offset);
+        hash_insert(st, pos);
+        if (len == 0)
+        {
+            pos++;
+            continue;
+        }
+        /* Lazy evaluation - prefer a literal if next byte starts longer match */
+        if ((st->lazy) && (len < RNC_MAX_MATCH))
+        {
+            unsigned long next_offset = 0;
+            if (find_match(st, pos+1, &next_offset) > len)
+            {
+                pos++;
+                continue;
+            }
+        }
+        item = &st->items[st->items_count++];
+        item->lit_pos = lit_pos;
+        item->lit_len = pos - lit_pos;
+        item->offset = offset;
+        item->length = len;
+        for (i=1; i<len; i++)
+            hash_insert(st, pos+i);
+        pos += len;
+        lit_pos = pos;
+    }
+    item = &st->items[st->items_count++];
+    item->lit_pos = lit_pos;
+    item->lit_len = pos - lit_pos;
+    item->offset = 0;
+    item->length = 0;
+    return pos;
+}
+
+/**
+ * Prepares Huffman tables for items of a chunk.
+ * @return Returns amount of bits needed to store the chunk.
+ */
+static unsigned long chunk_tables (const pack_state *st,
+    huf_ctable *raw, huf_ctable *dist, huf_ctable *len)
+{
+    unsigned long i, bits;
+    memset(raw, 0, sizeof(huf_ctable));
+    memset(dist, 0, sizeof(huf_ctable));
+    memset(len, 0, sizeof(huf_ctable));
+    for (i=0; i<st->items_count; i++)
+    {
+        const pack_item *item = &st->items[i];
+        raw->freq[huf_symbol(item->lit_len)]++;
+        if (i+1 < st->items_count)
+        {
+            dist->freq[huf_symbol(item->offset-1)]++;
+            len->freq[huf_symbol(item->length-RNC_MIN_MATCH)]++;
+        }
+    }
+    huf_build(raw);
+    huf_build(dist);
+    huf_build(len);
+    bits = huf_table_bits(raw) + huf_table_bits(dist) + huf_table_bits(len) + 16;
+    for (i=0; i<st->items_count; i++)
+    {
+        const pack_item *item = &st->items[i];
+        bits += huf_value_bits(raw, item->lit_len) + 8*item->lit_len;
+        if (i+1 < st->items_count)
+        {
+            bits += huf_value_bits(dist, item->offset-1);
+            bits += huf_value_bits(len, item->length-RNC_MIN_MATCH);
+        }
+    }
+    return bits;
+}
+
+/**
+ * Writes one chunk of packed data - Huffman tables, followed by
+ * literals and matches.
+ */
+static void chunk_write (bit_writer *bw, const pack_state *st,
+    const huf_ctable *raw, const huf_ctable *dist, const huf_ctable *len,
+    long *lee_diff)
+{
+    unsigned long i;
+    huf_table_write (bw, raw);
+    huf_table_write (bw, dist);
+    huf_table_write (bw, len);
+    bit_write (bw, st->items_count, 16);
+    for (i=0; i<st->items_count; i++)
+    {
+        const pack_item *item = &st->items[i];
+        huf_write (bw, raw, item->lit_len);
+        if (item->lit_len > 0)
+        {
+            memcpy(bw->out+bw->len, st->input+item->lit_pos, item->lit_len);
+            bw->len += item->lit_len;
+        }
+        if (i+1 < st->items_count)
+        {
+            long diff;
+            huf_write (bw, dist, item->offset-1);
+            huf_write (bw, len, item->length-RNC_MIN_MATCH);
+            /* Unpacker reads input from next word to be written */
+            diff = (long)(item->lit_pos + item->lit_len + item->length) - (long)bw->len;
+            if (*lee_diff < diff)
+                *lee_diff = diff;
+        }
+    }
+}
+
+/**
+ * Packs data block into RNC method 1 format.
+ *
+ * @param unpacked Source data buffer.
+ * @param ulen Length of the source data.
+ * @param packed Packed destination data buffer. Its size should be
+ *     at least rnc_pack_bound(ulen).
+ * @param level Compression level, RNC_PACK_LEVEL_MIN to RNC_PACK_LEVEL_MAX.
+ *     Higher levels give better compression, but are slower.
+ * @return Returns the packed length, including header, if successful,
+ *    or negative error code if not.
+ */
+long rnc_pack (const void *unpacked, unsigned long ulen, void *packed, int level)
+{
+    pack_state st;
+    bit_writer bw;
+    huf_ctable raw, dist, len;
+    unsigned long pos, chunk_start, chunks;
+    long lee_diff, lee;
+    unsigned char *output = (unsigned char *)packed;
+    if (ulen > RNC_MAX_FILESIZE)
+        return RNC_FILE_SIZE_MISMATCH;
+    if (level < RNC_PACK_LEVEL_MIN)
+        level = RNC_PACK_LEVEL_MIN;
+    if (level > RNC_PACK_LEVEL_MAX)
+        level = RNC_PACK_LEVEL_MAX;
+    st.input = (const unsigned char *)unpacked;
+    st.ulen = ulen;
+    st.max_chain = 2 << level;
+    if (level >= RNC_PACK_LEVEL_MAX)
+        st.max_chain = 4096;
+    st.nice_len = 8 << (level/2);
+    if (level >= RNC_PACK_LEVEL_MAX)
+        st.nice_len = RNC_MAX_MATCH;
+    st.lazy = (level >= 5);
+    st.head = (long *)malloc(RNC_HASH_SIZE*sizeof(long));
+    st.prev = (long *)malloc(RNC_WINDOW_SIZE*sizeof(long));
+    st.items = (pack_item *)malloc((RNC_CHUNK_SIZE+1)*sizeof(pack_item));
+    if ((st.head==NULL) || (st.prev==NULL) || (st.items==NULL))
+    {
+        free(st.head);
+        free(st.prev);
+        free(st.items);
+        return RNC_MALLOC_ERROR;
+    }
+    for (pos=0; pos<RNC_HASH_SIZE; pos++)
+        st.head[pos] = -1;
+    for (pos=0; pos<RNC_WINDOW_SIZE; pos++)
+        st.prev[pos] = -1;
+
+    bw.out = output + SIZEOF_RNC_HEADER;
+    bw.len = 0;
+    bw.bitpos = 0;
+    bw.bitcount = 16;
+    /* Two leading bits; both are zero, as we don't use encryption */
+    bit_write (&bw, 0, 2);
+    lee_diff = 0;
+    chunks = 0;
+    pos = 0;
+    chunk_start = 0;
+    while (pos < ulen)
+    {
+        unsigned long bits;
+        chunk_start = bw.len;
+        pos = parse_chunk(&st, pos);
+        bits = chunk_tables(&st, &raw, &dist, &len);
+        /* If matches don't help, store the chunk as literals */
+        if (st.items_count > 1)
+        {
+            pack_item lit_item;
+            unsigned long lit_bits;
+            pack_item *items = st.items;
+            unsigned long items_count = st.items_count;
+            huf_ctable lraw, ldist, llen;
+            lit_item.lit_pos = st.items[0].lit_pos;
+            lit_item.lit_len = pos - lit_item.lit_pos;
+            lit_item.offset = 0;
+            lit_item.length = 0;
+            st.items = &lit_item;
+            st.items_count = 1;
+            lit_bits = chunk_tables(&st, &lraw, &ldist, &llen);
+            if (lit_bits < bits)
+            {
+                raw = lraw;
+                dist = ldist;
+                len = llen;
+                chunk_write (&bw, &st, &raw, &dist, &len, &lee_diff);
+                st.items = items;
+                chunks++;
+                continue;
+            }
+            st.items = items;
+            st.items_count = items_count;
+        }
+        chunk_write (&bw, &st, &raw, &dist, &len, &lee_diff);
+        chunks++;
+    }
+    free(st.head);
+    free(st.prev);
+    free(st.items);
+    /* The unpacker needs a few readable bytes at start of a chunk */
+    while (bw.len < chunk_start + RNC_PACK_PADDING)
+        output[SIZEOF_RNC_HEADER + bw.len++] = 0;
+    /* Leeway - how much the packed data may overlap unpacked ones */
+    lee = (long)bw.len - (long)ulen + lee_diff;
+    if (lee < 0)
+        lee = 0;
+    if (lee > 255)
+        lee = 255;
+    /* Header */
+    write_int32_be_buf(output+0, RNC_SIGNATURE_INT);
+    write_int32_be_buf(output+4, ulen);
+    write_int32_be_buf(output+8, bw.len);
+    write_int16_be_buf(output+12, rnc_crc(unpacked, ulen));
+    write_int16_be_buf(output+14, rnc_crc(output+SIZEOF_RNC_HEADER, bw.len));
+    output[16] = lee;
+    output[17] = (chunks > 255) ? 255 : chunks;
+    return SIZEOF_RNC_HEADER + bw.len;
+}
@@ -0,0 +1,36 @@
+/******************************************************************************/
+/** @file enrnc.h
+ * RNC compression support.
+ * @par Purpose:
+ *     Header file. Defines exported routines from enrnc.c.
+ * @par Comment:
+ *     None.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#ifndef RNC_ENRNC_H
+#define RNC_ENRNC_H
+
+#include "globals.h"
+
+/**
+ * Compression levels. Higher levels search for matches longer,
+ * giving smaller output at cost of speed.
+ */
+#define RNC_PACK_LEVEL_MIN     1
+#define RNC_PACK_LEVEL_MAX     9
+#define RNC_PACK_LEVEL_DEFAULT 6
+
+/*
+ * Routines
+ */
+DLLIMPORT unsigned long rnc_pack_bound(unsigned long ulen);
+DLLIMPORT long rnc_pack(const void *unpacked, unsigned long ulen, void *packed, int level);
+
+#endif
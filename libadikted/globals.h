@@ -63,6 +63,13 @@
 # define FASTCALL
 #endif
 
+/* Variables with separate copy for every thread */
+#if defined(_MSC_VER)
+# define THREAD_LOCAL __declspec(thread)
+#else
+# define THREAD_LOCAL __thread
+#endif
+
 /* Basic Definitions */
 
 #if defined(unix) && !defined (GO32)
@@ -178,8 +185,15 @@ struct LEVOPTIONS {
      * is larger than it should
      */
     short load_redundant_objects;
+    /* Map files which are RNC packed on save; LEVEL_CHANGE_FLAGS bits */
+    unsigned long packed_files;
+    /* RNC compression level used for packed files */
+    short pack_level;
     /* Flags used for level verification */
     unsigned int verify_warn_flags;
+    /* True means thing statistics kept up to date on every change */
+    /* are compared with a full recount in update_level_stats() */
+    short stats_check;
     /* Map picture generation options */
     struct MAPDRAW_OPTIONS picture;
     /* Level script options */
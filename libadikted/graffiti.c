@@ -26,6 +26,7 @@
 #include "obj_column.h"
 #include "msg_log.h"
 #include "lev_column.h"
+#include "lev_undo.h"
 
 /**
  * Frees the whole graffiti structure.
@@ -42,9 +43,126 @@ short level_free_graffiti(struct LEVEL *lvl)
     }
     if (lvl->graffiti_count>0)
       free(lvl->graffiti);
+    free(lvl->graffiti_tiles);
+    lvl->graffiti_tiles=NULL;
+    lvl->graffiti_tiles_alloc=0;
+    lvl->graffiti_tiles_used=0;
+    lvl->graffiti_tiles_free=-1;
+    if (lvl->graffiti_tile_head!=NULL)
+    {
+      for (i=0; i < lvl->tlsize.x*lvl->tlsize.y; i++)
+        lvl->graffiti_tile_head[i]=-1;
+    }
     return ERR_NONE;
 }
 
+/**
+ * Computes the tiles rectangle under which graffiti is kept in tile index.
+ * The rectangle always contains graffiti starting tile, and is clipped
+ * to map size.
+ * @param graf Pointer to the DK_GRAFFITI structure.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param start,end Returned rectangle corners.
+ * @return Returns true if the rectangle isn't empty, false otherwise.
+ */
+static short graffiti_tiles_rect(const struct DK_GRAFFITI *graf,const struct LEVEL *lvl,
+    struct IPOINT_2D *start,struct IPOINT_2D *end)
+{
+    start->x=graf->tile.x;
+    start->y=graf->tile.y;
+    end->x=max(graf->fin_tile.x,graf->tile.x);
+    end->y=max(graf->fin_tile.y,graf->tile.y);
+    if (start->x<0) start->x=0;
+    if (start->y<0) start->y=0;
+    if (end->x>=lvl->tlsize.x) end->x=lvl->tlsize.x-1;
+    if (end->y>=lvl->tlsize.y) end->y=lvl->tlsize.y-1;
+    return (start->x<=end->x)&&(start->y<=end->y);
+}
+
+/**
+ * Adds graffiti with given index to tile index, on all tiles it covers.
+ * The graffiti must already be in level graffiti array.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param graf_idx Graffiti index.
+ * @return Returns true on success, false on error.
+ */
+static short graffiti_tiles_link(struct LEVEL *lvl,int graf_idx)
+{
+    struct DK_GRAFFITI *graf=get_graffiti(lvl,graf_idx);
+    if ((graf==NULL)||(lvl->graffiti_tile_head==NULL))
+      return false;
+    struct IPOINT_2D start,end;
+    if (!graffiti_tiles_rect(graf,lvl,&start,&end))
+      return true;
+    int tx,ty;
+    for (ty=start.y; ty<=end.y; ty++)
+      for (tx=start.x; tx<=end.x; tx++)
+      {
+        int node;
+        if (lvl->graffiti_tiles_free>=0)
+        {
+          node=lvl->graffiti_tiles_free;
+          lvl->graffiti_tiles_free=lvl->graffiti_tiles[node].next;
+        } else
+        {
+          if (lvl->graffiti_tiles_used>=lvl->graffiti_tiles_alloc)
+          {
+            unsigned int nalloc=lvl->graffiti_tiles_alloc*2+64;
+            struct DK_GRAFFITI_TILE *ntiles;
+            ntiles=(struct DK_GRAFFITI_TILE *)realloc(lvl->graffiti_tiles,
+                     nalloc*sizeof(struct DK_GRAFFITI_TILE));
+            if (ntiles==NULL)
+            {
+              message_error("Cannot alloc memory for graffiti index");
+              return false;
+            }
+            lvl->graffiti_tiles=ntiles;
+            lvl->graffiti_tiles_alloc=nalloc;
+          }
+          node=lvl->graffiti_tiles_used;
+          lvl->graffiti_tiles_used++;
+        }
+        lvl->graffiti_tiles[node].graf_idx=graf_idx;
+        /* Keep the chain sorted, so that graffiti_idx_next() works */
+        int *prev=&lvl->graffiti_tile_head[ty*lvl->tlsize.x+tx];
+        while ((*prev>=0)&&(lvl->graffiti_tiles[*prev].graf_idx<graf_idx))
+          prev=&lvl->graffiti_tiles[*prev].next;
+        lvl->graffiti_tiles[node].next=*prev;
+        *prev=node;
+      }
+    return true;
+}
+
+/**
+ * Removes graffiti with given index from tile index.
+ * The graffiti tiles rectangle must be the same as when it was linked.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param graf_idx Graffiti index.
+ */
+static void graffiti_tiles_unlink(struct LEVEL *lvl,int graf_idx)
+{
+    struct DK_GRAFFITI *graf=get_graffiti(lvl,graf_idx);
+    if ((graf==NULL)||(lvl->graffiti_tile_head==NULL))
+      return;
+    struct IPOINT_2D start,end;
+    if (!graffiti_tiles_rect(graf,lvl,&start,&end))
+      return;
+    int tx,ty;
+    for (ty=start.y; ty<=end.y; ty++)
+      for (tx=start.x; tx<=end.x; tx++)
+      {
+        int *prev=&lvl->graffiti_tile_head[ty*lvl->tlsize.x+tx];
+        while ((*prev>=0)&&(lvl->graffiti_tiles[*prev].graf_idx!=graf_idx))
+          prev=&lvl->graffiti_tiles[*prev].next;
+        if (*prev<0) continue;
+        int node=*prev;
+        *prev=lvl->graffiti_tiles[node].next;
+        lvl->graffiti_tiles[node].graf_idx=-1;
+        lvl->graffiti_tiles[node].next=lvl->graffiti_tiles_free;
+        lvl->graffiti_tiles_free=node;
+      }
+}
+
 /**
  * Searches for graffiti at given tile and returns its index.
  * @param lvl Pointer to the LEVEL structure.
@@ -69,10 +187,17 @@ int graffiti_idx(struct LEVEL *lvl, int tx, int ty)
 int graffiti_idx_next(struct LEVEL *lvl, int tx, int ty, int prev_idx)
 {
     if (prev_idx < -1) return -1;
-    int i;
+    if ((tx<0)||(ty<0)||(tx>=lvl->tlsize.x)||(ty>=lvl->tlsize.y))
+      return -1;
     struct DK_GRAFFITI *graf;
-    for (i=prev_idx+1; i < lvl->graffiti_count; i++)
+    /* The tile index gives candidates; coordinates are still verified, */
+    /* as graffiti_clear_from_columns() moves graffiti temporarily */
+    int node=lvl->graffiti_tile_head[ty*lvl->tlsize.x+tx];
+    while (node>=0)
     {
+      int i=lvl->graffiti_tiles[node].graf_idx;
+      node=lvl->graffiti_tiles[node].next;
+      if (i<=prev_idx) continue;
       graf = lvl->graffiti[i];
       if ((tx>=graf->tile.x) && (tx<=graf->fin_tile.x) && (ty>=graf->tile.y) && (ty<=graf->fin_tile.y))
           return i;
@@ -109,6 +234,14 @@ void graffiti_del(struct LEVEL *lvl,unsigned int num)
     int i;
     if ((lvl==NULL)||(num>=lvl->graffiti_count))
       return;
+    level_undo_rec_graffiti(lvl,UDT_GRAFFITI_DEL,lvl->graffiti[num]);
+    graffiti_tiles_unlink(lvl,num);
+    /*Graffiti after the deleted one are moved to lower index */
+    for (i=0; i < lvl->graffiti_tiles_used; i++)
+    {
+      if (lvl->graffiti_tiles[i].graf_idx > (int)num)
+        lvl->graffiti_tiles[i].graf_idx--;
+    }
     struct DK_GRAFFITI *graf;
     graf=lvl->graffiti[num];
     if (graf!=NULL)
@@ -181,6 +314,13 @@ int graffiti_add_obj(struct LEVEL *lvl,struct DK_GRAFFITI *graf)
     }
     lvl->graffiti[graf_idx]=graf;
     lvl->graffiti_count=graf_idx+1;
+    if (!graffiti_tiles_link(lvl,graf_idx))
+    {
+        graffiti_tiles_unlink(lvl,graf_idx);
+        lvl->graffiti_count=graf_idx;
+        return -1;
+    }
+    level_undo_rec_graffiti(lvl,UDT_GRAFFITI_ADD,graf);
     return graf_idx;
 }
 
@@ -301,6 +441,24 @@ short set_graffiti_orientation(struct DK_GRAFFITI *graf,const struct LEVEL *lvl,
     return ERR_NONE;
 }
 
+/**
+ * Sets orientation of graffiti which is in the LEVEL structure.
+ * Unlike set_graffiti_orientation(), keeps the graffiti tile index
+ * up to date. Level graphics is not updated by this function.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param graf_idx Graffiti index.
+ * @param orient New graffiti orientation, from GRAFFITI_ORIENT enumeration.
+ * @return Returns true on success, false on error.
+ */
+short graffiti_set_orientation(struct LEVEL *lvl,int graf_idx,unsigned short orient)
+{
+    struct DK_GRAFFITI *graf=get_graffiti(lvl,graf_idx);
+    if ((graf==NULL)||(graf->text==NULL)) return false;
+    graffiti_tiles_unlink(lvl,graf_idx);
+    set_graffiti_orientation(graf,lvl,orient);
+    return graffiti_tiles_link(lvl,graf_idx);
+}
+
 /**
  * Sets new height to the graffiti. Makes sure the parameter will be
  * in appropiate range.
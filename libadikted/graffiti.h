@@ -47,6 +47,7 @@ DLLIMPORT int compute_graffiti_subtl_length(unsigned short font,char *text);
 DLLIMPORT void graffiti_update_columns(struct LEVEL *lvl,int graf_idx);
 DLLIMPORT void graffiti_clear_from_columns(struct LEVEL *lvl,int graf_idx);
 DLLIMPORT short set_graffiti_orientation(struct DK_GRAFFITI *graf,const struct LEVEL *lvl,unsigned short orient);
+DLLIMPORT short graffiti_set_orientation(struct LEVEL *lvl,int graf_idx,unsigned short orient);
 DLLIMPORT int set_graffiti_height(struct DK_GRAFFITI *graf,int height);
 
 DLLIMPORT int get_graffiti_cube_height(unsigned short font,char *text);
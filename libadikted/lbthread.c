@@ -0,0 +1,382 @@
+/******************************************************************************/
+/** @file lbthread.c
+ * Library for portable threads and locks.
+ * @par Purpose:
+ *     Thin wrappers over Windows threads, POSIX threads, or nothing
+ *     on systems without threads.
+ * @par Comment:
+ *     None.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include "lbthread.h"
+
+#if defined(PROJECT_TARGETS_WINDOWS)
+#include <windows.h>
+#elif !defined(MSDOS)
+#include <pthread.h>
+#define LB_PTHREADS
+#endif
+
+struct LB_MUTEX {
+#if defined(PROJECT_TARGETS_WINDOWS)
+    CRITICAL_SECTION cs;
+#elif defined(LB_PTHREADS)
+    pthread_mutex_t mtx;
+#else
+    int dummy;
+#endif
+  };
+
+struct LB_COND {
+#if defined(PROJECT_TARGETS_WINDOWS)
+    CONDITION_VARIABLE cv;
+#elif defined(LB_PTHREADS)
+    pthread_cond_t cv;
+#else
+    int dummy;
+#endif
+  };
+
+struct LB_THREAD {
+    lb_thread_func func;
+    void *arg;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    HANDLE handle;
+#elif defined(LB_PTHREADS)
+    pthread_t handle;
+#endif
+  };
+
+/**
+ * Creates a mutex. Mutexes are not recursive.
+ * @return Returns the new mutex, or NULL on error.
+ */
+struct LB_MUTEX *lb_mutex_create(void)
+{
+    struct LB_MUTEX *mtx;
+    mtx=(struct LB_MUTEX *)malloc(sizeof(struct LB_MUTEX));
+    if (mtx==NULL)
+      return NULL;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    InitializeCriticalSection(&mtx->cs);
+#elif defined(LB_PTHREADS)
+    if (pthread_mutex_init(&mtx->mtx,NULL)!=0)
+    {
+      free(mtx);
+      return NULL;
+    }
+#endif
+    return mtx;
+}
+
+/**
+ * Frees a mutex, which must not be locked.
+ * @param mtx_ptr Double pointer to the mutex; it is set to NULL.
+ */
+void lb_mutex_free(struct LB_MUTEX **mtx_ptr)
+{
+    if ((mtx_ptr==NULL)||((*mtx_ptr)==NULL))
+      return;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    DeleteCriticalSection(&(*mtx_ptr)->cs);
+#elif defined(LB_PTHREADS)
+    pthread_mutex_destroy(&(*mtx_ptr)->mtx);
+#endif
+    free(*mtx_ptr);
+    *mtx_ptr=NULL;
+}
+
+/**
+ * Locks the mutex; waits, without using the CPU, until it is available.
+ */
+void lb_mutex_lock(struct LB_MUTEX *mtx)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    EnterCriticalSection(&mtx->cs);
+#elif defined(LB_PTHREADS)
+    pthread_mutex_lock(&mtx->mtx);
+#endif
+}
+
+/**
+ * Unlocks the mutex locked by current thread.
+ */
+void lb_mutex_unlock(struct LB_MUTEX *mtx)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    LeaveCriticalSection(&mtx->cs);
+#elif defined(LB_PTHREADS)
+    pthread_mutex_unlock(&mtx->mtx);
+#endif
+}
+
+/**
+ * Creates a condition variable.
+ * @return Returns the new condition, or NULL on error.
+ */
+struct LB_COND *lb_cond_create(void)
+{
+    struct LB_COND *cond;
+    cond=(struct LB_COND *)malloc(sizeof(struct LB_COND));
+    if (cond==NULL)
+      return NULL;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    InitializeConditionVariable(&cond->cv);
+#elif defined(LB_PTHREADS)
+    if (pthread_cond_init(&cond->cv,NULL)!=0)
+    {
+      free(cond);
+      return NULL;
+    }
+#endif
+    return cond;
+}
+
+/**
+ * Frees a condition variable, which no thread waits for.
+ * @param cond_ptr Double pointer to the condition; it is set to NULL.
+ */
+void lb_cond_free(struct LB_COND **cond_ptr)
+{
+    if ((cond_ptr==NULL)||((*cond_ptr)==NULL))
+      return;
+#if defined(LB_PTHREADS)
+    pthread_cond_destroy(&(*cond_ptr)->cv);
+#endif
+    free(*cond_ptr);
+    *cond_ptr=NULL;
+}
+
+/**
+ * Unlocks the mutex and waits for the condition to be signalled;
+ * the mutex is locked again before returning. Spurious wakeups
+ * are possible, so the caller should re-check its condition.
+ */
+void lb_cond_wait(struct LB_COND *cond,struct LB_MUTEX *mtx)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    SleepConditionVariableCS(&cond->cv,&mtx->cs,INFINITE);
+#elif defined(LB_PTHREADS)
+    pthread_cond_wait(&cond->cv,&mtx->mtx);
+#endif
+}
+
+/**
+ * Waits for the condition like lb_cond_wait(), but no longer
+ * than given amount of milliseconds.
+ */
+void lb_cond_wait_ms(struct LB_COND *cond,struct LB_MUTEX *mtx,unsigned int msec)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    SleepConditionVariableCS(&cond->cv,&mtx->cs,msec);
+#elif defined(LB_PTHREADS)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    ts.tv_sec+=msec/1000;
+    ts.tv_nsec+=(msec%1000)*1000000L;
+    if (ts.tv_nsec>=1000000000L)
+    {
+      ts.tv_sec++;
+      ts.tv_nsec-=1000000000L;
+    }
+    pthread_cond_timedwait(&cond->cv,&mtx->mtx,&ts);
+#endif
+}
+
+/**
+ * Wakes one of the threads waiting for the condition.
+ */
+void lb_cond_signal(struct LB_COND *cond)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    WakeConditionVariable(&cond->cv);
+#elif defined(LB_PTHREADS)
+    pthread_cond_signal(&cond->cv);
+#endif
+}
+
+/**
+ * Wakes all threads waiting for the condition.
+ */
+void lb_cond_broadcast(struct LB_COND *cond)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    WakeAllConditionVariable(&cond->cv);
+#elif defined(LB_PTHREADS)
+    pthread_cond_broadcast(&cond->cv);
+#endif
+}
+
+/**
+ * Increases the value by one, safely even if other threads
+ * access it at the same time.
+ * @return Returns the increased value.
+ */
+long lb_atomic_inc(volatile long *val)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    return InterlockedIncrement(val);
+#elif defined(LB_PTHREADS)
+    return __sync_add_and_fetch(val,1);
+#else
+    return ++(*val);
+#endif
+}
+
+/**
+ * Decreases the value by one, safely even if other threads
+ * access it at the same time.
+ * @return Returns the decreased value.
+ */
+long lb_atomic_dec(volatile long *val)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    return InterlockedDecrement(val);
+#elif defined(LB_PTHREADS)
+    return __sync_sub_and_fetch(val,1);
+#else
+    return --(*val);
+#endif
+}
+
+/**
+ * Reads the value, seeing all changes made by other threads
+ * before they changed it with one of the lb_atomic_* functions.
+ * @return Returns the value.
+ */
+long lb_atomic_get(volatile long *val)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    return InterlockedCompareExchange(val,0,0);
+#elif defined(LB_PTHREADS)
+    return __sync_add_and_fetch(val,0);
+#else
+    return *val;
+#endif
+}
+
+/**
+ * Sets the value; other threads which read it with lb_atomic_get()
+ * see all changes made before setting it.
+ */
+void lb_atomic_set(volatile long *val,long newval)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    InterlockedExchange(val,newval);
+#elif defined(LB_PTHREADS)
+    /* Exchange is only an acquire barrier; compare-and-swap is a full one */
+    long oldval=__sync_add_and_fetch(val,0);
+    while (!__sync_bool_compare_and_swap(val,oldval,newval))
+      oldval=__sync_add_and_fetch(val,0);
+#else
+    *val=newval;
+#endif
+}
+
+/**
+ * Sets the value only if it is equal to the expected one, safely
+ * even if other threads access it at the same time.
+ * @return Returns true if the value was set.
+ */
+short lb_atomic_cas(volatile long *val,long oldval,long newval)
+{
+#if defined(PROJECT_TARGETS_WINDOWS)
+    return (InterlockedCompareExchange(val,newval,oldval)==oldval);
+#elif defined(LB_PTHREADS)
+    return __sync_bool_compare_and_swap(val,oldval,newval);
+#else
+    if (*val!=oldval)
+      return false;
+    *val=newval;
+    return true;
+#endif
+}
+
+/**
+ * Returns if threads started by lb_thread_start() really run
+ * in parallel with the caller.
+ */
+short lb_threads_available(void)
+{
+#if defined(PROJECT_TARGETS_WINDOWS) || defined(LB_PTHREADS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(PROJECT_TARGETS_WINDOWS)
+static DWORD WINAPI lb_thread_entry(LPVOID param)
+{
+    struct LB_THREAD *thr=(struct LB_THREAD *)param;
+    thr->func(thr->arg);
+    return 0;
+}
+#elif defined(LB_PTHREADS)
+static void *lb_thread_entry(void *param)
+{
+    struct LB_THREAD *thr=(struct LB_THREAD *)param;
+    thr->func(thr->arg);
+    return NULL;
+}
+#endif
+
+/**
+ * Starts a new thread, which executes given function.
+ * If threads are not available, the function is executed before
+ * returning. The thread must be finished with lb_thread_join().
+ * @param func The function to execute.
+ * @param arg Parameter for the function.
+ * @return Returns the thread, or NULL on error.
+ */
+struct LB_THREAD *lb_thread_start(lb_thread_func func,void *arg)
+{
+    struct LB_THREAD *thr;
+    thr=(struct LB_THREAD *)malloc(sizeof(struct LB_THREAD));
+    if (thr==NULL)
+      return NULL;
+    thr->func=func;
+    thr->arg=arg;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    thr->handle=CreateThread(NULL,0,lb_thread_entry,thr,0,NULL);
+    if (thr->handle==NULL)
+    {
+      free(thr);
+      return NULL;
+    }
+#elif defined(LB_PTHREADS)
+    if (pthread_create(&thr->handle,NULL,lb_thread_entry,thr)!=0)
+    {
+      free(thr);
+      return NULL;
+    }
+#else
+    func(arg);
+#endif
+    return thr;
+}
+
+/**
+ * Waits until the thread finishes, and frees it.
+ * @param thr_ptr Double pointer to the thread; it is set to NULL.
+ */
+void lb_thread_join(struct LB_THREAD **thr_ptr)
+{
+    if ((thr_ptr==NULL)||((*thr_ptr)==NULL))
+      return;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    WaitForSingleObject((*thr_ptr)->handle,INFINITE);
+    CloseHandle((*thr_ptr)->handle);
+#elif defined(LB_PTHREADS)
+    pthread_join((*thr_ptr)->handle,NULL);
+#endif
+    free(*thr_ptr);
+    *thr_ptr=NULL;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************/
+/** @file lbthread.h
+ * Library for portable threads and locks.
+ * @par Purpose:
+ *     Header file. Defines exported routines from lbthread.c
+ * @par Comment:
+ *     Objects are opaque, so that system headers aren't needed here.
+ *     On MSDOS there are no threads - locks do nothing, and a started
+ *     thread function is executed at once.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#ifndef LBTHREAD_H
+#define LBTHREAD_H
+
+#include "globals.h"
+
+struct LB_MUTEX;
+struct LB_COND;
+struct LB_THREAD;
+
+typedef void (*lb_thread_func)(void *arg);
+
+DLLIMPORT struct LB_MUTEX *lb_mutex_create(void);
+DLLIMPORT void lb_mutex_free(struct LB_MUTEX **mtx_ptr);
+DLLIMPORT void lb_mutex_lock(struct LB_MUTEX *mtx);
+DLLIMPORT void lb_mutex_unlock(struct LB_MUTEX *mtx);
+
+DLLIMPORT struct LB_COND *lb_cond_create(void);
+DLLIMPORT void lb_cond_free(struct LB_COND **cond_ptr);
+DLLIMPORT void lb_cond_wait(struct LB_COND *cond,struct LB_MUTEX *mtx);
+DLLIMPORT void lb_cond_wait_ms(struct LB_COND *cond,struct LB_MUTEX *mtx,unsigned int msec);
+DLLIMPORT void lb_cond_signal(struct LB_COND *cond);
+DLLIMPORT void lb_cond_broadcast(struct LB_COND *cond);
+
+DLLIMPORT long lb_atomic_inc(volatile long *val);
+DLLIMPORT long lb_atomic_dec(volatile long *val);
+DLLIMPORT long lb_atomic_get(volatile long *val);
+DLLIMPORT void lb_atomic_set(volatile long *val,long newval);
+DLLIMPORT short lb_atomic_cas(volatile long *val,long oldval,long newval);
+
+DLLIMPORT short lb_threads_available(void);
+DLLIMPORT struct LB_THREAD *lb_thread_start(lb_thread_func func,void *arg);
+DLLIMPORT void lb_thread_join(struct LB_THREAD **thr_ptr);
+
+#endif /* LBTHREAD_H */
@@ -26,6 +26,8 @@
 #include "obj_things.h"
 #include "graffiti.h"
 #include "msg_log.h"
+#include "lev_undo.h"
+#include "rng.h"
 
 char const INF_STANDARD_LTEXT[]="Standard";
 char const INF_ANCIENT_LTEXT[]="Ancient";
@@ -67,6 +69,8 @@ void set_clm(struct LEVEL *lvl, int num, unsigned int use, int base,
     clm_rec=create_column_rec();
     fill_column_rec_sim(clm_rec,use, base, c0, c1, c2, c3, c4, c5, c6, c7);
     set_clm_entry(clmentry, clm_rec);
+    clm_anim_update(lvl,num);
+    lvl->changed_files|=LCF_CLM;
     free_column_rec(clm_rec);
 }
 
@@ -94,18 +98,22 @@ void set_clm_ent_idx(struct LEVEL *lvl,int num, unsigned int use, int permanent,
     fill_column_rec(clm_rec,use, permanent, lintel, height, solid,
              base, orientation, c0, c1, c2, c3, c4, c5, c6, c7);
     set_clm_entry(clmentry, clm_rec);
+    clm_anim_update(lvl,num);
+    lvl->changed_files|=LCF_CLM;
     free_column_rec(clm_rec);
 }
 
 /**
  * Searches CLM structure for given column; if not found, creates it.
+ * If the column table is full, it is enlarged when the map format allows it.
  * @param lvl Pointer to the LEVEL structure.
  * @param clm_rec Pointer at searched column.
  * @return Returns index if the column which consists of cubes
  *     identical to those from clm_rec parameter.
        If such column is not found, creates it and returns
        index of the new column. On error returns 0 (column 0 is never
-       used, so this indicates error).
+       used, so this indicates error); such errors are counted
+       in clm_overflows of level statistics.
  */
 int column_find_or_create(struct LEVEL *lvl,struct COLUMN_REC *clm_rec)
 {
@@ -113,37 +121,50 @@ int column_find_or_create(struct LEVEL *lvl,struct COLUMN_REC *clm_rec)
   int num=-1;
   unsigned char *clmentry;
   /* Search for column identical to the one we want */
-  struct COLUMN_REC *clm_rec2;
-  clm_rec2=create_column_rec();
-  for (num=0;num<COLUMN_ENTRIES;num++)
+  struct COLUMN_KEY key;
+  clm_rec_to_key(&key,clm_rec);
+  for (num=0;num<lvl->clm_entries;num++)
   {
       if (clm_entry_is_used(lvl,num))
       {
         clmentry = (unsigned char *)(lvl->clm[num]);
-        get_clm_entry(clm_rec2, clmentry);
-        if (compare_column_recs(clm_rec,clm_rec2))
+        if (compare_column_entry_key(clmentry,&key))
           break;
       }
   }
-  free_column_rec(clm_rec2);
   /* If no identical column, then create one */
-  if ((num<0)||(num>=COLUMN_ENTRIES))
+  if ((num<0)||(num>=lvl->clm_entries))
   {
       num=column_get_free_index(lvl);
-      if ((num>=0)&&(num<COLUMN_ENTRIES))
+      if ((num<0)&&(clm_table_grow(lvl,2*lvl->clm_entries)))
+        num=column_get_free_index(lvl);
+      if ((num>=0)&&(num<lvl->clm_entries))
       {
          clmentry = (unsigned char *)(lvl->clm[num]);
          set_clm_entry(clmentry, clm_rec);
+         clm_anim_update(lvl,num);
+         lvl->changed_files|=LCF_CLM;
+         if (num>=lvl->stats.clm_entries_peak)
+           lvl->stats.clm_entries_peak=num+1;
       }
   }
   /* Sometimes we may not find the free entry... */
   /* If so, return 0 - index of the empty entry */
-  if ((num<0)||(num>=COLUMN_ENTRIES))
+  if ((num<0)||(num>=lvl->clm_entries))
+  {
+     if (lvl->stats.clm_overflows==0)
+       message_error("Column table full, %u entries; using empty column instead",lvl->clm_entries);
+     lvl->stats.clm_overflows++;
      return 0;
+  }
   /* But if we have it - the work is nearly done */
   clmentry = (unsigned char *)(lvl->clm[num]);
   /* If the new entry has permanent set, make sure to keep it */
-  if (clm_rec->permanent) set_clm_entry_permanent(clmentry,1);
+  if ((clm_rec->permanent)&&(!get_clm_entry_permanent(clmentry)))
+  {
+      set_clm_entry_permanent(clmentry,1);
+      lvl->changed_files|=LCF_CLM;
+  }
   /* Now we may return the CLM index */
   return num;
 }
@@ -159,7 +180,7 @@ int column_get_free_index(struct LEVEL *lvl)
   int num;
   /* Search for free column entry */
   /* Skip the first one - it is always zero-filled entry */
-  for (num=1;num<COLUMN_ENTRIES;num++)
+  for (num=1;num<lvl->clm_entries;num++)
   {
       if (!clm_entry_is_used(lvl,num))
           return num;
@@ -167,6 +188,190 @@ int column_get_free_index(struct LEVEL *lvl)
   return -1;
 }
 
+/**
+ * Returns the largest size of column table allowed by the map format.
+ * Standard Dungeon Keeper levels can't have more than COLUMN_ENTRIES.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns maximal number of column entries.
+ */
+unsigned int get_clm_entries_max(const struct LEVEL *lvl)
+{
+  switch (lvl->format_version)
+  {
+  case MFV_DKXPAND:
+      return COLUMN_ENTRIES_DKXPAND;
+  default:
+      return COLUMN_ENTRIES;
+  }
+}
+
+/**
+ * Enlarges the column table, if the map format allows it.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param entries Wanted number of column entries; limited to
+ *     the maximum allowed by the map format.
+ * @return Returns true if the table was enlarged.
+ */
+short clm_table_grow(struct LEVEL *lvl,unsigned int entries)
+{
+  unsigned int max_entries=get_clm_entries_max(lvl);
+  if (entries>max_entries)
+    entries=max_entries;
+  /* Size must allow storing the animation bits in whole bytes */
+  entries=(entries+7)&~7;
+  if (entries<=lvl->clm_entries)
+    return false;
+  message_log_lvl(MSGLOG_DEBUG," clm_table_grow: enlarging from %u to %u columns",lvl->clm_entries,entries);
+  if (!level_set_clm_entries(lvl,entries))
+    return false;
+  lvl->changed_files|=LCF_CLM;
+  return true;
+}
+
+/**
+ * Merges identical columns, and optionally moves all used columns
+ * to lowest indices. DAT entries are changed to use the remaining columns.
+ * Column 0 is never changed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param renumber If true, used columns are moved to lowest indices,
+ *     and enlarged column table is shrunk if possible.
+ * @return Returns number of column entries which were freed by merging.
+ */
+unsigned int columns_compact(struct LEVEL *lvl,short renumber)
+{
+  if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL))
+    return 0;
+  /* Open addressing hash of used columns; keeps index+1, or 0 if empty */
+  unsigned int hash_size=1;
+  while (hash_size<2*lvl->clm_entries)
+    hash_size<<=1;
+  unsigned int *hash;
+  hash=(unsigned int *)calloc(hash_size,sizeof(unsigned int));
+  if (hash==NULL)
+  {
+    message_error("columns_compact: Cannot alloc hash");
+    return 0;
+  }
+  /* Unused entries are overwritten, so the counters must be exact */
+  update_clm_utilize_counters(lvl);
+  unsigned int merged=0;
+  unsigned int idx;
+  struct COLUMN_KEY key;
+  struct COLUMN_KEY key2;
+  for (idx=1; idx<lvl->clm_entries; idx++)
+  {
+    if (!clm_entry_is_used(lvl,idx))
+      continue;
+    unsigned char *clmentry=lvl->clm[idx];
+    clm_entry_to_key(&key,clmentry);
+    unsigned int pos=hash_column_key(&key)&(hash_size-1);
+    while (hash[pos]!=0)
+    {
+      clm_entry_to_key(&key2,lvl->clm[hash[pos]-1]);
+      if (compare_column_keys(&key,&key2))
+        break;
+      pos=(pos+1)&(hash_size-1);
+    }
+    if (hash[pos]==0)
+    {
+      hash[pos]=idx+1;
+      continue;
+    }
+    /* Identical column found - moving DAT entries to it */
+    unsigned int dst_idx=hash[pos]-1;
+    unsigned char *dstentry=lvl->clm[dst_idx];
+    if ((get_clm_entry_permanent(clmentry))&&(!get_clm_entry_permanent(dstentry)))
+      set_clm_entry_permanent(dstentry,1);
+    dat_replace_column(lvl,idx,dst_idx);
+    if (lvl->clm_utilize[idx]>0)
+      continue;
+    clear_clm_entry(clmentry);
+    clm_anim_update(lvl,idx);
+    merged++;
+  }
+  free(hash);
+  if (merged>0)
+    lvl->changed_files|=LCF_CLM|LCF_DAT;
+  if (!renumber)
+    return merged;
+  /* Moving used columns from the end of the table into free entries */
+  unsigned int free_idx=1;
+  unsigned int last_idx=lvl->clm_entries-1;
+  while (1)
+  {
+    while ((free_idx<last_idx)&&(clm_entry_is_used(lvl,free_idx)))
+      free_idx++;
+    while ((last_idx>free_idx)&&(!clm_entry_is_used(lvl,last_idx)))
+      last_idx--;
+    if (free_idx>=last_idx)
+      break;
+    memcpy(lvl->clm[free_idx],lvl->clm[last_idx],SIZEOF_DK_CLM_REC);
+    unsigned int stl;
+    while ((stl=lvl->clm_dat_first[last_idx])!=DAT_CLM_NONE)
+    {
+      set_dat_subtile(lvl,stl%lvl->subsize.x,stl/lvl->subsize.x,free_idx);
+      /* Setting fails if a row shared with snapshot can't be copied */
+      if (lvl->clm_dat_first[last_idx]==stl)
+        break;
+    }
+    if (lvl->clm_dat_first[last_idx]!=DAT_CLM_NONE)
+    {
+      /* Some subtiles are left on the old column; both entries stay */
+      update_clm_utilize_counters(lvl);
+      clm_anim_update(lvl,free_idx);
+      break;
+    }
+    lvl->clm_utilize[free_idx]=lvl->clm_utilize[last_idx];
+    lvl->clm_utilize[last_idx]=0;
+    clear_clm_entry(lvl->clm[last_idx]);
+    clm_anim_update(lvl,free_idx);
+    clm_anim_update(lvl,last_idx);
+    lvl->changed_files|=LCF_CLM|LCF_DAT;
+  }
+  /* Shrinking enlarged table, if the used columns fit in smaller one */
+  unsigned int entries=lvl->clm_entries;
+  while ((entries>COLUMN_ENTRIES)&&(last_idx<entries/2))
+    entries/=2;
+  if (entries<COLUMN_ENTRIES)
+    entries=COLUMN_ENTRIES;
+  if (entries<lvl->clm_entries)
+  {
+    if (level_set_clm_entries(lvl,entries))
+      lvl->changed_files|=LCF_CLM;
+  }
+  return merged;
+}
+
+/**
+ * Gives column table usage, to check how close it is to being full.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param usage The structure to be filled.
+ * @return Returns true on success, false on error.
+ */
+short get_clm_table_usage(const struct LEVEL *lvl,struct CLM_TABLE_USAGE *usage)
+{
+  if ((lvl==NULL)||(usage==NULL)||(lvl->clm==NULL))
+    return false;
+  usage->used=0;
+  usage->highest=0;
+  unsigned int idx;
+  for (idx=0; idx<lvl->clm_entries; idx++)
+  {
+    if (!clm_entry_is_used(lvl,idx))
+      continue;
+    usage->used++;
+    usage->highest=idx;
+  }
+  usage->entries=lvl->clm_entries;
+  usage->max_entries=get_clm_entries_max(lvl);
+  /* Columns set directly, ie. by loading, aren't counted in the peak */
+  usage->peak=lvl->stats.clm_entries_peak;
+  if (usage->peak<=usage->highest)
+    usage->peak=usage->highest+1;
+  usage->overflows=lvl->stats.clm_overflows;
+  return true;
+}
+
 /**
  * Updates DAT, CLM and w?b entries for the whole map. All tiles
  * and subtiles are reset. Additionally, USE values in columns
@@ -288,17 +493,23 @@ void update_datclm_for_square(struct LEVEL *lvl, int tx_first, int tx_last,
 void update_datclm_for_slab(struct LEVEL *lvl, int tx, int ty)
 {
   /*Retrieving parameters from LEVEL structure - the slab and its surrounding */
-  unsigned char *surr_slb=(unsigned char *)malloc(9*sizeof(unsigned char));
-  unsigned char *surr_own=(unsigned char *)malloc(9*sizeof(unsigned char));
-  unsigned char **surr_tng=(unsigned char **)malloc(9*sizeof(unsigned char *));
+  unsigned char surr_slb[9];
+  unsigned char surr_own[9];
+  unsigned char *surr_tng[9];
   get_slab_surround(surr_slb,surr_own,surr_tng,lvl,tx,ty);
   int i;
   /* Creating CoLuMn for each subtile */
-  message_log(" update_datclm_for_slab: Refreshing slab %d tile at %d,%d",(int)surr_slb[IDIR_CENTR],tx,ty);
+  message_log_lvl(MSGLOG_TRACE," update_datclm_for_slab: Refreshing slab %d tile at %d,%d",(int)surr_slb[IDIR_CENTR],tx,ty);
   struct COLUMN_REC *clm_recs[9];
   for (i=0;i<9;i++)
     clm_recs[i]=create_column_rec();
+  /* Every tile has its own sub-stream, so the columns don't depend */
+  /* on the order in which tiles are updated */
+  struct RNG_STREAM tile_rng;
+  rng_stream_split(&tile_rng,&(lvl->rng),(unsigned long long)ty*lvl->tlsize.x+tx);
+  struct RNG_STREAM *prev_rng=rng_stream_bind(&tile_rng);
   create_columns_for_slab(clm_recs,&(lvl->optns),surr_slb,surr_own,surr_tng);
+  rng_stream_bind(prev_rng);
   /*Custom columns, and graffiti */
   if (slab_has_custom_columns(lvl, tx, ty))
     update_custom_columns_for_slab(clm_recs,lvl,tx,ty);
@@ -307,9 +518,6 @@ void update_datclm_for_slab(struct LEVEL *lvl, int tx, int ty)
   /* Flushing dynamic data */
   for (i=0;i<9;i++)
     free_column_rec(clm_recs[i]);
-  free(surr_slb);
-  free(surr_own);
-  free(surr_tng);
 }
 
 /**
@@ -450,9 +658,10 @@ void set_new_datclm_entry(struct LEVEL *lvl, int sx, int sy, struct COLUMN_REC *
  */
 void clm_utilize_dec(struct LEVEL *lvl, int clmidx)
 {
-  if ((clmidx<0)||(clmidx>=COLUMN_ENTRIES))
+  if ((clmidx<0)||(clmidx>=lvl->clm_entries))
     return;
   lvl->clm_utilize[clmidx]--;
+  lvl->changed_files|=LCF_CLM;
   unsigned char *clmentry;
   clmentry=lvl->clm[clmidx];
   if (clmentry!=NULL)
@@ -462,6 +671,7 @@ void clm_utilize_dec(struct LEVEL *lvl, int clmidx)
   {
     lvl->clm_utilize[clmidx]=0;
     clear_clm_entry(clmentry);
+    clm_anim_update(lvl,clmidx);
   }
 }
 
@@ -474,9 +684,10 @@ void clm_utilize_dec(struct LEVEL *lvl, int clmidx)
  */
 void clm_utilize_inc(struct LEVEL *lvl, int clmidx)
 {
-  if ((clmidx<0)||(clmidx>=COLUMN_ENTRIES))
+  if ((clmidx<0)||(clmidx>=lvl->clm_entries))
     return;
   lvl->clm_utilize[clmidx]++;
+  lvl->changed_files|=LCF_CLM;
   unsigned char *clmentry;
   clmentry=lvl->clm[clmidx];
   if (clmentry!=NULL)
@@ -497,7 +708,7 @@ short columns_verify(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt)
     /*checking entries */
     short result;
     int i;
-    for (i=0; i<COLUMN_ENTRIES; i++)
+    for (i=0; i<lvl->clm_entries; i++)
     {
       result=clm_verify_entry(lvl->clm[i],err_msg);
       if (result!=VERIF_OK)
@@ -519,6 +730,13 @@ short columns_verify(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt)
         return result;
       }
     }
+    if (lvl->stats.clm_overflows>0)
+    {
+      errpt->x=-1;errpt->y=-1;
+      sprintf(err_msg,"Column table was full, %d columns replaced by empty one.",
+          lvl->stats.clm_overflows);
+      return VERIF_WARN;
+    }
   return VERIF_OK;
 }
 
@@ -533,7 +751,7 @@ void update_clm_utilize_counters(struct LEVEL *lvl)
 {
   int clmidx;
   /*Set all "utilize" values to 0 */
-  for (clmidx=0; clmidx<COLUMN_ENTRIES; clmidx++)
+  for (clmidx=0; clmidx<lvl->clm_entries; clmidx++)
   {
       lvl->clm_utilize[clmidx]=0;
   }
@@ -543,50 +761,97 @@ void update_clm_utilize_counters(struct LEVEL *lvl)
     for (cx=0; cx < lvl->subsize.x; cx++)
     {
       clmidx=get_dat_subtile(lvl, cx, cy);
-      if ((clmidx>=0)&&(clmidx<COLUMN_ENTRIES))
+      if ((clmidx>=0)&&(clmidx<lvl->clm_entries))
         lvl->clm_utilize[clmidx]++;
     }
 }
 
+/**
+ * Updates the animated columns set entry for given column.
+ * Should be called every time cubes of a CLM entry are changed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param clmidx Column index.
+ */
+void clm_anim_update(struct LEVEL *lvl, int clmidx)
+{
+  if ((clmidx<0)||(clmidx>=lvl->clm_entries))
+    return;
+  unsigned char mask=(1<<(clmidx&7));
+  if (clm_entry_wib_animate(lvl->clm[clmidx]))
+    lvl->clm_anim[clmidx>>3]|=mask;
+  else
+    lvl->clm_anim[clmidx>>3]&=~mask;
+}
+
+/**
+ * Recomputes the animated columns set for all CLM entries.
+ * Should be called after loading CLM file.
+ * @param lvl Pointer to the LEVEL structure.
+ */
+void update_clm_anim_bits(struct LEVEL *lvl)
+{
+  int clmidx;
+  for (clmidx=0; clmidx<lvl->clm_entries; clmidx++)
+    clm_anim_update(lvl,clmidx);
+}
+
+/**
+ * Returns if column on given subtile contains animated cubes.
+ * Subtiles outside of the map are treated as column 0.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param sx,sy Map subtile coordinates.
+ * @return Returns 1 if the column is animated, 0 otherwise.
+ */
+static unsigned int subtile_clm_anim(const struct LEVEL *lvl, int sx, int sy)
+{
+  unsigned int clmidx=get_dat_subtile(lvl, sx, sy);
+  if (clmidx>=lvl->clm_entries)
+    return 0;
+  return (lvl->clm_anim[clmidx>>3]>>(clmidx&7))&1;
+}
+
 /**
  * Updates WIB animation entries for all subtiles of given tile.
+ * A subtile is animated if its column and columns at north, west
+ * and north-west are all animated.
  * @param lvl Pointer to the LEVEL structure.
  * @param tx,ty Map tile coordinates, in range 0-MAP_MAXINDEX_X/Y.
  */
 void update_tile_wib_entries(struct LEVEL *lvl, int tx, int ty)
 {
   int i,k;
-  struct COLUMN_REC *clm_rec;
-  struct COLUMN_REC *clm_rec_n;
-  struct COLUMN_REC *clm_rec_w;
-  struct COLUMN_REC *clm_rec_nw;
-  clm_rec=create_column_rec();
-  clm_rec_n=create_column_rec();
-  clm_rec_w=create_column_rec();
-  clm_rec_nw=create_column_rec();
+  int sx_first=tx*MAP_SUBNUM_X;
+  int sy_first=ty*MAP_SUBNUM_Y;
+  /* Animation bits of the previous and current subtile row, */
+  /* starting with the column at west of the tile */
+  unsigned int prev_row[MAP_SUBNUM_X+1];
+  unsigned int cur_row[MAP_SUBNUM_X+1];
+  for (i=0;i<=MAP_SUBNUM_X;i++)
+    prev_row[i]=subtile_clm_anim(lvl,sx_first+i-1,sy_first-1);
   for (k=0;k<MAP_SUBNUM_Y;k++)
+  {
+    int sy=sy_first+k;
+    for (i=0;i<=MAP_SUBNUM_X;i++)
+      cur_row[i]=subtile_clm_anim(lvl,sx_first+i-1,sy);
     for (i=0;i<MAP_SUBNUM_X;i++)
     {
-      int sx=tx*MAP_SUBNUM_X+i;
-      int sy=ty*MAP_SUBNUM_Y+k;
-            short wib_entry;
+      int sx=sx_first+i;
+      short wib_entry;
       if (get_cust_col(lvl,sx,sy)!=NULL)
       {
         wib_entry=get_cust_col_wib_entry(lvl,sx,sy);
       } else
+      if (cur_row[i+1]&cur_row[i]&prev_row[i+1]&prev_row[i])
       {
-        get_subtile_column_rec(lvl, clm_rec_nw, sx-1, sy-1);
-        get_subtile_column_rec(lvl, clm_rec_n,  sx,   sy-1);
-        get_subtile_column_rec(lvl, clm_rec_w,  sx-1, sy);
-        get_subtile_column_rec(lvl, clm_rec,    sx  , sy);
-        wib_entry=column_wib_entry(clm_rec,clm_rec_n,clm_rec_w,clm_rec_nw);
+        wib_entry=COLUMN_WIB_ANIMATE;
+      } else
+      {
+        wib_entry=COLUMN_WIB_SKEW;
       }
-      set_subtl_wib(lvl, tx*MAP_SUBNUM_X+i, ty*MAP_SUBNUM_Y+k, wib_entry);
+      set_subtl_wib(lvl, sx, sy, wib_entry);
     }
-  free_column_rec(clm_rec);
-  free_column_rec(clm_rec_n);
-  free_column_rec(clm_rec_w);
-  free_column_rec(clm_rec_nw);
+    memcpy(prev_row,cur_row,sizeof(prev_row));
+  }
 }
 
 /**
@@ -727,7 +992,7 @@ unsigned char *get_subtile_column(const struct LEVEL *lvl, int sx, int sy)
     return NULL;
   unsigned int clmidx;
   clmidx=get_dat_subtile(lvl, sx, sy);
-  if (clmidx>=COLUMN_ENTRIES)
+  if (clmidx>=lvl->clm_entries)
     return NULL;
   return (unsigned char *)(lvl->clm[clmidx]);
 }
@@ -846,11 +1111,93 @@ void set_dat_unif (struct LEVEL *lvl, int x, int y, int d)
     set_dat (lvl, x, y, d, d, d, d, d, d, d, d, d);
 }
 
+/**
+ * Adds a subtile to the reverse DAT index list of given column.
+ */
+static void dat_clm_link(struct LEVEL *lvl, unsigned int stl, unsigned int clmidx)
+{
+  unsigned int first=lvl->clm_dat_first[clmidx];
+  lvl->dat_clm_prev[stl]=DAT_CLM_NONE;
+  lvl->dat_clm_next[stl]=first;
+  if (first!=DAT_CLM_NONE)
+    lvl->dat_clm_prev[first]=stl;
+  lvl->clm_dat_first[clmidx]=stl;
+}
+
+/**
+ * Removes a subtile from the reverse DAT index list of given column.
+ * Subtiles which are not on the list are left untouched.
+ */
+static void dat_clm_unlink(struct LEVEL *lvl, unsigned int stl, unsigned int clmidx)
+{
+  unsigned int prev=lvl->dat_clm_prev[stl];
+  unsigned int next=lvl->dat_clm_next[stl];
+  if (prev!=DAT_CLM_NONE)
+    lvl->dat_clm_next[prev]=next;
+  else
+  if (lvl->clm_dat_first[clmidx]==stl)
+    lvl->clm_dat_first[clmidx]=next;
+  else
+    return;
+  if (next!=DAT_CLM_NONE)
+    lvl->dat_clm_prev[next]=prev;
+  lvl->dat_clm_prev[stl]=DAT_CLM_NONE;
+  lvl->dat_clm_next[stl]=DAT_CLM_NONE;
+}
+
+/**
+ * Updates the reverse DAT index after a DAT value was changed.
+ * Called by set_dat_val(); shouldn't be used directly.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param sx,sy Map subtile coordinates.
+ * @param prev_val,new_val Raw DAT values before and after the change.
+ */
+void dat_clm_index_change(struct LEVEL *lvl, int sx, int sy,
+    unsigned int prev_val, unsigned int new_val)
+{
+  if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL))
+    return;
+  unsigned int stl=sy*lvl->subsize.x+sx;
+  unsigned int clmidx;
+  clmidx=(0x10000-prev_val)&0x0ffff;
+  if (clmidx<lvl->clm_entries)
+    dat_clm_unlink(lvl,stl,clmidx);
+  clmidx=(0x10000-new_val)&0x0ffff;
+  if (clmidx<lvl->clm_entries)
+    dat_clm_link(lvl,stl,clmidx);
+}
+
+/**
+ * Rebuilds the reverse DAT index from DAT values.
+ * Needed only if DAT entries were changed without set_dat_val().
+ * @param lvl Pointer to the LEVEL structure.
+ */
+void update_dat_clm_index(struct LEVEL *lvl)
+{
+  if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL))
+    return;
+  memset(lvl->clm_dat_first,0xff,lvl->clm_entries*sizeof(unsigned int));
+  int sx,sy;
+  /* Going backwards makes every list sorted by subtile number */
+  for (sy=lvl->subsize.y-1; sy>=0; sy--)
+    for (sx=lvl->subsize.x-1; sx>=0; sx--)
+    {
+      unsigned int stl=sy*lvl->subsize.x+sx;
+      unsigned int clmidx=get_dat_subtile(lvl,sx,sy);
+      lvl->dat_clm_prev[stl]=DAT_CLM_NONE;
+      lvl->dat_clm_next[stl]=DAT_CLM_NONE;
+      if (clmidx<lvl->clm_entries)
+        dat_clm_link(lvl,stl,clmidx);
+    }
+}
+
 /**
  * Searches for next subtile which uses column of given index.
  * Starts searching at a subtile after (sx,sy). Finds the next subtile containing
  * given clm_index and returns it in (sx,sy). On error/cannot find,
  * sets (sx,sy) to (-1,-1). If (-1,-1) is given at start, searches from (0,0).
+ * Uses the reverse DAT index, so the cost depends on amount of subtiles
+ * using the column, not on map size.
  * @param lvl Pointer to the LEVEL structure.
  * @param sx,sy Map subtile position to start search. Position of the subtile
  *     found is also returned here.
@@ -861,17 +1208,116 @@ short find_dat_entry(const struct LEVEL *lvl, int *sx, int *sy, const unsigned i
 {
   if (((*sx)<0)||((*sy)<0))
   { (*sx)=-1; (*sy)=0; }
-  do {
-    (*sx)++;
-    if ((*sx)>=lvl->subsize.x)
-    { (*sx)=0; (*sy)++; }
-    if ((*sy)>=lvl->subsize.x)
+  if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL))
+  {
+    do {
+      (*sx)++;
+      if ((*sx)>=lvl->subsize.x)
+      { (*sx)=0; (*sy)++; }
+      if ((*sy)>=lvl->subsize.y)
+      {
+        (*sx)=-1; (*sy)=-1;
+        return false;
+      }
+    } while (get_dat_subtile(lvl,*sx,*sy) != clm_idx);
+    return true;
+  }
+  /* Lists aren't sorted after edits, so we need the nearest following item */
+  long start=(long)(*sy)*lvl->subsize.x+(*sx);
+  unsigned int found=DAT_CLM_NONE;
+  unsigned int stl=DAT_CLM_NONE;
+  if (clm_idx<lvl->clm_entries)
+    stl=lvl->clm_dat_first[clm_idx];
+  while (stl!=DAT_CLM_NONE)
+  {
+    if (((long)stl>start)&&(stl<found))
+      found=stl;
+    stl=lvl->dat_clm_next[stl];
+  }
+  if (found==DAT_CLM_NONE)
+  {
+    (*sx)=-1; (*sy)=-1;
+    return false;
+  }
+  (*sx)=found%lvl->subsize.x;
+  (*sy)=found/lvl->subsize.x;
+  return true;
+}
+
+/**
+ * Returns positions of all subtiles which use column of given index.
+ * The subtiles are returned in no particular order.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param clm_idx Column index.
+ * @param stl_list Output array for subtile positions, or NULL.
+ * @param max_count Size of the output array.
+ * @return Returns amount of subtiles using the column; it may be larger
+ *     than max_count, but no more than max_count items are stored.
+ */
+unsigned int get_clm_dat_entries(const struct LEVEL *lvl, const unsigned int clm_idx,
+    struct IPOINT_2D *stl_list, unsigned int max_count)
+{
+  unsigned int count=0;
+  if (clm_idx>=lvl->clm_entries)
+    return 0;
+  if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL))
+  {
+    int sx,sy;
+    sx=-1; sy=-1;
+    while (find_dat_entry(lvl,&sx,&sy,clm_idx))
     {
-      (*sx)=-1; (*sy)=-1;
-      return false;
+      if ((stl_list!=NULL)&&(count<max_count))
+      { stl_list[count].x=sx; stl_list[count].y=sy; }
+      count++;
     }
-  } while (get_dat_subtile(lvl,*sx,*sy) != clm_idx);
-  return true;
+    return count;
+  }
+  unsigned int stl=lvl->clm_dat_first[clm_idx];
+  while (stl!=DAT_CLM_NONE)
+  {
+    if ((stl_list!=NULL)&&(count<max_count))
+    {
+      stl_list[count].x=stl%lvl->subsize.x;
+      stl_list[count].y=stl/lvl->subsize.x;
+    }
+    count++;
+    stl=lvl->dat_clm_next[stl];
+  }
+  return count;
+}
+
+/**
+ * Replaces one column with another on all subtiles which use it.
+ * Updates UTILIZE and USE values; the old column is cleared if it
+ * becomes unused.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param src_idx Index of the column to be replaced.
+ * @param dst_idx Index of the column to put instead.
+ * @return Returns amount of subtiles changed.
+ */
+unsigned int dat_replace_column(struct LEVEL *lvl, const unsigned int src_idx,
+    const unsigned int dst_idx)
+{
+  if ((src_idx>=lvl->clm_entries)||(dst_idx>=lvl->clm_entries)||(src_idx==dst_idx))
+    return 0;
+  if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL))
+    return 0;
+  unsigned int count=0;
+  unsigned int stl;
+  /* Every change removes the subtile from the source list */
+  while ((stl=lvl->clm_dat_first[src_idx])!=DAT_CLM_NONE)
+  {
+    int sx=stl%lvl->subsize.x;
+    int sy=stl/lvl->subsize.x;
+    set_dat_subtile(lvl,sx,sy,dst_idx);
+    /* Setting fails if a row shared with snapshot can't be copied */
+    if (lvl->clm_dat_first[src_idx]==stl)
+      break;
+    clm_utilize_inc(lvl,dst_idx);
+    clm_utilize_dec(lvl,src_idx);
+    count++;
+  }
+  return count;
 }
 
 /**
@@ -891,7 +1337,7 @@ short dat_verify(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt)
       for (i=0; i<lvl->subsize.x; i++)
       {
           int dat_idx=get_dat_subtile(lvl, i, k);
-          if ((dat_idx<0)||(dat_idx>=COLUMN_ENTRIES))
+          if ((dat_idx<0)||(dat_idx>=lvl->clm_entries))
           {
               errpt->x=i/MAP_SUBNUM_X;
               errpt->y=k/MAP_SUBNUM_Y;
@@ -912,11 +1358,12 @@ short dat_verify(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt)
  */
 short clm_entry_is_used(const struct LEVEL *lvl,unsigned int clmidx)
 {
+    if (lvl->clm_utilize[clmidx]>0)
+        return true;
     unsigned char *clmentry;
     clmentry = (unsigned char *)(lvl->clm[clmidx]);
     if (clmentry==NULL) return false;
-    unsigned int permanent=get_clm_entry_permanent(clmentry);
-    return (lvl->clm_utilize[clmidx]>0)||(permanent);
+    return get_clm_entry_permanent(clmentry);
 }
 
 /**
@@ -931,9 +1378,9 @@ short clm_entry_is_used(const struct LEVEL *lvl,unsigned int clmidx)
 short update_dat_last_column(struct LEVEL *lvl, unsigned short slab)
 {
   /*Retrieving parameters from LEVEL structure - the slab and its surrounding */
-  unsigned char *surr_slb=(unsigned char *)malloc(9*sizeof(unsigned char));
-  unsigned char *surr_own=(unsigned char *)malloc(9*sizeof(unsigned char));
-  unsigned char **surr_tng=(unsigned char **)malloc(9*sizeof(unsigned char *));
+  unsigned char surr_slb[9];
+  unsigned char surr_own[9];
+  unsigned char *surr_tng[9];
   get_slab_surround(surr_slb,surr_own,surr_tng,lvl,lvl->tlsize.x,lvl->tlsize.y);
   surr_slb[IDIR_CENTR]=slab;
   int i;
@@ -941,7 +1388,12 @@ short update_dat_last_column(struct LEVEL *lvl, unsigned short slab)
   struct COLUMN_REC *clm_recs[9];
   for (i=0;i<9;i++)
     clm_recs[i]=create_column_rec();
+  /* The last column gets sub-stream after the ones of tiles */
+  struct RNG_STREAM tile_rng;
+  rng_stream_split(&tile_rng,&(lvl->rng),(unsigned long long)lvl->tlsize.y*lvl->tlsize.x);
+  struct RNG_STREAM *prev_rng=rng_stream_bind(&tile_rng);
   create_columns_for_slab(clm_recs,&(lvl->optns),surr_slb,surr_own,surr_tng);
+  rng_stream_bind(prev_rng);
   /*Use the columns to set DAT/CLM entries in LEVEL */
   int sx, sy;
   sx=lvl->subsize.x-1;
@@ -953,9 +1405,6 @@ short update_dat_last_column(struct LEVEL *lvl, unsigned short slab)
   /* Flushing dynamic data */
   for (i=0;i<9;i++)
     free_column_rec(clm_recs[i]);
-  free(surr_slb);
-  free(surr_own);
-  free(surr_tng);
   return ERR_NONE;
 }
 
@@ -1140,6 +1589,7 @@ short set_cust_col(struct LEVEL *lvl,int sx,int sy,struct DK_CUSTOM_CLM *ccol)
       return false;
     lvl->cust_clm_lookup[sx][sy]=ccol;
     lvl->cust_clm_count++;
+    level_undo_rec_custclm(lvl,UDT_CUSTCLM_ADD,sx,sy,ccol);
     return true;
 }
 
@@ -1191,6 +1641,7 @@ short cust_col_del(struct LEVEL *lvl, int sx, int sy)
     ccol=lvl->cust_clm_lookup[sx][sy];
     lvl->cust_clm_lookup[sx][sy]=NULL;
     if (ccol==NULL) return false;
+    level_undo_rec_custclm(lvl,UDT_CUSTCLM_DEL,sx,sy,ccol);
     /*Decrease the count by one */
     lvl->cust_clm_count--;
     /*Decrease amount of allocated memory, or free the block */
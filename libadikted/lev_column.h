@@ -21,6 +21,9 @@
 //Size of texture/tileset list
 #define INF_MAX_INDEX 11
 
+//End of list marker in the reverse DAT index
+#define DAT_CLM_NONE 0xffffffff
+
 struct LEVEL;
 struct COLUMN_REC;
 struct DK_CUSTOM_CLM;
@@ -28,6 +31,22 @@ struct IPOINT_2D;
 
 #include "globals.h"
 
+/**
+ * Column table usage, to check how close it is to being full.
+ */
+struct CLM_TABLE_USAGE {
+    /* Number of used columns, and the highest used index */
+    unsigned int used;
+    unsigned int highest;
+    /* Current and maximal size of the column table */
+    unsigned int entries;
+    unsigned int max_entries;
+    /* Highest column index ever used plus one */
+    unsigned int peak;
+    /* Columns which couldn't be created because the table was full */
+    unsigned int overflows;
+  };
+
 void set_clm_ent_idx(struct LEVEL *lvl, int num, unsigned int use, int permanent,
         int lintel, int height, unsigned int solid, int base, int orientation,
         int c0, int c1, int c2, int c3, int c4, int c5, int c6, int c7);
@@ -37,6 +56,10 @@ DLLIMPORT void set_clm(struct LEVEL *lvl, int num, unsigned int use, int base,
 DLLIMPORT int column_find_or_create(struct LEVEL *lvl,struct COLUMN_REC *clm_rec);
 DLLIMPORT int column_get_free_index(struct LEVEL *lvl);
 DLLIMPORT short columns_verify(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt);
+DLLIMPORT unsigned int get_clm_entries_max(const struct LEVEL *lvl);
+DLLIMPORT short clm_table_grow(struct LEVEL *lvl,unsigned int entries);
+DLLIMPORT unsigned int columns_compact(struct LEVEL *lvl,short renumber);
+DLLIMPORT short get_clm_table_usage(const struct LEVEL *lvl,struct CLM_TABLE_USAGE *usage);
 
 DLLIMPORT unsigned int get_dat_subtile(const struct LEVEL *lvl, const unsigned int sx, const unsigned int sy);
 DLLIMPORT void set_dat_subtile(struct LEVEL *lvl, int sx, int sy, int d);
@@ -44,6 +67,13 @@ void set_dat(struct LEVEL *lvl,int x, int y, int tl, int tm, int tr,
         int ml, int mm, int mr, int bl, int bm, int br);
 void set_dat_unif (struct LEVEL *lvl, int x, int y, int d);
 DLLIMPORT short find_dat_entry(const struct LEVEL *lvl, int *sx, int *sy, const unsigned int clm_idx);
+DLLIMPORT unsigned int get_clm_dat_entries(const struct LEVEL *lvl, const unsigned int clm_idx,
+    struct IPOINT_2D *stl_list, unsigned int max_count);
+DLLIMPORT unsigned int dat_replace_column(struct LEVEL *lvl, const unsigned int src_idx,
+    const unsigned int dst_idx);
+DLLIMPORT void update_dat_clm_index(struct LEVEL *lvl);
+void dat_clm_index_change(struct LEVEL *lvl, int sx, int sy,
+    unsigned int prev_val, unsigned int new_val);
 DLLIMPORT short dat_verify(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt);
 
 DLLIMPORT void update_datclm_for_whole_map(struct LEVEL *lvl);
@@ -59,6 +89,8 @@ DLLIMPORT void get_slab_surround(unsigned char *surr_slb,unsigned char *surr_own
 DLLIMPORT void clm_utilize_dec(struct LEVEL *lvl, int clmidx);
 DLLIMPORT void clm_utilize_inc(struct LEVEL *lvl, int clmidx);
 DLLIMPORT short clm_entry_is_used(const struct LEVEL *lvl,unsigned int clmidx);
+DLLIMPORT void clm_anim_update(struct LEVEL *lvl, int clmidx);
+DLLIMPORT void update_clm_anim_bits(struct LEVEL *lvl);
 DLLIMPORT short update_dat_last_column(struct LEVEL *lvl, unsigned short slab);
 
 DLLIMPORT void update_tile_wib_entries(struct LEVEL *lvl, int tx, int ty);
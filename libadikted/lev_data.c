@@ -38,6 +38,10 @@
 #include "bulcommn.h"
 #include "arr_utils.h"
 #include "rng.h"
+#include "lev_regions.h"
+#include "enrnc.h"
+#include "lev_undo.h"
+#include "lev_snapshot.h"
 
 const int idir_subtl_x[]={
     0, 1, 2,
@@ -54,6 +58,8 @@ const char default_map_name[]="Unnamed %Y.%m.%d map";
 /**
  * Creates object for storing one level. Allocates memory and inits
  * the values to zero; drops any previous pointers without deallocating.
+ * Levels don't share data, so separate levels may be used by separate
+ * threads; one level must be used by one thread at a time.
  * @param lvl_ptr Double pointer to the new level structure.
  * @param map_version Map version constant, from MAP_FORMAT_VERSION enumeration.
  * @param lvl_size Level size struct.This can be NULL if map_version 
@@ -96,24 +102,19 @@ short level_init(struct LEVEL **lvl_ptr,short map_version,struct UPOINT_3D *lvl_
     const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
 
   { /*allocating CLM structures */
-    lvl->clm = (unsigned char **)malloc(COLUMN_ENTRIES*sizeof(char *));
+    lvl->clm_entries=COLUMN_ENTRIES;
+    lvl->clm = clm_table_alloc(lvl->clm_entries);
     if (lvl->clm==NULL)
     {
         message_error("level_init: Cannot alloc clm memory");
         return false;
     }
-    int i;
-    for (i=0; i<COLUMN_ENTRIES; i++)
-    {
-      lvl->clm[i]=(unsigned char *)malloc(SIZEOF_DK_CLM_REC);
-      if (lvl->clm[i]==NULL)
-    {
-        message_error("level_init: Cannot alloc clm entries");
-        return false;
-    }
-    }
     lvl->clm_hdr=(unsigned char *)malloc(SIZEOF_DK_CLM_HEADER);
-    lvl->clm_utilize=(unsigned int *)malloc(COLUMN_ENTRIES*sizeof(unsigned int *));
+    lvl->clm_utilize=(unsigned int *)malloc(lvl->clm_entries*sizeof(unsigned int));
+    lvl->clm_anim=(unsigned char *)malloc(lvl->clm_entries>>3);
+    lvl->clm_dat_first=(unsigned int *)malloc(lvl->clm_entries*sizeof(unsigned int));
+    if (lvl->clm_dat_first!=NULL)
+      memset(lvl->clm_dat_first,0xff,lvl->clm_entries*sizeof(unsigned int));
   }
   { /*allocating SLB structures */
     int i;
@@ -168,6 +169,16 @@ short level_init(struct LEVEL **lvl_ptr,short map_version,struct UPOINT_3D *lvl_
         return false;
       }
     }
+    lvl->dat_clm_next=(unsigned int *)malloc(lvl->subsize.x*lvl->subsize.y*sizeof(unsigned int));
+    lvl->dat_clm_prev=(unsigned int *)malloc(lvl->subsize.x*lvl->subsize.y*sizeof(unsigned int));
+    if ((lvl->dat_clm_next==NULL)||(lvl->dat_clm_prev==NULL))
+    {
+        message_error("level_init: Cannot alloc dat index");
+        return false;
+    }
+    /* DAT entries aren't set yet, so no subtile is on any list */
+    memset(lvl->dat_clm_next,0xff,lvl->subsize.x*lvl->subsize.y*sizeof(unsigned int));
+    memset(lvl->dat_clm_prev,0xff,lvl->subsize.x*lvl->subsize.y*sizeof(unsigned int));
   }
   { /*allocating WIB structures */
     lvl->wib= (unsigned char **)malloc(lvl->subsize.y*sizeof(char *));
@@ -224,64 +235,28 @@ short level_init(struct LEVEL **lvl_ptr,short map_version,struct UPOINT_3D *lvl_
     }
   }
   { /*Allocating "things" structure */
-    lvl->tng_lookup = (unsigned char ****)malloc(arr_entries_y*sizeof(unsigned char ***));
-    lvl->tng_subnums= (unsigned short **)malloc(arr_entries_y*sizeof(unsigned short *));
-    if ((lvl->tng_lookup==NULL) || (lvl->tng_subnums==NULL))
+    lvl->tng_lookup = objlookup_create(arr_entries_x,arr_entries_y);
+    if (lvl->tng_lookup==NULL)
     {
         message_error("level_init: Cannot alloc tng memory");
         return false;
     }
-    int i;
-    for (i=0; i<arr_entries_y; i++)
-    {
-      lvl->tng_lookup[i]=(unsigned char ***)malloc (arr_entries_x*sizeof(unsigned char **));
-      lvl->tng_subnums[i]=(unsigned short *)malloc (arr_entries_x*sizeof(unsigned short));
-      if ((lvl->tng_lookup[i]==NULL) || (lvl->tng_subnums[i]==NULL))
-      {
-        message_error("level_init: Cannot alloc tng subnums");
-        return false;
-      }
-    }
   }
   { /*Allocating "action points" structure */
-    lvl->apt_lookup = (unsigned char ****)malloc(arr_entries_y*sizeof(unsigned char ***));
-    lvl->apt_subnums= (unsigned short **)malloc(arr_entries_y*sizeof(unsigned short *));
-    if ((lvl->apt_lookup==NULL) || (lvl->apt_subnums==NULL))
+    lvl->apt_lookup = objlookup_create(arr_entries_x,arr_entries_y);
+    if (lvl->apt_lookup==NULL)
     {
         message_error("level_init: Cannot alloc apt lookup");
         return false;
     }
-    int i;
-    for (i=0; i<arr_entries_y; i++)
-    {
-      lvl->apt_lookup[i]=(unsigned char ***)malloc (arr_entries_x*sizeof(unsigned char **));
-      lvl->apt_subnums[i]=(unsigned short *)malloc (arr_entries_x*sizeof(unsigned short));
-      if ((lvl->apt_lookup[i]==NULL) || (lvl->apt_subnums[i]==NULL))
-      {
-        message_error("level_init: Cannot alloc apt entries");
-        return false;
-      }
-    }
   }
   { /*Allocating "static lights" structure */
-    lvl->lgt_lookup = (unsigned char ****)malloc(arr_entries_y*sizeof(unsigned char ***));
-    lvl->lgt_subnums= (unsigned short **)malloc(arr_entries_y*sizeof(unsigned short *));
-    if ((lvl->lgt_lookup==NULL) || (lvl->lgt_subnums==NULL))
+    lvl->lgt_lookup = objlookup_create(arr_entries_x,arr_entries_y);
+    if (lvl->lgt_lookup==NULL)
     {
         message_error("level_init: Cannot alloc lgt lookup");
         return false;
     }
-    int i;
-    for (i=0; i<arr_entries_y; i++)
-    {
-      lvl->lgt_lookup[i]=(unsigned char ***)malloc (arr_entries_x*sizeof(unsigned char **));
-      lvl->lgt_subnums[i]=(unsigned short *)malloc (arr_entries_x*sizeof(unsigned short));
-      if ((lvl->lgt_lookup[i]==NULL) || (lvl->lgt_subnums[i]==NULL))
-      {
-        message_error("level_init: Cannot alloc lgt entries");
-        return false;
-      }
-    }
   }
   { /*Allocating WLB structure */
     lvl->wlb = (unsigned char **)malloc(lvl->tlsize.y*sizeof(unsigned char *));
@@ -351,6 +326,44 @@ short level_init(struct LEVEL **lvl_ptr,short map_version,struct UPOINT_3D *lvl_
       }
     }
   }
+  { /*allocating SLX structure */
+    lvl->slx_data=(unsigned char *)malloc(lvl->tlsize.x*lvl->tlsize.y*sizeof(unsigned char));
+    if (lvl->slx_data==NULL)
+    {
+        message_error("level_init: Cannot alloc slx memory");
+        return false;
+    }
+  }
+  { /*allocating graffiti index structures */
+    lvl->graffiti_tile_head=(int *)malloc(lvl->tlsize.x*lvl->tlsize.y*sizeof(int));
+    if (lvl->graffiti_tile_head==NULL)
+    {
+        message_error("level_init: Cannot alloc graffiti index");
+        return false;
+    }
+    lvl->graffiti_tiles=NULL;
+    lvl->graffiti_tiles_alloc=0;
+  }
+  { /*allocating edit transaction structures */
+    lvl->edit_dirty=(unsigned char *)malloc(lvl->tlsize.x*lvl->tlsize.y*sizeof(unsigned char));
+    if (lvl->edit_dirty==NULL)
+    {
+        message_error("level_init: Cannot alloc edit dirty tiles");
+        return false;
+    }
+    lvl->undo=NULL;
+    lvl->obj_hook=NULL;
+    lvl->obj_hook_data=NULL;
+  }
+  { /* no rows are shared with snapshots yet */
+    int i;
+    for (i=0; i<LGRD_COUNT; i++)
+      lvl->grid_refs[i]=NULL;
+    lvl->snapshot_seq=0;
+    lvl->snapshot_changed=LCF_NONE;
+  }
+  /* unless seeded by the caller, every level gets its own random stream */
+  level_rng_seed(lvl,((unsigned long long)rng_rand()<<32) ^ rng_rand());
   message_log(" level_init: finished, now clearing");
   level_clear_options(&(lvl->optns));
   return level_clear(lvl);
@@ -398,7 +411,10 @@ short level_clear_options(struct LEVOPTIONS *optns)
     optns->levels_path=NULL;
     optns->data_path=NULL;
     optns->load_redundant_objects=true;
+    optns->packed_files=LCF_NONE;
+    optns->pack_level=RNC_PACK_LEVEL_DEFAULT;
     optns->verify_warn_flags=VWFLAG_NONE;
+    optns->stats_check=false;
     optns->picture.rescale=4;
     optns->picture.data_path=NULL;
     optns->picture.bmfonts=BMFONT_DONT_LOAD;
@@ -458,6 +474,58 @@ struct MAPDRAW_OPTIONS *level_get_mapdraw_options(struct LEVEL *lvl)
     return &(lvl->optns.picture);
 }
 
+/**
+ * Seeds the random numbers stream of the level.
+ * Random map generation and column generation draw from this stream,
+ * so the same seed gives the same level in any thread, regardless of
+ * how many other levels are generated at the same time.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param seed The new seed value.
+ */
+void level_rng_seed(struct LEVEL *lvl,unsigned long long seed)
+{
+    rng_stream_seed(&(lvl->rng),seed);
+}
+
+/**
+ * Sets the function notified about every object added to or removed
+ * from the level. Allows editors to keep data computed from objects
+ * up to date without sweeping through all of them.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param func The function to call, or NULL to stop the notifications.
+ * @param data Value passed to the function.
+ */
+void level_set_obj_hook(struct LEVEL *lvl,level_obj_hook_func func,void *data)
+{
+    lvl->obj_hook=func;
+    lvl->obj_hook_data=data;
+}
+
+/**
+ * Notifies the level object hook about added or removed object.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param obj_type Type of the object, from OBJECT_TYPE_INDEX enumeration.
+ * @param obj Pointer to the object data.
+ * @param delta 1 if the object was added, -1 if it is being removed.
+ */
+void level_obj_changed(struct LEVEL *lvl,short obj_type,const unsigned char *obj,int delta)
+{
+    if (lvl->obj_hook!=NULL)
+      lvl->obj_hook(lvl,obj_type,obj,delta,lvl->obj_hook_data);
+}
+
+/**
+ * Gets the random numbers stream of the level.
+ * Returns direct pointer to the structure; it can be used to derive
+ * sub-streams with rng_stream_split().
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns RNG_STREAM structure from the level.
+ */
+struct RNG_STREAM *level_get_rng(struct LEVEL *lvl)
+{
+    return &(lvl->rng);
+}
+
 /**
  * Clears the "things" structure for storing level. Drops any old pointers
  * without deallocating them. Requies level_init() to be run first.
@@ -466,19 +534,11 @@ struct MAPDRAW_OPTIONS *level_get_mapdraw_options(struct LEVEL *lvl)
  */
 short level_clear_tng(struct LEVEL *lvl)
 {
-  /*Preparing array bounds */
-  int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
-  int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
   /*Clearing single variables */
   lvl->tng_total_count=0;
   /*Clearing pointer arrays */
+  objlookup_clear(lvl->tng_lookup);
   int i,j;
-  for (i=0; i<arr_entries_y; i++)
-      for (j=0; j<arr_entries_x; j++)
-      {
-          lvl->tng_lookup[i][j]=NULL;
-          lvl->tng_subnums[i][j]=0;
-      }
   for (i=0; i<lvl->tlsize.y; i++)
       for (j=0; j<lvl->tlsize.x; j++)
           lvl->tng_apt_lgt_nums[i][j]=0;
@@ -496,19 +556,10 @@ short level_clear_tng(struct LEVEL *lvl)
  */
 short level_clear_apt(struct LEVEL *lvl)
 {
-    /*Preparing array bounds */
-    int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
-    int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Clearing single variables */
     lvl->apt_total_count=0;
     /*Clearing pointer arrays */
-    int i,j;
-    for (i=0; i<arr_entries_y; i++)
-      for (j=0; j<arr_entries_x; j++)
-      {
-          lvl->apt_lookup[i][j]=NULL;
-          lvl->apt_subnums[i][j]=0;
-      }
+    objlookup_clear(lvl->apt_lookup);
   return true;
 }
 
@@ -520,19 +571,10 @@ short level_clear_apt(struct LEVEL *lvl)
  */
 short level_clear_lgt(struct LEVEL *lvl)
 {
-    /*Preparing array bounds */
-    int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
-    int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Clearing single variables */
     lvl->lgt_total_count=0;
     /*Clearing pointer arrays */
-    int i,j;
-    for (i=0; i<arr_entries_y; i++)
-      for (j=0; j<arr_entries_x; j++)
-      {
-          lvl->lgt_lookup[i][j]=NULL;
-          lvl->lgt_subnums[i][j]=0;
-      }
+    objlookup_clear(lvl->lgt_lookup);
   return true;
 }
 
@@ -548,16 +590,24 @@ short level_clear_datclm(struct LEVEL *lvl)
     /*const int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;*/
 
+    /* Cleared level starts with the standard column table size */
+    if (lvl->clm_entries>COLUMN_ENTRIES)
+      level_set_clm_entries(lvl,COLUMN_ENTRIES);
+    /* Column table pressure is kept until the table is cleared, */
+    /* not reset with the thing statistics */
+    lvl->stats.clm_entries_peak=0;
+    lvl->stats.clm_overflows=0;
     /* zero-filling CLM memory */
     int i,k;
-    for (i=0; i<COLUMN_ENTRIES; i++)
+    for (i=0; i<lvl->clm_entries; i++)
     {
       lvl->clm_utilize[i]=0;
       clear_clm_entry(lvl->clm[i]);
     }
+    memset(lvl->clm_anim,0,lvl->clm_entries>>3);
     /*Clearing CLM header */
     memset(lvl->clm_hdr,0,SIZEOF_DK_CLM_HEADER);
-    write_int32_le_buf(lvl->clm_hdr+0,COLUMN_ENTRIES);
+    write_int32_le_buf(lvl->clm_hdr+0,lvl->clm_entries);
     /* Setting all DAT entries to one, first column */
     /* (it is unused in all maps) */
     for (k=0; k<lvl->subsize.y; k++)
@@ -575,12 +625,14 @@ short level_clear_datclm(struct LEVEL *lvl)
     clmentry = (unsigned char *)(lvl->clm[0]);
     fill_column_rec_sim(clm_rec,lvl->clm_utilize[0], 0,  0, 0, 0, 0, 0, 0, 0, 0);
     set_clm_entry(clmentry, clm_rec);
+    clm_anim_update(lvl,0);
+    update_dat_clm_index(lvl);
 
     #if 0
     /* filling with zeros again is now not needed, */
     /* but may become needed on future modifications (if USE will be required to set here) */
     fill_column_rec_sim(clm_rec,0, 0,  0, 0, 0, 0, 0, 0, 0, 0);
-    for (i=1; i < COLUMN_ENTRIES; i++)
+    for (i=1; i < lvl->clm_entries; i++)
     {
       clmentry = (unsigned char *)(lvl->clm[i]);
       set_clm_entry(clmentry, clm_rec);
@@ -642,8 +694,9 @@ short level_clear_info(struct LEVEL *lvl)
     lvl->info.ver_rel=0;
     int name_len=strlen(default_map_name)+10;
     char *name_text=malloc(name_len);
+    struct tm creat_tm;
     if (name_text!=NULL)
-        strftime(name_text,name_len, default_map_name, localtime(&(lvl->info.creat_date)) );
+        strftime(name_text,name_len, default_map_name, local_time_r(&(lvl->info.creat_date),&creat_tm) );
     lvl->info.name_text=name_text;
     lvl->info.desc_text=NULL;
     lvl->info.author_text=NULL;
@@ -658,7 +711,7 @@ short level_clear_info(struct LEVEL *lvl)
  */
 short level_clear_script(struct LEVEL *lvl)
 {
-    message_log("  level_clear_script: started");
+    message_log_lvl(MSGLOG_DEBUG,"  level_clear_script: started");
     lvl->script.list=NULL;
     lvl->script.txt=NULL;
     lvl->script.lines_count=0;
@@ -738,6 +791,8 @@ short level_clear_other(struct LEVEL *lvl)
     /*const int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;*/
 
+    /* Rows shared with snapshots can't be cleared in place */
+    level_grid_unshare_all(lvl);
     int i;
     for (i=0; i < lvl->tlsize.y; i++)
     {
@@ -755,6 +810,7 @@ short level_clear_other(struct LEVEL *lvl)
       if (lvl->dat[i]!=NULL)
         memset(lvl->dat[i],0,lvl->subsize.x*sizeof(unsigned short));
     }
+    update_dat_clm_index(lvl);
 
     for (i=0; i < lvl->subsize.y; i++)
     {
@@ -789,8 +845,26 @@ short level_clear_other(struct LEVEL *lvl)
     lvl->cust_clm_count=0;
     lvl->graffiti=NULL;
     lvl->graffiti_count=0;
-
-    memset(lvl->slx_data, 0, sizeof(lvl->slx_data));
+    /* Graffiti index nodes stay allocated, but are all released */
+    if (lvl->graffiti_tile_head!=NULL)
+    {
+      for (i=0; i < lvl->tlsize.x*lvl->tlsize.y; i++)
+        lvl->graffiti_tile_head[i]=-1;
+    }
+    lvl->graffiti_tiles_used=0;
+    lvl->graffiti_tiles_free=-1;
+    /* No edit transaction is active on cleared level */
+    lvl->edit_depth=0;
+    if (lvl->edit_dirty!=NULL)
+      memset(lvl->edit_dirty,0,lvl->tlsize.x*lvl->tlsize.y*sizeof(unsigned char));
+    lvl->edit_start.x=lvl->tlsize.x;
+    lvl->edit_start.y=lvl->tlsize.y;
+    lvl->edit_end.x=-1;
+    lvl->edit_end.y=-1;
+    /* Changes can't be undone past clearing */
+    level_undo_clear(lvl);
+
+    memset(lvl->slx_data, 0, lvl->tlsize.x*lvl->tlsize.y*sizeof(unsigned char));
     return true;
 }
 
@@ -813,6 +887,12 @@ short level_clear(struct LEVEL *lvl)
   result&=level_clear_info(lvl);
   result&=level_clear_script(lvl);
   result&=level_clear_other(lvl);
+  /* Cleared level differs from any files on disk */
+  lvl->changed_files=LCF_ALL;
+  lvl->snapshot_changed=LCF_NONE;
+  lvl->tng_digest=0;
+  lvl->apt_digest=0;
+  lvl->lgt_digest=0;
     message_log(" level_clear: finished");
   return result;
 }
@@ -824,9 +904,11 @@ short level_clear(struct LEVEL *lvl)
  */
 short level_free_script_param(struct DK_SCRIPT_PARAMETERS *par)
 {
-  message_log(" level_free_script_param: starting");
+  message_log_lvl(MSGLOG_TRACE," level_free_script_param: starting");
   int idx;
   free(par->creature_pool);
+  if (par->player==NULL)
+    return true;
   /* Double arrays with first indices PLAYER0..PLAYER_UNSET */
 /*  message_log(" level_free_script_param: freeing 2d player arrays"); */
   for (idx=0;idx<PLAYERS_COUNT;idx++)
@@ -845,6 +927,102 @@ short level_free_script_param(struct DK_SCRIPT_PARAMETERS *par)
   return true;
 }
 
+/**
+ * Allocates the CoLuMn entries table. All entries are placed in one
+ * memory block, and every row of the returned array points into it.
+ * @see clm_table_free
+ * @param entries Number of column entries.
+ * @return Returns the new table, or NULL on error.
+ */
+unsigned char **clm_table_alloc(unsigned int entries)
+{
+    unsigned char **clm;
+    clm=(unsigned char **)malloc(entries*sizeof(unsigned char *));
+    if (clm==NULL)
+      return NULL;
+    unsigned char *block;
+    block=(unsigned char *)malloc(entries*SIZEOF_DK_CLM_REC);
+    if (block==NULL)
+    {
+      free(clm);
+      return NULL;
+    }
+    unsigned int i;
+    for (i=0; i<entries; i++)
+      clm[i]=block+i*SIZEOF_DK_CLM_REC;
+    return clm;
+}
+
+/**
+ * Frees the CoLuMn entries table allocated by clm_table_alloc().
+ * @param clm The column entries table.
+ */
+void clm_table_free(unsigned char **clm)
+{
+    if (clm==NULL)
+      return;
+    free(clm[0]);
+    free(clm);
+}
+
+/**
+ * Changes number of entries in the CoLuMn table, and in arrays indexed
+ * by column. New entries are cleared; when shrinking, the removed entries
+ * must not be used by DAT.
+ * @see get_clm_entries_max
+ * @param lvl Pointer to the LEVEL structure.
+ * @param entries The new number of column entries, multiplicity of 8.
+ * @return Returns true on success, false on error.
+ */
+short level_set_clm_entries(struct LEVEL *lvl,unsigned int entries)
+{
+    const unsigned int prev_entries=lvl->clm_entries;
+    if ((entries<1)||((entries&7)!=0))
+      return false;
+    if (entries==prev_entries)
+      return true;
+    unsigned char **clm;
+    unsigned int *utilize;
+    unsigned char *anim;
+    unsigned int *dat_first;
+    clm=clm_table_alloc(entries);
+    if (clm==NULL)
+    {
+      message_error("level_set_clm_entries: Cannot alloc %u columns",entries);
+      return false;
+    }
+    utilize=(unsigned int *)realloc(lvl->clm_utilize,entries*sizeof(unsigned int));
+    if (utilize!=NULL) lvl->clm_utilize=utilize;
+    anim=(unsigned char *)realloc(lvl->clm_anim,entries>>3);
+    if (anim!=NULL) lvl->clm_anim=anim;
+    dat_first=(unsigned int *)realloc(lvl->clm_dat_first,entries*sizeof(unsigned int));
+    if (dat_first!=NULL) lvl->clm_dat_first=dat_first;
+    if (entries>prev_entries)
+    {
+      /* Arrays which were enlarged stay so; they're just not used yet */
+      if ((utilize==NULL)||(anim==NULL)||(dat_first==NULL))
+      {
+        clm_table_free(clm);
+        message_error("level_set_clm_entries: Cannot alloc %u columns",entries);
+        return false;
+      }
+      memcpy(clm[0],lvl->clm[0],prev_entries*SIZEOF_DK_CLM_REC);
+      memset(clm[prev_entries],0,(entries-prev_entries)*SIZEOF_DK_CLM_REC);
+      memset(utilize+prev_entries,0,(entries-prev_entries)*sizeof(unsigned int));
+      memset(anim+(prev_entries>>3),0,(entries-prev_entries)>>3);
+      memset(dat_first+prev_entries,0xff,(entries-prev_entries)*sizeof(unsigned int));
+    } else
+    {
+      /* If shrinking the arrays failed, they just remain larger */
+      memcpy(clm[0],lvl->clm[0],entries*SIZEOF_DK_CLM_REC);
+    }
+    clm_table_free(lvl->clm);
+    lvl->clm=clm;
+    lvl->clm_entries=entries;
+    write_int32_le_buf(lvl->clm_hdr+0,entries);
+    return true;
+}
+
 /**
  * Frees structures for storing level. Frees only the memory
  * allocated by level_init(); to free the content of loaded level,
@@ -860,9 +1038,8 @@ short level_deinit(struct LEVEL **lvl_ptr)
       return false;
     struct LEVEL *lvl;
     lvl=(*lvl_ptr);
-    /*Preparing array bounds */
-    /*const int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;*/
-    const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
+    /* Rows still used by snapshots are not freed */
+    level_grid_refs_release(lvl);
 
 /*    message_log(" level_deinit: Freeing SLB structure"); */
     if (lvl->slb!=NULL)
@@ -890,6 +1067,8 @@ short level_deinit(struct LEVEL **lvl_ptr)
           free(lvl->dat[i]);
       free (lvl->dat);
     }
+    free(lvl->dat_clm_next);
+    free(lvl->dat_clm_prev);
 
 /*    message_log(" level_deinit: Freeing WIB structure"); */
     if (lvl->wib!=NULL)
@@ -917,62 +1096,22 @@ short level_deinit(struct LEVEL **lvl_ptr)
         free(lvl->tng_apt_lgt_nums[i]);
       free(lvl->tng_apt_lgt_nums);
     }
-    if (lvl->tng_lookup!=NULL)
-    {
-      int i;
-      for (i=0; i<arr_entries_y; i++)
-        free(lvl->tng_lookup[i]);
-      free(lvl->tng_lookup);
-    }
-    if (lvl->tng_subnums!=NULL)
-    {
-      int i;
-      for (i=0; i<arr_entries_y; i++)
-        free(lvl->tng_subnums[i]);
-      free(lvl->tng_subnums);
-    }
+    objlookup_free(&(lvl->tng_lookup));
 
 /*    message_log(" level_deinit: Freeing action points structure"); */
-    if (lvl->apt_lookup!=NULL)
-    {
-      int i;
-      for (i=0; i<arr_entries_y; i++)
-        free(lvl->apt_lookup[i]);
-      free(lvl->apt_lookup);
-    }
-    if (lvl->apt_subnums!=NULL)
-    {
-      int i;
-      for (i=0; i<arr_entries_y; i++)
-        free(lvl->apt_subnums[i]);
-      free(lvl->apt_subnums);
-    }
+    objlookup_free(&(lvl->apt_lookup));
 
 /*    message_log(" level_deinit: Freeing static lights structure"); */
-    if (lvl->lgt_lookup!=NULL)
-    {
-      int i;
-      for (i=0; i<arr_entries_y; i++)
-        free(lvl->lgt_lookup[i]);
-      free(lvl->lgt_lookup);
-    }
-    if (lvl->lgt_subnums!=NULL)
-    {
-      int i;
-      for (i=0; i<arr_entries_y; i++)
-        free(lvl->lgt_subnums[i]);
-      free(lvl->lgt_subnums);
-    }
+    objlookup_free(&(lvl->lgt_lookup));
 
 /*    message_log(" level_deinit: Freeing column structure"); */
     if (lvl->clm!=NULL)
     {
-      int i;
-      for (i=0; i<COLUMN_ENTRIES; i++)
-          free (lvl->clm[i]);
-      free(lvl->clm);
+      clm_table_free(lvl->clm);
       free(lvl->clm_hdr);
       free(lvl->clm_utilize);
+      free(lvl->clm_anim);
+      free(lvl->clm_dat_first);
     }
 
 /*    message_log(" level_deinit: Freeing WLB structure"); */
@@ -996,6 +1135,12 @@ short level_deinit(struct LEVEL **lvl_ptr)
     }
     
     /*TODO: free graffiti */
+    /* Graffiti index */
+    free(lvl->graffiti_tile_head);
+    free(lvl->graffiti_tiles);
+    free(lvl->slx_data);
+    free(lvl->edit_dirty);
+    level_undo_disable(lvl);
 
     free(lvl->info.name_text);
     free(lvl->info.desc_text);
@@ -1025,14 +1170,16 @@ short level_free_tng(struct LEVEL *lvl)
     int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Freeing object arrays */
-    if ((lvl->tng_subnums!=NULL) && (lvl->tng_lookup!=NULL))
+    if (lvl->tng_lookup!=NULL)
     {
       int cx,cy,k;
       for (cx=0; cx<arr_entries_x; cx++)
       {
+          if (lvl->tng_lookup->start[cx]==NULL)
+            continue;
           for (cy=0; cy<arr_entries_y; cy++)
           {
-            int last_idx=lvl->tng_subnums[cx][cy]-1;
+            int last_idx=objlookup_subnums(lvl->tng_lookup,cx,cy)-1;
             for (k=last_idx; k >=0; k--)
                 thing_del(lvl,cx, cy, k);
           }
@@ -1054,14 +1201,16 @@ short level_free_apt(struct LEVEL *lvl)
     int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Freeing object arrays */
-    if ((lvl->apt_subnums!=NULL) && (lvl->apt_lookup!=NULL))
+    if (lvl->apt_lookup!=NULL)
     {
       int cx,cy,k;
       for (cx=0; cx<arr_entries_x; cx++)
       {
+          if (lvl->apt_lookup->start[cx]==NULL)
+            continue;
           for (cy=0; cy<arr_entries_y; cy++)
           {
-            int last_idx=lvl->apt_subnums[cx][cy]-1;
+            int last_idx=objlookup_subnums(lvl->apt_lookup,cx,cy)-1;
             for (k=last_idx; k >=0; k--)
                 actnpt_del(lvl,cx, cy, k);
           }
@@ -1126,14 +1275,16 @@ short level_free_lgt(struct LEVEL *lvl)
     int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Freeing object arrays */
-    if ((lvl->lgt_subnums!=NULL) && (lvl->lgt_lookup!=NULL))
+    if (lvl->lgt_lookup!=NULL)
     {
       int cx,cy,k;
       for (cx=0; cx<arr_entries_x; cx++)
       {
+          if (lvl->lgt_lookup->start[cx]==NULL)
+            continue;
           for (cy=0; cy<arr_entries_y; cy++)
           {
-            int last_idx=lvl->lgt_subnums[cx][cy]-1;
+            int last_idx=objlookup_subnums(lvl->lgt_lookup,cx,cy)-1;
             for (k=last_idx; k >=0; k--)
                 stlight_del(lvl,cx, cy, k);
           }
@@ -1163,6 +1314,54 @@ short level_free(struct LEVEL *lvl)
   return result;
 }
 
+/**
+ * Computes amount of memory used by the level. Grid rows shared with
+ * snapshots are counted in every level which uses them.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param usage The structure to be filled with memory usage.
+ * @return Returns true on success, false on error.
+ */
+short level_memory_usage(const struct LEVEL *lvl,struct LEVEL_MEMORY_USAGE *usage)
+{
+    if ((lvl==NULL)||(usage==NULL))
+      return false;
+    const unsigned long tiles=lvl->tlsize.x*lvl->tlsize.y;
+    const unsigned long subtiles=lvl->subsize.x*lvl->subsize.y;
+    unsigned int i;
+    usage->level=sizeof(struct LEVEL);
+    /* SLB and WLB have a row for every tile line, others for subtile line */
+    usage->grids=2*lvl->tlsize.y*sizeof(void *) + 4*lvl->subsize.y*sizeof(void *);
+    usage->grids+=tiles*(sizeof(unsigned short)+2*sizeof(unsigned char));
+    usage->grids+=subtiles*(2*sizeof(unsigned char)+2*sizeof(unsigned short));
+    usage->columns=lvl->clm_entries*(sizeof(unsigned char *)+SIZEOF_DK_CLM_REC);
+    usage->columns+=SIZEOF_DK_CLM_HEADER+(lvl->clm_entries>>3);
+    usage->columns+=lvl->clm_entries*2*sizeof(unsigned int);
+    usage->columns+=subtiles*2*sizeof(unsigned int);
+    usage->objects=objlookup_memory(lvl->tng_lookup)+objlookup_memory(lvl->apt_lookup)
+        +objlookup_memory(lvl->lgt_lookup);
+    usage->objects+=lvl->tng_total_count*SIZEOF_DK_TNG_REC+lvl->apt_total_count*SIZEOF_DK_APT_REC
+        +lvl->lgt_total_count*SIZEOF_DK_LGT_REC;
+    usage->objects+=lvl->tlsize.y*sizeof(void *)+tiles*sizeof(unsigned short);
+    usage->other=2*DISKPATH_SIZE*sizeof(char);
+    usage->other+=lvl->script.lines_count*(sizeof(char *)+sizeof(struct DK_SCRIPT_COMMAND *));
+    if (lvl->script.txt!=NULL)
+      for (i=0; i<lvl->script.lines_count; i++)
+        if (lvl->script.txt[i]!=NULL)
+          usage->other+=strlen(lvl->script.txt[i])+1;
+    usage->other+=lvl->subsize.y*sizeof(void *)+subtiles*sizeof(struct DK_CUSTOM_CLM *);
+    usage->other+=lvl->cust_clm_count*(sizeof(struct DK_CUSTOM_CLM)+sizeof(struct COLUMN_REC));
+    usage->other+=lvl->graffiti_count*(sizeof(struct DK_GRAFFITI *)+sizeof(struct DK_GRAFFITI));
+    if (lvl->graffiti!=NULL)
+      for (i=0; i<lvl->graffiti_count; i++)
+        if ((lvl->graffiti[i]!=NULL)&&(lvl->graffiti[i]->text!=NULL))
+          usage->other+=strlen(lvl->graffiti[i]->text)+1;
+    usage->other+=tiles*sizeof(int)+lvl->graffiti_tiles_alloc*sizeof(struct DK_GRAFFITI_TILE);
+    usage->other+=tiles*sizeof(unsigned char);
+    usage->other+=level_undo_mem_usage(lvl);
+    usage->total=usage->level+usage->grids+usage->columns+usage->objects+usage->other;
+    return true;
+}
+
 /**
  * Returns DK_SCRIPT_PARAMETERS struct for given level.
  * @param lvl Pointer to the LEVEL structure.
@@ -1267,29 +1466,29 @@ short level_verify_struct(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *err
     int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Checking base pointers */
-    if (lvl->tng_subnums==NULL)
+    if (lvl->tng_lookup==NULL)
     {
-          strncpy(err_msg,"Null internal object tng_subnums!",LINEMSG_SIZE);
+          strncpy(err_msg,"Null internal object tng_lookup!",LINEMSG_SIZE);
           errpt->x=-1;errpt->y=-1;
           return VERIF_ERROR;
     }
-    if (lvl->apt_subnums==NULL)
+    if (lvl->apt_lookup==NULL)
     {
-          strncpy(err_msg,"Null internal object apt_subnums!",LINEMSG_SIZE);
+          strncpy(err_msg,"Null internal object apt_lookup!",LINEMSG_SIZE);
           errpt->x=-1;errpt->y=-1;
           return VERIF_ERROR;
     }
-    if (lvl->lgt_subnums==NULL)
+    if (lvl->lgt_lookup==NULL)
     {
-          strncpy(err_msg,"Null internal object lgt_subnums!",LINEMSG_SIZE);
+          strncpy(err_msg,"Null internal object lgt_lookup!",LINEMSG_SIZE);
           errpt->x=-1;errpt->y=-1;
           return VERIF_ERROR;
     }
     /*Sweeping through structures */
     int i, j, k;
-    for (i=0; i < arr_entries_y; i++)
+    for (i=0; i < arr_entries_x; i++)
     {
-      for (j=0; j < arr_entries_x; j++)
+      for (j=0; j < arr_entries_y; j++)
       {
         int things_count=get_thing_subnums(lvl,i,j);
         for (k=0; k <things_count ; k++)
@@ -1304,10 +1503,10 @@ short level_verify_struct(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *err
           }
         }
 
-        int actpt_count=lvl->apt_subnums[i][j];
+        int actpt_count=get_actnpt_subnums(lvl,i,j);
         for (k=0; k <actpt_count ; k++)
         {
-          unsigned char *actnpt = lvl->apt_lookup[i][j][k];
+          unsigned char *actnpt = get_actnpt(lvl,i,j,k);
           if (actnpt==NULL)
           {
               errpt->x=i/MAP_SUBNUM_X;
@@ -1317,10 +1516,10 @@ short level_verify_struct(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *err
           }
         }
         
-        int stlight_count=lvl->lgt_subnums[i][j];
+        int stlight_count=get_stlight_subnums(lvl,i,j);
         for (k=0; k <stlight_count ; k++)
         {
-          unsigned char *stlight = lvl->lgt_lookup[i][j][k];
+          unsigned char *stlight = get_stlight(lvl,i,j,k);
           if (stlight==NULL)
           {
               errpt->x=i/MAP_SUBNUM_X;
@@ -1331,7 +1530,7 @@ short level_verify_struct(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *err
         }
       }
     }
-    for (i=0; i<COLUMN_ENTRIES; i++)
+    for (i=0; i<lvl->clm_entries; i++)
     {
       if (lvl->clm[i]==NULL)
       {
@@ -1340,12 +1539,18 @@ short level_verify_struct(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *err
         return VERIF_ERROR;
       }
     }
-    if ((lvl->clm_hdr==NULL)||(lvl->clm_utilize==NULL))
+    if ((lvl->clm_hdr==NULL)||(lvl->clm_utilize==NULL)||(lvl->clm_anim==NULL))
     {
       errpt->x=-1;errpt->y=-1;
       sprintf(err_msg,"Null CoLuMn help arrays.");
       return VERIF_ERROR;
     }
+    if ((lvl->clm_dat_first==NULL)||(lvl->dat_clm_next==NULL)||(lvl->dat_clm_prev==NULL))
+    {
+      errpt->x=-1;errpt->y=-1;
+      sprintf(err_msg,"Null DAT index arrays.");
+      return VERIF_ERROR;
+    }
     if (lvl->inf>7)
     {
           errpt->x=-1;errpt->y=-1;
@@ -1493,6 +1698,12 @@ short level_verify_logic(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errp
         sprintf(err_msg,"Human player doesn't have a dungeon heart thing.");
         return VERIF_WARN;
     }
+    if ((lvl->optns.verify_warn_flags&VWFLAG_NOWARN_UNREACHABLE)==0)
+    {
+        short result=level_verify_regions(lvl,err_msg,errpt);
+        if (result!=VERIF_OK)
+          return result;
+    }
   return VERIF_OK;
 }
 
@@ -1542,33 +1753,13 @@ void generate_slab_bkgnd_default(struct LEVEL *lvl,unsigned short def_slab)
 /**
  * Fills SLB/OWN structure with "random" background.
  * The resulting map is made of earth with random rock at borders.
- * DAT/CLM values are not updated here.
+ * Closed regions of earth are linked by corridors, so the whole
+ * earth area is connected. DAT/CLM values are not updated here.
  * @param lvl Pointer to the LEVEL structure.
  */
 void generate_slab_bkgnd_random(struct LEVEL *lvl)
 {
-/* TODO: check if there are not closed regions of earth, link them with */
-/* earth corridors */
-/*HOW: */
-/*1. Create array lvl->tlsize.x x lvl->tlsize.y of unsigned short, maybe call it "slab_group"? */
-/*2. Find an earth slab, start at map center, check at larger radius (rectangle) until found */
-/*3. Mark the found slab as group 1 */
-/*4. From the marked slab, extend the radius and mark slabs which have */
-/*   a neightbour alreadey marked; repeat until map edge reached */
-/* Note: use only 4 base directions for checking neightbour slabs */
-/*5. Sweep through whole map and mark slabs which have */
-/*   a neightbour alreadey marked; count the slabs marked in every sweep */
-/*6. Finish sweeping when count=0 */
-/*7. Sweep through whole map searching for unmarked earth slab. If found, */
-/*   mark it with last_group+1 (=2 at first sweep) */
-/*8. Repeat 5. and 6. */
-/*9. Repeat 7 and 8 until no unmarked earth slab found */
-/*10. Create array of unsigned int with size=last_group+1. Fill it with lvl->tlsize.x's */
-/*11. Sweep through all slabs, and for every which has index>1 find the shortest way */
-/*    to slab from group with smaller index (use one of four basic directions only). */
-/*    Write it in array. */
-/*12. Sweep throufg all slabs again and fill the shortest ways to slabs with dirt/water/lava */
-/*13. Free the two allocaded arrays */
+    struct RNG_STREAM *prev_rng=rng_stream_bind(&(lvl->rng));
     int i,j,k,l;
     /* Filling the map with SLAB_TYPE_EARTH */
     const struct UPOINT_2D tl_maxindex={lvl->tlsize.x-1,lvl->tlsize.y-1};
@@ -1671,10 +1862,13 @@ void generate_slab_bkgnd_random(struct LEVEL *lvl)
               set_tile_slab(lvl,i,j,SLAB_TYPE_ROCK);
           }
       }
+    /*Linking closed regions of earth with the largest one */
+    level_regions_connect(lvl,region_passable_dig,NULL,SLAB_TYPE_EARTH);
     /*Everything generated here should be unclaimed */
     for (i=0; i < lvl->tlsize.x; i++)
       for (j=0; j < lvl->tlsize.y; j++)
           set_tile_owner(lvl, i, j, PLAYER_UNSET);
+    rng_stream_bind(prev_rng);
 }
 
 /**
@@ -1710,10 +1904,12 @@ void start_new_map(struct LEVEL *lvl)
 /**
  * Creates random level. Requies the memory to be allocated by level_init().
  * Calls level_clear(), but not level_free() at start.
+ * Random values are taken from the level stream, see level_rng_seed().
  * @param lvl Pointer to the LEVEL structure.
  */
 void generate_random_map(struct LEVEL *lvl)
 {
+    struct RNG_STREAM *prev_rng=rng_stream_bind(&(lvl->rng));
     level_clear(lvl);
     /*Preparing array bounds */
     /*int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;*/
@@ -1728,6 +1924,7 @@ void generate_random_map(struct LEVEL *lvl)
         update_datclm_for_whole_map(lvl);
     lvl->inf=rnd(8);
     update_level_stats(lvl);
+    rng_stream_bind(prev_rng);
 }
 
 /**
@@ -1783,10 +1980,49 @@ char *get_thing(const struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsigned
     /*Bounding position */
     sx %= arr_entries_x;
     sy %= arr_entries_y;
-    unsigned char *thing=NULL;
-    if (num < lvl->tng_subnums[sx][sy])
-      thing = lvl->tng_lookup[sx][sy][num];
-    return thing;
+    return objlookup_get(lvl->tng_lookup,sx,sy,num);
+}
+
+/**
+ * Changes the thing counters in statistics, according to the thing
+ * type and subtype. Doesn't change the added and removed counters.
+ * @param stats The statistics structure to update.
+ * @param thing Pointer to the thing data.
+ * @param change How the amount of such things have changed.
+ */
+static void thing_stats_change(struct LEVSTATS *stats,const unsigned char *thing,short change)
+{
+          if (thing==NULL) return;
+          unsigned char type_idx=get_thing_type(thing);
+          switch (type_idx)
+          {
+          case THING_TYPE_CREATURE:
+              stats->creatures_count+=change;
+              break;
+          case THING_TYPE_EFFECTGEN:
+              stats->effectgenrts_count+=change;
+              break;
+          case THING_TYPE_TRAP:
+              stats->traps_count+=change;
+              break;
+          case THING_TYPE_DOOR:
+              stats->doors_count+=change;
+              break;
+          case THING_TYPE_ITEM:
+              stats->items_count+=change;
+              break;
+          }
+          if (is_herogate(thing))
+              stats->hero_gates_count+=change;
+          if (is_dnheart(thing))
+              stats->dn_hearts_count+=change;
+
+          int categr=get_thing_subtypes_arridx(thing);
+          if (categr<THING_CATEGR_COUNT)
+            stats->things_count[categr]+=change;
+
+          if (is_room_inventory(thing))
+              stats->room_things_count+=change;
 }
 
 /**
@@ -1804,23 +2040,19 @@ int thing_add(struct LEVEL *lvl,unsigned char *thing)
     unsigned int x, y;
     x = get_thing_subtile_x(thing)%arr_entries_x;
     y = get_thing_subtile_y(thing)%arr_entries_y;
-    lvl->tng_total_count++;
     /*setting TNG entries */
-    lvl->tng_subnums[x][y]++;
-    lvl->tng_apt_lgt_nums[(x/MAP_SUBNUM_X)][(y/MAP_SUBNUM_Y)]++;
-    if (lvl->tng_lookup[x][y]==NULL)
-      lvl->tng_lookup[x][y]=(unsigned char **)malloc(sizeof(char *));
-    else
-      lvl->tng_lookup[x][y]=(unsigned char **)realloc(lvl->tng_lookup[x][y],
-                          lvl->tng_subnums[x][y]*sizeof(char *));
-    if (lvl->tng_lookup[x][y]==NULL)
+    int new_idx=objlookup_add(lvl->tng_lookup,x,y,thing);
+    if (new_idx<0)
     {
         message_error("thing_add: Cannot alloc tng entry");
         return -1;
     }
-    int new_idx=lvl->tng_subnums[x][y]-1;
-    lvl->tng_lookup[x][y][new_idx]=thing;
+    lvl->tng_total_count++;
+    lvl->tng_apt_lgt_nums[(x/MAP_SUBNUM_X)][(y/MAP_SUBNUM_Y)]++;
     update_thing_stats(lvl,thing,1);
+    lvl->changed_files|=LCF_TNG;
+    level_undo_rec_object(lvl,UDT_THING_ADD,x,y,thing);
+    level_obj_changed(lvl,OBJECT_TYPE_THING,thing,1);
     return new_idx;
 }
 
@@ -1839,7 +2071,8 @@ void thing_del(struct LEVEL *lvl,unsigned int sx, unsigned int sy, unsigned int
     /*Bounding position */
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y)) return;
     unsigned char *thing;
-    thing = lvl->tng_lookup[sx][sy][num];
+    thing = objlookup_get(lvl->tng_lookup,sx,sy,num);
+    if (thing==NULL) return;
     thing_drop(lvl,sx,sy,num);
     free(thing);
 }
@@ -1859,19 +2092,105 @@ void thing_drop(struct LEVEL *lvl,unsigned int sx, unsigned int sy, unsigned int
     unsigned int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Bounding position */
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y)) return;
-    int i;
-    if (num >= lvl->tng_subnums[sx][sy])
+    unsigned char *thing;
+    thing = objlookup_get(lvl->tng_lookup,sx,sy,num);
+    if (thing==NULL)
       return;
     lvl->tng_total_count--;
-    unsigned char *thing;
-    thing = lvl->tng_lookup[sx][sy][num];
+    level_undo_rec_object(lvl,UDT_THING_DEL,sx,sy,thing);
+    level_obj_changed(lvl,OBJECT_TYPE_THING,thing,-1);
     update_thing_stats(lvl,thing,-1);
-    for (i=num; i < lvl->tng_subnums[sx][sy]-1; i++)
-      lvl->tng_lookup[sx][sy][i]=lvl->tng_lookup[sx][sy][i+1];
-    lvl->tng_subnums[sx][sy]--;
+    objlookup_remove(lvl->tng_lookup,sx,sy,num);
     lvl->tng_apt_lgt_nums[sx/3][sy/3]--;
-    lvl->tng_lookup[sx][sy]=(unsigned char **)realloc(lvl->tng_lookup[sx][sy], 
-                        lvl->tng_subnums[sx][sy]*sizeof(char *));
+    lvl->changed_files|=LCF_TNG;
+}
+
+/**
+ * Sets subtype of a thing which is already on the level.
+ * Keeps the thing statistics up to date.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param thing Pointer to the thing data.
+ * @param stype_idx The new thing subtype.
+ * @return Returns true on success, false on failure.
+ */
+short thing_set_subtype(struct LEVEL *lvl,unsigned char *thing,const unsigned char stype_idx)
+{
+    if (thing==NULL) return false;
+    unsigned char prev[SIZEOF_DK_TNG_REC];
+    memcpy(prev,thing,SIZEOF_DK_TNG_REC);
+    thing_stats_change(&(lvl->stats),thing,-1);
+    short result=set_thing_subtype(thing,stype_idx);
+    thing_stats_change(&(lvl->stats),thing,1);
+    level_undo_rec_thing_mod(lvl,prev,thing);
+    lvl->changed_files|=LCF_TNG;
+    return result;
+}
+
+/**
+ * Sets owner of a thing which is already on the level.
+ * Keeps the thing statistics up to date.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param thing Pointer to the thing data.
+ * @param ownr_idx The new owner index.
+ * @return Returns true on success, false on failure.
+ */
+short thing_set_owner(struct LEVEL *lvl,unsigned char *thing,const unsigned char ownr_idx)
+{
+    if (thing==NULL) return false;
+    unsigned char prev[SIZEOF_DK_TNG_REC];
+    memcpy(prev,thing,SIZEOF_DK_TNG_REC);
+    thing_stats_change(&(lvl->stats),thing,-1);
+    short result=set_thing_owner(thing,ownr_idx);
+    thing_stats_change(&(lvl->stats),thing,1);
+    level_undo_rec_thing_mod(lvl,prev,thing);
+    lvl->changed_files|=LCF_TNG;
+    return result;
+}
+
+/**
+ * Switches a thing which is already on the level to next or previous
+ * subtype from its category. Keeps the thing statistics up to date.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param thing Pointer to the thing data.
+ * @param forward If true, next subtype is selected; otherwise previous.
+ * @return Returns true if the subtype was changed, false otherwise.
+ */
+short thing_switch_subtype(struct LEVEL *lvl,unsigned char *thing,const short forward)
+{
+    if (thing==NULL) return false;
+    unsigned char prev[SIZEOF_DK_TNG_REC];
+    memcpy(prev,thing,SIZEOF_DK_TNG_REC);
+    thing_stats_change(&(lvl->stats),thing,-1);
+    short result=switch_thing_subtype(thing,forward);
+    thing_stats_change(&(lvl->stats),thing,1);
+    level_undo_rec_thing_mod(lvl,prev,thing);
+    if (result)
+      lvl->changed_files|=LCF_TNG;
+    return result;
+}
+
+/**
+ * Replaces data of a thing which is already on the level, ie. to restore
+ * its previous state. The thing should stay on the same subtile.
+ * Keeps the thing statistics up to date.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param thing Pointer to the thing data.
+ * @param data The new thing data, SIZEOF_DK_TNG_REC bytes.
+ * @return Returns true on success, false on failure.
+ */
+short thing_set_data(struct LEVEL *lvl,unsigned char *thing,const unsigned char *data)
+{
+    if ((thing==NULL)||(data==NULL)) return false;
+    unsigned char prev[SIZEOF_DK_TNG_REC];
+    memcpy(prev,thing,SIZEOF_DK_TNG_REC);
+    level_obj_changed(lvl,OBJECT_TYPE_THING,thing,-1);
+    thing_stats_change(&(lvl->stats),thing,-1);
+    memcpy(thing,data,SIZEOF_DK_TNG_REC);
+    thing_stats_change(&(lvl->stats),thing,1);
+    level_obj_changed(lvl,OBJECT_TYPE_THING,thing,1);
+    lvl->changed_files|=LCF_TNG;
+    level_undo_rec_thing_mod(lvl,prev,thing);
+    return true;
 }
 
 /**
@@ -1887,7 +2206,7 @@ unsigned int get_thing_subnums(const struct LEVEL *lvl,unsigned int sx,unsigned
     unsigned int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Bounding position */
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y)) return 0;
-    return lvl->tng_subnums[sx][sy];
+    return objlookup_subnums(lvl->tng_lookup,sx,sy);
 }
 
 /**
@@ -1905,10 +2224,7 @@ char *get_actnpt(const struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsigne
     /*Bounding position */
     sx %= arr_entries_x;
     sy %= arr_entries_y;
-    unsigned char *actnpt=NULL;
-    if (num < get_actnpt_subnums(lvl,sx,sy))
-      actnpt = lvl->apt_lookup[sx][sy][num];
-    return actnpt;
+    return objlookup_get(lvl->apt_lookup,sx,sy,num);
 }
 
 /**
@@ -1926,24 +2242,18 @@ int actnpt_add(struct LEVEL *lvl,unsigned char *actnpt)
     unsigned int x, y;
     x = get_actnpt_subtile_x(actnpt)%arr_entries_x;
     y = get_actnpt_subtile_y(actnpt)%arr_entries_y;
-    lvl->apt_total_count++;
     /*setting APT entries */
-    unsigned int apt_snum=get_actnpt_subnums(lvl,x,y);
-    apt_snum++;
-    lvl->apt_subnums[x][y]=apt_snum;
-    lvl->tng_apt_lgt_nums[(x/MAP_SUBNUM_X)][(y/MAP_SUBNUM_Y)]++;
-    if (lvl->apt_lookup[x][y]==NULL)
-      lvl->apt_lookup[x][y]=(unsigned char **)malloc(sizeof(char *));
-    else
-      lvl->apt_lookup[x][y]=(unsigned char **)realloc(lvl->apt_lookup[x][y],
-                          apt_snum*sizeof(char *));
-    if (lvl->apt_lookup[x][y]==NULL)
+    int new_idx=objlookup_add(lvl->apt_lookup,x,y,actnpt);
+    if (new_idx<0)
     {
         message_error("actnpt_add: Cannot allocate memory");
         return -1;
     }
-    unsigned int new_idx=apt_snum-1;
-    lvl->apt_lookup[x][y][new_idx]=actnpt;
+    lvl->apt_total_count++;
+    lvl->tng_apt_lgt_nums[(x/MAP_SUBNUM_X)][(y/MAP_SUBNUM_Y)]++;
+    lvl->changed_files|=LCF_APT;
+    level_undo_rec_object(lvl,UDT_ACTNPT_ADD,x,y,actnpt);
+    level_obj_changed(lvl,OBJECT_TYPE_ACTNPT,actnpt,1);
     return new_idx;
 }
 
@@ -1961,21 +2271,17 @@ void actnpt_del(struct LEVEL *lvl,unsigned int sx, unsigned int sy, unsigned int
     int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     sx%=arr_entries_x;
     sy%=arr_entries_y;
-    unsigned int apt_snum=get_actnpt_subnums(lvl,sx,sy);
-    if (num >= apt_snum)
+    unsigned char *actnpt;
+    actnpt = objlookup_get(lvl->apt_lookup,sx,sy,num);
+    if (actnpt==NULL)
       return;
     lvl->apt_total_count--;
-    unsigned char *actnpt;
-    actnpt = lvl->apt_lookup[sx][sy][num];
+    level_undo_rec_object(lvl,UDT_ACTNPT_DEL,sx,sy,actnpt);
+    level_obj_changed(lvl,OBJECT_TYPE_ACTNPT,actnpt,-1);
+    objlookup_remove(lvl->apt_lookup,sx,sy,num);
     free(actnpt);
-    int i;
-    apt_snum--;
-    for (i=num; i < apt_snum; i++)
-      lvl->apt_lookup[sx][sy][i]=lvl->apt_lookup[sx][sy][i+1];
-    lvl->apt_subnums[sx][sy]=apt_snum;
     lvl->tng_apt_lgt_nums[sx/MAP_SUBNUM_X][sy/MAP_SUBNUM_Y]--;
-    lvl->apt_lookup[sx][sy]=(unsigned char **)realloc(lvl->apt_lookup[sx][sy], 
-                        apt_snum*sizeof(char *));
+    lvl->changed_files|=LCF_APT;
 }
 
 /**
@@ -1992,7 +2298,7 @@ unsigned int get_actnpt_subnums(const struct LEVEL *lvl,unsigned int sx,unsigned
     /*Bounding position */
     sx %= arr_entries_x;
     sy %= arr_entries_y;
-    return lvl->apt_subnums[sx][sy];
+    return objlookup_subnums(lvl->apt_lookup,sx,sy);
 }
 
 /**
@@ -2010,10 +2316,7 @@ char *get_stlight(const struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsign
     /*Bounding position */
     sx %= arr_entries_x;
     sy %= arr_entries_y;
-    unsigned char *stlight=NULL;
-    if (num < lvl->lgt_subnums[sx][sy])
-      stlight = lvl->lgt_lookup[sx][sy][num];
-    return stlight;
+    return objlookup_get(lvl->lgt_lookup,sx,sy,num);
 }
 
 /**
@@ -2030,24 +2333,18 @@ int stlight_add(struct LEVEL *lvl,unsigned char *stlight)
     unsigned int x, y;
     x = get_stlight_subtile_x(stlight)%arr_entries_x;
     y = get_stlight_subtile_y(stlight)%arr_entries_y;
-    lvl->lgt_total_count++;
     /*setting LGT entries */
-    unsigned int lgt_snum=lvl->lgt_subnums[x][y];
-    lgt_snum++;
-    lvl->lgt_subnums[x][y]=lgt_snum;
-    lvl->tng_apt_lgt_nums[(x/MAP_SUBNUM_X)][(y/MAP_SUBNUM_Y)]++;
-    if (lvl->lgt_lookup[x][y]==NULL)
-      lvl->lgt_lookup[x][y]=(unsigned char **)malloc(sizeof(char *));
-    else
-      lvl->lgt_lookup[x][y]=(unsigned char **)realloc(lvl->lgt_lookup[x][y],
-                          lgt_snum*sizeof(char *));
-    if (lvl->lgt_lookup[x][y]==NULL)
+    int new_idx=objlookup_add(lvl->lgt_lookup,x,y,stlight);
+    if (new_idx<0)
     {
         message_error("stlight_add: Cannot allocate memory");
         return -1;
     }
-    unsigned int new_idx=lgt_snum-1;
-    lvl->lgt_lookup[x][y][new_idx]=stlight;
+    lvl->lgt_total_count++;
+    lvl->tng_apt_lgt_nums[(x/MAP_SUBNUM_X)][(y/MAP_SUBNUM_Y)]++;
+    lvl->changed_files|=LCF_LGT;
+    level_undo_rec_object(lvl,UDT_STLIGHT_ADD,x,y,stlight);
+    level_obj_changed(lvl,OBJECT_TYPE_STLIGHT,stlight,1);
     return new_idx;
 }
 
@@ -2065,22 +2362,17 @@ void stlight_del(struct LEVEL *lvl,unsigned int sx, unsigned int sy, unsigned in
     int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     sx%=arr_entries_x;
     sy%=arr_entries_y;
-    unsigned int lgt_snum=lvl->lgt_subnums[sx][sy];
-    if (num >= lgt_snum)
+    unsigned char *stlight;
+    stlight = objlookup_get(lvl->lgt_lookup,sx,sy,num);
+    if (stlight==NULL)
       return;
     lvl->lgt_total_count--;
-    /* commented due to -Wunused-but-set-variable
-    unsigned char *stlight;
-    stlight = lvl->lgt_lookup[sx][sy][num];*/
-    free(lvl->lgt_lookup[sx][sy][num]);
-    int i;
-    lgt_snum--;
-    for (i=num; i < lgt_snum; i++)
-      lvl->lgt_lookup[sx][sy][i]=lvl->lgt_lookup[sx][sy][i+1];
-    lvl->lgt_subnums[sx][sy]=lgt_snum;
+    level_undo_rec_object(lvl,UDT_STLIGHT_DEL,sx,sy,stlight);
+    level_obj_changed(lvl,OBJECT_TYPE_STLIGHT,stlight,-1);
+    objlookup_remove(lvl->lgt_lookup,sx,sy,num);
+    free(stlight);
     lvl->tng_apt_lgt_nums[sx/MAP_SUBNUM_X][sy/MAP_SUBNUM_Y]--;
-    lvl->lgt_lookup[sx][sy]=(unsigned char **)realloc(lvl->lgt_lookup[sx][sy], 
-                        lgt_snum*sizeof(char *));
+    lvl->changed_files|=LCF_LGT;
 }
 
 /**
@@ -2097,7 +2389,7 @@ unsigned int get_stlight_subnums(const struct LEVEL *lvl,unsigned int sx,unsigne
     /*Bounding position */
     sx %= arr_entries_x;
     sy %= arr_entries_y;
-    return lvl->lgt_subnums[sx][sy];
+    return objlookup_subnums(lvl->lgt_lookup,sx,sy);
 }
 
 /**
@@ -2118,11 +2410,11 @@ short get_object_type(const struct LEVEL *lvl, unsigned int sx, unsigned int sy,
     /*Bounding indices */
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y))
       return OBJECT_TYPE_NONE;
-    int tng_num=lvl->tng_subnums[sx][sy];
+    int tng_num=get_thing_subnums(lvl,sx,sy);
     if (z<tng_num) return OBJECT_TYPE_THING;
     int apt_num=get_actnpt_subnums(lvl,sx,sy);
     if (z<(tng_num+apt_num)) return OBJECT_TYPE_ACTNPT;
-    int lgt_num=lvl->lgt_subnums[sx][sy];
+    int lgt_num=get_stlight_subnums(lvl,sx,sy);
     if (z<(tng_num+apt_num+lgt_num)) return OBJECT_TYPE_STLIGHT;
     return OBJECT_TYPE_NONE;
 }
@@ -2145,13 +2437,13 @@ unsigned char *get_object(const struct LEVEL *lvl,unsigned int sx,unsigned int s
     /*Bounding indices */
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y))
       return NULL;
-    int tng_num=lvl->tng_subnums[sx][sy];
+    int tng_num=get_thing_subnums(lvl,sx,sy);
     if (z<tng_num)
       return get_thing(lvl,sx,sy,z);
     int apt_num=get_actnpt_subnums(lvl,sx,sy);
     if (z<(tng_num+apt_num))
       return get_actnpt(lvl,sx,sy,z-tng_num);
-    int lgt_num=lvl->lgt_subnums[sx][sy];
+    int lgt_num=get_stlight_subnums(lvl,sx,sy);
     if (z<(tng_num+apt_num+lgt_num))
       return get_stlight(lvl,sx,sy,z-tng_num-apt_num);
     return NULL;
@@ -2174,7 +2466,7 @@ void object_del(struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsigned int z
     /*Bounding indices */
     sx%=arr_entries_x;
     sy%=arr_entries_y;
-    int tng_num=lvl->tng_subnums[sx][sy];
+    int tng_num=get_thing_subnums(lvl,sx,sy);
     if (z<tng_num)
     {
       thing_del(lvl,sx,sy,z);
@@ -2186,7 +2478,7 @@ void object_del(struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsigned int z
       actnpt_del(lvl,sx,sy,z-tng_num);
       return;
     }
-    int lgt_num=lvl->lgt_subnums[sx][sy];
+    int lgt_num=get_stlight_subnums(lvl,sx,sy);
     if (z<(tng_num+apt_num+lgt_num))
     {
       stlight_del(lvl,sx,sy,z-tng_num-apt_num);
@@ -2210,7 +2502,7 @@ unsigned int get_object_subnums(const struct LEVEL *lvl,unsigned int sx,unsigned
     /*Bounding position */
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y))
       return 0;
-    return lvl->tng_subnums[sx][sy]+get_actnpt_subnums(lvl,sx,sy)+lvl->lgt_subnums[sx][sy];
+    return get_thing_subnums(lvl,sx,sy)+get_actnpt_subnums(lvl,sx,sy)+get_stlight_subnums(lvl,sx,sy);
 }
 
 /**
@@ -2244,13 +2536,13 @@ int get_object_subtl_last(const struct LEVEL *lvl,unsigned int sx,unsigned int s
     if ((sx>=arr_entries_x)||(sy>=arr_entries_y))
       return 0;
     int last=-1;
-    last+=lvl->tng_subnums[sx][sy];
+    last+=get_thing_subnums(lvl,sx,sy);
     if (obj_type==OBJECT_TYPE_THING)
       return last;
     last+=get_actnpt_subnums(lvl,sx,sy);
     if (obj_type==OBJECT_TYPE_ACTNPT)
       return last;
-    last+=lvl->lgt_subnums[sx][sy];
+    last+=get_stlight_subnums(lvl,sx,sy);
     if (obj_type==OBJECT_TYPE_STLIGHT)
       return last;
     return get_object_subnums(lvl,sx,sy)-1;
@@ -2281,7 +2573,11 @@ void set_subtl_wib(struct LEVEL *lvl, unsigned int sx, unsigned int sy, short nv
     /*Bounding position */
     if ((sx>=lvl->subsize.x)||(sy>=lvl->subsize.y))
         return;
+    if (lvl->wib[sx][sy]==nval) return;
+    if ((lvl->grid_refs[LGRD_WIB]!=NULL)&&(!level_grid_row_unshare(lvl,LGRD_WIB,sx)))
+      return;
     lvl->wib[sx][sy]=nval;
+    lvl->changed_files|=LCF_WIB;
 }
 
 /**
@@ -2308,7 +2604,11 @@ void set_tile_wlb(struct LEVEL *lvl, unsigned int tx, unsigned int ty, short nva
 {
     /*Bounding position */
     if ((tx>=lvl->tlsize.x)||(ty>=lvl->tlsize.y)) return;
+    if (lvl->wlb[tx][ty]==nval) return;
+    if ((lvl->grid_refs[LGRD_WLB]!=NULL)&&(!level_grid_row_unshare(lvl,LGRD_WLB,tx)))
+      return;
     lvl->wlb[tx][ty]=nval;
+    lvl->changed_files|=LCF_WLB;
 }
 
 /**
@@ -2335,7 +2635,12 @@ void set_subtl_owner(struct LEVEL *lvl, unsigned int sx, unsigned int sy, unsign
 {
     /*Bounding position */
     if ((sx>=lvl->subsize.x)||(sy>=lvl->subsize.y)) return;
+    if (lvl->own[sx][sy]==nval) return;
+    if ((lvl->grid_refs[LGRD_OWN]!=NULL)&&(!level_grid_row_unshare(lvl,LGRD_OWN,sx)))
+      return;
+    level_undo_rec_tile(lvl,sx/MAP_SUBNUM_X,sy/MAP_SUBNUM_Y);
     lvl->own[sx][sy]=nval;
+    lvl->changed_files|=LCF_OWN;
 }
 
 /**
@@ -2390,7 +2695,12 @@ void set_tile_slab(struct LEVEL *lvl, unsigned int tx, unsigned int ty, unsigned
 {
     /*Bounding position */
     if ((tx>=lvl->tlsize.x)||(ty>=lvl->tlsize.y)) return;
+    if (lvl->slb[tx][ty]==nval) return;
+    if ((lvl->grid_refs[LGRD_SLB]!=NULL)&&(!level_grid_row_unshare(lvl,LGRD_SLB,tx)))
+      return;
+    level_undo_rec_tile(lvl,tx,ty);
     lvl->slb[tx][ty]=nval;
+    lvl->changed_files|=LCF_SLB;
 }
 
 /**
@@ -2418,8 +2728,10 @@ void set_slx_tileset(struct LEVEL *lvl, unsigned int tx, unsigned int ty, unsign
 {
     /*Bounding position */
     if ( (tx >= lvl->tlsize.x) || (ty >= lvl->tlsize.y) ) return;
+    if ((lvl->slx_data[tx + ty * lvl->tlsize.x] & 0x0F) == (nval & 0x0F)) return;
     lvl->slx_data[tx + ty * lvl->tlsize.x] &= 0xF0;
     lvl->slx_data[tx + ty * lvl->tlsize.x] |= nval & 0x0F;
+    lvl->changed_files|=LCF_SLX;
 }
 
 /**
@@ -2446,7 +2758,13 @@ void set_dat_val(struct LEVEL *lvl, int sx, int sy, unsigned int d)
 {
     if (lvl->dat==NULL) return;
     if ((sx<0)||(sy<0)||(sx>=lvl->subsize.x)||(sy>=lvl->subsize.y)) return;
+    if (lvl->dat[sx][sy]==d) return;
+    if ((lvl->grid_refs[LGRD_DAT]!=NULL)&&(!level_grid_row_unshare(lvl,LGRD_DAT,sx)))
+      return;
+    unsigned int prev_d=lvl->dat[sx][sy];
     lvl->dat[sx][sy]=d;
+    dat_clm_index_change(lvl,sx,sy,prev_d,d);
+    lvl->changed_files|=LCF_DAT;
 }
 
 /**
@@ -2472,18 +2790,52 @@ void set_subtl_flg(struct LEVEL *lvl, unsigned int sx, unsigned int sy,unsigned
 {
     if (lvl->flg==NULL) return;
     if ((sx>=lvl->subsize.x)||(sy>=lvl->subsize.y)) return;
+    if (lvl->flg[sx][sy]==nval) return;
+    if ((lvl->grid_refs[LGRD_FLG]!=NULL)&&(!level_grid_row_unshare(lvl,LGRD_FLG,sx)))
+      return;
     lvl->flg[sx][sy]=nval;
+    lvl->changed_files|=LCF_FLG;
+}
+
+/**
+ * Counts things statistics by sweeping through all things on the level.
+ * Only thing counters are changed in the stats structure, they
+ * should be zeroed before.
+ * @param stats The statistics structure to fill.
+ * @param lvl Pointer to the LEVEL structure.
+ */
+static void count_things_stats(struct LEVSTATS *stats,const struct LEVEL *lvl)
+{
+    /*Preparing array bounds */
+    int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
+    int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
+    int i, j, k;
+    for (i=0; i < arr_entries_y; i++)
+    {
+      for (j=0; j < arr_entries_x; j++)
+      {
+        int things_count=get_thing_subnums(lvl,i,j);
+        for (k=0; k <things_count ; k++)
+        {
+          unsigned char *thing = (unsigned char *)get_thing(lvl,i,j,k);
+          thing_stats_change(stats,thing,1);
+        }
+      }
+    }
 }
 
 /**
  * Updates some statistics about the level. The update includes
- * "utilize" values of columns.
+ * "utilize" values of columns. Thing statistics are kept up to date
+ * by every thing change, so they're only recounted if the stats_check
+ * option is set, to verify them.
  * @param lvl Pointer to the LEVEL structure.
  */
 void update_level_stats(struct LEVEL *lvl)
 {
      update_clm_utilize_counters(lvl);
-     update_things_stats(lvl);
+     if (lvl->optns.stats_check)
+       level_verify_stats(lvl);
 }
 
 /**
@@ -2493,25 +2845,48 @@ void update_level_stats(struct LEVEL *lvl)
  */
 void update_things_stats(struct LEVEL *lvl)
 {
-    /*Preparing array bounds */
-    int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
-    int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
     /*Clearing previous stats */
     level_clear_stats(lvl);
     /*Sweeping through structures */
-    int i, j, k;
-    for (i=0; i < arr_entries_y; i++)
+    count_things_stats(&(lvl->stats),lvl);
+    lvl->stats.things_added=lvl->tng_total_count;
+}
+
+/**
+ * Compares thing statistics of the level with a full recount.
+ * Logs every difference, and replaces the wrong values.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true if the statistics were correct, false otherwise.
+ */
+short level_verify_stats(struct LEVEL *lvl)
+{
+    struct LEVSTATS full;
+    memset(&full,0,sizeof(struct LEVSTATS));
+    count_things_stats(&full,lvl);
+    short result=true;
+    int i;
+#define STATS_CHECK(field) \
+    if (lvl->stats.field!=full.field) \
+    { \
+      message_error("level_verify_stats: " #field " is %d, recount gives %d", \
+          lvl->stats.field,full.field); \
+      lvl->stats.field=full.field; \
+      result=false; \
+    }
+    STATS_CHECK(creatures_count);
+    STATS_CHECK(effectgenrts_count);
+    STATS_CHECK(traps_count);
+    STATS_CHECK(doors_count);
+    STATS_CHECK(items_count);
+    STATS_CHECK(hero_gates_count);
+    STATS_CHECK(dn_hearts_count);
+    for (i=0;i<THING_CATEGR_COUNT;i++)
     {
-      for (j=0; j < arr_entries_x; j++)
-      {
-        int things_count=get_thing_subnums(lvl,i,j);
-        for (k=0; k <things_count ; k++)
-        {
-          unsigned char *thing = get_thing(lvl,i,j,k);
-          update_thing_stats(lvl,thing,1);
-        }
-      }
+      STATS_CHECK(things_count[i]);
     }
+    STATS_CHECK(room_things_count);
+#undef STATS_CHECK
+    return result;
 }
 
 /**
@@ -2524,36 +2899,7 @@ void update_things_stats(struct LEVEL *lvl)
 void update_thing_stats(struct LEVEL *lvl,const unsigned char *thing,short change)
 {
           if (thing==NULL) return;
-          unsigned char type_idx=get_thing_type(thing);
-          switch (type_idx)
-          {
-          case THING_TYPE_CREATURE:
-              lvl->stats.creatures_count+=change;
-              break;
-          case THING_TYPE_EFFECTGEN:
-              lvl->stats.effectgenrts_count+=change;
-              break;
-          case THING_TYPE_TRAP:
-              lvl->stats.traps_count+=change;
-              break;
-          case THING_TYPE_DOOR:
-              lvl->stats.doors_count+=change;
-              break;
-          case THING_TYPE_ITEM:
-              lvl->stats.items_count+=change;
-              break;
-          }
-          if (is_herogate(thing))
-              lvl->stats.hero_gates_count+=change;
-          if (is_dnheart(thing))
-              lvl->stats.dn_hearts_count+=change;
-
-          int categr=get_thing_subtypes_arridx(thing);
-          if (categr<THING_CATEGR_COUNT)
-            lvl->stats.things_count[categr]+=change;
-
-          if (is_room_inventory(thing))
-              lvl->stats.room_things_count+=change;
+          thing_stats_change(&(lvl->stats),thing,change);
           if (change>0)
               lvl->stats.things_added+=change;
           else
@@ -2630,6 +2976,41 @@ short set_datclm_auto_update(struct LEVEL *lvl,short val)
     return true;
 }
 
+/**
+ * Sets which map files are RNC packed when saving the level.
+ * Files whose packing has changed are marked as changed, so that
+ * the next save rewrites them.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param flags LEVEL_CHANGE_FLAGS bits of the files to pack.
+ * @param level RNC compression level for the packed files.
+ * @return Returns true if the option was successfully changed.
+ */
+short set_lvl_packed_files(struct LEVEL *lvl,unsigned long flags,short level)
+{
+    if (lvl==NULL) return false;
+    if ((level<RNC_PACK_LEVEL_MIN)||(level>RNC_PACK_LEVEL_MAX))
+        return false;
+    unsigned long changed;
+    changed=(lvl->optns.packed_files^flags);
+    if (lvl->optns.pack_level!=level)
+        changed|=flags;
+    mark_lvl_changed(lvl,changed);
+    lvl->optns.packed_files=flags;
+    lvl->optns.pack_level=level;
+    return true;
+}
+
+/**
+ * Returns which map files are RNC packed when saving the level.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns LEVEL_CHANGE_FLAGS bits of the packed files.
+ */
+unsigned long get_lvl_packed_files(struct LEVEL *lvl)
+{
+    if (lvl==NULL) return LCF_NONE;
+    return lvl->optns.packed_files;
+}
+
 /**
  * Returns state of the obj_auto_update option for the level.
  * @param lvl Pointer to the LEVEL structure.
@@ -2682,9 +3063,12 @@ short set_lvl_fname(struct LEVEL *lvl,char *fname)
       lvl->fname=NULL;
     }
     free(lvl->fname);
-    lvl->fname=strdup(fname);
+    /* Other functions expect the buffer to be DISKPATH_SIZE long */
+    lvl->fname=(char *)malloc(DISKPATH_SIZE*sizeof(char));
     if (lvl->fname==NULL)
       return false;
+    strncpy(lvl->fname,fname,DISKPATH_SIZE);
+    lvl->fname[DISKPATH_SIZE-1]='\0';
     return true;
 }
 
@@ -2738,9 +3122,12 @@ short set_lvl_savfname(struct LEVEL *lvl,char *fname)
       lvl->savfname=NULL;
     }
     free(lvl->savfname);
-    lvl->savfname=strdup(fname);
+    /* Other functions expect the buffer to be DISKPATH_SIZE long */
+    lvl->savfname=(char *)malloc(DISKPATH_SIZE*sizeof(char));
     if (lvl->savfname==NULL)
       return false;
+    strncpy(lvl->savfname,fname,DISKPATH_SIZE);
+    lvl->savfname[DISKPATH_SIZE-1]='\0';
     return true;
 }
 
@@ -2804,6 +3191,7 @@ short set_lif_name_text(struct LEVEL *lvl,char *name)
     if (lvl==NULL) return false;
     free(lvl->info.name_text);
     lvl->info.name_text=name;
+    lvl->changed_files|=LCF_LIF;
     return true;
 }
 
@@ -2899,6 +3287,95 @@ struct LEVSTATS *get_lvl_stats(struct LEVEL *lvl)
     return &(lvl->stats);
 }
 
+/**
+ * Computes digest of an objects list - things, action points or lights.
+ * Objects are visited in the same order in which they're written to disk.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param lookup The objects lookup, indexed by subtile.
+ * @param rec_size Size of a single object record.
+ * @return Returns FNV-1a digest of the objects list.
+ */
+static unsigned long objects_list_digest(const struct LEVEL *lvl,
+    const struct OBJECTS_LOOKUP *lookup,int rec_size)
+{
+    unsigned long digest=2166136261UL;
+    if (lookup==NULL)
+      return digest;
+    /*Preparing array bounds */
+    const unsigned int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
+    const unsigned int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
+    unsigned int sx,sy,k;
+    int i;
+    for (sy=0; sy < arr_entries_y; sy++)
+      for (sx=0; sx < arr_entries_x; sx++)
+        for (k=0; k < objlookup_subnums(lookup,sx,sy); k++)
+        {
+          unsigned char *obj=objlookup_get(lookup,sx,sy,k);
+          for (i=0; i < rec_size; i++)
+            digest=((digest^obj[i])*16777619UL)&0xffffffffUL;
+        }
+    return digest;
+}
+
+/**
+ * Marks map files as changed. Changed files will be rewritten on next save.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param flags Changed files, LEVEL_CHANGE_FLAGS bits.
+ */
+void mark_lvl_changed(struct LEVEL *lvl,unsigned long flags)
+{
+    if (lvl==NULL) return;
+    lvl->changed_files|=flags;
+    lvl->stats.unsaved_changes++;
+}
+
+/**
+ * Returns map files which were changed since last load or save.
+ * Object records are modified in place, so besides the flags, lists
+ * of things, action points and lights are compared with their digests.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns LEVEL_CHANGE_FLAGS bits of the changed files.
+ */
+unsigned long get_lvl_changed(struct LEVEL *lvl)
+{
+    if (lvl==NULL) return LCF_NONE;
+    unsigned long flags=lvl->changed_files|lvl->snapshot_changed;
+    if (((flags&LCF_TNG)==0) && (lvl->tng_digest!=objects_list_digest(lvl,
+        lvl->tng_lookup,SIZEOF_DK_TNG_REC)))
+      flags|=LCF_TNG;
+    if (((flags&LCF_APT)==0) && (lvl->apt_digest!=objects_list_digest(lvl,
+        lvl->apt_lookup,SIZEOF_DK_APT_REC)))
+      flags|=LCF_APT;
+    if (((flags&LCF_LGT)==0) && (lvl->lgt_digest!=objects_list_digest(lvl,
+        lvl->lgt_lookup,SIZEOF_DK_LGT_REC)))
+      flags|=LCF_LGT;
+    return flags;
+}
+
+/**
+ * Clears the changed state of map files. Should be called when the files
+ * were loaded or saved - the level is then identical to files on disk.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param flags Files to be marked as unchanged, LEVEL_CHANGE_FLAGS bits.
+ */
+void clear_lvl_changed(struct LEVEL *lvl,unsigned long flags)
+{
+    if (lvl==NULL) return;
+    lvl->changed_files&=~flags;
+    lvl->snapshot_changed&=~flags;
+    if (((lvl->changed_files|lvl->snapshot_changed)&LCF_ALL)==0)
+      lvl->stats.unsaved_changes=0;
+    if (flags&LCF_TNG)
+      lvl->tng_digest=objects_list_digest(lvl,
+          lvl->tng_lookup,SIZEOF_DK_TNG_REC);
+    if (flags&LCF_APT)
+      lvl->apt_digest=objects_list_digest(lvl,
+          lvl->apt_lookup,SIZEOF_DK_APT_REC);
+    if (flags&LCF_LGT)
+      lvl->lgt_digest=objects_list_digest(lvl,
+          lvl->lgt_lookup,SIZEOF_DK_LGT_REC);
+}
+
 /**
  * Increases mode switches counter.
  * Used for user commands statistics for the level.
@@ -3022,6 +3499,8 @@ short get_lvl_format_version(struct LEVEL *lvl)
 short set_lvl_inf(struct LEVEL *lvl,unsigned char ninf)
 {
     if (lvl==NULL) return false;
+    if (lvl->inf!=ninf)
+      lvl->changed_files|=LCF_INF;
     lvl->inf=ninf;
     return true;
 }
@@ -3149,6 +3628,35 @@ short get_level_objstats_textln(struct LEVEL *lvl,char *stat_buf,const int line_
     }
 }
 
+/**
+ * Marks a rectangle of tiles as changed within edit transaction.
+ * If there is no active transaction, does nothing.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param startx,starty Top left of the changed rectangle.
+ * @param endx,endy Bottom right of the changed rectangle.
+ * @return Returns true if the tiles were marked, and level graphics
+ *     update should be deferred until level_edit_commit().
+ */
+short level_edit_mark_rect(struct LEVEL *lvl, unsigned int startx, unsigned int endx,
+    unsigned int starty, unsigned int endy)
+{
+    if ((lvl->edit_depth<1)||(lvl->edit_dirty==NULL))
+      return false;
+    if (endx>=lvl->tlsize.x) endx=lvl->tlsize.x-1;
+    if (endy>=lvl->tlsize.y) endy=lvl->tlsize.y-1;
+    if ((startx>endx)||(starty>endy))
+      return true;
+    unsigned int tx,ty;
+    for (ty=starty; ty<=endy; ty++)
+      for (tx=startx; tx<=endx; tx++)
+        lvl->edit_dirty[ty*lvl->tlsize.x+tx]=1;
+    if (lvl->edit_start.x>(int)startx) lvl->edit_start.x=startx;
+    if (lvl->edit_start.y>(int)starty) lvl->edit_start.y=starty;
+    if (lvl->edit_end.x<(int)endx) lvl->edit_end.x=endx;
+    if (lvl->edit_end.y<(int)endy) lvl->edit_end.y=endy;
+    return true;
+}
+
 /**
  * Puts a new slab on map. Updates level graphics, things and statistics.
  * @see set_tile_slab
@@ -3164,6 +3672,8 @@ short user_set_slab(struct LEVEL *lvl, unsigned int tx, unsigned int ty, unsigne
   /* Update user commands statistics */
   inc_info_usr_slbchng_count(lvl);
   /* Update the level graphics */
+  if (level_edit_mark_rect(lvl,tx,tx,ty,ty))
+      return true;
   if (get_obj_auto_update(lvl))
       update_obj_for_square_radius1(lvl,tx,ty);
   if (get_datclm_auto_update(lvl))
@@ -3188,6 +3698,8 @@ short user_set_tile_owner(struct LEVEL *lvl, unsigned int tx, unsigned int ty, u
   /* Update user commands statistics */
   inc_info_usr_slbchng_count(lvl);
   /* Update the level graphics */
+  if (level_edit_mark_rect(lvl,tx,tx,ty,ty))
+      return true;
   if (get_obj_auto_update(lvl))
       update_obj_for_square_radius1(lvl,tx,ty);
   if (get_datclm_auto_update(lvl))
@@ -3224,6 +3736,8 @@ short user_set_slab_rect(struct LEVEL *lvl, unsigned int startx, unsigned int en
           set_tile_slab(lvl,tile_x,tile_y,nslab);
           inc_info_usr_slbchng_count(lvl);
       }
+    if (level_edit_mark_rect(lvl,startx,endx,starty,endy))
+      return true;
     if (get_obj_auto_update(lvl))
       update_obj_for_square(lvl, startx-1, endx+1, starty-1, endy+1);
     if (get_datclm_auto_update(lvl))
@@ -3258,6 +3772,8 @@ short user_set_owner_rect(struct LEVEL *lvl, unsigned int startx, unsigned int e
           set_tile_owner(lvl,tile_x,tile_y,nown);
           inc_info_usr_slbchng_count(lvl);
       }
+    if (level_edit_mark_rect(lvl,startx,endx,starty,endy))
+      return true;
     if (get_obj_auto_update(lvl))
       update_obj_for_square(lvl, startx-1, endx+1, starty-1, endy+1);
     if (get_datclm_auto_update(lvl))
@@ -3294,6 +3810,8 @@ short user_set_slabown_rect(struct LEVEL *lvl, unsigned int startx, unsigned int
           set_tile_owner(lvl,tile_x,tile_y,nown);
           inc_info_usr_slbchng_count(lvl);
       }
+    if (level_edit_mark_rect(lvl,startx,endx,starty,endy))
+      return true;
     if (get_obj_auto_update(lvl))
       update_obj_for_square(lvl, startx-1, endx+1, starty-1, endy+1);
     if (get_datclm_auto_update(lvl))
@@ -3302,3 +3820,143 @@ short user_set_slabown_rect(struct LEVEL *lvl, unsigned int startx, unsigned int
       update_obj_subpos_and_height_for_square(lvl, startx-1, endx+1, starty-1, endy+1);
     return true;
 }
+
+/**
+ * Starts edit transaction. Until the matching level_edit_commit(),
+ * the user_set_* functions only change map values and remember
+ * the changed tiles; level graphics and objects are updated once,
+ * when the transaction is committed. Transactions can be nested;
+ * only the outermost commit makes the update.
+ * @see level_edit_commit
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true on success, false on error.
+ */
+short level_edit_begin(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->edit_dirty==NULL))
+      return false;
+    lvl->edit_depth++;
+    level_undo_begin(lvl);
+    return true;
+}
+
+/**
+ * Updates level graphics and objects for tiles marked within
+ * the finished edit transaction, and clears the marks.
+ */
+static short level_edit_update(struct LEVEL *lvl,short update_objs)
+{
+    if (lvl->edit_end.x<0)
+      return true;
+    /* Marking neighbours; 1 - up to one tile from a changed tile, */
+    /* 2 - up to two tiles; W?B and FLG need the wider update */
+    int sx,sy,ex,ey;
+    sx=max(lvl->edit_start.x-2,0);
+    sy=max(lvl->edit_start.y-2,0);
+    ex=min(lvl->edit_end.x+2,lvl->tlsize.x-1);
+    ey=min(lvl->edit_end.y+2,lvl->tlsize.y-1);
+    unsigned char *area;
+    area=(unsigned char *)calloc(lvl->tlsize.x*lvl->tlsize.y,sizeof(unsigned char));
+    if (area==NULL)
+    {
+      message_error("level_edit_update: Cannot alloc memory");
+      return false;
+    }
+    int tx,ty,i,k;
+    for (ty=lvl->edit_start.y; ty<=lvl->edit_end.y; ty++)
+      for (tx=lvl->edit_start.x; tx<=lvl->edit_end.x; tx++)
+      {
+        if (!lvl->edit_dirty[ty*lvl->tlsize.x+tx])
+          continue;
+        for (k=max(ty-2,sy); k<=min(ty+2,ey); k++)
+          for (i=max(tx-2,sx); i<=min(tx+2,ex); i++)
+          {
+            unsigned char dist;
+            dist=max(abs(i-tx),abs(k-ty));
+            if (dist<1) dist=1;
+            if ((area[k*lvl->tlsize.x+i]==0)||(area[k*lvl->tlsize.x+i]>dist))
+              area[k*lvl->tlsize.x+i]=dist;
+          }
+      }
+    /* Updating in the same order as user_set_slab() does */
+    if ((update_objs)&&(get_obj_auto_update(lvl)))
+    {
+      for (ty=sy; ty<=ey; ty++)
+        for (tx=sx; tx<=ex; tx++)
+          if (area[ty*lvl->tlsize.x+tx]==1)
+            update_clmaffective_obj_for_slab(lvl,tx,ty);
+    }
+    if (get_datclm_auto_update(lvl))
+    {
+      for (ty=sy; ty<=ey; ty++)
+        for (tx=sx; tx<=ex; tx++)
+          if (area[ty*lvl->tlsize.x+tx]==1)
+            update_datclm_for_slab(lvl,tx,ty);
+      for (ty=sy; ty<=ey; ty++)
+        for (tx=sx; tx<=ex; tx++)
+          if (area[ty*lvl->tlsize.x+tx]!=0)
+            update_tile_wib_entries(lvl,tx,ty);
+      for (ty=sy; ty<=ey; ty++)
+        for (tx=sx; tx<=ex; tx++)
+          if (area[ty*lvl->tlsize.x+tx]!=0)
+          {
+            update_tile_wlb_entry(lvl,tx,ty);
+            update_tile_flg_entries(lvl,tx,ty);
+          }
+    }
+    if ((update_objs)&&(get_obj_auto_update(lvl)))
+    {
+      for (ty=sy; ty<=ey; ty++)
+        for (tx=sx; tx<=ex; tx++)
+          if (area[ty*lvl->tlsize.x+tx]==1)
+            update_things_subpos_and_height_for_slab(lvl,tx,ty);
+    }
+    free(area);
+    /* Clearing the changed tiles */
+    for (ty=lvl->edit_start.y; ty<=lvl->edit_end.y; ty++)
+      memset(lvl->edit_dirty+ty*lvl->tlsize.x+lvl->edit_start.x,0,
+          lvl->edit_end.x-lvl->edit_start.x+1);
+    lvl->edit_start.x=lvl->tlsize.x;
+    lvl->edit_start.y=lvl->tlsize.y;
+    lvl->edit_end.x=-1;
+    lvl->edit_end.y=-1;
+    return true;
+}
+
+/**
+ * Ends edit transaction. When the outermost transaction ends,
+ * updates level graphics and objects for all changed tiles and
+ * their neighbours. Every tile is updated only once, even if
+ * it was affected by many changes.
+ * @see level_edit_begin
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true on success, false on error.
+ */
+short level_edit_commit(struct LEVEL *lvl)
+{
+    return level_edit_end(lvl,true);
+}
+
+/**
+ * Ends edit transaction, optionally without updating objects.
+ * Undo replays the objects exactly, and needs only graphics update.
+ * @see level_edit_commit
+ * @param lvl Pointer to the LEVEL structure.
+ * @param update_objs If false, only DAT/CLM and W?B/FLG are updated.
+ * @return Returns true on success, false on error.
+ */
+short level_edit_end(struct LEVEL *lvl,short update_objs)
+{
+    if ((lvl==NULL)||(lvl->edit_depth<1))
+      return false;
+    lvl->edit_depth--;
+    if (lvl->edit_depth>0)
+    {
+      level_undo_end(lvl);
+      return true;
+    }
+    short result=level_edit_update(lvl,update_objs);
+    level_undo_end(lvl);
+    return result;
+}
+
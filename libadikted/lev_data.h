@@ -19,6 +19,8 @@
 #define ADIKT_LEVDATA_H
 
 #include "globals.h"
+#include "rng.h"
+#include "arr_utils.h"
 
 /* Map size definitions */
 
@@ -31,6 +33,8 @@
 #define MAP_SUBNUM_X 3
 #define MAP_SUBNUM_Y 3
 #define COLUMN_ENTRIES 2048
+/* Largest column table allowed in KeeperFX maps */
+#define COLUMN_ENTRIES_DKXPAND 8192
 
 /**
  * Map format type selection.
@@ -58,7 +62,8 @@ enum OBJECT_TYPE_INDEX {
 enum VERIFY_WARN_FLAGS {
      VWFLAG_NONE              =  0,
      VWFLAG_NOWARN_MANYHEART  =  1,
-/*     VWFLAG_NOWARN_           =  2, */
+     VWFLAG_NOWARN_UNREACHABLE=  2,
+/*     VWFLAG_NOWARN_           =  4, */
      };
 
 /* Select level verification steps to skip (bit fields) */
@@ -73,6 +78,39 @@ enum VERIFY_SKIP_FLAGS {
     VSF_LOGIC       = VSF_TXT       << 1
 };
 
+/* Map files changed since last load or save (bit fields) */
+enum LEVEL_CHANGE_FLAGS {
+    LCF_NONE        = 0x0000,
+    LCF_SLB         = 0x0001,
+    LCF_OWN         = LCF_SLB       << 1,
+    LCF_DAT         = LCF_OWN       << 1,
+    LCF_CLM         = LCF_DAT       << 1,
+    LCF_TNG         = LCF_CLM       << 1,
+    LCF_APT         = LCF_TNG       << 1,
+    LCF_WIB         = LCF_APT       << 1,
+    LCF_INF         = LCF_WIB       << 1,
+    LCF_TXT         = LCF_INF       << 1,
+    LCF_LGT         = LCF_TXT       << 1,
+    LCF_WLB         = LCF_LGT       << 1,
+    LCF_FLG         = LCF_WLB       << 1,
+    LCF_LIF         = LCF_FLG       << 1,
+    LCF_VSN         = LCF_LIF       << 1,
+    LCF_ADI         = LCF_VSN       << 1,
+    LCF_SLX         = LCF_ADI       << 1,
+    LCF_ALL         = (LCF_SLX << 1) - 1
+};
+
+/* Level grids which rows can be shared with level snapshots */
+enum LEVEL_GRID_INDEX {
+    LGRD_SLB        =  0,
+    LGRD_OWN,
+    LGRD_WIB,
+    LGRD_WLB,
+    LGRD_FLG,
+    LGRD_DAT,
+    LGRD_COUNT
+};
+
 /*Disk files entries */
 
 #define SIZEOF_DK_TNG_REC 21
@@ -155,6 +193,15 @@ struct DK_GRAFFITI {
     unsigned short cube;
   };
 
+/**
+ * Graffiti tile index node. Links graffiti which covers a tile with
+ * next graffiti on the same tile; chains are sorted by graffiti index.
+ */
+struct DK_GRAFFITI_TILE {
+    int graf_idx;
+    int next;
+  };
+
 /**
  * Script player structure. Stores player information retrieved from script.
  */
@@ -268,6 +315,11 @@ struct LEVSTATS {
     int saves_count;
     /* Number of unsaved changes */
     int unsaved_changes;
+    /* Column table pressure - highest column index ever used plus one, */
+    /* and columns which couldn't be created because the table was full; */
+    /* these are cleared with the column table, not by level_clear_stats() */
+    int clm_entries_peak;
+    int clm_overflows;
   };
 
 /**
@@ -294,6 +346,15 @@ struct LEVINFO {
     char *editor_text; /* name of the person who last edited the level */
   };
 
+struct LEVEL;
+
+/**
+ * Function notified about objects added to the level (with delta=1)
+ * or removed from it (with delta=-1); see level_set_obj_hook().
+ */
+typedef void (*level_obj_hook_func)(struct LEVEL *lvl,short obj_type,
+    const unsigned char *obj,int delta,void *data);
+
 /**
  * The main Level data structure.
  * Stores all elements of Dungeon Keeper level, including data for
@@ -321,11 +382,22 @@ struct LEVEL {
     unsigned char **wlb;
     /*Flag file - size arr_entries_y+1 x arr_entries_x+1 */
     unsigned short **flg;
-    /*Column file - constant-size array of entries used for displaying tiles, */
-    /* size COLUMN_ENTRIES x SIZEOF_DK_CLM_REC */
+    /*Column file - array of entries used for displaying tiles, */
+    /* size clm_entries x SIZEOF_DK_CLM_REC; all entries are in one block, */
+    /* see clm_table_alloc() */
     unsigned char **clm;
+    /*Number of column entries; COLUMN_ENTRIES, unless the map format */
+    /* allows more and they were needed - see get_clm_entries_max() */
+    unsigned int clm_entries;
     /*How many DAT entries points at every column */
     unsigned int *clm_utilize;
+    /*Set of columns containing animated cubes, one bit per column */
+    unsigned char *clm_anim;
+    /*Reverse DAT index - lists of subtiles using every column; the lists */
+    /* are linked through subtile numbers, sy*subsize.x+sx */
+    unsigned int *clm_dat_first;
+    unsigned int *dat_clm_next;
+    unsigned int *dat_clm_prev;
     /*Column file header */
     unsigned char *clm_hdr;
     /*Texture information file - one byte file, identifies texture pack index */
@@ -336,17 +408,14 @@ struct LEVEL {
 
     /*our objects - apt, tng and lgt */
 
-    unsigned char ****apt_lookup; /* Index to action points, by subtile */
-    unsigned short **apt_subnums; /* Number of action points in a subtile */
+    struct OBJECTS_LOOKUP *apt_lookup; /* Index to action points, by subtile */
     unsigned int apt_total_count; /* Total number of action points */
 
-    unsigned char ****tng_lookup; /* Index to things, by subtile */
-    unsigned short **tng_subnums; /* Number of things in a subtile */
+    struct OBJECTS_LOOKUP *tng_lookup; /* Index to things, by subtile */
     unsigned int tng_total_count; /* Number of things in total */
 
     /*Light file - contains static light definitions */
-    unsigned char ****lgt_lookup; /* Index to static light, by subtile */
-    unsigned short **lgt_subnums; /* Number of static lights in a subtile */
+    struct OBJECTS_LOOKUP *lgt_lookup; /* Index to static light, by subtile */
     unsigned int lgt_total_count; /* Total number of static lights */
 
     unsigned short **tng_apt_lgt_nums;    /* Number of all objects in a tile */
@@ -361,8 +430,16 @@ struct LEVEL {
     struct LEVSTATS stats;
     /* Level information */
     struct LEVINFO info;
+    /* Map files changed since last load or save, LEVEL_CHANGE_FLAGS bits */
+    unsigned long changed_files;
+    /* Digests of the object lists, as they were last loaded or saved */
+    unsigned long tng_digest;
+    unsigned long apt_digest;
+    unsigned long lgt_digest;
     /* Options, which affects level graphic generation, and other stuff */
     struct LEVOPTIONS optns;
+    /* Random numbers stream used when generating the level; see level_rng_seed() */
+    struct RNG_STREAM rng;
     /* Custom columns definition */
     /* There can be only one custom column on each subtile. */
     /* The lookup array size is arr_entries_y+1 x arr_entries_x+1 */
@@ -370,8 +447,53 @@ struct LEVEL {
     unsigned int cust_clm_count;
     struct DK_GRAFFITI **graffiti;
     unsigned int graffiti_count;
+    /* Graffiti index by tile - first node for every tile, or -1 */
+    /* The array size is tlsize.y x tlsize.x, it is indexed by ty*tlsize.x+tx */
+    int *graffiti_tile_head;
+    struct DK_GRAFFITI_TILE *graffiti_tiles;
+    unsigned int graffiti_tiles_used;
+    unsigned int graffiti_tiles_alloc;
+    int graffiti_tiles_free;
+    /* Edit transaction nesting level; see level_edit_begin() */
+    int edit_depth;
+    /* Tiles changed inside edit transaction, nonzero if changed; */
+    /* the array size is tlsize.y x tlsize.x, indexed by ty*tlsize.x+tx */
+    unsigned char *edit_dirty;
+    /* Bounding rectangle of the changed tiles */
+    struct IPOINT_2D edit_start;
+    struct IPOINT_2D edit_end;
+    /* Undo journal, or NULL if undo is disabled; see level_undo_enable() */
+    struct UNDO_JOURNAL *undo;
+    /* Function notified about added and removed objects, or NULL */
+    level_obj_hook_func obj_hook;
+    void *obj_hook_data;
+    /* Reference counters of grid rows shared with snapshots, by */
+    /* LEVEL_GRID_INDEX and row; NULL if the row is not shared */
+    long **grid_refs[LGRD_COUNT];
+    /* Number of the last snapshot made, see level_snapshot_create() */
+    unsigned int snapshot_seq;
+    /* Changed files which were passed to snapshots, and not saved yet */
+    unsigned long snapshot_changed;
+    /* Tilesets of slabs, size tlsize.y x tlsize.x, indexed by ty*tlsize.x+tx */
+    unsigned char *slx_data;
+  };
 
-    unsigned char slx_data[MAX_MAP_SIZE_DKXPAND_X * MAX_MAP_SIZE_DKXPAND_Y];
+/**
+ * Memory used by a level, in bytes. Sizes of the allocated data;
+ * allocator overhead is not included.
+ */
+struct LEVEL_MEMORY_USAGE {
+    /* The LEVEL structure itself */
+    unsigned long level;
+    /* Map grids - SLB, OWN, WIB, WLB, FLG, DAT and SLX */
+    unsigned long grids;
+    /* Columns, and the indices used to update them */
+    unsigned long columns;
+    /* Things, action points, static lights and their lookups */
+    unsigned long objects;
+    /* Script, custom columns, graffiti and edit transactions */
+    unsigned long other;
+    unsigned long total;
   };
 
 extern const char default_map_name[];
@@ -384,6 +506,10 @@ DLLIMPORT short level_set_options(struct LEVEL *lvl,struct LEVOPTIONS *optns);
 DLLIMPORT struct LEVOPTIONS *level_get_options(struct LEVEL *lvl);
 DLLIMPORT short level_set_mapdraw_options(struct LEVEL *lvl,struct MAPDRAW_OPTIONS *mdrwopts);
 DLLIMPORT struct MAPDRAW_OPTIONS *level_get_mapdraw_options(struct LEVEL *lvl);
+DLLIMPORT void level_rng_seed(struct LEVEL *lvl,unsigned long long seed);
+DLLIMPORT void level_set_obj_hook(struct LEVEL *lvl,level_obj_hook_func func,void *data);
+void level_obj_changed(struct LEVEL *lvl,short obj_type,const unsigned char *obj,int delta);
+DLLIMPORT struct RNG_STREAM *level_get_rng(struct LEVEL *lvl);
 
 DLLIMPORT short level_clear(struct LEVEL *lvl);
 short level_clear_tng(struct LEVEL *lvl);
@@ -401,6 +527,10 @@ DLLIMPORT short level_free(struct LEVEL *lvl);
 short level_free_tng(struct LEVEL *lvl);
 DLLIMPORT short level_free_script_param(struct DK_SCRIPT_PARAMETERS *par);
 DLLIMPORT short free_text_file(char ***lines,int *lines_count);
+DLLIMPORT short level_memory_usage(const struct LEVEL *lvl,struct LEVEL_MEMORY_USAGE *usage);
+unsigned char **clm_table_alloc(unsigned int entries);
+void clm_table_free(unsigned char **clm);
+short level_set_clm_entries(struct LEVEL *lvl,unsigned int entries);
 
 DLLIMPORT short level_verify(struct LEVEL *lvl, char *actn_name,struct IPOINT_2D *errpt);
 DLLIMPORT short level_verify_control(struct LEVEL *lvl, char *actn_name, unsigned long skip_step_flags, struct IPOINT_2D *errpt);
@@ -420,6 +550,10 @@ DLLIMPORT char *get_thing(const struct LEVEL *lvl,unsigned int sx,unsigned int s
 DLLIMPORT int thing_add(struct LEVEL *lvl,unsigned char *thing);
 DLLIMPORT void thing_del(struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsigned int num);
 DLLIMPORT void thing_drop(struct LEVEL *lvl,unsigned int sx, unsigned int sy, unsigned int num);
+DLLIMPORT short thing_set_subtype(struct LEVEL *lvl,unsigned char *thing,const unsigned char stype_idx);
+DLLIMPORT short thing_set_owner(struct LEVEL *lvl,unsigned char *thing,const unsigned char ownr_idx);
+DLLIMPORT short thing_switch_subtype(struct LEVEL *lvl,unsigned char *thing,const short forward);
+DLLIMPORT short thing_set_data(struct LEVEL *lvl,unsigned char *thing,const unsigned char *data);
 DLLIMPORT unsigned int get_thing_subnums(const struct LEVEL *lvl,unsigned int sx,unsigned int sy);
 
 DLLIMPORT char *get_actnpt(const struct LEVEL *lvl,unsigned int sx,unsigned int sy,unsigned int num);
@@ -446,6 +580,8 @@ DLLIMPORT unsigned int get_tng_total_count(struct LEVEL *lvl);
 DLLIMPORT short get_datclm_auto_update(struct LEVEL *lvl);
 DLLIMPORT short switch_datclm_auto_update(struct LEVEL *lvl);
 DLLIMPORT short set_datclm_auto_update(struct LEVEL *lvl,short val);
+DLLIMPORT short set_lvl_packed_files(struct LEVEL *lvl,unsigned long flags,short level);
+DLLIMPORT unsigned long get_lvl_packed_files(struct LEVEL *lvl);
 DLLIMPORT short get_obj_auto_update(struct LEVEL *lvl);
 DLLIMPORT short switch_obj_auto_update(struct LEVEL *lvl);
 DLLIMPORT short set_obj_auto_update(struct LEVEL *lvl,short val);
@@ -471,6 +607,11 @@ DLLIMPORT short user_set_slab_rect(struct LEVEL *lvl, unsigned int startx, unsig
     unsigned int starty, unsigned int endy, unsigned short nslab);
 DLLIMPORT short user_set_slabown_rect(struct LEVEL *lvl, unsigned int startx, unsigned int endx,
     unsigned int starty, unsigned int endy, unsigned short nslab,unsigned short nown);
+DLLIMPORT short level_edit_begin(struct LEVEL *lvl);
+DLLIMPORT short level_edit_commit(struct LEVEL *lvl);
+short level_edit_end(struct LEVEL *lvl,short update_objs);
+short level_edit_mark_rect(struct LEVEL *lvl, unsigned int startx, unsigned int endx,
+    unsigned int starty, unsigned int endy);
 
 DLLIMPORT unsigned int get_dat_val(const struct LEVEL *lvl, const unsigned int sx, const unsigned int sy);
 DLLIMPORT void set_dat_val(struct LEVEL *lvl, int sx, int sy, unsigned int d);
@@ -494,6 +635,9 @@ DLLIMPORT short set_lif_name_text(struct LEVEL *lvl,char *name);
 
 DLLIMPORT struct DK_SCRIPT *get_lvl_script(struct LEVEL *lvl);
 DLLIMPORT struct LEVSTATS *get_lvl_stats(struct LEVEL *lvl);
+DLLIMPORT void mark_lvl_changed(struct LEVEL *lvl,unsigned long flags);
+DLLIMPORT unsigned long get_lvl_changed(struct LEVEL *lvl);
+DLLIMPORT void clear_lvl_changed(struct LEVEL *lvl,unsigned long flags);
 
 DLLIMPORT unsigned long inc_info_usr_mdswtch_count(struct LEVEL *lvl);
 DLLIMPORT unsigned long inc_info_usr_cmds_count(struct LEVEL *lvl);
@@ -507,6 +651,7 @@ DLLIMPORT unsigned int inc_info_ver_rel(struct LEVEL *lvl);
 DLLIMPORT void update_level_stats(struct LEVEL *lvl);
 DLLIMPORT void update_things_stats(struct LEVEL *lvl);
 DLLIMPORT void update_thing_stats(struct LEVEL *lvl,const unsigned char *thing,short change);
+DLLIMPORT short level_verify_stats(struct LEVEL *lvl);
 DLLIMPORT short get_level_objstats_textln(struct LEVEL *lvl,char *stat_buf,const int line_num);
 
 DLLIMPORT unsigned char get_lvl_inf(struct LEVEL *lvl);
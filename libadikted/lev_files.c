@@ -31,9 +31,11 @@
 #include "bulcommn.h"
 #include "obj_column.h"
 #include "lev_data.h"
+#include "lev_column.h"
 #include "lev_script.h"
 #include "msg_log.h"
 #include "lbfileio.h"
+#include "lbthread.h"
 #include "lev_script.h"
 #include "lev_things.h"
 
@@ -180,7 +182,7 @@ unsigned char **load_subtile_malloc(char *fname, int length,
  */
 short load_tng(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_tng: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_tng: started");
     int tng_num;
     int i;
     if (lvl==NULL) return ERR_INTERNAL;
@@ -200,7 +202,7 @@ short load_tng(struct LEVEL *lvl,char *fname)
     unsigned long expect_size=tng_num*SIZEOF_DK_TNG_REC+SIZEOF_DK_TNG_HEADER;
     if (mem->len != expect_size)
     {
-        message_log("  load_tng: File length %d, expected %lu (%d things)",mem->len,expect_size,tng_num);
+        message_log_lvl(MSGLOG_INFO,"  load_tng: File length %d, expected %lu (%d things)",mem->len,expect_size,tng_num);
         /* Fixing the problem */
         if (((lvl->optns.load_redundant_objects&EXLD_THING)==EXLD_THING)||(mem->len < expect_size))
           tng_num=(mem->len-SIZEOF_DK_TNG_HEADER)/SIZEOF_DK_TNG_REC;
@@ -231,7 +233,7 @@ short load_tng(struct LEVEL *lvl,char *fname)
  */
 short load_clm(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_clm: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_clm: started");
     int i;
     if ((lvl==NULL)||(lvl->clm==NULL)) return ERR_INTERNAL;
     /*Reading file */
@@ -247,14 +249,17 @@ short load_clm(struct LEVEL *lvl,char *fname)
     int num_clms=read_int32_le_buf(mem->content+0);
     if (mem->len != SIZEOF_DK_CLM_REC*num_clms+SIZEOF_DK_CLM_HEADER)
     { memfile_free(&mem); return ERR_FILE_BADDATA; }
-    if (num_clms>COLUMN_ENTRIES)
+    if (num_clms>get_clm_entries_max(lvl))
     { memfile_free(&mem); return ERR_FILE_BADDATA; }
+    if ((num_clms>lvl->clm_entries)&&(!clm_table_grow(lvl,num_clms)))
+    { memfile_free(&mem); return ERR_CANT_MALLOC; }
     for (i=0; i<num_clms; i++)
     {
       int offs=SIZEOF_DK_CLM_REC*i+SIZEOF_DK_CLM_HEADER;
       memcpy(lvl->clm[i], mem->content+offs, SIZEOF_DK_CLM_REC);
     }
     memfile_free(&mem);
+    update_clm_anim_bits(lvl);
     return ERR_NONE;
 }
 
@@ -267,7 +272,7 @@ short load_clm(struct LEVEL *lvl,char *fname)
  */
 short load_apt(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_apt: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_apt: started");
     int i;
     unsigned char *actnpt;
     if ((lvl==NULL)||(lvl->apt_lookup==NULL)) return ERR_INTERNAL;
@@ -287,7 +292,7 @@ short load_apt(struct LEVEL *lvl,char *fname)
     unsigned long expect_size=apt_num*SIZEOF_DK_APT_REC+SIZEOF_DK_APT_HEADER;
     if (mem->len != expect_size)
     {
-        message_log("  load_apt: File length %d, expected %lu (%d items)",mem->len,expect_size,apt_num);
+        message_log_lvl(MSGLOG_INFO,"  load_apt: File length %d, expected %lu (%d items)",mem->len,expect_size,apt_num);
         /* Fixing the problem */
         if (((lvl->optns.load_redundant_objects&EXLD_ACTNPT)==EXLD_ACTNPT)||(mem->len < expect_size))
           apt_num=(mem->len-SIZEOF_DK_APT_HEADER)/SIZEOF_DK_APT_REC;
@@ -321,7 +326,7 @@ short load_apt(struct LEVEL *lvl,char *fname)
  */
 short load_inf(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_inf: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_inf: started");
     struct MEMORY_FILE *mem;
     short result;
     result = memfile_readnew(&mem,fname,MAX_FILE_SIZE);
@@ -343,7 +348,7 @@ short load_inf(struct LEVEL *lvl,char *fname)
  */
 short load_vsn(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_vsn: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_vsn: started");
     struct MEMORY_FILE *mem;
     short result;
     result = memfile_readnew(&mem,fname,MAX_FILE_SIZE);
@@ -370,7 +375,7 @@ short load_vsn(struct LEVEL *lvl,char *fname)
  */
 short load_wib(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_wib: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_wib: started");
     /*Loading the file */
     struct MEMORY_FILE *mem;
     short result;
@@ -405,7 +410,7 @@ short load_wib(struct LEVEL *lvl,char *fname)
  */
 short load_slb(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_slb: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_slb: started");
     /* Let's get the modification date, in case ADI script is lost */
     struct stat attrib;    /* create a file attribute structure */
     if (stat(fname,&attrib) == 0)  /* get the attributes of file */
@@ -416,7 +421,8 @@ short load_slb(struct LEVEL *lvl,char *fname)
         char *name_text=malloc(name_len);
         if (name_text!=NULL)
         {
-            strftime(name_text,name_len, default_map_name, localtime(&(lvl->info.creat_date)) );
+            struct tm creat_tm;
+            strftime(name_text,name_len, default_map_name, local_time_r(&(lvl->info.creat_date),&creat_tm) );
             set_lif_name_text(lvl,name_text);
         }
     }
@@ -453,7 +459,7 @@ short load_slb(struct LEVEL *lvl,char *fname)
  */
 short load_own(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_own: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_own: started");
     /*Reading file */
     struct MEMORY_FILE *mem;
     short result;
@@ -488,7 +494,7 @@ short load_own(struct LEVEL *lvl,char *fname)
  */
 short load_dat(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_dat: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_dat: started");
     short result;
     const unsigned int line_len=2*lvl->subsize.x;
     /*Loading the file */
@@ -503,6 +509,20 @@ short load_dat(struct LEVEL *lvl,char *fname)
     /*message_log("  load_dat: Reading DAT entries"); */
     int sx, sy;
     unsigned char *addr;
+    /* Extended formats may use more columns; CLM is loaded after DAT, */
+    /* and the table must be large enough before DAT entries are indexed */
+    unsigned int clm_idx_max=0;
+    for (sx=0; sx<lvl->subsize.x*lvl->subsize.y; sx++)
+    {
+      unsigned int clm_idx=(0x10000-read_int16_le_buf(mem->content+sx*2))&0x0ffff;
+      if (clm_idx>clm_idx_max)
+        clm_idx_max=clm_idx;
+    }
+    if ((clm_idx_max>=lvl->clm_entries)&&(clm_idx_max<get_clm_entries_max(lvl)))
+    {
+      if (!clm_table_grow(lvl,clm_idx_max+1))
+      { memfile_free(&mem); return ERR_CANT_MALLOC; }
+    }
     for (sy=0; sy<lvl->subsize.y; sy++)
     {
       addr = mem->content+sy*line_len;
@@ -525,7 +545,7 @@ short load_dat(struct LEVEL *lvl,char *fname)
  */
 short load_txt(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_txt: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_txt: started");
     lvl->script.lines_count=0;
     /*Loading the file */
     struct MEMORY_FILE *mem;
@@ -602,7 +622,7 @@ short load_txt(struct LEVEL *lvl,char *fname)
  */
 short load_lgt(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_lgt: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_lgt: started");
     unsigned char *stlight;
     if ((lvl==NULL)||(lvl->lgt_lookup==NULL))
       return ERR_INTERNAL;
@@ -624,7 +644,7 @@ short load_lgt(struct LEVEL *lvl,char *fname)
     /* Check everything's cushty */
     if (mem->len != expect_size)
     {
-        message_log("  load_lgt: File length %d, expected %lu (%d items)",mem->len,expect_size,lgt_num);
+        message_log_lvl(MSGLOG_INFO,"  load_lgt: File length %d, expected %lu (%d items)",mem->len,expect_size,lgt_num);
         /* Fixing the problem */
         if (((lvl->optns.load_redundant_objects&EXLD_STLGHT)==EXLD_STLGHT)||(mem->len < expect_size))
           lgt_num=(mem->len-SIZEOF_DK_LGT_HEADER)/SIZEOF_DK_LGT_REC;
@@ -661,7 +681,7 @@ short load_lgt(struct LEVEL *lvl,char *fname)
  */
 short load_wlb(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_wlb: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_wlb: started");
     /*Reading file */
     struct MEMORY_FILE *mem;
     short result;
@@ -690,13 +710,16 @@ short load_wlb(struct LEVEL *lvl,char *fname)
  */
 short load_slx(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_slx: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_slx: started");
     short result;
     FILE *F = fopen(fname, "rb");
     if (F == NULL)
         return ERR_FILE_BADDATA;
-    if (1 != fread(lvl->slx_data, sizeof(lvl->slx_data), 1, F))
+    if (1 != fread(lvl->slx_data, lvl->tlsize.x*lvl->tlsize.y, 1, F))
+    {
+        fclose(F);
         return ERR_FILE_BADDATA;
+    }
     fclose(F);
     return ERR_NONE;
 }
@@ -710,7 +733,7 @@ short load_slx(struct LEVEL *lvl,char *fname)
  */
 short load_flg(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_flg: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_flg: started");
     const unsigned int line_len=2*lvl->subsize.x;
     /*Loading the file */
     struct MEMORY_FILE *mem;
@@ -745,7 +768,7 @@ short load_flg(struct LEVEL *lvl,char *fname)
  */
 short load_lif(struct LEVEL *lvl,char *fname)
 {
-    message_log("  load_lif: started");
+    message_log_lvl(MSGLOG_TRACE,"  load_lif: started");
     short result;
     /* Load the file lines */
     char **lines=NULL;
@@ -935,6 +958,75 @@ short load_text_file(char ***lines,int *lines_count,char *fname)
     return ERR_NONE;
 }
 
+/**
+ * Map file being written by save_mapfiles_all().
+ */
+struct MAPFILE_SAVE_JOB {
+    const struct MAPFILE_WRITE_ENTRY *file;
+    char *fname;
+    char *new_fname;
+    char *bak_fname;
+    short skipped;
+    short backed_up;
+    short replaced;
+    short pack;
+    int pack_level;
+    short result;
+};
+
+/**
+ * The save_mapfiles_all() job which current thread is writing, or NULL
+ * if the write_*() function was called directly.
+ */
+static THREAD_LOCAL const struct MAPFILE_SAVE_JOB *mapfile_save_job=NULL;
+
+/**
+ * Writes memory file with level data into disk, and frees it.
+ * The file is replaced atomically, using memfile_write().
+ * When written by save_mapfiles_all(), the file name is temporary already;
+ * then the data is packed if needed, and written directly to the file.
+ * @param mem Double pointer to the MEMORY_FILE structure.
+ * @param fname Destination file name.
+ * @return Returns ERR_NONE on success, error code on failure.
+ */
+static short write_mapfile_mem(struct MEMORY_FILE **mem,char *fname)
+{
+    const struct MAPFILE_SAVE_JOB *job=mapfile_save_job;
+    short mf_result;
+    short result;
+    if ((*mem)->errcode!=MFILE_OK)
+      mf_result=MFILE_MALLOC_ERR;
+    else
+    if (job==NULL)
+      mf_result=memfile_write(*mem,fname);
+    else
+    {
+      mf_result=MFILE_OK;
+      /* Empty files are left unpacked, as there's nothing to pack */
+      if ((job->pack)&&((*mem)->len>0))
+        mf_result=memfile_pack(*mem,job->pack_level);
+      if (mf_result==MFILE_OK)
+        mf_result=memfile_write_direct(*mem,fname);
+    }
+    switch (mf_result)
+    {
+    case MFILE_OK:
+        result=ERR_NONE;
+        break;
+    case MFILE_CANNOT_OPEN:
+        result=ERR_CANT_OPENWR;
+        break;
+    case MFILE_MALLOC_ERR:
+        result=ERR_CANT_MALLOC;
+        break;
+    default:
+        result=ERR_CANT_WRITE;
+        break;
+    }
+    memfile_free(mem);
+    return result;
+}
+
 /**
  * Writes the SLB file from LEVEL structure into disk.
  * @param lvl Pointer to the LEVEL structure.
@@ -943,21 +1035,22 @@ short load_text_file(char ***lines,int *lines_count,char *fname)
  */
 short write_slb(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_slb: starting");
-    FILE *fp;
+    message_log_lvl(MSGLOG_TRACE," write_slb: starting");
+    struct MEMORY_FILE *mem;
     int i, k;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    if (memfile_new(&mem,2*lvl->tlsize.x*lvl->tlsize.y)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    unsigned char *buf=mem->content;
     for (k=0; k < lvl->tlsize.y; k++)
     {
       for (i=0; i < lvl->tlsize.x; i++)
       {
-          write_int16_le_file(fp,get_tile_slab(lvl,i,k));
+          write_int16_le_buf(buf,get_tile_slab(lvl,i,k));
+          buf+=2;
       }
     }
-    fclose (fp);
-    return ERR_NONE;
+    mem->len=buf-mem->content;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -968,23 +1061,23 @@ short write_slb(struct LEVEL *lvl,char *fname)
  */
 short write_own(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_own: starting");
-    /*Opening */
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    message_log_lvl(MSGLOG_TRACE," write_own: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,lvl->subsize.x*lvl->subsize.y)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
     /*Writing data */
+    unsigned char *buf=mem->content;
     int sx,sy;
     for (sy=0; sy<lvl->subsize.y; sy++)
     {
       for (sx=0; sx<lvl->subsize.x; sx++)
       {
-          fputc (get_subtl_owner(lvl,sx,sy), fp);
+          *buf=get_subtl_owner(lvl,sx,sy);
+          buf++;
       }
     }
-    fclose (fp);
-    return ERR_NONE;
+    mem->len=buf-mem->content;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -995,24 +1088,23 @@ short write_own(struct LEVEL *lvl,char *fname)
  */
 short write_dat(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_dat: starting");
-    /*const unsigned int line_len=2*lvl->subsize.x;*/
-
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    message_log_lvl(MSGLOG_TRACE," write_dat: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,2*lvl->subsize.x*lvl->subsize.y)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
     /*Writing data */
+    unsigned char *buf=mem->content;
     int sx,sy;
     for (sy=0; sy<lvl->subsize.y; sy++)
     {
       for (sx=0; sx<lvl->subsize.x; sx++)
       {
-          write_int16_le_file(fp,get_dat_val(lvl,sx,sy));
+          write_int16_le_buf(buf,get_dat_val(lvl,sx,sy));
+          buf+=2;
       }
     }
-    fclose (fp);
-    return ERR_NONE;
+    mem->len=buf-mem->content;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1023,24 +1115,23 @@ short write_dat(struct LEVEL *lvl,char *fname)
  */
 short write_flg(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_flg: starting");
-    /*const unsigned int line_len=2*lvl->subsize.x;*/
-
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    message_log_lvl(MSGLOG_TRACE," write_flg: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,2*lvl->subsize.x*lvl->subsize.y)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
     /*Writing data */
+    unsigned char *buf=mem->content;
     int sx,sy;
     for (sy=0; sy<lvl->subsize.y; sy++)
     {
       for (sx=0; sx<lvl->subsize.x; sx++)
       {
-          write_int16_le_file(fp,get_subtl_flg(lvl,sx,sy));
+          write_int16_le_buf(buf,get_subtl_flg(lvl,sx,sy));
+          buf+=2;
       }
     }
-    fclose (fp);
-    return ERR_NONE;
+    mem->len=buf-mem->content;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1051,18 +1142,16 @@ short write_flg(struct LEVEL *lvl,char *fname)
  */
 short write_clm(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_clm: starting");
-    FILE *fp;
+    message_log_lvl(MSGLOG_TRACE," write_clm: starting");
+    struct MEMORY_FILE *mem;
     int i;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
-    write_int32_le_buf(lvl->clm_hdr+0,COLUMN_ENTRIES);
-    fwrite(lvl->clm_hdr, SIZEOF_DK_CLM_HEADER, 1, fp);
-    for (i=0; i<COLUMN_ENTRIES; i++)
-      fwrite(lvl->clm[i], SIZEOF_DK_CLM_REC, 1, fp);
-    fclose (fp);
-    return ERR_NONE;
+    if (memfile_new(&mem,SIZEOF_DK_CLM_HEADER+lvl->clm_entries*SIZEOF_DK_CLM_REC)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    write_int32_le_buf(lvl->clm_hdr+0,lvl->clm_entries);
+    memfile_add(mem,lvl->clm_hdr,SIZEOF_DK_CLM_HEADER);
+    for (i=0; i<lvl->clm_entries; i++)
+      memfile_add(mem,lvl->clm[i],SIZEOF_DK_CLM_REC);
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1073,20 +1162,22 @@ short write_clm(struct LEVEL *lvl,char *fname)
  */
 short write_wib(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_wib: starting");
-
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    message_log_lvl(MSGLOG_TRACE," write_wib: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,lvl->subsize.x*lvl->subsize.y)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    unsigned char *buf=mem->content;
     int i, j;
     for (i=0; i < lvl->subsize.y; i++)
     {
       for (j=0; j<lvl->subsize.x; j++)
-          fputc (get_subtl_wib(lvl,j,i), fp);
+      {
+          *buf=get_subtl_wib(lvl,j,i);
+          buf++;
+      }
     }
-    fclose (fp);
-    return ERR_NONE;
+    mem->len=buf-mem->content;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1097,16 +1188,16 @@ short write_wib(struct LEVEL *lvl,char *fname)
  */
 short write_apt(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_apt: starting");
+    message_log_lvl(MSGLOG_TRACE," write_apt: starting");
     /*Preparing array bounds */
     const int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
 
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
-    write_int32_le_file (fp,lvl->apt_total_count);
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,4+lvl->apt_total_count*SIZEOF_DK_APT_REC)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    write_int32_le_buf(mem->content,lvl->apt_total_count);
+    mem->len=4;
     int cy, cx, k;
     for (cy=0; cy<arr_entries_y; cy++)
     {
@@ -1116,12 +1207,11 @@ short write_apt(struct LEVEL *lvl,char *fname)
           for (k=0; k<num_subs; k++)
           {
                 char *actnpt=get_actnpt(lvl,cx,cy,k);
-                fwrite (actnpt, SIZEOF_DK_APT_REC, 1, fp);
+                memfile_add(mem,(unsigned char *)actnpt,SIZEOF_DK_APT_REC);
           }
       }
     }
-    fclose (fp);
-    return ERR_NONE;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1132,25 +1222,24 @@ short write_apt(struct LEVEL *lvl,char *fname)
  */
 short write_tng(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_tng: starting");
+    message_log_lvl(MSGLOG_TRACE," write_tng: starting");
     /*Preparing array bounds */
     const int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
 
-    FILE *fp;
+    struct MEMORY_FILE *mem;
     int cx, cy, k;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    if (memfile_new(&mem,2+lvl->tng_total_count*SIZEOF_DK_TNG_REC)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
     /*Header */
-    write_int16_le_file(fp, lvl->tng_total_count);
+    write_int16_le_buf(mem->content, lvl->tng_total_count);
+    mem->len=2;
     /*Entries */
     for (cy=0; cy < arr_entries_y; cy++)
       for (cx=0; cx < arr_entries_x; cx++)
           for (k=0; k < get_thing_subnums(lvl,cx,cy); k++)
-                fwrite (get_thing(lvl,cx,cy,k), SIZEOF_DK_TNG_REC, 1, fp);
-    fclose (fp);
-    return ERR_NONE;
+                memfile_add(mem,(unsigned char *)get_thing(lvl,cx,cy,k),SIZEOF_DK_TNG_REC);
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1162,14 +1251,13 @@ short write_tng(struct LEVEL *lvl,char *fname)
  */
 short write_inf(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_inf: starting");
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
-    fputc ((lvl->inf) & 255, fp);
-    fclose (fp);
-    return ERR_NONE;
+    message_log_lvl(MSGLOG_TRACE," write_inf: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,1)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    mem->content[0]=(lvl->inf) & 255;
+    mem->len=1;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1181,11 +1269,10 @@ short write_inf(struct LEVEL *lvl,char *fname)
  */
 short write_vsn(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_vsn: starting");
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    message_log_lvl(MSGLOG_TRACE," write_vsn: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,1)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
     unsigned char vsn;
     switch (lvl->format_version)
     {
@@ -1200,9 +1287,9 @@ short write_vsn(struct LEVEL *lvl,char *fname)
          vsn=0;
          break;
     }
-    fputc (vsn, fp);
-    fclose (fp);
-    return ERR_NONE;
+    mem->content[0]=vsn;
+    mem->len=1;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1214,7 +1301,7 @@ short write_vsn(struct LEVEL *lvl,char *fname)
  */
 short write_txt(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_txt: starting");
+    message_log_lvl(MSGLOG_TRACE," write_txt: starting");
     return write_text_file(lvl->script.txt,lvl->script.lines_count,fname);
 }
 
@@ -1226,16 +1313,16 @@ short write_txt(struct LEVEL *lvl,char *fname)
  */
 short write_lgt(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_lgt: starting");
+    message_log_lvl(MSGLOG_TRACE," write_lgt: starting");
     /*Preparing array bounds */
     const int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
     const int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
 
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
-    write_int32_le_file (fp,lvl->lgt_total_count);
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,4+lvl->lgt_total_count*SIZEOF_DK_LGT_REC)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    write_int32_le_buf(mem->content,lvl->lgt_total_count);
+    mem->len=4;
     int cy, cx, k;
     for (cy=0; cy<arr_entries_y; cy++)
     {
@@ -1245,12 +1332,11 @@ short write_lgt(struct LEVEL *lvl,char *fname)
           for (k=0; k<num_subs; k++)
           {
                 char *stlight=get_stlight(lvl,cx,cy,k);
-                fwrite (stlight, SIZEOF_DK_LGT_REC, 1, fp);
+                memfile_add(mem,(unsigned char *)stlight,SIZEOF_DK_LGT_REC);
           }
       }
     }
-    fclose (fp);
-    return ERR_NONE;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1262,19 +1348,22 @@ short write_lgt(struct LEVEL *lvl,char *fname)
  */
 short write_wlb(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_wlb: starting");
-    FILE *fp;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    message_log_lvl(MSGLOG_TRACE," write_wlb: starting");
+    struct MEMORY_FILE *mem;
+    if (memfile_new(&mem,lvl->tlsize.x*lvl->tlsize.y)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    unsigned char *buf=mem->content;
     int i, j;
     for (i=0; i < lvl->tlsize.y; i++)
     {
       for (j=0; j < lvl->tlsize.x; j++)
-          fputc(lvl->wlb[j][i], fp);
+      {
+          *buf=lvl->wlb[j][i];
+          buf++;
+      }
     }
-    fclose(fp);
-    return ERR_NONE;
+    mem->len=buf-mem->content;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1299,7 +1388,7 @@ static char* find_last( char *buffer, const char item )
  */
 short write_lif(struct LEVEL *lvl,char *fname)
 {
-  message_log(" write_lif: starting");
+  message_log_lvl(MSGLOG_TRACE," write_lif: starting");
   /*Acquiring map number */
   long lvl_num;
   char *fname_num = fname;
@@ -1333,7 +1422,7 @@ short write_lif(struct LEVEL *lvl,char *fname)
  */
 short write_lof(struct LEVEL *lvl,char *fname)
 {
-    message_log(" write_lof: starting");
+    message_log_lvl(MSGLOG_TRACE," write_lof: starting");
 
     /*Creating text lines */
     char **lines=(char **)malloc(13*sizeof(char *));
@@ -1399,7 +1488,7 @@ short write_lof(struct LEVEL *lvl,char *fname)
  */
 short write_adi_script(struct LEVEL *lvl,char *fname)
 {
-  message_log(" write_adi_script: starting");
+  message_log_lvl(MSGLOG_TRACE," write_adi_script: starting");
   /*Creating text lines */
   char **lines=NULL;
   int lines_count=0;
@@ -1420,7 +1509,7 @@ short write_adi_script(struct LEVEL *lvl,char *fname)
  */
 short write_nfo(struct LEVEL *lvl,char *fname)
 {
-  message_log(" write_nfo: starting");
+  message_log_lvl(MSGLOG_TRACE," write_nfo: starting");
   /*Creating text lines */
   char **lines=NULL;
   int lines_count=0;
@@ -1441,8 +1530,9 @@ short write_nfo(struct LEVEL *lvl,char *fname)
     if ((lvl->info.editor_text!=NULL)&&(lvl->info.editor_text[0]!='\0'))
         sprintf(line+strlen(line),", Editor: %s",lvl->info.editor_text);
     strcat(line,", Created on ");
+    struct tm creat_tm;
     strftime(line+strlen(line),LINEMSG_SIZE/2, "%d %b %Y",
-        gmtime(&lvl->info.creat_date) );
+        utc_time_r(&lvl->info.creat_date,&creat_tm) );
     text_file_linecp_add(&lines,&lines_count,line);
     strcpy(line,"Keepers: ");
     /*Clearing array for storing players heart count */
@@ -1528,25 +1618,24 @@ short write_nfo(struct LEVEL *lvl,char *fname)
  */
 short write_text_file(char **lines,int lines_count,char *fname)
 {
-    FILE *fp;
+    struct MEMORY_FILE *mem;
     int i;
-    fp = fopen (fname, "wb");
-    if (fp==NULL)
-      return ERR_CANT_OPENWR;
+    if (memfile_new(&mem,0)!=MFILE_OK)
+      return ERR_CANT_MALLOC;
+    mem->alloc_delta=4096;
     int last_line=lines_count-1;
     for (i=0;i<last_line;i++)
     {
-      fputs(lines[i],fp);
-      fputs("\r\n",fp);
+      memfile_add(mem,(unsigned char *)lines[i],strlen(lines[i]));
+      memfile_add(mem,(unsigned char *)"\r\n",2);
     }
     if (last_line>=0)
     {
-      fputs(lines[last_line],fp);
+      memfile_add(mem,(unsigned char *)lines[last_line],strlen(lines[last_line]));
       if (lines[last_line][0] != '\0')
-        fputs("\r\n",fp);
+        memfile_add(mem,(unsigned char *)"\r\n",2);
     }
-    fclose(fp);
-    return ERR_NONE;
+    return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1558,14 +1647,13 @@ short write_text_file(char **lines,int lines_count,char *fname)
  */
 short write_slx(struct LEVEL *lvl,char *fname)
 {
-  message_log(" write_slx: starting");
+  message_log_lvl(MSGLOG_TRACE," write_slx: starting");
 
-  FILE* fp = fopen(fname, "wb");
-  if (fp==NULL)
-    return ERR_CANT_OPENWR;
-  fwrite(lvl->slx_data, lvl->tlsize.x * lvl->tlsize.y, 1, fp);
-  fclose(fp);
-  return ERR_NONE;
+  struct MEMORY_FILE *mem;
+  if (memfile_new(&mem,lvl->tlsize.x * lvl->tlsize.y)!=MFILE_OK)
+    return ERR_CANT_MALLOC;
+  memfile_add(mem,lvl->slx_data,lvl->tlsize.x * lvl->tlsize.y);
+  return write_mapfile_mem(&mem,fname);
 }
 
 /**
@@ -1614,9 +1702,322 @@ short save_mapfile(struct LEVEL *lvl,char *mfname,char *fext,mapfile_io_func wri
   return file_result;
 }
 
+/**
+ * Returns the change flag of map file with given extension.
+ * @param fext Extension of the map file.
+ * @return Returns LEVEL_CHANGE_FLAGS bit, or LCF_NONE if unknown.
+ */
+static unsigned long mapfile_change_flag(const char *fext)
+{
+    static const struct {
+        const char *fext;
+        unsigned long flag;
+    } exts[] = {
+        {"slb",LCF_SLB}, {"own",LCF_OWN}, {"dat",LCF_DAT}, {"clm",LCF_CLM},
+        {"tng",LCF_TNG}, {"apt",LCF_APT}, {"wib",LCF_WIB}, {"inf",LCF_INF},
+        {"txt",LCF_TXT}, {"lgt",LCF_LGT}, {"wlb",LCF_WLB}, {"flg",LCF_FLG},
+        {"lif",LCF_LIF}, {"lof",LCF_LIF}, {"vsn",LCF_VSN}, {"adi",LCF_ADI},
+        {"slx",LCF_SLX},
+    };
+    int i;
+    for (i=0; i<sizeof(exts)/sizeof(exts[0]); i++)
+    {
+        if (strcmp(exts[i].fext,fext)==0)
+          return exts[i].flag;
+    }
+    return LCF_NONE;
+}
+
+/**
+ * Level file writing entry - extension and function writing the file.
+ */
+struct MAPFILE_WRITE_ENTRY {
+    char *fext;
+    mapfile_io_func write_file;
+};
+
+/**
+ * Map files written by save_dk1_map().
+ */
+static const struct MAPFILE_WRITE_ENTRY dk1_map_files[] = {
+    {"slb",write_slb}, {"own",write_own}, {"dat",write_dat},
+    {"clm",write_clm}, {"tng",write_tng}, {"apt",write_apt},
+    {"wib",write_wib}, {"inf",write_inf}, {"txt",write_txt},
+    {"lgt",write_lgt}, {"wlb",write_wlb}, {"flg",write_flg},
+    {"lif",write_lif}, {"vsn",write_vsn}, {"adi",write_adi_script},
+    {"slx",write_slx},
+};
+
+/**
+ * Map files written by save_dke_map().
+ * @todo Replace tng, apt and lgt with tngfx, aptfx and lgtfx.
+ */
+static const struct MAPFILE_WRITE_ENTRY dke_map_files[] = {
+    {"slb",write_slb}, {"own",write_own}, {"dat",write_dat},
+    {"clm",write_clm}, {"tng",write_tng}, {"apt",write_apt},
+    {"wib",write_wib}, {"inf",write_inf}, {"txt",write_txt},
+    {"lgt",write_lgt}, {"wlb",write_wlb}, {"flg",write_flg},
+    {"lof",write_lof}, {"adi",write_adi_script}, {"slx",write_slx},
+};
+
+/**
+ * Amount of threads writing map files in save_mapfiles_all(),
+ * including the calling thread.
+ */
+#define MAPFILE_SAVE_THREADS 4
+
+/**
+ * Map files shared by the threads of save_mapfiles_all().
+ */
+struct MAPFILE_SAVE_TASK {
+    struct LEVEL *lvl;
+    struct MAPFILE_SAVE_JOB *jobs;
+    int jobs_count;
+    volatile long next_job;
+};
+
+/**
+ * Writes the map files of save_mapfiles_all() task, taking the next
+ * job until none are left. Every thread of the task executes it.
+ * Messages aren't shown here - every job stores its result instead.
+ * @param task Pointer to the MAPFILE_SAVE_TASK structure.
+ */
+static void save_mapfiles_jobs(struct MAPFILE_SAVE_TASK *task)
+{
+    long i;
+    while ((i=lb_atomic_inc(&task->next_job)-1)<task->jobs_count)
+    {
+        struct MAPFILE_SAVE_JOB *job=&task->jobs[i];
+        if (job->skipped)
+            continue;
+        mapfile_save_job=job;
+        job->result=job->file->write_file(task->lvl,job->new_fname);
+        mapfile_save_job=NULL;
+    }
+}
+
+/**
+ * Entry of additional threads started by save_mapfiles_all().
+ * @param arg Pointer to the MAPFILE_SAVE_TASK structure.
+ */
+static void save_mapfiles_thread(void *arg)
+{
+    save_mapfiles_jobs((struct MAPFILE_SAVE_TASK *)arg);
+    message_thread_end();
+}
+
+/**
+ * Replaces the previous map files with the written ones. Previous files
+ * are kept as backups until all files are replaced; if replacing any
+ * of them fails, the files already replaced are restored from backups.
+ * @param jobs Array of the save jobs.
+ * @param files_count Amount of entries in the jobs array.
+ * @param saved_files Saved files counter. Incremented for every saved file.
+ * @return Returns ERR_NONE on success, error code on failure.
+ */
+static short replace_mapfiles_all(struct MAPFILE_SAVE_JOB *jobs,int files_count,int *saved_files)
+{
+  struct stat attrib;
+  short result=ERR_NONE;
+  int i;
+  for (i=0; i<files_count; i++)
+  {
+      struct MAPFILE_SAVE_JOB *job=&jobs[i];
+      if (job->skipped)
+          continue;
+      if (stat(job->fname,&attrib)==0)
+      {
+          if (memfile_replace_file(job->fname,job->bak_fname)!=MFILE_OK)
+          {
+              result=ERR_CANT_WRITE;
+              break;
+          }
+          job->backed_up=true;
+      }
+      if (memfile_replace_file(job->new_fname,job->fname)!=MFILE_OK)
+      {
+          result=ERR_CANT_WRITE;
+          break;
+      }
+      job->replaced=true;
+  }
+  if (result!=ERR_NONE)
+  {
+      message_error("Error: %s when saving \"%s\"; previous map files restored",
+          levfile_error(result), jobs[i].fname);
+      /* Going back to the previous files; the new ones are removed */
+      for (i=0; i<files_count; i++)
+      {
+          struct MAPFILE_SAVE_JOB *job=&jobs[i];
+          if (job->skipped)
+              continue;
+          if (job->replaced)
+              remove(job->fname);
+          else
+              remove(job->new_fname);
+          if (job->backed_up)
+          {
+              if (memfile_replace_file(job->bak_fname,job->fname)!=MFILE_OK)
+                  message_error("Error: cannot restore \"%s\" from \"%s\"",job->fname,job->bak_fname);
+          }
+      }
+      return result;
+  }
+  for (i=0; i<files_count; i++)
+  {
+      struct MAPFILE_SAVE_JOB *job=&jobs[i];
+      if (job->skipped)
+          continue;
+      if (job->backed_up)
+          remove(job->bak_fname);
+      (*saved_files)++;
+  }
+  return ERR_NONE;
+}
+
+/**
+ * Saves a set of map files, so that either all of them are replaced,
+ * or none. Every file is written once, under temporary name; only
+ * if all were written, they replace the previous files. The previous
+ * files are kept as backups while replacing, and restored if any file
+ * can't be replaced.
+ * The files are written by several threads at once; the level
+ * must not be changed until this function returns.
+ * Files which weren't changed are skipped, if they exist on disk.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param mfname Destination file name, without extension.
+ * @param files Array of the files to write.
+ * @param files_count Amount of entries in the files array.
+ * @param write_files Changed files, LEVEL_CHANGE_FLAGS bits.
+ * @param saved_files Saved files counter. Incremented for every saved file.
+ * @return Returns ERR_NONE on success, last error code on failure.
+ */
+static short save_mapfiles_all(struct LEVEL *lvl,char *mfname,
+    const struct MAPFILE_WRITE_ENTRY *files,int files_count,
+    unsigned long write_files,int *saved_files)
+{
+  short result=ERR_NONE;
+  struct MAPFILE_SAVE_TASK task;
+  struct MAPFILE_SAVE_JOB *jobs;
+  struct LB_THREAD *threads[MAPFILE_SAVE_THREADS-1];
+  int threads_count;
+  int i;
+  jobs = (struct MAPFILE_SAVE_JOB *)calloc(files_count,sizeof(struct MAPFILE_SAVE_JOB));
+  if (jobs==NULL)
+  {
+      message_error("save_mapfiles_all: Out of memory");
+      return ERR_CANT_MALLOC;
+  }
+  for (i=0; i<files_count; i++)
+  {
+      struct MAPFILE_SAVE_JOB *job=&jobs[i];
+      struct stat attrib;
+      size_t fname_len=strlen(mfname)+strlen(files[i].fext)+2;
+      job->file=&files[i];
+      job->fname=(char *)malloc(fname_len);
+      job->new_fname=(char *)malloc(fname_len+4);
+      job->bak_fname=(char *)malloc(fname_len+4);
+      if ((job->fname==NULL)||(job->new_fname==NULL)||(job->bak_fname==NULL))
+      {
+          message_error("save_mapfiles_all: Out of memory");
+          result=ERR_CANT_MALLOC;
+          break;
+      }
+      sprintf(job->fname, "%s.%s", mfname, files[i].fext);
+      sprintf(job->new_fname, "%s.new", job->fname);
+      sprintf(job->bak_fname, "%s.bak", job->fname);
+      job->skipped=((mapfile_change_flag(files[i].fext)&write_files)==0)
+          && (stat(job->fname,&attrib)==0);
+      job->pack=((mapfile_change_flag(files[i].fext)&lvl->optns.packed_files)!=0);
+      job->pack_level=lvl->optns.pack_level;
+      job->result=ERR_NONE;
+  }
+  if (result==ERR_NONE)
+  {
+      /* Writing new files under temporary names */
+      task.lvl=lvl;
+      task.jobs=jobs;
+      task.jobs_count=files_count;
+      task.next_job=0;
+      threads_count=0;
+      if (lb_threads_available())
+      {
+          while (threads_count<MAPFILE_SAVE_THREADS-1)
+          {
+              threads[threads_count]=lb_thread_start(save_mapfiles_thread,&task);
+              if (threads[threads_count]==NULL)
+                  break;
+              threads_count++;
+          }
+      }
+      save_mapfiles_jobs(&task);
+      for (i=0; i<threads_count; i++)
+          lb_thread_join(&threads[i]);
+      /* Reporting the results in order of the files */
+      for (i=0; i<files_count; i++)
+      {
+          struct MAPFILE_SAVE_JOB *job=&jobs[i];
+          if (job->result<ERR_NONE)
+          {
+              message_error("Error: %s when saving \"%s\"",levfile_error(job->result), job->fname);
+              result=job->result;
+          } else
+          if (job->result>ERR_NONE)
+          {
+              char *ifname;
+              ifname=prepare_short_fname(job->fname,24);
+              message_info_force("Warning: %s when saving \"%s\"",levfile_error(job->result), ifname);
+              free(ifname);
+              if (result>=ERR_NONE)
+                  result=job->result;
+          }
+      }
+  }
+  if (result>=ERR_NONE)
+  {
+      /* All written - replacing the previous files */
+      short rpl_result=replace_mapfiles_all(jobs,files_count,saved_files);
+      if (rpl_result!=ERR_NONE)
+          result=rpl_result;
+  } else
+  {
+      /* Previous files are left untouched; remove what was written */
+      for (i=0; i<files_count; i++)
+      {
+          struct MAPFILE_SAVE_JOB *job=&jobs[i];
+          if ((job->new_fname!=NULL)&&(!job->skipped))
+              remove(job->new_fname);
+      }
+  }
+  for (i=0; i<files_count; i++)
+  {
+      free(jobs[i].fname);
+      free(jobs[i].new_fname);
+      free(jobs[i].bak_fname);
+  }
+  free(jobs);
+  return result;
+}
+
+/**
+ * Returns map files which should be written when saving the level.
+ * Saving under the name the level was loaded from rewrites only
+ * the changed files; saving under new name rewrites all of them.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns LEVEL_CHANGE_FLAGS bits of the files to write.
+ */
+static unsigned long save_map_write_files(struct LEVEL *lvl)
+{
+    if (strcmp(lvl->fname,lvl->savfname)!=0)
+      return LCF_ALL;
+    /* ADI script stores save date and level version, so is always written */
+    return get_lvl_changed(lvl)|LCF_ADI;
+}
+
 /**
  * Saves the whole map. Includes all files editable in ADiKtEd.
- * On failure, tries to save at least some of the files.
+ * The files are replaced only if all of them were written properly;
+ * on failure, the previous files are left untouched.
  * Does not perform an update before saving - to do this, use
  * user_save_map() instead.
  * @see user_save_map
@@ -1627,41 +2028,13 @@ short save_dk1_map(struct LEVEL *lvl)
 {
     message_log(" save_dk1_map: started");
 
-    short result=ERR_NONE;
+    short result;
     int saved_files=0;
-    int total_files=0;
-    save_mapfile(lvl,lvl->savfname,"slb",write_slb,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"own",write_own,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"dat",write_dat,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"clm",write_clm,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"tng",write_tng,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"apt",write_apt,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"wib",write_wib,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"inf",write_inf,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"txt",write_txt,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"lgt",write_lgt,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"wlb",write_wlb,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"flg",write_flg,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"lif",write_lif,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"vsn",write_vsn,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"adi",write_adi_script,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"slx",write_slx,&saved_files,&result);
-    total_files++;
+    int total_files=sizeof(dk1_map_files)/sizeof(dk1_map_files[0]);
+    unsigned long write_files=save_map_write_files(lvl);
+    result=save_mapfiles_all(lvl,lvl->savfname,dk1_map_files,total_files,write_files,&saved_files);
+    if (result==ERR_NONE)
+      clear_lvl_changed(lvl,LCF_ALL);
 
     if ((result==ERR_NONE)||(strlen(lvl->fname)<1))
     {
@@ -1669,7 +2042,7 @@ short save_dk1_map(struct LEVEL *lvl)
       lvl->fname[DISKPATH_SIZE-1]=0;
     }
     lvl->stats.saves_count++;
-    message_log(" save_dk1_map: properly saved %d out of %d map files",saved_files,total_files);
+    message_log(" save_dk1_map: properly saved %d changed files out of %d map files",saved_files,total_files);
     return result;
 }
 
@@ -1683,7 +2056,8 @@ short save_nfo_file(struct LEVEL *lvl)
 
 /**
  * Saves the whole DK Extended map. Includes all files editable in ADiKtEd.
- * On failure, tries to save at least some of the files.
+ * The files are replaced only if all of them were written properly;
+ * on failure, the previous files are left untouched.
  * DK Extended map files won't load in standard Dungeon Keeper on DD.
  * Does not perform an update before saving - to do this, use
  * user_save_map() instead.
@@ -1696,44 +2070,13 @@ short save_dke_map(struct LEVEL *lvl)
 {
     message_log(" save_dke_map: started");
 
-    short result=ERR_NONE;
+    short result;
     int saved_files=0;
-    int total_files=0;
-
-    save_mapfile(lvl,lvl->savfname,"slb",write_slb,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"own",write_own,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"dat",write_dat,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"clm",write_clm,&saved_files,&result);
-    total_files++;
-    //TODO replace with tngfx
-    save_mapfile(lvl,lvl->savfname,"tng",write_tng,&saved_files,&result);
-    total_files++;
-    //TODO replace with aptfx
-    save_mapfile(lvl,lvl->savfname,"apt",write_apt,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"wib",write_wib,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"inf",write_inf,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"txt",write_txt,&saved_files,&result);
-    total_files++;
-    //TODO replace with lgtfx
-    save_mapfile(lvl,lvl->savfname,"lgt",write_lgt,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"wlb",write_wlb,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"flg",write_flg,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"lof",write_lof,&saved_files,&result);
-    total_files++;
-
-    save_mapfile(lvl,lvl->savfname,"adi",write_adi_script,&saved_files,&result);
-    total_files++;
-    save_mapfile(lvl,lvl->savfname,"slx",write_slx,&saved_files,&result);
-    total_files++;
+    int total_files=sizeof(dke_map_files)/sizeof(dke_map_files[0]);
+    unsigned long write_files=save_map_write_files(lvl);
+    result=save_mapfiles_all(lvl,lvl->savfname,dke_map_files,total_files,write_files,&saved_files);
+    if (result==ERR_NONE)
+      clear_lvl_changed(lvl,LCF_ALL);
 
     if ((result==ERR_NONE)||(strlen(lvl->fname)<1))
     {
@@ -1741,7 +2084,7 @@ short save_dke_map(struct LEVEL *lvl)
       lvl->fname[DISKPATH_SIZE-1]=0;
     }
     lvl->stats.saves_count++;
-    message_log(" save_dke_map: properly saved %d out of %d map files",saved_files,total_files);
+    message_log(" save_dke_map: properly saved %d changed files out of %d map files",saved_files,total_files);
     return result;
 }
 
@@ -1814,14 +2157,14 @@ short load_mapfile(struct LEVEL *lvl,char *fext,mapfile_io_func load_file,
 {
   short file_result;
   char *fname;
-  message_log("load_mapfile: loading %s file",fext);
+  message_log_lvl(MSGLOG_TRACE,"load_mapfile: loading %s file",fext);
   fname = (char *)malloc(strlen(lvl->fname)+strlen(fext)+3);
   if (fname==NULL)
   {
       file_result=ERR_CANT_MALLOC;
       if (flags&LFF_IGNORE_INTERNAL)
       {
-          message_log("load_mapfile: Out of memory");
+          message_log_lvl(MSGLOG_ERROR,"load_mapfile: Out of memory");
       } else
       {
           message_error("load_mapfile: Out of memory");
@@ -1834,6 +2177,8 @@ short load_mapfile(struct LEVEL *lvl,char *fext,mapfile_io_func load_file,
   /*message_log("load_mapfile: Load function execution finished"); */
   if (file_result==ERR_NONE)
   {
+      /* Level part is now identical to the file */
+      clear_lvl_changed(lvl,mapfile_change_flag(fext));
       (*loaded_files)++;
   } else
   if (file_result<ERR_NONE)
@@ -1886,7 +2231,7 @@ short load_mapfile_msg(struct LEVEL *lvl,char *fext,mapfile_iomsg_func load_file
   short file_result;
   char *fname;
   char *err_msg;
-  message_log("load_mapfile_msg: loading %s file",fext);
+  message_log_lvl(MSGLOG_TRACE,"load_mapfile_msg: loading %s file",fext);
   fname = (char *)malloc(strlen(lvl->fname)+strlen(fext)+3);
   err_msg=(char *)malloc(LINEMSG_SIZE);
   if ((fname==NULL)||(err_msg==NULL))
@@ -1894,7 +2239,7 @@ short load_mapfile_msg(struct LEVEL *lvl,char *fext,mapfile_iomsg_func load_file
       file_result=ERR_CANT_MALLOC;
       if (flags&LFF_IGNORE_INTERNAL)
       {
-          message_log("load_mapfile_msg: Out of memory");
+          message_log_lvl(MSGLOG_ERROR,"load_mapfile_msg: Out of memory");
       } else
       {
           message_error("load_mapfile_msg: Out of memory");
@@ -1914,7 +2259,7 @@ short load_mapfile_msg(struct LEVEL *lvl,char *fext,mapfile_iomsg_func load_file
       if (flags&LFF_IGNORE_CANNOT_LOAD)
       {
           if (flags&LFF_DONT_EVEN_WARN)
-            message_log(" load_mapfile_msg: %s when reading \"%s\"",memfile_error(file_result), fname);
+            message_log_lvl(MSGLOG_ERROR," load_mapfile_msg: %s when reading \"%s\"",memfile_error(file_result), fname);
           else
             message_info_force("Warning: %s when reading \"%s\"",memfile_error(file_result), fname);
       } else
@@ -2221,7 +2566,7 @@ short write_def_clm_source(struct LEVEL *lvl,char *fname)
     unsigned char *clmentry;
     struct COLUMN_REC *clm_rec;
     clm_rec=create_column_rec();
-    for (i=0; i<COLUMN_ENTRIES; i++)
+    for (i=0; i<lvl->clm_entries; i++)
       {
         clmentry = (unsigned char *)(lvl->clm[i]);
         get_clm_entry(clm_rec, clmentry);
@@ -0,0 +1,329 @@
+/******************************************************************************/
+/** @file lev_reach.c
+ * Reachability analysis for keepers.
+ * @par Purpose:
+ *     Finds the tiles which diggers of a keeper can reach from the dungeon
+ *     heart, and counts wealth, portals, special boxes and enemy contact
+ *     points on them. Allows checking map balance without the game.
+ * @par Comment:
+ *     The map is kept as rows of 64-bit words, one bit per tile. The search
+ *     fills whole words at once - along rows with shift-and-mask steps,
+ *     and between rows with bitwise or - sweeping down and up the map
+ *     until nothing changes.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include "lev_reach.h"
+
+#include <string.h>
+#include "globals.h"
+#include "lev_data.h"
+#include "obj_slabs.h"
+#include "obj_things.h"
+#include "msg_log.h"
+
+#define REACH_WORD_BITS 64
+
+enum REACH_TILE_CLASS {
+    RTC_BLOCK = 0,  /* Can't be entered */
+    RTC_PASS,       /* Can be entered and passed through */
+    RTC_STOP,       /* Can be reached, but not passed through */
+};
+
+/**
+ * Classifies a tile for diggers of given keeper. Everything but rock and
+ * lava can be dug or walked through, except that gems are never removed,
+ * and tiles claimed by other players stop the diggers. Walls are not
+ * dug by own diggers.
+ */
+static int reach_tile_class(const struct LEVEL *lvl,unsigned int tx,unsigned int ty,
+    unsigned char plyr_idx)
+{
+    unsigned short slab=get_tile_slab(lvl,tx,ty);
+    if ((slab==SLAB_TYPE_ROCK)||(slab==SLAB_TYPE_LAVA))
+      return RTC_BLOCK;
+    unsigned char own=get_tile_owner(lvl,tx,ty);
+    if ((own<PLAYER_UNSET)&&(own!=plyr_idx)&&slab_is_clmabl(slab))
+      return RTC_STOP;
+    if (slab==SLAB_TYPE_GEMS)
+      return RTC_STOP;
+    if (slab_is_wall(slab))
+      return RTC_BLOCK;
+    return RTC_PASS;
+}
+
+/**
+ * Fills the set bits of g towards higher bits, through bits set in p.
+ */
+static unsigned long long reach_fill_up(unsigned long long g,unsigned long long p)
+{
+    g |= p & (g << 1);  p &= (p << 1);
+    g |= p & (g << 2);  p &= (p << 2);
+    g |= p & (g << 4);  p &= (p << 4);
+    g |= p & (g << 8);  p &= (p << 8);
+    g |= p & (g << 16); p &= (p << 16);
+    g |= p & (g << 32);
+    return g;
+}
+
+/**
+ * Fills the set bits of g towards lower bits, through bits set in p.
+ */
+static unsigned long long reach_fill_down(unsigned long long g,unsigned long long p)
+{
+    g |= p & (g >> 1);  p &= (p >> 1);
+    g |= p & (g >> 2);  p &= (p >> 2);
+    g |= p & (g >> 4);  p &= (p >> 4);
+    g |= p & (g >> 8);  p &= (p >> 8);
+    g |= p & (g >> 16); p &= (p >> 16);
+    g |= p & (g >> 32);
+    return g;
+}
+
+/**
+ * Spreads reachable tiles along one row. Passable tiles are filled
+ * in both directions, and the tiles next to them which can be
+ * reached but not passed are added at end.
+ */
+static void reach_fill_row(unsigned long long *row,const unsigned long long *pass,
+    const unsigned long long *allow,unsigned int row_words)
+{
+    unsigned long long carry;
+    unsigned long long g;
+    unsigned int w;
+    carry=0;
+    for (w=0;w<row_words;w++)
+    {
+      g=(row[w]|carry)&pass[w];
+      g=reach_fill_up(g,pass[w]);
+      row[w]|=g;
+      carry=g>>(REACH_WORD_BITS-1);
+    }
+    carry=0;
+    for (w=row_words;w>0;w--)
+    {
+      g=(row[w-1]|carry)&pass[w-1];
+      g=reach_fill_down(g,pass[w-1]);
+      row[w-1]|=g;
+      carry=g<<(REACH_WORD_BITS-1);
+    }
+    for (w=0;w<row_words;w++)
+    {
+      unsigned long long src=row[w]&pass[w];
+      unsigned long long nbr=(src<<1)|(src>>1);
+      if (w>0)
+        nbr|=(row[w-1]&pass[w-1])>>(REACH_WORD_BITS-1);
+      if (w+1<row_words)
+        nbr|=(row[w+1]&pass[w+1])<<(REACH_WORD_BITS-1);
+      row[w]|=nbr&allow[w];
+    }
+}
+
+/**
+ * Adds tiles reached from neighbour rows to given row, and fills it.
+ * @return Returns true if the row has changed.
+ */
+static short reach_update_row(struct KEEPER_REACH *reach,const unsigned long long *pass,
+    const unsigned long long *allow,unsigned int ty)
+{
+    const unsigned int row_words=reach->row_words;
+    unsigned long long *row=reach->tiles+ty*row_words;
+    const unsigned long long *row_pass=pass+ty*row_words;
+    const unsigned long long *row_allow=allow+ty*row_words;
+    short seeded=false;
+    unsigned int w;
+    for (w=0;w<row_words;w++)
+    {
+      unsigned long long nbr=0;
+      if (ty>0)
+        nbr|=(row-row_words)[w]&(row_pass-row_words)[w];
+      if (ty+1<reach->size.y)
+        nbr|=(row+row_words)[w]&(row_pass+row_words)[w];
+      nbr&=row_allow[w]&(~row[w]);
+      if (nbr!=0)
+      {
+        row[w]|=nbr;
+        seeded=true;
+      }
+    }
+    if (!seeded)
+      return false;
+    reach_fill_row(row,row_pass,row_allow,row_words);
+    return true;
+}
+
+/**
+ * Counts the reachable slabs, things and contact points.
+ */
+static void reach_count_objects(struct KEEPER_REACH *reach,const struct LEVEL *lvl)
+{
+    unsigned int tx,ty,i,k;
+    for (ty=0;ty<reach->size.y;ty++)
+      for (tx=0;tx<reach->size.x;tx++)
+      {
+        if (!keeper_reach_tile(reach,tx,ty))
+          continue;
+        reach->tiles_count++;
+        unsigned short slab=get_tile_slab(lvl,tx,ty);
+        unsigned char own=get_tile_owner(lvl,tx,ty);
+        if ((own<PLAYER_UNSET)&&(own!=reach->owner)&&slab_is_clmabl(slab))
+        {
+          if (reach->contact_tiles[own]==0)
+          {
+            reach->contact_pos[own].x=tx;
+            reach->contact_pos[own].y=ty;
+          }
+          reach->contact_tiles[own]++;
+        } else
+        if (slab==SLAB_TYPE_PORTAL)
+          reach->portal_slabs++;
+        if (slab==SLAB_TYPE_GOLD)
+          reach->gold_slabs++;
+        if (slab==SLAB_TYPE_GEMS)
+          reach->gem_slabs++;
+        for (i=0;i<MAP_SUBNUM_X*MAP_SUBNUM_Y;i++)
+        {
+          unsigned int sx=tx*MAP_SUBNUM_X+i%MAP_SUBNUM_X;
+          unsigned int sy=ty*MAP_SUBNUM_Y+i/MAP_SUBNUM_X;
+          unsigned int things_count=get_thing_subnums(lvl,sx,sy);
+          for (k=0;k<things_count;k++)
+          {
+            unsigned char *thing=(unsigned char *)get_thing(lvl,sx,sy,k);
+            if (is_gold(thing))
+              reach->gold_things++;
+            else
+            if (is_dngspecbox(thing))
+              reach->special_boxes++;
+          }
+        }
+      }
+}
+
+/**
+ * Finds tiles which diggers of given keeper can reach from the keeper's
+ * dungeon hearts, and counts objects on them.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param plyr_idx The keeper index.
+ * @return Returns new KEEPER_REACH structure, or NULL on error. If the keeper
+ *     has no heart, no tiles are reachable. The structure must be freed
+ *     with keeper_reach_free().
+ */
+struct KEEPER_REACH *keeper_reach_create(const struct LEVEL *lvl,unsigned char plyr_idx)
+{
+    struct KEEPER_REACH *reach;
+    reach=(struct KEEPER_REACH *)malloc(sizeof(struct KEEPER_REACH));
+    if (reach==NULL)
+    {
+      message_error("keeper_reach_create: Cannot alloc memory");
+      return NULL;
+    }
+    memset(reach,0,sizeof(struct KEEPER_REACH));
+    reach->owner=plyr_idx;
+    reach->size.x=lvl->tlsize.x;
+    reach->size.y=lvl->tlsize.y;
+    reach->row_words=(reach->size.x+REACH_WORD_BITS-1)/REACH_WORD_BITS;
+    const unsigned int num_words=reach->row_words*reach->size.y;
+    unsigned int i;
+    for (i=0;i<PLAYERS_COUNT;i++)
+    {
+      reach->contact_pos[i].x=-1;
+      reach->contact_pos[i].y=-1;
+    }
+    reach->tiles=(unsigned long long *)malloc(num_words*sizeof(unsigned long long));
+    unsigned long long *pass=(unsigned long long *)malloc(num_words*sizeof(unsigned long long));
+    unsigned long long *allow=(unsigned long long *)malloc(num_words*sizeof(unsigned long long));
+    if ((reach->tiles==NULL)||(pass==NULL)||(allow==NULL))
+    {
+      message_error("keeper_reach_create: Cannot alloc tile sets");
+      free(pass);
+      free(allow);
+      keeper_reach_free(&reach);
+      return NULL;
+    }
+    memset(reach->tiles,0,num_words*sizeof(unsigned long long));
+    memset(pass,0,num_words*sizeof(unsigned long long));
+    memset(allow,0,num_words*sizeof(unsigned long long));
+    unsigned int tx,ty;
+    for (ty=0;ty<reach->size.y;ty++)
+      for (tx=0;tx<reach->size.x;tx++)
+      {
+        int tclass=reach_tile_class(lvl,tx,ty,plyr_idx);
+        if (tclass==RTC_BLOCK)
+          continue;
+        unsigned long long bit=1ULL<<(tx%REACH_WORD_BITS);
+        unsigned int w=ty*reach->row_words+tx/REACH_WORD_BITS;
+        allow[w]|=bit;
+        if (tclass==RTC_PASS)
+          pass[w]|=bit;
+      }
+    /* Starting from tiles with the keeper's hearts */
+    const unsigned int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
+    const unsigned int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
+    unsigned int sx,sy,k;
+    for (sy=0;sy<arr_entries_y;sy++)
+      for (sx=0;sx<arr_entries_x;sx++)
+      {
+        unsigned int things_count=get_thing_subnums(lvl,sx,sy);
+        for (k=0;k<things_count;k++)
+        {
+          unsigned char *thing=(unsigned char *)get_thing(lvl,sx,sy,k);
+          if ((!is_dnheart(thing))||(get_thing_owner(thing)!=plyr_idx))
+            continue;
+          reach->hearts++;
+          tx=sx/MAP_SUBNUM_X;
+          ty=sy/MAP_SUBNUM_Y;
+          unsigned int w=ty*reach->row_words+tx/REACH_WORD_BITS;
+          reach->tiles[w]|=(1ULL<<(tx%REACH_WORD_BITS))&allow[w];
+        }
+      }
+    for (ty=0;ty<reach->size.y;ty++)
+      reach_fill_row(reach->tiles+ty*reach->row_words,pass+ty*reach->row_words,
+          allow+ty*reach->row_words,reach->row_words);
+    /* Sweeping down and up, until no row changes */
+    short changed=(reach->hearts>0);
+    while (changed)
+    {
+      changed=false;
+      for (ty=0;ty<reach->size.y;ty++)
+        changed|=reach_update_row(reach,pass,allow,ty);
+      for (ty=reach->size.y;ty>0;ty--)
+        changed|=reach_update_row(reach,pass,allow,ty-1);
+    }
+    free(pass);
+    free(allow);
+    reach_count_objects(reach,lvl);
+    return reach;
+}
+
+/**
+ * Frees the reachability structure, and sets the pointer to NULL.
+ * @param reach_ptr Double pointer to the reachability structure.
+ */
+void keeper_reach_free(struct KEEPER_REACH **reach_ptr)
+{
+    if ((reach_ptr==NULL)||((*reach_ptr)==NULL))
+      return;
+    free((*reach_ptr)->tiles);
+    free(*reach_ptr);
+    (*reach_ptr)=NULL;
+}
+
+/**
+ * Returns if given tile is reachable.
+ * @param reach Pointer to the reachability structure.
+ * @param tx,ty Map tile coordinates.
+ * @return Returns true if the tile is reachable, false otherwise.
+ */
+short keeper_reach_tile(const struct KEEPER_REACH *reach,unsigned int tx,unsigned int ty)
+{
+    if ((tx>=reach->size.x)||(ty>=reach->size.y))
+      return false;
+    unsigned long long word=reach->tiles[ty*reach->row_words+tx/REACH_WORD_BITS];
+    return ((word>>(tx%REACH_WORD_BITS))&1)!=0;
+}
@@ -0,0 +1,57 @@
+/******************************************************************************/
+/** @file lev_reach.h
+ * Reachability analysis for keepers.
+ * @par Purpose:
+ *     Header file. Defines exported routines from lev_reach.c
+ * @par Comment:
+ *     None.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#ifndef ADIKT_LEVREACH_H
+#define ADIKT_LEVREACH_H
+
+#include "globals.h"
+#include "obj_slabs.h"
+
+struct LEVEL;
+
+/**
+ * Tiles which diggers of one keeper can reach from the dungeon heart,
+ * and the things found on them.
+ */
+struct KEEPER_REACH {
+    /* The keeper, and number of its dungeon heart things */
+    unsigned char owner;
+    unsigned int hearts;
+    /* Size of the map, in tiles, and number of 64-bit words in a row */
+    struct UPOINT_2D size;
+    unsigned int row_words;
+    /* Reachable tiles, one bit per tile; bit tx%64 of word */
+    /* ty*row_words+tx/64 is set if tile tx,ty is reachable */
+    unsigned long long *tiles;
+    /* Number of reachable tiles */
+    unsigned int tiles_count;
+    /* Reachable gold and gem slabs, and unowned or own portal slabs */
+    unsigned int gold_slabs;
+    unsigned int gem_slabs;
+    unsigned int portal_slabs;
+    /* Gold things and dungeon special boxes on reachable tiles */
+    unsigned int gold_things;
+    unsigned int special_boxes;
+    /* Reachable tiles owned by every other player, and the first of them */
+    unsigned int contact_tiles[PLAYERS_COUNT];
+    struct IPOINT_2D contact_pos[PLAYERS_COUNT];
+  };
+
+DLLIMPORT struct KEEPER_REACH *keeper_reach_create(const struct LEVEL *lvl,unsigned char plyr_idx);
+DLLIMPORT void keeper_reach_free(struct KEEPER_REACH **reach_ptr);
+DLLIMPORT short keeper_reach_tile(const struct KEEPER_REACH *reach,unsigned int tx,unsigned int ty);
+
+#endif /* ADIKT_LEVREACH_H */
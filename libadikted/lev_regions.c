@@ -0,0 +1,513 @@
+/******************************************************************************/
+/** @file lev_regions.c
+ * Connected regions of level tiles.
+ * @par Purpose:
+ *     Divides map into regions of connected passable tiles, and finds
+ *     shortest corridors between them. Used to link closed caves
+ *     in generated maps, and to find unreachable objects on verification.
+ * @par Comment:
+ *     Regions are labeled in one pass with union-find, and corridors are
+ *     found with breadth-first search started from all tiles of a region;
+ *     both are linear in the number of tiles.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include "lev_regions.h"
+
+#include <string.h>
+#include "globals.h"
+#include "lev_data.h"
+#include "obj_slabs.h"
+#include "obj_things.h"
+#include "msg_log.h"
+
+/**
+ * Returns true if diggers can get through the tile, by digging or walking.
+ * Only impenetrable rock and gems can't be removed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param tx,ty Map tile coordinates.
+ * @param data Unused.
+ * @return Returns true if the tile is passable, false otherwise.
+ */
+short region_passable_dig(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,__attribute__((unused)) void *data)
+{
+    unsigned short slab=get_tile_slab(lvl,tx,ty);
+    return (slab!=SLAB_TYPE_ROCK)&&(slab!=SLAB_TYPE_GEMS);
+}
+
+/**
+ * Returns true if creatures can walk through the tile without digging.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param tx,ty Map tile coordinates.
+ * @param data Unused.
+ * @return Returns true if the tile is passable, false otherwise.
+ */
+short region_passable_walk(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,__attribute__((unused)) void *data)
+{
+    unsigned short slab=get_tile_slab(lvl,tx,ty);
+    return (!slab_is_tall(slab))&&(slab!=SLAB_TYPE_LAVA);
+}
+
+/**
+ * Returns true for every tile except the ones at map border.
+ * Used when searching for corridors which can be dug through anything.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param tx,ty Map tile coordinates.
+ * @param data Unused.
+ * @return Returns true if the tile is not at map border.
+ */
+short region_passable_inner(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,__attribute__((unused)) void *data)
+{
+    return (tx>0)&&(ty>0)&&(tx+1<lvl->tlsize.x)&&(ty+1<lvl->tlsize.y);
+}
+
+/**
+ * Finds root of a union-find set, halving the path on the way.
+ */
+static unsigned int regions_find_root(unsigned int *parent,unsigned int i)
+{
+    while (parent[i]!=i)
+    {
+      parent[i]=parent[parent[i]];
+      i=parent[i];
+    }
+    return i;
+}
+
+/**
+ * Joins two union-find sets. The smaller index always becomes the root,
+ * so roots are the first tiles of their regions in row order.
+ */
+static void regions_join(unsigned int *parent,unsigned int a,unsigned int b)
+{
+    a=regions_find_root(parent,a);
+    b=regions_find_root(parent,b);
+    if (a<b)
+      parent[b]=a;
+    else
+    if (b<a)
+      parent[a]=b;
+}
+
+/**
+ * Divides the map into regions of connected passable tiles.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param passable Function which decides whether a tile is passable.
+ * @param data Parameter passed to the passable function.
+ * @return Returns new LEVEL_REGIONS structure, or NULL on error.
+ *     The structure must be freed with level_regions_free().
+ */
+struct LEVEL_REGIONS *level_regions_create(const struct LEVEL *lvl,
+    region_passable_func passable,void *data)
+{
+    struct LEVEL_REGIONS *rgns;
+    rgns=(struct LEVEL_REGIONS *)malloc(sizeof(struct LEVEL_REGIONS));
+    if (rgns==NULL)
+    {
+      message_error("level_regions_create: Cannot alloc memory");
+      return NULL;
+    }
+    const unsigned int size_x=lvl->tlsize.x;
+    const unsigned int size_y=lvl->tlsize.y;
+    const unsigned int num_tiles=size_x*size_y;
+    rgns->size.x=size_x;
+    rgns->size.y=size_y;
+    rgns->count=0;
+    rgns->tiles=NULL;
+    rgns->label=(unsigned int *)malloc(num_tiles*sizeof(unsigned int));
+    unsigned int *parent=(unsigned int *)malloc(num_tiles*sizeof(unsigned int));
+    if ((rgns->label==NULL)||(parent==NULL))
+    {
+      message_error("level_regions_create: Cannot alloc labels");
+      free(parent);
+      level_regions_free(&rgns);
+      return NULL;
+    }
+    /* Joining every passable tile with passable tiles on its left and top */
+    unsigned int tx,ty,i;
+    for (ty=0;ty<size_y;ty++)
+      for (tx=0;tx<size_x;tx++)
+      {
+        i=ty*size_x+tx;
+        if (!passable(lvl,tx,ty,data))
+        {
+          parent[i]=REGION_NONE;
+          continue;
+        }
+        parent[i]=i;
+        if ((tx>0)&&(parent[i-1]!=REGION_NONE))
+          regions_join(parent,i,i-1);
+        if ((ty>0)&&(parent[i-size_x]!=REGION_NONE))
+          regions_join(parent,i,i-size_x);
+      }
+    /* Numbering the sets; roots come before other tiles of their sets */
+    for (i=0;i<num_tiles;i++)
+    {
+        if (parent[i]==REGION_NONE)
+        {
+          rgns->label[i]=REGION_NONE;
+          continue;
+        }
+        unsigned int root=regions_find_root(parent,i);
+        if (root==i)
+          rgns->label[i]=rgns->count++;
+        else
+          rgns->label[i]=rgns->label[root];
+    }
+    free(parent);
+    rgns->tiles=(unsigned int *)malloc((rgns->count+1)*sizeof(unsigned int));
+    if (rgns->tiles==NULL)
+    {
+      message_error("level_regions_create: Cannot alloc region sizes");
+      level_regions_free(&rgns);
+      return NULL;
+    }
+    memset(rgns->tiles,0,(rgns->count+1)*sizeof(unsigned int));
+    for (i=0;i<num_tiles;i++)
+      if (rgns->label[i]!=REGION_NONE)
+        rgns->tiles[rgns->label[i]]++;
+    return rgns;
+}
+
+/**
+ * Frees the regions structure, and sets the pointer to NULL.
+ * @param rgns_ptr Double pointer to the regions structure.
+ */
+void level_regions_free(struct LEVEL_REGIONS **rgns_ptr)
+{
+    if ((rgns_ptr==NULL)||((*rgns_ptr)==NULL))
+      return;
+    free((*rgns_ptr)->label);
+    free((*rgns_ptr)->tiles);
+    free(*rgns_ptr);
+    (*rgns_ptr)=NULL;
+}
+
+/**
+ * Returns region of given tile.
+ * @param rgns Pointer to the regions structure.
+ * @param tx,ty Map tile coordinates.
+ * @return Returns region index, or REGION_NONE if the tile is impassable
+ *     or outside of the map.
+ */
+unsigned int level_regions_get(const struct LEVEL_REGIONS *rgns,
+    unsigned int tx,unsigned int ty)
+{
+    if ((tx>=rgns->size.x)||(ty>=rgns->size.y))
+      return REGION_NONE;
+    return rgns->label[ty*rgns->size.x+tx];
+}
+
+/**
+ * Returns the region which has most tiles.
+ * @param rgns Pointer to the regions structure.
+ * @return Returns region index, or REGION_NONE if there are no regions.
+ */
+unsigned int level_regions_largest(const struct LEVEL_REGIONS *rgns)
+{
+    unsigned int best=REGION_NONE;
+    unsigned int i;
+    for (i=0;i<rgns->count;i++)
+    {
+      if ((best==REGION_NONE)||(rgns->tiles[i]>rgns->tiles[best]))
+        best=i;
+    }
+    return best;
+}
+
+/**
+ * Finds shortest paths from a region to all tiles of the map.
+ * Tiles of any region can always be walked through; other tiles only
+ * if the crossable function accepts them.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param rgns Regions of the level.
+ * @param src_region The region to start from.
+ * @param crossable Function which decides whether impassable tile can be
+ *     crossed by the corridor; if NULL, only region tiles are used.
+ * @param data Parameter passed to the crossable function.
+ * @return Returns new REGION_PATHS structure, or NULL on error.
+ *     The structure must be freed with region_paths_free().
+ */
+struct REGION_PATHS *region_paths_create(const struct LEVEL *lvl,
+    const struct LEVEL_REGIONS *rgns,unsigned int src_region,
+    region_passable_func crossable,void *data)
+{
+    struct REGION_PATHS *paths;
+    paths=(struct REGION_PATHS *)malloc(sizeof(struct REGION_PATHS));
+    if (paths==NULL)
+    {
+      message_error("region_paths_create: Cannot alloc memory");
+      return NULL;
+    }
+    const unsigned int size_x=rgns->size.x;
+    const unsigned int size_y=rgns->size.y;
+    const unsigned int num_tiles=size_x*size_y;
+    paths->size.x=size_x;
+    paths->size.y=size_y;
+    paths->src_region=src_region;
+    paths->dist=(unsigned int *)malloc(num_tiles*sizeof(unsigned int));
+    paths->from=(unsigned int *)malloc(num_tiles*sizeof(unsigned int));
+    paths->nearest=(unsigned int *)malloc((rgns->count+1)*sizeof(unsigned int));
+    /* Queue of tiles to visit; every tile enters it only once */
+    unsigned int *queue=(unsigned int *)malloc(num_tiles*sizeof(unsigned int));
+    if ((paths->dist==NULL)||(paths->from==NULL)||(paths->nearest==NULL)||(queue==NULL))
+    {
+      message_error("region_paths_create: Cannot alloc path arrays");
+      free(queue);
+      region_paths_free(&paths);
+      return NULL;
+    }
+    memset(paths->dist,0xff,num_tiles*sizeof(unsigned int));
+    memset(paths->from,0xff,num_tiles*sizeof(unsigned int));
+    memset(paths->nearest,0xff,(rgns->count+1)*sizeof(unsigned int));
+    unsigned int q_first=0;
+    unsigned int q_last=0;
+    unsigned int i;
+    for (i=0;i<num_tiles;i++)
+      if (rgns->label[i]==src_region)
+      {
+        paths->dist[i]=0;
+        queue[q_last++]=i;
+      }
+    if (src_region<rgns->count)
+      paths->nearest[src_region]=(q_last>0)?queue[0]:REGION_NONE;
+    while (q_first<q_last)
+    {
+      i=queue[q_first++];
+      unsigned int tx=i%size_x;
+      unsigned int ty=i/size_x;
+      unsigned int k;
+      for (k=0;k<4;k++)
+      {
+        unsigned int nx=tx;
+        unsigned int ny=ty;
+        switch (k)
+        {
+        case 0: if (tx==0) continue; nx--; break;
+        case 1: if (tx+1>=size_x) continue; nx++; break;
+        case 2: if (ty==0) continue; ny--; break;
+        default: if (ty+1>=size_y) continue; ny++; break;
+        }
+        unsigned int n=ny*size_x+nx;
+        if (paths->dist[n]!=REGION_NONE)
+          continue;
+        unsigned int rgn=rgns->label[n];
+        if (rgn==REGION_NONE)
+        {
+          if ((crossable==NULL)||(!crossable(lvl,nx,ny,data)))
+            continue;
+        } else
+        if (paths->nearest[rgn]==REGION_NONE)
+        {
+          /* Tiles are visited by distance, so the first one is nearest */
+          paths->nearest[rgn]=n;
+        }
+        paths->dist[n]=paths->dist[i]+1;
+        paths->from[n]=i;
+        queue[q_last++]=n;
+      }
+    }
+    free(queue);
+    return paths;
+}
+
+/**
+ * Frees the paths structure, and sets the pointer to NULL.
+ * @param paths_ptr Double pointer to the paths structure.
+ */
+void region_paths_free(struct REGION_PATHS **paths_ptr)
+{
+    if ((paths_ptr==NULL)||((*paths_ptr)==NULL))
+      return;
+    free((*paths_ptr)->dist);
+    free((*paths_ptr)->from);
+    free((*paths_ptr)->nearest);
+    free(*paths_ptr);
+    (*paths_ptr)=NULL;
+}
+
+/**
+ * Returns the shortest corridor from source region of the paths
+ * to given region. The corridor consists of tiles which don't belong
+ * to any region, and have to be made passable to link the regions.
+ * @param paths Paths from the source region.
+ * @param rgns Regions of the level.
+ * @param dst_region The region to link with source.
+ * @param tiles Array for the corridor tiles, or NULL.
+ * @param tiles_max Size of the tiles array.
+ * @return Returns number of tiles in the corridor, or REGION_NONE if there
+ *     is no path. Only up to tiles_max tiles are stored in the array.
+ */
+unsigned int region_paths_corridor(const struct REGION_PATHS *paths,
+    const struct LEVEL_REGIONS *rgns,unsigned int dst_region,
+    struct IPOINT_2D *tiles,unsigned int tiles_max)
+{
+    if ((dst_region>=rgns->count)||(paths->nearest[dst_region]==REGION_NONE))
+      return REGION_NONE;
+    unsigned int num=0;
+    unsigned int i=paths->nearest[dst_region];
+    while (i!=REGION_NONE)
+    {
+      if (rgns->label[i]==REGION_NONE)
+      {
+        if ((tiles!=NULL)&&(num<tiles_max))
+        {
+          tiles[num].x=i%paths->size.x;
+          tiles[num].y=i/paths->size.x;
+        }
+        num++;
+      }
+      i=paths->from[i];
+    }
+    return num;
+}
+
+/**
+ * Links all regions with the largest one, by changing the shortest
+ * corridors between them into given slab. Corridors are never made
+ * at map border.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param passable Function which decides whether a tile is passable.
+ * @param data Parameter passed to the passable function.
+ * @param corridor_slab Slab type to be placed in corridors.
+ * @return Returns number of linked regions, or -1 on error.
+ */
+int level_regions_connect(struct LEVEL *lvl,
+    region_passable_func passable,void *data,unsigned short corridor_slab)
+{
+    struct LEVEL_REGIONS *rgns;
+    rgns=level_regions_create(lvl,passable,data);
+    if (rgns==NULL)
+      return -1;
+    if (rgns->count<2)
+    {
+      level_regions_free(&rgns);
+      return 0;
+    }
+    unsigned int main_rgn=level_regions_largest(rgns);
+    struct REGION_PATHS *paths;
+    paths=region_paths_create(lvl,rgns,main_rgn,region_passable_inner,NULL);
+    if (paths==NULL)
+    {
+      level_regions_free(&rgns);
+      return -1;
+    }
+    /* Corridors may overlap; the tiles are changed only after */
+    /* all of them are found, so the paths stay valid */
+    unsigned int i;
+    int linked=0;
+    for (i=0;i<rgns->count;i++)
+    {
+      if (i==main_rgn)
+        continue;
+      unsigned int k=paths->nearest[i];
+      if (k==REGION_NONE)
+        continue;
+      while ((k!=REGION_NONE)&&(paths->dist[k]>0))
+      {
+        if (rgns->label[k]==REGION_NONE)
+          set_tile_slab(lvl,k%rgns->size.x,k/rgns->size.x,corridor_slab);
+        k=paths->from[k];
+      }
+      linked++;
+    }
+    region_paths_free(&paths);
+    level_regions_free(&rgns);
+    return linked;
+}
+
+/**
+ * Verifies whether dungeon hearts, hero gates and portals can be reached
+ * from the human player's dungeon heart by digging.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param err_msg Error message buffer.
+ * @param errpt Error point - the unreachable tile.
+ * @return Returns VERIF_ERROR, VERIF_WARN or VERIF_OK.
+ */
+short level_verify_regions(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt)
+{
+    struct LEVEL_REGIONS *rgns;
+    rgns=level_regions_create(lvl,region_passable_dig,NULL);
+    if (rgns==NULL)
+    {
+        errpt->x=-1;errpt->y=-1;
+        sprintf(err_msg,"Cannot alloc memory for region verification.");
+        return VERIF_ERROR;
+    }
+    const unsigned int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
+    const unsigned int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
+    unsigned int sx,sy,k;
+    /* Finding region of the human player's heart */
+    unsigned int main_rgn=REGION_NONE;
+    for (sy=0; (sy<arr_entries_y)&&(main_rgn==REGION_NONE); sy++)
+      for (sx=0; (sx<arr_entries_x)&&(main_rgn==REGION_NONE); sx++)
+      {
+        unsigned int things_count=get_thing_subnums(lvl,sx,sy);
+        for (k=0; k<things_count; k++)
+        {
+          unsigned char *thing=(unsigned char *)get_thing(lvl,sx,sy,k);
+          if (is_dnheart(thing)&&(get_thing_owner(thing)==PLAYER0))
+          {
+            main_rgn=level_regions_get(rgns,sx/MAP_SUBNUM_X,sy/MAP_SUBNUM_Y);
+            break;
+          }
+        }
+      }
+    if (main_rgn==REGION_NONE)
+    {
+        level_regions_free(&rgns);
+        return VERIF_OK;
+    }
+    /* Checking other hearts and hero gates */
+    for (sy=0; sy<arr_entries_y; sy++)
+      for (sx=0; sx<arr_entries_x; sx++)
+      {
+        unsigned int things_count=get_thing_subnums(lvl,sx,sy);
+        for (k=0; k<things_count; k++)
+        {
+          unsigned char *thing=(unsigned char *)get_thing(lvl,sx,sy,k);
+          short heart=is_dnheart(thing);
+          if ((!heart)&&(!is_herogate(thing)))
+            continue;
+          if (level_regions_get(rgns,sx/MAP_SUBNUM_X,sy/MAP_SUBNUM_Y)==main_rgn)
+            continue;
+          errpt->x=sx/MAP_SUBNUM_X;
+          errpt->y=sy/MAP_SUBNUM_Y;
+          if (heart)
+            sprintf(err_msg,"Dungeon heart of player %d on slab %d,%d can't be reached from human player's heart.",
+                (int)get_thing_owner(thing),errpt->x,errpt->y);
+          else
+            sprintf(err_msg,"Hero gate on slab %d,%d can't be reached from human player's heart.",
+                errpt->x,errpt->y);
+          level_regions_free(&rgns);
+          return VERIF_WARN;
+        }
+      }
+    /* Checking portals */
+    unsigned int tx,ty;
+    for (ty=0; ty<lvl->tlsize.y; ty++)
+      for (tx=0; tx<lvl->tlsize.x; tx++)
+      {
+        if (get_tile_slab(lvl,tx,ty)!=SLAB_TYPE_PORTAL)
+          continue;
+        if (level_regions_get(rgns,tx,ty)==main_rgn)
+          continue;
+        errpt->x=tx;
+        errpt->y=ty;
+        sprintf(err_msg,"Portal on slab %d,%d can't be reached from human player's heart.",
+            errpt->x,errpt->y);
+        level_regions_free(&rgns);
+        return VERIF_WARN;
+      }
+    level_regions_free(&rgns);
+    return VERIF_OK;
+}
@@ -0,0 +1,89 @@
+/******************************************************************************/
+/** @file lev_regions.h
+ * Connected regions of level tiles.
+ * @par Purpose:
+ *     Header file. Defines exported routines from lev_regions.c
+ * @par Comment:
+ *     None.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#ifndef ADIKT_LEVREGIONS_H
+#define ADIKT_LEVREGIONS_H
+
+#include "globals.h"
+
+struct LEVEL;
+
+/* Region of impassable tile, or tile which wasn't reached */
+#define REGION_NONE 0xffffffff
+
+/* Returns nonzero if the tile is passable */
+typedef short (*region_passable_func)(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,void *data);
+
+/**
+ * Connected regions of passable tiles. Tiles are connected through
+ * the four base directions only.
+ */
+struct LEVEL_REGIONS {
+    /* Size of the labeled grid, in tiles */
+    struct UPOINT_2D size;
+    /* Region of every tile, or REGION_NONE for impassable tiles; */
+    /* the array is indexed by ty*size.x+tx */
+    unsigned int *label;
+    /* Number of regions */
+    unsigned int count;
+    /* Number of tiles in every region */
+    unsigned int *tiles;
+  };
+
+/**
+ * Shortest paths from a region to every tile of the map.
+ */
+struct REGION_PATHS {
+    struct UPOINT_2D size;
+    /* Index of the source region */
+    unsigned int src_region;
+    /* Distance from the source region, in tiles, or REGION_NONE */
+    unsigned int *dist;
+    /* Tile from which every tile was reached, ty*size.x+tx, */
+    /* or REGION_NONE for source tiles and unreached tiles */
+    unsigned int *from;
+    /* Tile of every region closest to the source, or REGION_NONE */
+    unsigned int *nearest;
+  };
+
+DLLIMPORT short region_passable_dig(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,void *data);
+DLLIMPORT short region_passable_walk(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,void *data);
+DLLIMPORT short region_passable_inner(const struct LEVEL *lvl,
+    unsigned int tx,unsigned int ty,void *data);
+
+DLLIMPORT struct LEVEL_REGIONS *level_regions_create(const struct LEVEL *lvl,
+    region_passable_func passable,void *data);
+DLLIMPORT void level_regions_free(struct LEVEL_REGIONS **rgns_ptr);
+DLLIMPORT unsigned int level_regions_get(const struct LEVEL_REGIONS *rgns,
+    unsigned int tx,unsigned int ty);
+DLLIMPORT unsigned int level_regions_largest(const struct LEVEL_REGIONS *rgns);
+
+DLLIMPORT struct REGION_PATHS *region_paths_create(const struct LEVEL *lvl,
+    const struct LEVEL_REGIONS *rgns,unsigned int src_region,
+    region_passable_func crossable,void *data);
+DLLIMPORT void region_paths_free(struct REGION_PATHS **paths_ptr);
+DLLIMPORT unsigned int region_paths_corridor(const struct REGION_PATHS *paths,
+    const struct LEVEL_REGIONS *rgns,unsigned int dst_region,
+    struct IPOINT_2D *tiles,unsigned int tiles_max);
+
+DLLIMPORT int level_regions_connect(struct LEVEL *lvl,
+    region_passable_func passable,void *data,unsigned short corridor_slab);
+short level_verify_regions(struct LEVEL *lvl, char *err_msg,struct IPOINT_2D *errpt);
+
+#endif /* ADIKT_LEVREGIONS_H */
@@ -30,6 +30,7 @@
 #include "lev_things.h"
 #include "obj_actnpts.h"
 #include "msg_log.h"
+#include "bulcommn.h"
 
 /* Conditional statements */
 const char if_cmdtext[]="IF";
@@ -3007,7 +3008,7 @@ short execute_script_line(struct LEVEL *lvl,char *line,char *err_msg)
 short decompose_script(struct DK_SCRIPT *script,const struct SCRIPT_OPTIONS *optns)
 {
   if (script==NULL) return false;
-  message_log("  decompose_script: %d lines to analyze",script->lines_count);
+  message_log_lvl(MSGLOG_DEBUG,"  decompose_script: %d lines to analyze",script->lines_count);
   int i;
   for (i=0;i<script->lines_count;i++)
   {
@@ -3728,14 +3729,27 @@ short script_params_to_decomposed(__attribute__((unused)) struct DK_SCRIPT *scri
   return false;
 }
 
-short script_strword_pos( char const **ptr, unsigned int *ptr_len, const char *str, const short whole_rest )
+/* Tokenizer position for the non-reentrant script_strword() calls */
+static THREAD_LOCAL const char *strword_text=NULL;
+
+/**
+ * Finds next word in script line. Reentrant version - the position
+ * within text is stored in variable provided by caller.
+ * @param ptr Returns pointer to start of the word.
+ * @param ptr_len Returns length of the word.
+ * @param str Line to start with, or NULL to continue with previous line.
+ * @param whole_rest If true, the whole rest of the line is returned.
+ * @param text Tokenizer position, kept between calls.
+ * @return Returns true if a word was found.
+ */
+short script_strword_pos_r( char const **ptr, unsigned int *ptr_len, const char *str,
+    const short whole_rest, const char **text )
 {
-  static const char *text;
   if (str!=NULL)
   {
-    text=str;
+    (*text)=str;
   }
-  if (text==NULL)
+  if ((*text)==NULL)
   {
     (*ptr_len)=0;
 /*    message_log("  script_strword_pos: end of text"); */
@@ -3743,76 +3757,94 @@ short script_strword_pos( char const **ptr, unsigned int *ptr_len, const char *s
   }
   int len;
   do {
-    len=strcspn(text," \t,();");
+    len=strcspn((*text)," \t,();");
     if (len==0)
     {
-      if (text[0]=='\0')
+      if ((*text)[0]=='\0')
       {
         (*ptr_len)=0;
-        text=NULL;
+        (*text)=NULL;
 /*          message_log("  script_strword_pos: line empty"); */
         return false;
       }
-      text++;
+      (*text)++;
     }
   } while (len==0);
   int text_len;
-  text_len=strlen(text);
+  text_len=strlen((*text));
   if (whole_rest)
   {
-    (*ptr)=text;
+    (*ptr)=(*text);
     (*ptr_len)=text_len;
-/*    message_log("  script_strword_pos: returning whole \"%s\"",text); */
-    text=NULL;
+/*    message_log("  script_strword_pos: returning whole \"%s\"",(*text)); */
+    (*text)=NULL;
     return true;
   }
   /* So now we're sure that first character is not a token. */
   /* and that the string is not empty */
   /* Determining end of the parameter */
   /* operators */
-  if ((text[0]=='=')||(text[0]=='>')||(text[0]=='<')
-  ||(text[0]=='|')||(text[0]=='/')||(text[0]=='*')||(text[0]=='!'))
+  if (((*text)[0]=='=')||((*text)[0]=='>')||((*text)[0]=='<')
+  ||((*text)[0]=='|')||((*text)[0]=='/')||((*text)[0]=='*')||((*text)[0]=='!'))
   {
     len=1;
-    while (((text[len]=='=')||(text[len]=='>')||(text[len]=='<')||
-        (text[len]=='|')||(text[len]=='/')||(text[len]=='*'))&&(len<3))
+    while ((((*text)[len]=='=')||((*text)[len]=='>')||((*text)[len]=='<')||
+        ((*text)[len]=='|')||((*text)[len]=='/')||((*text)[len]=='*'))&&(len<3))
     {
       len++;
     }
   } else
   /* Text block taken into quote */
-  if ((text[0]=='\"')||(text[0]=='\''))
+  if (((*text)[0]=='\"')||((*text)[0]=='\''))
   {
     char quot_chr[2];
-    quot_chr[0]=text[0];
+    quot_chr[0]=(*text)[0];
     quot_chr[1]='\0';
     len=1;
     do {
-      len=strcspn( text+len, quot_chr );
+      len=strcspn( (*text)+len, quot_chr );
       if (len<text_len) len++;
-    } while ((len<text_len)&&(text[len-1]=='\\'));
+    } while ((len<text_len)&&((*text)[len-1]=='\\'));
     if (len<text_len) len++;
   } else
   /* Standard word */
   {
     /* Check for operators after the word */
     int oplen=0;
-    if (text[0]!='\0')
-      oplen=strcspn(text+1,"=><|/*\"\'-+!")+1;
+    if ((*text)[0]!='\0')
+      oplen=strcspn((*text)+1,"=><|/*\"\'-+!")+1;
     if (oplen<len)
       len=oplen;
   }
-  (*ptr)=text;
+  (*ptr)=(*text);
   (*ptr_len)=len;
-  text+=len;
+  (*text)+=len;
   return true;
 }
 
-char *script_strword( const char *str, const short whole_rest )
+/**
+ * Finds next word in script line. Keeps the position between calls
+ * separately for every thread, so threads may parse scripts at the same
+ * time; but nested parsing in one thread needs script_strword_pos_r().
+ */
+short script_strword_pos( char const **ptr, unsigned int *ptr_len, const char *str, const short whole_rest )
+{
+  return script_strword_pos_r(ptr,ptr_len,str,whole_rest,&strword_text);
+}
+
+/**
+ * Returns copy of next word in script line. Reentrant version
+ * of script_strword().
+ * @param str Line to start with, or NULL to continue with previous line.
+ * @param whole_rest If true, the whole rest of the line is returned.
+ * @param text Tokenizer position, kept between calls.
+ * @return Returns newly allocated word, or NULL if there are no more words.
+ */
+char *script_strword_r( const char *str, const short whole_rest, const char **text )
 {
   const char *ptr;
   unsigned int len;
-  if (!script_strword_pos(&ptr,&len,str,whole_rest))
+  if (!script_strword_pos_r(&ptr,&len,str,whole_rest,text))
     return NULL;
   char *wordtxt;
   wordtxt=malloc(len+1);
@@ -3826,6 +3858,15 @@ char *script_strword( const char *str, const short whole_rest )
   return wordtxt;
 }
 
+/**
+ * Returns copy of next word in script line. The position is kept
+ * per thread, like in script_strword_pos().
+ */
+char *script_strword( const char *str, const short whole_rest )
+{
+  return script_strword_r(str,whole_rest,&strword_text);
+}
+
 /*
  * Returns group and index of a script word
  */
@@ -3990,15 +4031,16 @@ short decompose_script_command(struct DK_SCRIPT_COMMAND *cmd,const char *text,co
   if ((cmd==NULL)||(text==NULL)) return false;
   /*Decomposing the string into single parameters - getting first (command name) */
   char *wordtxt;
+  const char *wordpos=NULL;
   cmd->level=get_script_command_level(text,optns);
-  wordtxt = script_strword(text,false);
+  wordtxt = script_strword_r(text,false,&wordpos);
   int cmd_idx;
   cmd->group=recognize_script_word_group_and_idx(&cmd_idx,wordtxt,false);
   cmd->index=cmd_idx;
   if (cmd->index<0)
   {
       cmd->group=CMD_UNKNOWN;
-      message_log("  decompose_script_command: \"%s\" not recognized",wordtxt);
+      message_log_lvl(MSGLOG_TRACE,"  decompose_script_command: \"%s\" not recognized",wordtxt);
       free(wordtxt);
       script_command_param_add(cmd,strdup(text));
       return false;
@@ -4007,7 +4049,7 @@ short decompose_script_command(struct DK_SCRIPT_COMMAND *cmd,const char *text,co
   /*Decomposing the string into parameters - in this case, treat the rest as one parameter */
   if (cmd->group==CMD_COMMNT)
   {
-      wordtxt = script_strword(NULL,true);
+      wordtxt = script_strword_r(NULL,true,&wordpos);
 /*      message_log("  decompose_script_command: got comment \"%s\"",wordtxt); */
       script_command_param_add(cmd,wordtxt);
   } else
@@ -4015,7 +4057,7 @@ short decompose_script_command(struct DK_SCRIPT_COMMAND *cmd,const char *text,co
   {
     while (wordtxt != NULL)
     {
-      wordtxt = script_strword(NULL,false);
+      wordtxt = script_strword_r(NULL,false,&wordpos);
 /*      message_log("  decompose_script_command: got parameter \"%s\"",wordtxt); */
       script_command_param_add(cmd,wordtxt);
     }
@@ -5042,7 +5084,8 @@ short add_stats_to_script(char ***lines,int *lines_count,struct LEVEL *lvl)
     sprintf(line,"%s %s script file for %s",rem_cmdtext,PROGRAM_NAME,tmp2);
     free(tmp2);
     text_file_linecp_add(lines,lines_count,line);
-    strftime(tmp,LINEMSG_SIZE/2, "%d %b %Y, %H:%M:%S", localtime(&curr_time) );
+    struct tm curr_tm;
+    strftime(tmp,LINEMSG_SIZE/2, "%d %b %Y, %H:%M:%S", local_time_r(&curr_time,&curr_tm) );
     sprintf(line,"%s %s %s",rem_cmdtext,"Automatically generated on",tmp);
     text_file_linecp_add(lines,lines_count,line);
     text_file_linecp_add(lines,lines_count,"");
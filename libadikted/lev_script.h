@@ -484,6 +484,9 @@ DLLIMPORT short is_no_bracket_command(int group,int cmdidx);
 DLLIMPORT char *script_strword( const char *str, const short whole_rest );
 DLLIMPORT short script_strword_pos( char const **ptr, unsigned int *ptr_len,
     const char *str, const short whole_rest );
+DLLIMPORT char *script_strword_r( const char *str, const short whole_rest, const char **text );
+DLLIMPORT short script_strword_pos_r( char const **ptr, unsigned int *ptr_len, const char *str,
+    const short whole_rest, const char **text );
 
 /*Lower level - executing commands */
 DLLIMPORT short execute_adikted_command(struct LEVEL *lvl,struct DK_SCRIPT_COMMAND *cmd,char *err_msg);
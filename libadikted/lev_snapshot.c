@@ -0,0 +1,689 @@
+/******************************************************************************/
+/** @file lev_snapshot.c
+ * Copy-on-write snapshots of levels.
+ * @par Purpose:
+ *     Creates frozen copies of a level, which can be saved, drawn or
+ *     verified while the original level is still being edited.
+ * @par Comment:
+ *     Rows of the map grids (SLB, OWN, WIB, WLB, FLG, DAT) are shared
+ *     between level and its snapshots, and copied by the setter functions
+ *     only when written. Objects, columns and script are small, and are
+ *     copied when the snapshot is created.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include "lev_snapshot.h"
+
+#include <string.h>
+#include "globals.h"
+#include "lev_data.h"
+#include "lev_column.h"
+#include "lev_script.h"
+#include "obj_column_def.h"
+#include "obj_column.h"
+#include "obj_slabs.h"
+#include "msg_log.h"
+#include "lbthread.h"
+
+/**
+ * Returns the rows array of given level grid.
+ */
+static void **grid_rows(const struct LEVEL *lvl,short grid)
+{
+    switch (grid)
+    {
+    case LGRD_SLB:
+      return (void **)lvl->slb;
+    case LGRD_OWN:
+      return (void **)lvl->own;
+    case LGRD_WIB:
+      return (void **)lvl->wib;
+    case LGRD_WLB:
+      return (void **)lvl->wlb;
+    case LGRD_FLG:
+      return (void **)lvl->flg;
+    case LGRD_DAT:
+      return (void **)lvl->dat;
+    default:
+      return NULL;
+    }
+}
+
+/**
+ * Sets the rows array of given level grid.
+ */
+static void grid_rows_set(struct LEVEL *lvl,short grid,void **rows)
+{
+    switch (grid)
+    {
+    case LGRD_SLB:
+      lvl->slb=(unsigned short **)rows;
+      break;
+    case LGRD_OWN:
+      lvl->own=(unsigned char **)rows;
+      break;
+    case LGRD_WIB:
+      lvl->wib=(unsigned char **)rows;
+      break;
+    case LGRD_WLB:
+      lvl->wlb=(unsigned char **)rows;
+      break;
+    case LGRD_FLG:
+      lvl->flg=(unsigned short **)rows;
+      break;
+    case LGRD_DAT:
+      lvl->dat=(unsigned short **)rows;
+      break;
+    }
+}
+
+/**
+ * Returns amount of rows in given level grid.
+ */
+static unsigned int grid_rows_count(const struct LEVEL *lvl,short grid)
+{
+    if ((grid==LGRD_SLB)||(grid==LGRD_WLB))
+      return lvl->tlsize.y;
+    return lvl->subsize.y;
+}
+
+/**
+ * Returns size of a single row of given level grid, in bytes.
+ */
+static unsigned long grid_row_size(const struct LEVEL *lvl,short grid)
+{
+    switch (grid)
+    {
+    case LGRD_SLB:
+      return lvl->tlsize.x*sizeof(unsigned short);
+    case LGRD_WLB:
+      return lvl->tlsize.x*sizeof(unsigned char);
+    case LGRD_OWN:
+    case LGRD_WIB:
+      return lvl->subsize.x*sizeof(unsigned char);
+    default:
+      return lvl->subsize.x*sizeof(unsigned short);
+    }
+}
+
+/**
+ * Makes a grid row owned only by the level, copying it if it's shared
+ * with snapshots. Should be called before the row is written.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param grid Grid index, from LEVEL_GRID_INDEX enumeration.
+ * @param row Index of the row to be written.
+ * @return Returns true on success, false if the row couldn't be copied.
+ */
+short level_grid_row_unshare(struct LEVEL *lvl,short grid,unsigned int row)
+{
+    if (lvl->grid_refs[grid]==NULL)
+      return true;
+    long *refs=lvl->grid_refs[grid][row];
+    if (refs==NULL)
+      return true;
+    void **rows=grid_rows(lvl,grid);
+    if ((*refs)>1)
+    {
+      unsigned long size=grid_row_size(lvl,grid);
+      void *nrow=malloc(size);
+      if (nrow==NULL)
+      {
+        message_error("Cannot alloc memory for grid row copy");
+        return false;
+      }
+      memcpy(nrow,rows[row],size);
+      /* Snapshots may have been freed in the meantime */
+      if (lb_atomic_dec(refs)==0)
+      {
+        free(rows[row]);
+        free(refs);
+      }
+      rows[row]=nrow;
+    } else
+    {
+      free(refs);
+    }
+    lvl->grid_refs[grid][row]=NULL;
+    return true;
+}
+
+/**
+ * Makes all grid rows owned only by the level. Should be called before
+ * the grids are rewritten as a whole.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true on success, false on error.
+ */
+short level_grid_unshare_all(struct LEVEL *lvl)
+{
+    short result=true;
+    short grid;
+    unsigned int row;
+    for (grid=0; grid<LGRD_COUNT; grid++)
+    {
+      if (lvl->grid_refs[grid]==NULL)
+        continue;
+      unsigned int count=grid_rows_count(lvl,grid);
+      for (row=0; row<count; row++)
+        result&=level_grid_row_unshare(lvl,grid,row);
+    }
+    return result;
+}
+
+/**
+ * Drops references to grid rows shared with other levels, before
+ * the grids are freed. Rows still used by other levels are removed
+ * from the grids, so they won't be freed.
+ * @param lvl Pointer to the LEVEL structure.
+ */
+void level_grid_refs_release(struct LEVEL *lvl)
+{
+    short grid;
+    unsigned int row;
+    for (grid=0; grid<LGRD_COUNT; grid++)
+    {
+      if (lvl->grid_refs[grid]==NULL)
+        continue;
+      void **rows=grid_rows(lvl,grid);
+      unsigned int count=grid_rows_count(lvl,grid);
+      for (row=0; row<count; row++)
+      {
+        long *refs=lvl->grid_refs[grid][row];
+        if (refs==NULL)
+          continue;
+        if (lb_atomic_dec(refs)==0)
+          free(refs);
+        else if (rows!=NULL)
+          rows[row]=NULL;
+      }
+      free(lvl->grid_refs[grid]);
+      lvl->grid_refs[grid]=NULL;
+    }
+}
+
+/**
+ * Makes snapshot grid using the same rows as grid of the source level.
+ */
+static short snapshot_share_grid(struct LEVEL *lvl,struct LEVEL *snap,short grid)
+{
+    unsigned int count=grid_rows_count(lvl,grid);
+    if (lvl->grid_refs[grid]==NULL)
+    {
+      lvl->grid_refs[grid]=(long **)calloc(count,sizeof(long *));
+      if (lvl->grid_refs[grid]==NULL)
+        return false;
+    }
+    void **rows=(void **)calloc(count,sizeof(void *));
+    if (rows==NULL)
+      return false;
+    grid_rows_set(snap,grid,rows);
+    snap->grid_refs[grid]=(long **)calloc(count,sizeof(long *));
+    if (snap->grid_refs[grid]==NULL)
+      return false;
+    void **src_rows=grid_rows(lvl,grid);
+    unsigned int row;
+    for (row=0; row<count; row++)
+    {
+      long *refs=lvl->grid_refs[grid][row];
+      if (refs==NULL)
+      {
+        refs=(long *)malloc(sizeof(long));
+        if (refs==NULL)
+          return false;
+        (*refs)=1;
+        lvl->grid_refs[grid][row]=refs;
+      }
+      /* Snapshots may be used and freed on another thread */
+      lb_atomic_inc(refs);
+      snap->grid_refs[grid][row]=refs;
+      rows[row]=src_rows[row];
+    }
+    return true;
+}
+
+/**
+ * Allocates a copy of memory block. Returns NULL if the source is NULL.
+ */
+static void *snapshot_memdup(const void *src,unsigned long size)
+{
+    if (src==NULL)
+      return NULL;
+    void *dest=malloc(size);
+    if (dest!=NULL)
+      memcpy(dest,src,size);
+    return dest;
+}
+
+/**
+ * Allocates two-dimensional array with the same values as given one.
+ */
+static void **snapshot_arrdup(void **src,unsigned int rows,unsigned long row_size)
+{
+    if (src==NULL)
+      return NULL;
+    void **dest=(void **)calloc(rows,sizeof(void *));
+    if (dest==NULL)
+      return NULL;
+    unsigned int i;
+    for (i=0; i<rows; i++)
+    {
+      dest[i]=snapshot_memdup(src[i],row_size);
+      if (dest[i]==NULL)
+        return dest;
+    }
+    return dest;
+}
+
+/**
+ * Copies objects lookup with all the objects.
+ * @return Returns true on success, false if not all objects were copied.
+ */
+static short snapshot_copy_objects(const struct LEVEL *lvl,
+    struct OBJECTS_LOOKUP **dest_lookup,const struct OBJECTS_LOOKUP *lookup,int rec_size)
+{
+    /*Preparing array bounds */
+    const unsigned int arr_entries_x=lvl->tlsize.x*MAP_SUBNUM_X;
+    const unsigned int arr_entries_y=lvl->tlsize.y*MAP_SUBNUM_Y;
+    struct OBJECTS_LOOKUP *nlookup;
+    nlookup=objlookup_create(arr_entries_x,arr_entries_y);
+    if (nlookup==NULL)
+      return false;
+    (*dest_lookup)=nlookup;
+    unsigned int sx,sy,k;
+    for (sx=0; sx<arr_entries_x; sx++)
+    {
+      if (lookup->start[sx]==NULL)
+        continue;
+      for (sy=0; sy<arr_entries_y; sy++)
+      {
+        unsigned int num=objlookup_subnums(lookup,sx,sy);
+        for (k=0; k<num; k++)
+        {
+          unsigned char *obj;
+          obj=(unsigned char *)snapshot_memdup(objlookup_get(lookup,sx,sy,k),rec_size);
+          if (obj==NULL)
+            return false;
+          if (objlookup_add(nlookup,sx,sy,obj)<0)
+          {
+            free(obj);
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+}
+
+/**
+ * Copies script lines and parameters into the snapshot.
+ */
+static short snapshot_copy_script(const struct LEVEL *lvl,struct LEVEL *snap)
+{
+    const struct DK_SCRIPT_PARAMETERS *par=&(lvl->script.par);
+    struct DK_SCRIPT_PARAMETERS *npar=&(snap->script.par);
+    int idx;
+    npar->creature_pool=(unsigned int *)snapshot_memdup(par->creature_pool,
+        creatures_cmd_arrsize()*sizeof(unsigned int));
+    npar->player=(struct DK_SCRIPT_PLAYER *)calloc(PLAYERS_COUNT,sizeof(struct DK_SCRIPT_PLAYER));
+    if ((npar->creature_pool==NULL)||(npar->player==NULL))
+      return false;
+    short result=true;
+    for (idx=0; idx<PLAYERS_COUNT; idx++)
+    {
+      const struct DK_SCRIPT_PLAYER *plyr=&(par->player[idx]);
+      struct DK_SCRIPT_PLAYER *nplyr=&(npar->player[idx]);
+      nplyr->max_creatures=plyr->max_creatures;
+      nplyr->start_gold=plyr->start_gold;
+      nplyr->computer_player=plyr->computer_player;
+      nplyr->ally=snapshot_memdup(plyr->ally,PLAYERS_COUNT*sizeof(unsigned short));
+      nplyr->creature_avail=snapshot_memdup(plyr->creature_avail,creatures_cmd_arrsize()*sizeof(unsigned short));
+      nplyr->creature_maxlvl=snapshot_memdup(plyr->creature_maxlvl,creatures_cmd_arrsize()*sizeof(int));
+      nplyr->room_avail=snapshot_memdup(plyr->room_avail,room_cmd_arrsize()*sizeof(unsigned short));
+      nplyr->spell_avail=snapshot_memdup(plyr->spell_avail,spell_cmd_arrsize()*sizeof(unsigned short));
+      nplyr->trap_avail=snapshot_memdup(plyr->trap_avail,trap_cmd_arrsize()*sizeof(unsigned short));
+      nplyr->door_avail=snapshot_memdup(plyr->door_avail,door_cmd_arrsize()*sizeof(unsigned short));
+      nplyr->trap_amount=snapshot_memdup(plyr->trap_amount,trap_cmd_arrsize()*sizeof(unsigned int));
+      nplyr->door_amount=snapshot_memdup(plyr->door_amount,door_cmd_arrsize()*sizeof(unsigned int));
+      result&=(nplyr->ally!=NULL)&&(nplyr->creature_avail!=NULL)&&(nplyr->creature_maxlvl!=NULL)&&
+          (nplyr->room_avail!=NULL)&&(nplyr->spell_avail!=NULL)&&(nplyr->trap_avail!=NULL)&&
+          (nplyr->door_avail!=NULL)&&(nplyr->trap_amount!=NULL)&&(nplyr->door_amount!=NULL);
+    }
+    if ((!result)||(lvl->script.lines_count<1))
+      return result;
+    int lines_count=lvl->script.lines_count;
+    snap->script.txt=(char **)malloc(lines_count*sizeof(char *));
+    snap->script.list=(struct DK_SCRIPT_COMMAND **)malloc(lines_count*sizeof(struct DK_SCRIPT_COMMAND *));
+    if ((snap->script.txt==NULL)||(snap->script.list==NULL))
+      return false;
+    for (idx=0; idx<lines_count; idx++)
+    {
+      snap->script.txt[idx]=NULL;
+      snap->script.list[idx]=NULL;
+      snap->script.lines_count=idx+1;
+      if (lvl->script.txt[idx]!=NULL)
+      {
+        snap->script.txt[idx]=strdup(lvl->script.txt[idx]);
+        if (snap->script.txt[idx]==NULL)
+          return false;
+      }
+      const struct DK_SCRIPT_COMMAND *cmd=lvl->script.list[idx];
+      if (cmd==NULL)
+        continue;
+      struct DK_SCRIPT_COMMAND *ncmd=script_command_create();
+      if (ncmd==NULL)
+        return false;
+      ncmd->group=cmd->group;
+      ncmd->index=cmd->index;
+      ncmd->level=cmd->level;
+      snap->script.list[idx]=ncmd;
+      int i;
+      for (i=0; i<cmd->param_count; i++)
+      {
+        char *param=strdup((char *)cmd->params[i]);
+        if (!script_command_param_add(ncmd,param))
+        {
+          free(param);
+          return false;
+        }
+      }
+    }
+    return true;
+}
+
+/**
+ * Copies custom columns into the snapshot.
+ */
+static short snapshot_copy_custclm(const struct LEVEL *lvl,struct LEVEL *snap)
+{
+    unsigned int sx,sy;
+    snap->cust_clm_lookup=(struct DK_CUSTOM_CLM ***)snapshot_arrdup((void **)lvl->cust_clm_lookup,
+        lvl->subsize.y,lvl->subsize.x*sizeof(struct DK_CUSTOM_CLM *));
+    if (snap->cust_clm_lookup==NULL)
+      return false;
+    for (sx=0; sx<lvl->subsize.y; sx++)
+    {
+      if (snap->cust_clm_lookup[sx]==NULL)
+        return false;
+      for (sy=0; sy<lvl->subsize.x; sy++)
+      {
+        struct DK_CUSTOM_CLM *ccol=lvl->cust_clm_lookup[sx][sy];
+        snap->cust_clm_lookup[sx][sy]=NULL;
+        if ((ccol==NULL)||(ccol->rec==NULL))
+          continue;
+        struct DK_CUSTOM_CLM *nccol=create_cust_col();
+        if ((nccol==NULL)||(nccol->rec==NULL))
+        {
+          free(nccol);
+          return false;
+        }
+        nccol->wib_val=ccol->wib_val;
+        clm_rec_copy(nccol->rec,ccol->rec);
+        snap->cust_clm_lookup[sx][sy]=nccol;
+        snap->cust_clm_count++;
+      }
+    }
+    return true;
+}
+
+/**
+ * Copies graffiti and their tile index into the snapshot.
+ */
+static short snapshot_copy_graffiti(const struct LEVEL *lvl,struct LEVEL *snap)
+{
+    snap->graffiti_tile_head=(int *)snapshot_memdup(lvl->graffiti_tile_head,
+        lvl->tlsize.x*lvl->tlsize.y*sizeof(int));
+    if (snap->graffiti_tile_head==NULL)
+      return false;
+    if (lvl->graffiti_tiles_alloc>0)
+    {
+      snap->graffiti_tiles=(struct DK_GRAFFITI_TILE *)snapshot_memdup(lvl->graffiti_tiles,
+          lvl->graffiti_tiles_alloc*sizeof(struct DK_GRAFFITI_TILE));
+      if (snap->graffiti_tiles==NULL)
+        return false;
+      snap->graffiti_tiles_alloc=lvl->graffiti_tiles_alloc;
+      snap->graffiti_tiles_used=lvl->graffiti_tiles_used;
+      snap->graffiti_tiles_free=lvl->graffiti_tiles_free;
+    }
+    if (lvl->graffiti_count<1)
+      return true;
+    snap->graffiti=(struct DK_GRAFFITI **)malloc(lvl->graffiti_count*sizeof(struct DK_GRAFFITI *));
+    if (snap->graffiti==NULL)
+      return false;
+    unsigned int i;
+    for (i=0; i<lvl->graffiti_count; i++)
+    {
+      struct DK_GRAFFITI *graf;
+      graf=(struct DK_GRAFFITI *)snapshot_memdup(lvl->graffiti[i],sizeof(struct DK_GRAFFITI));
+      if (graf!=NULL)
+      {
+        graf->text=strdup(lvl->graffiti[i]->text);
+        if (graf->text==NULL)
+        {
+          free(graf);
+          graf=NULL;
+        }
+      }
+      if (graf==NULL)
+      {
+        /* Empty array isn't freed by level_free_graffiti() */
+        if (snap->graffiti_count<1)
+        {
+          free(snap->graffiti);
+          snap->graffiti=NULL;
+        }
+        return false;
+      }
+      snap->graffiti[i]=graf;
+      snap->graffiti_count=i+1;
+    }
+    return true;
+}
+
+/**
+ * Creates a frozen copy of the level. The snapshot can be saved, drawn
+ * or verified on another thread, while the source level is edited.
+ * Map grids are shared with the source level, and rows are copied only
+ * when written, so creating a snapshot is cheap.
+ * The snapshot is a LEVEL structure, and can be modified too, but
+ * edit transactions and undo are not available for it.
+ * Snapshot can't be created during edit transaction, when the level
+ * graphics isn't updated.
+ * @see level_snapshot_free
+ * @param lvl Pointer to the source LEVEL structure.
+ * @return Returns the new snapshot, or NULL on error.
+ */
+struct LEVEL *level_snapshot_create(struct LEVEL *lvl)
+{
+    message_log(" level_snapshot_create: started");
+    if ((lvl==NULL)||(lvl->edit_depth>0))
+      return NULL;
+    struct LEVEL *snap;
+    snap=(struct LEVEL *)malloc(sizeof(struct LEVEL));
+    if (snap==NULL)
+    {
+      message_error("level_snapshot_create: Cannot alloc memory for level");
+      return NULL;
+    }
+    memcpy(snap,lvl,sizeof(struct LEVEL));
+    /* Clearing pointers to data owned by the source level */
+    short grid;
+    for (grid=0; grid<LGRD_COUNT; grid++)
+    {
+      grid_rows_set(snap,grid,NULL);
+      snap->grid_refs[grid]=NULL;
+    }
+    snap->fname=NULL;
+    snap->savfname=NULL;
+    snap->clm=NULL;
+    snap->clm_hdr=NULL;
+    snap->clm_utilize=NULL;
+    snap->clm_anim=NULL;
+    /* Snapshots have no reverse DAT index; lookups fall back to scanning */
+    snap->clm_dat_first=NULL;
+    snap->dat_clm_next=NULL;
+    snap->dat_clm_prev=NULL;
+    memset(&(snap->script),0,sizeof(struct DK_SCRIPT));
+    snap->apt_lookup=NULL;
+    snap->tng_lookup=NULL;
+    snap->lgt_lookup=NULL;
+    snap->tng_apt_lgt_nums=NULL;
+    snap->cust_clm_lookup=NULL;
+    snap->cust_clm_count=0;
+    snap->graffiti=NULL;
+    snap->graffiti_count=0;
+    snap->graffiti_tile_head=NULL;
+    snap->graffiti_tiles=NULL;
+    snap->graffiti_tiles_used=0;
+    snap->graffiti_tiles_alloc=0;
+    snap->graffiti_tiles_free=-1;
+    snap->slx_data=NULL;
+    snap->edit_dirty=NULL;
+    snap->edit_depth=0;
+    snap->undo=NULL;
+    snap->obj_hook=NULL;
+    snap->obj_hook_data=NULL;
+    snap->info.name_text=NULL;
+    snap->info.desc_text=NULL;
+    snap->info.author_text=NULL;
+    snap->info.editor_text=NULL;
+    /* Now making the copies */
+    short result=true;
+    for (grid=0; (result)&&(grid<LGRD_COUNT); grid++)
+      result=snapshot_share_grid(lvl,snap,grid);
+    if (result)
+    {
+      snap->fname=(char *)snapshot_memdup(lvl->fname,DISKPATH_SIZE*sizeof(char));
+      snap->savfname=(char *)snapshot_memdup(lvl->savfname,DISKPATH_SIZE*sizeof(char));
+      snap->clm=clm_table_alloc(lvl->clm_entries);
+      if (snap->clm!=NULL)
+        memcpy(snap->clm[0],lvl->clm[0],lvl->clm_entries*SIZEOF_DK_CLM_REC);
+      snap->clm_hdr=(unsigned char *)snapshot_memdup(lvl->clm_hdr,SIZEOF_DK_CLM_HEADER);
+      snap->clm_utilize=(unsigned int *)snapshot_memdup(lvl->clm_utilize,lvl->clm_entries*sizeof(unsigned int));
+      snap->clm_anim=(unsigned char *)snapshot_memdup(lvl->clm_anim,lvl->clm_entries>>3);
+      snap->tng_apt_lgt_nums=(unsigned short **)snapshot_arrdup((void **)lvl->tng_apt_lgt_nums,
+          lvl->tlsize.y,lvl->tlsize.x*sizeof(unsigned short));
+      snap->slx_data=(unsigned char *)snapshot_memdup(lvl->slx_data,
+          lvl->tlsize.x*lvl->tlsize.y*sizeof(unsigned char));
+      result=(snap->fname!=NULL)&&(snap->savfname!=NULL)&&(snap->clm!=NULL)&&
+          (snap->slx_data!=NULL)&&(snap->clm_hdr!=NULL)&&
+          (snap->clm_utilize!=NULL)&&(snap->clm_anim!=NULL)&&(snap->tng_apt_lgt_nums!=NULL)&&
+          (snap->tng_apt_lgt_nums[lvl->tlsize.y-1]!=NULL);
+    }
+    if (result)
+    {
+      result&=snapshot_copy_objects(lvl,&(snap->tng_lookup),
+          lvl->tng_lookup,SIZEOF_DK_TNG_REC);
+      result&=snapshot_copy_objects(lvl,&(snap->apt_lookup),
+          lvl->apt_lookup,SIZEOF_DK_APT_REC);
+      result&=snapshot_copy_objects(lvl,&(snap->lgt_lookup),
+          lvl->lgt_lookup,SIZEOF_DK_LGT_REC);
+      result&=snapshot_copy_script(lvl,snap);
+      result&=snapshot_copy_custclm(lvl,snap);
+      result&=snapshot_copy_graffiti(lvl,snap);
+    }
+    if (result)
+    {
+      if (lvl->info.name_text!=NULL) snap->info.name_text=strdup(lvl->info.name_text);
+      if (lvl->info.desc_text!=NULL) snap->info.desc_text=strdup(lvl->info.desc_text);
+      if (lvl->info.author_text!=NULL) snap->info.author_text=strdup(lvl->info.author_text);
+      if (lvl->info.editor_text!=NULL) snap->info.editor_text=strdup(lvl->info.editor_text);
+    }
+    if (!result)
+    {
+      message_error("level_snapshot_create: Cannot alloc memory for level copy");
+      level_snapshot_free(&snap);
+      return NULL;
+    }
+    /* Changes up to now are stored in the snapshot */
+    lvl->snapshot_seq++;
+    snap->snapshot_seq=lvl->snapshot_seq;
+    snap->changed_files=lvl->changed_files|lvl->snapshot_changed;
+    snap->snapshot_changed=LCF_NONE;
+    lvl->snapshot_changed|=lvl->changed_files;
+    lvl->changed_files=LCF_NONE;
+    message_log(" level_snapshot_create: finished");
+    return snap;
+}
+
+/**
+ * Frees the level snapshot. Can be called on any thread.
+ * @see level_snapshot_create
+ * @param snap_ptr Double pointer to the snapshot LEVEL structure.
+ */
+void level_snapshot_free(struct LEVEL **snap_ptr)
+{
+    if ((snap_ptr==NULL)||((*snap_ptr)==NULL))
+      return;
+    struct LEVEL *snap=(*snap_ptr);
+    int i;
+    /* Commands have parameters which level_free() doesn't free */
+    if (snap->script.list!=NULL)
+    {
+      for (i=0; i<snap->script.lines_count; i++)
+      {
+        if (snap->script.list[i]!=NULL)
+          script_command_free(snap->script.list[i]);
+        snap->script.list[i]=NULL;
+      }
+    }
+    if (snap->cust_clm_lookup!=NULL)
+    {
+      unsigned int sx,sy;
+      for (sx=0; sx<snap->subsize.y; sx++)
+      {
+        if (snap->cust_clm_lookup[sx]==NULL)
+          continue;
+        for (sy=0; sy<snap->subsize.x; sy++)
+        {
+          struct DK_CUSTOM_CLM *ccol=snap->cust_clm_lookup[sx][sy];
+          if (ccol==NULL)
+            continue;
+          free_column_rec(ccol->rec);
+          free(ccol);
+          snap->cust_clm_lookup[sx][sy]=NULL;
+        }
+      }
+    }
+    level_free(snap);
+    level_deinit(snap_ptr);
+}
+
+/**
+ * Updates the source level after its snapshot was saved successfully.
+ * Clears changed files state of the level, except the changes which
+ * were made after the snapshot was created, and copies save statistics.
+ * Should be called on the thread which edits the source level.
+ * @param lvl Pointer to the source LEVEL structure.
+ * @param snap Pointer to the snapshot which was saved.
+ * @return Returns true on success, false on error.
+ */
+short level_snapshot_saved(struct LEVEL *lvl,const struct LEVEL *snap)
+{
+    if ((lvl==NULL)||(snap==NULL))
+      return false;
+    /* If a newer snapshot exists, it holds changes not saved yet */
+    if (snap->snapshot_seq==lvl->snapshot_seq)
+      lvl->snapshot_changed=snap->changed_files;
+    lvl->tng_digest=snap->tng_digest;
+    lvl->apt_digest=snap->apt_digest;
+    lvl->lgt_digest=snap->lgt_digest;
+    if (strlen(snap->fname)>0)
+    {
+      strncpy(lvl->fname,snap->fname,DISKPATH_SIZE);
+      lvl->fname[DISKPATH_SIZE-1]='\0';
+    }
+    lvl->info.creat_date=snap->info.creat_date;
+    lvl->info.lastsav_date=snap->info.lastsav_date;
+    lvl->info.ver_major=snap->info.ver_major;
+    lvl->info.ver_minor=snap->info.ver_minor;
+    lvl->info.ver_rel=snap->info.ver_rel;
+    lvl->stats.saves_count=snap->stats.saves_count;
+    if (((lvl->changed_files|lvl->snapshot_changed)&LCF_ALL)==0)
+      lvl->stats.unsaved_changes=0;
+    return true;
+}
@@ -0,0 +1,33 @@
+/******************************************************************************/
+/** @file lev_snapshot.h
+ * Copy-on-write snapshots of levels.
+ * @par Purpose:
+ *     Header file. Defines exported routines from lev_snapshot.c
+ * @par Comment:
+ *     None.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#ifndef ADIKT_LEVSNAPSHOT_H
+#define ADIKT_LEVSNAPSHOT_H
+
+#include "globals.h"
+
+struct LEVEL;
+
+DLLIMPORT struct LEVEL *level_snapshot_create(struct LEVEL *lvl);
+DLLIMPORT void level_snapshot_free(struct LEVEL **snap_ptr);
+DLLIMPORT short level_snapshot_saved(struct LEVEL *lvl,const struct LEVEL *snap);
+
+/* Sharing grid rows; used by the level setter functions */
+short level_grid_row_unshare(struct LEVEL *lvl,short grid,unsigned int row);
+short level_grid_unshare_all(struct LEVEL *lvl);
+void level_grid_refs_release(struct LEVEL *lvl);
+
+#endif /* ADIKT_LEVSNAPSHOT_H */
@@ -27,6 +27,7 @@
 #include "msg_log.h"
 #include "obj_column_def.h"
 #include "obj_actnpts.h"
+#include "lev_undo.h"
 
 /*
  * Functions and names used in search mode
@@ -247,7 +248,7 @@ unsigned char *find_next_object_on_map(struct LEVEL *lvl, int *tx, int *ty, unsi
     case 2: return find_next_stlight_on_map(lvl,tx,ty);
     case 0:
     default:
-        message_log(" find_next_object_on_map: search index %d too small",srch_idx);
+        message_log_lvl(MSGLOG_DEBUG," find_next_object_on_map: search index %d too small",srch_idx);
         return NULL;
     }
 }
@@ -290,7 +291,10 @@ short set_door_lock(struct LEVEL *lvl, unsigned char *thing, unsigned char nlock
           thing_add(lvl,thing_key);
         }
     }
+    unsigned char prev[SIZEOF_DK_TNG_REC];
+    memcpy(prev,thing,SIZEOF_DK_TNG_REC);
     set_thing_level(thing,nlock);
+    level_undo_rec_thing_mod(lvl,prev,thing);
     return true;
 }
 
@@ -399,7 +403,7 @@ short create_herogate_number_used_arr(const struct LEVEL *lvl,unsigned char **us
     {
       for (cx=0; cx<arr_entries_x; cx++)
       {
-          int num_subs=lvl->tng_subnums[cx][cy];
+          int num_subs=get_thing_subnums(lvl,cx,cy);
           for (k=0; k<num_subs; k++)
           {
                 char *thing=get_thing(lvl,cx,cy,k);
@@ -502,7 +506,7 @@ unsigned char *find_thing_on_tile(struct LEVEL *lvl, int tx, int ty, is_thing_su
  */
 unsigned char *find_next_thing_on_map(struct LEVEL *lvl, int *tx, int *ty, is_thing_subtype check_func)
 {
-  message_log(" find_next_thing_on_map: starting");
+  message_log_lvl(MSGLOG_TRACE," find_next_thing_on_map: starting");
   if (check_func==NULL) return NULL;
   if ((*ty)<0) {(*tx)=-1;(*ty)=0;};
   if ((*tx)<0) (*tx)=-1;
@@ -524,7 +528,7 @@ unsigned char *find_next_thing_on_map(struct LEVEL *lvl, int *tx, int *ty, is_th
 
 unsigned char *find_next_actnpt_on_map(struct LEVEL *lvl, int *tx, int *ty)
 {
-  message_log(" find_next_actnpt_on_map: starting");
+  message_log_lvl(MSGLOG_TRACE," find_next_actnpt_on_map: starting");
   if ((*ty)<0) {(*tx)=-1;(*ty)=0;};
   if ((*tx)<0) (*tx)=-1;
   do {
@@ -550,7 +554,7 @@ unsigned char *find_next_actnpt_on_map(struct LEVEL *lvl, int *tx, int *ty)
 
 unsigned char *find_next_stlight_on_map(struct LEVEL *lvl, int *tx, int *ty)
 {
-  message_log(" find_next_stlight_on_map: starting");
+  message_log_lvl(MSGLOG_TRACE," find_next_stlight_on_map: starting");
   if ((*ty)<0) {(*tx)=-1;(*ty)=0;};
   if ((*tx)<0) (*tx)=-1;
   do {
@@ -842,7 +846,7 @@ unsigned short get_free_indexedthing_number(const struct LEVEL *lvl)
     {
       for (cx=0; cx<arr_entries_x; cx++)
       {
-          int num_subs=lvl->tng_subnums[cx][cy];
+          int num_subs=get_thing_subnums(lvl,cx,cy);
           for (k=0; k<num_subs; k++)
           {
               char *thing=get_thing(lvl,cx,cy,k);
@@ -1223,7 +1227,8 @@ void update_door_things_on_slab(struct LEVEL *lvl, int tx, int ty)
     {
       thing=create_door(lvl, tx*MAP_SUBNUM_X+1, ty*MAP_SUBNUM_Y+1, door_subtype);
     } else
-    /* and if we found one, modify its parameters */
+    /* and if we found one, modify its parameters; it was dropped, */
+    /* so undo journal gets it removed and added again */
     {
       set_thing_subtype(thing,door_subtype);
       set_thing_subtile(thing,tx*MAP_SUBNUM_X+1,ty*MAP_SUBNUM_Y+1);
@@ -1287,8 +1292,8 @@ void create_things_slb_room(cr_tng_func cr_floor,cr_tng_func cr_edge,
   const unsigned short dir_c[]={IDIR_NW, IDIR_NE, IDIR_SE, IDIR_SW};
   const unsigned short dir_x[]={0, 2, 2, 0};
   const unsigned short dir_y[]={0, 0, 2, 2};
-  unsigned char *surr_slb=(unsigned char *)malloc(9*sizeof(unsigned char));
-  unsigned char *surr_own=(unsigned char *)malloc(9*sizeof(unsigned char));
+  unsigned char surr_slb[9];
+  unsigned char surr_own[9];
   get_slab_surround(surr_slb,surr_own,NULL,lvl,tx,ty);
   unsigned short slab=surr_slb[IDIR_CENTR];
   unsigned char ownr=surr_own[IDIR_CENTR];
@@ -1416,8 +1421,8 @@ void create_things_slb_room(cr_tng_func cr_floor,cr_tng_func cr_edge,
 void create_things_slb_room_simple(cr_tng_func cr_any,
         struct LEVEL *lvl, int tx, int ty)
 {
-  unsigned char *surr_slb=(unsigned char *)malloc(9*sizeof(unsigned char));
-  unsigned char *surr_own=(unsigned char *)malloc(9*sizeof(unsigned char));
+  unsigned char surr_slb[9];
+  unsigned char surr_own[9];
   get_slab_surround(surr_slb,surr_own,NULL,lvl,tx,ty);
   struct UPOINT_2D corner_pos={0,0};
   /*unsigned short slab=surr_slb[IDIR_CENTR];
@@ -1495,13 +1500,13 @@ void update_things_slb_portal_inside(struct LEVEL *lvl, const int tx, const int
     } else
     {
       /*Position is not crucial, so leaving it as it was */
-      set_thing_owner(thing_eff,get_tile_owner(lvl,tx,ty));
+      thing_set_owner(lvl,thing_eff,get_tile_owner(lvl,tx,ty));
     }
     /*Second effect is not auto-created - user must make it */
     if (thing_eff2!=NULL)
     {
       /*Position is not crucial, so leaving it as it was */
-      set_thing_owner(thing_eff2,get_tile_owner(lvl,tx,ty));
+      thing_set_owner(lvl,thing_eff2,get_tile_owner(lvl,tx,ty));
     }
 }
 
@@ -1554,7 +1559,7 @@ unsigned char *update_thing_slb_room_one_central_item(struct LEVEL *lvl, int tx,
     } else
     {
       /*Position is not crucial, so leaving it as it was */
-      set_thing_owner(thing_dst,get_tile_owner(lvl,tx,ty));
+      thing_set_owner(lvl,thing_dst,get_tile_owner(lvl,tx,ty));
     }
     return thing_dst;
 }
@@ -1601,7 +1606,7 @@ unsigned char *update_thing_slb_room_one_item_subtl(struct LEVEL *lvl, int sx, i
     } else
     {
       /*Position is not crucial, so leaving it as it was */
-      set_thing_owner(thing_dst,get_tile_owner(lvl,sx/MAP_SUBNUM_X,sy/MAP_SUBNUM_Y));
+      thing_set_owner(lvl,thing_dst,get_tile_owner(lvl,sx/MAP_SUBNUM_X,sy/MAP_SUBNUM_Y));
     }
     return thing_dst;
 }
@@ -1682,7 +1687,13 @@ void update_things_slb_temple_corner(struct LEVEL *lvl, const int tx, const int
 {
     unsigned char *thing;
     thing=update_thing_slb_room_one_central_item(lvl,tx,ty,ITEM_SUBTYPE_TEMPLESTA,true);
-    set_thing_subtile_h(thing,2); /* Temple floor is higher than ground */
+    if (thing!=NULL)
+    {
+      unsigned char prev[SIZEOF_DK_TNG_REC];
+      memcpy(prev,thing,SIZEOF_DK_TNG_REC);
+      set_thing_subtile_h(thing,2); /* Temple floor is higher than ground */
+      level_undo_rec_thing_mod(lvl,prev,thing);
+    }
 }
 
 void update_things_slb_workshop_corner(struct LEVEL *lvl, const int tx, const int ty,
@@ -1743,12 +1754,15 @@ void update_things_slb_barracks_corner(struct LEVEL *lvl, const int tx, const in
         thing_add(lvl,thing_trch);
       } else
       {
+        unsigned char prev[SIZEOF_DK_TNG_REC];
+        memcpy(prev,thing_trch,SIZEOF_DK_TNG_REC);
         set_thing_owner(thing_trch,get_tile_owner(lvl,tx,ty));
         if (allow_torch<3)
           set_thing_subtile(thing_trch,sx,sy);
         /*Sensitive tile */
         unsigned short sensitile=compute_torch_sensitile(lvl,thing_trch);
         set_thing_sensitile(thing_trch,sensitile);
+        level_undo_rec_thing_mod(lvl,prev,thing_trch);
       }
     }
     sx=tx*MAP_SUBNUM_X+2-corner_pos.x;
@@ -1858,7 +1872,7 @@ void update_things_slb_graveyard_corner(struct LEVEL *lvl, const int tx, const i
       thing_add(lvl,thing_dst);
     } else
     {
-      set_thing_owner(thing_dst,get_tile_owner(lvl,tx,ty));
+      thing_set_owner(lvl,thing_dst,get_tile_owner(lvl,tx,ty));
     }
     if (allow_torch>0)
     {
@@ -1877,12 +1891,15 @@ void update_things_slb_graveyard_corner(struct LEVEL *lvl, const int tx, const i
         thing_add(lvl,thing_trch);
       } else
       {
+        unsigned char prev[SIZEOF_DK_TNG_REC];
+        memcpy(prev,thing_trch,SIZEOF_DK_TNG_REC);
         set_thing_owner(thing_trch,get_tile_owner(lvl,tx,ty));
         if (allow_torch<3)
           set_thing_subtile(thing_trch,sx,sy);
         /*Sensitive tile */
         unsigned short sensitile=compute_torch_sensitile(lvl,thing_trch);
         set_thing_sensitile(thing_trch,sensitile);
+        level_undo_rec_thing_mod(lvl,prev,thing_trch);
       }
     }
     sx=tx*MAP_SUBNUM_X+2-corner_pos.x;
@@ -1894,7 +1911,7 @@ void update_things_slb_graveyard_corner(struct LEVEL *lvl, const int tx, const i
     } else
     {
       /*Position is not crucial, so leaving it as it was */
-      set_thing_owner(thing_eff,get_tile_owner(lvl,tx,ty));
+      thing_set_owner(lvl,thing_eff,get_tile_owner(lvl,tx,ty));
     }
 }
 
@@ -1924,7 +1941,13 @@ void update_things_slb_guardpost_floor(struct LEVEL *lvl, const int tx, const in
         break;
     }
     unsigned char *thing=update_thing_slb_room_one_central_item(lvl,tx,ty,flag_stype,true);
-    set_thing_subtile_h(thing,2);
+    if (thing!=NULL)
+    {
+      unsigned char prev[SIZEOF_DK_TNG_REC];
+      memcpy(prev,thing,SIZEOF_DK_TNG_REC);
+      set_thing_subtile_h(thing,2);
+      level_undo_rec_thing_mod(lvl,prev,thing);
+    }
 }
 
 void update_things_slb_prison(struct LEVEL *lvl, const int tx, const int ty,
@@ -2045,7 +2068,10 @@ short update_things_subpos_and_height_for_slab(struct LEVEL *lvl, int tx, int ty
           for (i=last_thing; i>=0; i--)
           {
             char *thing=get_thing(lvl,sx,sy,i);
+            unsigned char prev[SIZEOF_DK_TNG_REC];
+            memcpy(prev,thing,SIZEOF_DK_TNG_REC);
             result&=update_thing_subpos_and_height(clm_height,thing);
+            level_undo_rec_thing_mod(lvl,prev,thing);
           }
      }
     return result;
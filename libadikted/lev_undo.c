@@ -0,0 +1,954 @@
+/******************************************************************************/
+/** @file lev_undo.c
+ * Undo and redo journal for levels.
+ * @par Purpose:
+ *     Records compact deltas of level changes, made through the setter
+ *     functions, and replays them backward or forward.
+ * @par Comment:
+ *     Only changes made between level_undo_begin() and level_undo_end()
+ *     are recorded. Things modified in place are journaled if changed
+ *     by thing_set_*() functions, or recorded with level_undo_rec_thing_mod().
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#include "lev_undo.h"
+
+#include <string.h>
+#include "globals.h"
+#include "lev_data.h"
+#include "lev_column.h"
+#include "obj_column.h"
+#include "obj_column_def.h"
+#include "obj_things.h"
+#include "graffiti.h"
+#include "msg_log.h"
+
+/**
+ * Copy of a custom column, stored in custom column deltas.
+ */
+struct UNDO_CUSTCLM {
+    unsigned short wib_val;
+    struct COLUMN_REC rec;
+  };
+
+/**
+ * Returns size of the object copy stored in delta of given type.
+ */
+static unsigned long undo_obj_size(unsigned char type)
+{
+    switch (type)
+    {
+    case UDT_THING_ADD:
+    case UDT_THING_DEL:
+      return SIZEOF_DK_TNG_REC;
+    case UDT_ACTNPT_ADD:
+    case UDT_ACTNPT_DEL:
+      return SIZEOF_DK_APT_REC;
+    case UDT_STLIGHT_ADD:
+    case UDT_STLIGHT_DEL:
+      return SIZEOF_DK_LGT_REC;
+    case UDT_CUSTCLM_ADD:
+    case UDT_CUSTCLM_DEL:
+      return sizeof(struct UNDO_CUSTCLM);
+    case UDT_GRAFFITI_ADD:
+    case UDT_GRAFFITI_DEL:
+      return sizeof(struct DK_GRAFFITI);
+    case UDT_THING_MOD:
+      return 2*SIZEOF_DK_TNG_REC;
+    default:
+      return 0;
+    }
+}
+
+/**
+ * Frees object copy stored in the delta.
+ */
+static void undo_delta_free(struct UNDO_DELTA *delta)
+{
+    if (delta->type==UDT_TILE)
+      return;
+    if ((delta->type==UDT_GRAFFITI_ADD)||(delta->type==UDT_GRAFFITI_DEL))
+    {
+      struct DK_GRAFFITI *graf=(struct DK_GRAFFITI *)delta->d.obj;
+      if (graf!=NULL)
+        free(graf->text);
+    }
+    free(delta->d.obj);
+    delta->d.obj=NULL;
+}
+
+/**
+ * Frees all deltas of the step, leaving it empty.
+ */
+static void undo_step_free(struct UNDO_STEP *step)
+{
+    unsigned int i;
+    for (i=0; i<step->count; i++)
+      undo_delta_free(&step->deltas[i]);
+    free(step->deltas);
+    step->deltas=NULL;
+    step->count=0;
+    step->alloc=0;
+    step->mem_size=0;
+}
+
+/**
+ * Clears the tile delta index entries used by the current step.
+ */
+static void undo_cur_reset_tiles(struct LEVEL *lvl)
+{
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    unsigned int i;
+    for (i=0; i<jrnl->cur.count; i++)
+    {
+      struct UNDO_DELTA *delta=&jrnl->cur.deltas[i];
+      if (delta->type==UDT_TILE)
+        jrnl->tile_delta[delta->y*lvl->tlsize.x+delta->x]=-1;
+    }
+}
+
+/**
+ * Removes the oldest undo step from journal.
+ */
+static void undo_drop_oldest(struct UNDO_JOURNAL *jrnl)
+{
+    if (jrnl->count<1) return;
+    jrnl->mem_size-=jrnl->steps[0].mem_size;
+    undo_step_free(&jrnl->steps[0]);
+    jrnl->count--;
+    memmove(jrnl->steps,jrnl->steps+1,jrnl->count*sizeof(struct UNDO_STEP));
+    if (jrnl->pos>0) jrnl->pos--;
+}
+
+/**
+ * Removes all steps which could be redone.
+ */
+static void undo_drop_redo(struct UNDO_JOURNAL *jrnl)
+{
+    while (jrnl->count>jrnl->pos)
+    {
+      jrnl->count--;
+      jrnl->mem_size-=jrnl->steps[jrnl->count].mem_size;
+      undo_step_free(&jrnl->steps[jrnl->count]);
+    }
+}
+
+/**
+ * Stops recording the current step; the changes made in it
+ * won't be undoable.
+ */
+static void undo_cur_discard(struct LEVEL *lvl)
+{
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    undo_cur_reset_tiles(lvl);
+    undo_step_free(&jrnl->cur);
+    jrnl->discard=true;
+}
+
+/**
+ * Returns if changes to the level should be recorded now.
+ */
+static short undo_recording(const struct LEVEL *lvl)
+{
+    const struct UNDO_JOURNAL *jrnl=lvl->undo;
+    return (jrnl!=NULL)&&(jrnl->depth>0)&&(!jrnl->discard)&&(!jrnl->replaying);
+}
+
+/**
+ * Adds new delta to the current step, keeping the journal memory limit.
+ * @return Returns the new delta, or NULL if it can't be recorded.
+ */
+static struct UNDO_DELTA *undo_new_delta(struct LEVEL *lvl,unsigned char type,
+    unsigned int x,unsigned int y,unsigned long obj_size)
+{
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    struct UNDO_STEP *step=&jrnl->cur;
+    /* New change makes the undone steps impossible to redo */
+    if (step->count==0)
+      undo_drop_redo(jrnl);
+    if (step->count>=step->alloc)
+    {
+      unsigned int nalloc;
+      struct UNDO_DELTA *ndeltas;
+      nalloc=(step->alloc<16)?16:step->alloc*2;
+      ndeltas=(struct UNDO_DELTA *)realloc(step->deltas,nalloc*sizeof(struct UNDO_DELTA));
+      if (ndeltas==NULL)
+      {
+        message_error("Cannot alloc memory for undo step");
+        undo_cur_discard(lvl);
+        return NULL;
+      }
+      step->deltas=ndeltas;
+      step->mem_size+=(nalloc-step->alloc)*sizeof(struct UNDO_DELTA);
+      step->alloc=nalloc;
+    }
+    step->mem_size+=obj_size;
+    /* Making room by forgetting the oldest steps */
+    while ((jrnl->mem_size+step->mem_size>jrnl->max_mem)&&(jrnl->pos>0))
+      undo_drop_oldest(jrnl);
+    if (step->mem_size>jrnl->max_mem)
+    {
+      message_log(" undo_new_delta: step exceeds %lu bytes, not recorded",jrnl->max_mem);
+      undo_cur_discard(lvl);
+      return NULL;
+    }
+    struct UNDO_DELTA *delta=&step->deltas[step->count];
+    step->count++;
+    delta->type=type;
+    delta->x=x;
+    delta->y=y;
+    delta->d.obj=NULL;
+    return delta;
+}
+
+/**
+ * Reads slab and owners of a tile.
+ */
+static void undo_get_tile_state(const struct LEVEL *lvl,unsigned int tx,unsigned int ty,
+    struct UNDO_TILE_STATE *state)
+{
+    int i,k;
+    state->slab=get_tile_slab(lvl,tx,ty);
+    for (k=0; k<MAP_SUBNUM_Y; k++)
+      for (i=0; i<MAP_SUBNUM_X; i++)
+        state->own[k*MAP_SUBNUM_X+i]=get_subtl_owner(lvl,tx*MAP_SUBNUM_X+i,ty*MAP_SUBNUM_Y+k);
+}
+
+/**
+ * Sets slab and owners of a tile.
+ */
+static void undo_set_tile_state(struct LEVEL *lvl,unsigned int tx,unsigned int ty,
+    const struct UNDO_TILE_STATE *state)
+{
+    int i,k;
+    set_tile_slab(lvl,tx,ty,state->slab);
+    for (k=0; k<MAP_SUBNUM_Y; k++)
+      for (i=0; i<MAP_SUBNUM_X; i++)
+        set_subtl_owner(lvl,tx*MAP_SUBNUM_X+i,ty*MAP_SUBNUM_Y+k,state->own[k*MAP_SUBNUM_X+i]);
+}
+
+/**
+ * Records tile state before its slab or owner is changed.
+ * Every tile is recorded only once in a step.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param tx,ty Map tile coordinates.
+ */
+void level_undo_rec_tile(struct LEVEL *lvl,unsigned int tx,unsigned int ty)
+{
+    if (!undo_recording(lvl))
+      return;
+    if ((tx>=lvl->tlsize.x)||(ty>=lvl->tlsize.y))
+      return;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    int *tdelta=&jrnl->tile_delta[ty*lvl->tlsize.x+tx];
+    if ((*tdelta)>=0)
+      return;
+    struct UNDO_DELTA *delta;
+    delta=undo_new_delta(lvl,UDT_TILE,tx,ty,0);
+    if (delta==NULL)
+      return;
+    undo_get_tile_state(lvl,tx,ty,&delta->d.tile.prev);
+    (*tdelta)=jrnl->cur.count-1;
+}
+
+/**
+ * Records thing, action point or static light being added or removed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param type Delta type, from UNDO_DELTA_TYPE enumeration.
+ * @param sx,sy Subtile containing the object.
+ * @param obj The object data, which is copied.
+ */
+void level_undo_rec_object(struct LEVEL *lvl,unsigned char type,
+    unsigned int sx,unsigned int sy,const unsigned char *obj)
+{
+    if ((!undo_recording(lvl))||(obj==NULL))
+      return;
+    unsigned long obj_size=undo_obj_size(type);
+    unsigned char *copy=(unsigned char *)malloc(obj_size);
+    if (copy==NULL)
+    {
+      undo_cur_discard(lvl);
+      return;
+    }
+    memcpy(copy,obj,obj_size);
+    struct UNDO_DELTA *delta;
+    delta=undo_new_delta(lvl,type,sx,sy,obj_size);
+    if (delta==NULL)
+    {
+      free(copy);
+      return;
+    }
+    delta->d.obj=copy;
+}
+
+/**
+ * Records thing which was modified in place. The thing is found by its
+ * data when replaying, so it should be recorded right after the change.
+ * Nothing is recorded if the thing wasn't changed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param prev Copy of the thing data before the change.
+ * @param thing The thing after the change; it should stay in the same
+ *     thing lookup subtile as before.
+ */
+void level_undo_rec_thing_mod(struct LEVEL *lvl,const unsigned char *prev,
+    const unsigned char *thing)
+{
+    if ((!undo_recording(lvl))||(prev==NULL)||(thing==NULL))
+      return;
+    if (memcmp(prev,thing,SIZEOF_DK_TNG_REC)==0)
+      return;
+    unsigned char *copy=(unsigned char *)malloc(2*SIZEOF_DK_TNG_REC);
+    if (copy==NULL)
+    {
+      undo_cur_discard(lvl);
+      return;
+    }
+    memcpy(copy,prev,SIZEOF_DK_TNG_REC);
+    memcpy(copy+SIZEOF_DK_TNG_REC,thing,SIZEOF_DK_TNG_REC);
+    struct UNDO_DELTA *delta;
+    delta=undo_new_delta(lvl,UDT_THING_MOD,get_thing_subtile_x(prev),
+        get_thing_subtile_y(prev),2*SIZEOF_DK_TNG_REC);
+    if (delta==NULL)
+    {
+      free(copy);
+      return;
+    }
+    delta->d.obj=copy;
+}
+
+/**
+ * Records custom column being added or removed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param type Delta type, UDT_CUSTCLM_ADD or UDT_CUSTCLM_DEL.
+ * @param sx,sy Subtile containing the custom column.
+ * @param ccol The custom column, which is copied.
+ */
+void level_undo_rec_custclm(struct LEVEL *lvl,unsigned char type,
+    unsigned int sx,unsigned int sy,const struct DK_CUSTOM_CLM *ccol)
+{
+    if ((!undo_recording(lvl))||(ccol==NULL)||(ccol->rec==NULL))
+      return;
+    struct UNDO_CUSTCLM *copy;
+    copy=(struct UNDO_CUSTCLM *)malloc(sizeof(struct UNDO_CUSTCLM));
+    if (copy==NULL)
+    {
+      undo_cur_discard(lvl);
+      return;
+    }
+    copy->wib_val=ccol->wib_val;
+    clm_rec_copy(&copy->rec,ccol->rec);
+    struct UNDO_DELTA *delta;
+    delta=undo_new_delta(lvl,type,sx,sy,sizeof(struct UNDO_CUSTCLM));
+    if (delta==NULL)
+    {
+      free(copy);
+      return;
+    }
+    delta->d.obj=copy;
+}
+
+/**
+ * Records graffiti being added or removed.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param type Delta type, UDT_GRAFFITI_ADD or UDT_GRAFFITI_DEL.
+ * @param graf The graffiti, which is copied with its text.
+ */
+void level_undo_rec_graffiti(struct LEVEL *lvl,unsigned char type,
+    const struct DK_GRAFFITI *graf)
+{
+    if ((!undo_recording(lvl))||(graf==NULL)||(graf->text==NULL))
+      return;
+    struct DK_GRAFFITI *copy;
+    copy=(struct DK_GRAFFITI *)malloc(sizeof(struct DK_GRAFFITI));
+    if (copy!=NULL)
+    {
+      memcpy(copy,graf,sizeof(struct DK_GRAFFITI));
+      copy->text=strdup(graf->text);
+    }
+    if ((copy==NULL)||(copy->text==NULL))
+    {
+      free(copy);
+      undo_cur_discard(lvl);
+      return;
+    }
+    struct UNDO_DELTA *delta;
+    delta=undo_new_delta(lvl,type,graf->tile.x,graf->tile.y,
+        sizeof(struct DK_GRAFFITI)+strlen(copy->text)+1);
+    if (delta==NULL)
+    {
+      free(copy->text);
+      free(copy);
+      return;
+    }
+    delta->d.obj=copy;
+}
+
+/**
+ * Adds a copy of object stored in delta to the level.
+ */
+static void undo_object_add(struct LEVEL *lvl,const struct UNDO_DELTA *delta)
+{
+    unsigned long obj_size=undo_obj_size(delta->type);
+    unsigned char *obj=(unsigned char *)malloc(obj_size);
+    if (obj==NULL)
+    {
+      message_error("Cannot alloc memory for undo object");
+      return;
+    }
+    memcpy(obj,delta->d.obj,obj_size);
+    int idx;
+    switch (delta->type)
+    {
+    case UDT_THING_ADD:
+    case UDT_THING_DEL:
+      idx=thing_add(lvl,obj);
+      break;
+    case UDT_ACTNPT_ADD:
+    case UDT_ACTNPT_DEL:
+      idx=actnpt_add(lvl,obj);
+      break;
+    default:
+      idx=stlight_add(lvl,obj);
+      break;
+    }
+    if (idx<0)
+      free(obj);
+}
+
+/**
+ * Removes object identical to the one stored in delta from the level.
+ */
+static void undo_object_remove(struct LEVEL *lvl,const struct UNDO_DELTA *delta)
+{
+    unsigned long obj_size=undo_obj_size(delta->type);
+    const unsigned char *copy=(const unsigned char *)delta->d.obj;
+    unsigned int sx=delta->x;
+    unsigned int sy=delta->y;
+    int i,found;
+    found=-1;
+    switch (delta->type)
+    {
+    case UDT_THING_ADD:
+    case UDT_THING_DEL:
+      for (i=get_thing_subnums(lvl,sx,sy)-1; i>=0; i--)
+      {
+        unsigned char *thing=(unsigned char *)get_thing(lvl,sx,sy,i);
+        if (memcmp(thing,copy,obj_size)==0)
+        { found=i; break; }
+      }
+      if (found>=0)
+        thing_del(lvl,sx,sy,found);
+      break;
+    case UDT_ACTNPT_ADD:
+    case UDT_ACTNPT_DEL:
+      for (i=get_actnpt_subnums(lvl,sx,sy)-1; i>=0; i--)
+      {
+        unsigned char *actnpt=(unsigned char *)get_actnpt(lvl,sx,sy,i);
+        if (memcmp(actnpt,copy,obj_size)==0)
+        { found=i; break; }
+      }
+      if (found>=0)
+        actnpt_del(lvl,sx,sy,found);
+      break;
+    default:
+      for (i=get_stlight_subnums(lvl,sx,sy)-1; i>=0; i--)
+      {
+        unsigned char *stlight=(unsigned char *)get_stlight(lvl,sx,sy,i);
+        if (memcmp(stlight,copy,obj_size)==0)
+        { found=i; break; }
+      }
+      if (found>=0)
+        stlight_del(lvl,sx,sy,found);
+      break;
+    }
+}
+
+/**
+ * Replaces the thing modified in place with its state before or after
+ * the change.
+ */
+static void undo_thing_mod(struct LEVEL *lvl,const struct UNDO_DELTA *delta,short forward)
+{
+    const unsigned char *prev=(const unsigned char *)delta->d.obj;
+    const unsigned char *next=prev+SIZEOF_DK_TNG_REC;
+    const unsigned char *from=forward?prev:next;
+    const unsigned char *to=forward?next:prev;
+    int i;
+    for (i=get_thing_subnums(lvl,delta->x,delta->y)-1; i>=0; i--)
+    {
+      unsigned char *thing=(unsigned char *)get_thing(lvl,delta->x,delta->y,i);
+      if (memcmp(thing,from,SIZEOF_DK_TNG_REC)==0)
+      {
+        thing_set_data(lvl,thing,to);
+        return;
+      }
+    }
+    message_log(" undo_thing_mod: thing not found on subtile %d,%d",(int)delta->x,(int)delta->y);
+}
+
+/**
+ * Puts a copy of custom column stored in delta on the level.
+ */
+static void undo_custclm_add(struct LEVEL *lvl,const struct UNDO_DELTA *delta)
+{
+    const struct UNDO_CUSTCLM *copy=(const struct UNDO_CUSTCLM *)delta->d.obj;
+    struct DK_CUSTOM_CLM *ccol;
+    ccol=create_cust_col();
+    if ((ccol==NULL)||(ccol->rec==NULL))
+    {
+      free(ccol);
+      return;
+    }
+    ccol->wib_val=copy->wib_val;
+    clm_rec_copy(ccol->rec,&copy->rec);
+    cust_col_del(lvl,delta->x,delta->y);
+    if (!set_cust_col(lvl,delta->x,delta->y,ccol))
+    {
+      free_column_rec(ccol->rec);
+      free(ccol);
+    }
+}
+
+/**
+ * Returns index of graffiti identical to the given one, or -1.
+ */
+static int undo_graffiti_find(struct LEVEL *lvl,const struct DK_GRAFFITI *copy)
+{
+    int i;
+    for (i=get_graffiti_count(lvl)-1; i>=0; i--)
+    {
+      struct DK_GRAFFITI *graf=get_graffiti(lvl,i);
+      if (graf==NULL) continue;
+      if ((graf->tile.x==copy->tile.x)&&(graf->tile.y==copy->tile.y)&&
+          (graf->fin_tile.x==copy->fin_tile.x)&&(graf->fin_tile.y==copy->fin_tile.y)&&
+          (graf->orient==copy->orient)&&(graf->font==copy->font)&&
+          (graf->height==copy->height)&&(graf->cube==copy->cube)&&
+          (strcmp(graf->text,copy->text)==0))
+        return i;
+    }
+    return -1;
+}
+
+/**
+ * Puts a copy of graffiti stored in delta on the level.
+ */
+static void undo_graffiti_add(struct LEVEL *lvl,const struct UNDO_DELTA *delta)
+{
+    const struct DK_GRAFFITI *copy=(const struct DK_GRAFFITI *)delta->d.obj;
+    struct DK_GRAFFITI *graf;
+    graf=(struct DK_GRAFFITI *)malloc(sizeof(struct DK_GRAFFITI));
+    if (graf==NULL)
+      return;
+    memcpy(graf,copy,sizeof(struct DK_GRAFFITI));
+    graf->text=strdup(copy->text);
+    if ((graf->text==NULL)||(graffiti_add_obj(lvl,graf)<0))
+    {
+      free(graf->text);
+      free(graf);
+    }
+}
+
+/**
+ * Applies the delta backward (undo) or forward (redo), and marks
+ * the affected tiles for graphics update.
+ */
+static void undo_delta_apply(struct LEVEL *lvl,const struct UNDO_DELTA *delta,short forward)
+{
+    short adding;
+    switch (delta->type)
+    {
+    case UDT_TILE:
+      if (forward)
+        undo_set_tile_state(lvl,delta->x,delta->y,&delta->d.tile.next);
+      else
+        undo_set_tile_state(lvl,delta->x,delta->y,&delta->d.tile.prev);
+      level_edit_mark_rect(lvl,delta->x,delta->x,delta->y,delta->y);
+      break;
+    case UDT_THING_ADD:
+    case UDT_ACTNPT_ADD:
+    case UDT_STLIGHT_ADD:
+    case UDT_THING_DEL:
+    case UDT_ACTNPT_DEL:
+    case UDT_STLIGHT_DEL:
+      adding=((delta->type==UDT_THING_ADD)||(delta->type==UDT_ACTNPT_ADD)||
+          (delta->type==UDT_STLIGHT_ADD));
+      if (adding==forward)
+        undo_object_add(lvl,delta);
+      else
+        undo_object_remove(lvl,delta);
+      level_edit_mark_rect(lvl,delta->x/MAP_SUBNUM_X,delta->x/MAP_SUBNUM_X,
+          delta->y/MAP_SUBNUM_Y,delta->y/MAP_SUBNUM_Y);
+      break;
+    case UDT_THING_MOD:
+      undo_thing_mod(lvl,delta,forward);
+      level_edit_mark_rect(lvl,delta->x/MAP_SUBNUM_X,delta->x/MAP_SUBNUM_X,
+          delta->y/MAP_SUBNUM_Y,delta->y/MAP_SUBNUM_Y);
+      break;
+    case UDT_CUSTCLM_ADD:
+    case UDT_CUSTCLM_DEL:
+      adding=(delta->type==UDT_CUSTCLM_ADD);
+      if (adding==forward)
+        undo_custclm_add(lvl,delta);
+      else
+        cust_col_del(lvl,delta->x,delta->y);
+      level_edit_mark_rect(lvl,delta->x/MAP_SUBNUM_X,delta->x/MAP_SUBNUM_X,
+          delta->y/MAP_SUBNUM_Y,delta->y/MAP_SUBNUM_Y);
+      break;
+    case UDT_GRAFFITI_ADD:
+    case UDT_GRAFFITI_DEL:
+      {
+        const struct DK_GRAFFITI *copy=(const struct DK_GRAFFITI *)delta->d.obj;
+        adding=(delta->type==UDT_GRAFFITI_ADD);
+        if (adding==forward)
+        {
+          undo_graffiti_add(lvl,delta);
+        } else
+        {
+          int graf_idx=undo_graffiti_find(lvl,copy);
+          if (graf_idx>=0)
+            graffiti_del(lvl,graf_idx);
+        }
+        level_edit_mark_rect(lvl,min(copy->tile.x,copy->fin_tile.x),
+            max(copy->tile.x,copy->fin_tile.x),min(copy->tile.y,copy->fin_tile.y),
+            max(copy->tile.y,copy->fin_tile.y));
+      };break;
+    default:
+      break;
+    }
+}
+
+/**
+ * Enables undo journal for the level. If the journal is already enabled,
+ * changes its limits. When the limits are exceeded, the oldest steps
+ * are forgotten.
+ * @param lvl Pointer to the LEVEL structure.
+ * @param max_mem Maximal memory used by the journal, in bytes.
+ * @param max_steps Maximal amount of steps which can be undone.
+ * @return Returns true on success, false on error.
+ */
+short level_undo_enable(struct LEVEL *lvl,unsigned long max_mem,unsigned int max_steps)
+{
+    if ((lvl==NULL)||(max_steps<1))
+      return false;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if (jrnl==NULL)
+    {
+      jrnl=(struct UNDO_JOURNAL *)calloc(1,sizeof(struct UNDO_JOURNAL));
+      if (jrnl==NULL)
+      {
+        message_error("level_undo_enable: Cannot alloc memory");
+        return false;
+      }
+      jrnl->tile_delta=(int *)malloc(lvl->tlsize.x*lvl->tlsize.y*sizeof(int));
+      if (jrnl->tile_delta==NULL)
+      {
+        message_error("level_undo_enable: Cannot alloc memory");
+        free(jrnl);
+        return false;
+      }
+      unsigned int i;
+      for (i=0; i<lvl->tlsize.x*lvl->tlsize.y; i++)
+        jrnl->tile_delta[i]=-1;
+      lvl->undo=jrnl;
+    }
+    jrnl->max_mem=max_mem;
+    jrnl->max_steps=max_steps;
+    while ((jrnl->count>max_steps)||((jrnl->mem_size>max_mem)&&(jrnl->count>0)))
+    {
+      if (jrnl->pos>0)
+        undo_drop_oldest(jrnl);
+      else
+        undo_drop_redo(jrnl);
+    }
+    return true;
+}
+
+/**
+ * Disables undo journal for the level and frees its memory.
+ * @param lvl Pointer to the LEVEL structure.
+ */
+void level_undo_disable(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    unsigned int i;
+    for (i=0; i<jrnl->count; i++)
+      undo_step_free(&jrnl->steps[i]);
+    undo_step_free(&jrnl->cur);
+    free(jrnl->steps);
+    free(jrnl->tile_delta);
+    free(jrnl);
+    lvl->undo=NULL;
+}
+
+/**
+ * Forgets all undo and redo steps. If a step is being recorded,
+ * changes made in it are not recorded anymore.
+ * Should be called when the level is replaced with a new one.
+ * @param lvl Pointer to the LEVEL structure.
+ */
+void level_undo_clear(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    jrnl->pos=0;
+    undo_drop_redo(jrnl);
+    if (jrnl->depth>0)
+      undo_cur_discard(lvl);
+    jrnl->can_join=false;
+}
+
+/**
+ * Starts recording undo step. Every level change made until the matching
+ * level_undo_end() becomes a part of the step, and is undone with it.
+ * Steps can be nested; only the outermost ones are stored.
+ * @see level_undo_end
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true if the undo journal is enabled.
+ */
+short level_undo_begin(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return false;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if (jrnl->replaying)
+      return true;
+    jrnl->depth++;
+    return true;
+}
+
+/**
+ * Ends recording undo step. When the outermost step ends, and there
+ * were any changes in it, the step is stored in the journal.
+ * @see level_undo_begin
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true if a new undo step was stored.
+ */
+short level_undo_end(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return false;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if ((jrnl->replaying)||(jrnl->depth<1))
+      return false;
+    jrnl->depth--;
+    if (jrnl->depth>0)
+      return false;
+    struct UNDO_STEP *step=&jrnl->cur;
+    short stored=false;
+    if ((!jrnl->discard)&&(step->count>0))
+    {
+      unsigned int i;
+      for (i=0; i<step->count; i++)
+      {
+        struct UNDO_DELTA *delta=&step->deltas[i];
+        if (delta->type==UDT_TILE)
+          undo_get_tile_state(lvl,delta->x,delta->y,&delta->d.tile.next);
+      }
+      undo_cur_reset_tiles(lvl);
+      struct UNDO_STEP *last=NULL;
+      if ((jrnl->join)&&(jrnl->can_join)&&(jrnl->pos>0)&&(jrnl->pos==jrnl->count))
+        last=&jrnl->steps[jrnl->pos-1];
+      if (last!=NULL)
+      {
+        /* Appending deltas to the last step */
+        struct UNDO_DELTA *ndeltas;
+        ndeltas=(struct UNDO_DELTA *)realloc(last->deltas,
+            (last->count+step->count)*sizeof(struct UNDO_DELTA));
+        if (ndeltas!=NULL)
+        {
+          memcpy(ndeltas+last->count,step->deltas,step->count*sizeof(struct UNDO_DELTA));
+          jrnl->mem_size-=last->mem_size;
+          last->mem_size+=step->mem_size-(step->alloc-step->count)*sizeof(struct UNDO_DELTA)
+              -(last->alloc-last->count)*sizeof(struct UNDO_DELTA);
+          jrnl->mem_size+=last->mem_size;
+          last->deltas=ndeltas;
+          last->count+=step->count;
+          last->alloc=last->count;
+          free(step->deltas);
+          stored=true;
+        }
+      } else
+      {
+        if (jrnl->count>=jrnl->max_steps)
+          undo_drop_oldest(jrnl);
+        if (jrnl->count>=jrnl->alloc)
+        {
+          struct UNDO_STEP *nsteps;
+          nsteps=(struct UNDO_STEP *)realloc(jrnl->steps,(jrnl->alloc+16)*sizeof(struct UNDO_STEP));
+          if (nsteps!=NULL)
+          {
+            jrnl->steps=nsteps;
+            jrnl->alloc+=16;
+          }
+        }
+        if (jrnl->count<jrnl->alloc)
+        {
+          jrnl->steps[jrnl->count]=(*step);
+          jrnl->count++;
+          jrnl->pos=jrnl->count;
+          jrnl->mem_size+=step->mem_size;
+          stored=true;
+        }
+      }
+      if (stored)
+      {
+        step->deltas=NULL;
+        step->count=0;
+        step->alloc=0;
+        step->mem_size=0;
+        jrnl->can_join=true;
+      } else
+      {
+        message_error("Cannot alloc memory for undo step");
+        undo_step_free(step);
+      }
+    } else
+    {
+      undo_cur_reset_tiles(lvl);
+      undo_step_free(step);
+    }
+    jrnl->join=false;
+    jrnl->discard=false;
+    return stored;
+}
+
+/**
+ * Makes the step being recorded a part of the previous step, so
+ * both are undone together. Used to join consecutive paint strokes.
+ * Works only if nothing was undone since the previous step.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true if the step will be joined.
+ */
+short level_undo_join_last(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return false;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if ((jrnl->depth<1)||(!jrnl->can_join))
+      return false;
+    jrnl->join=true;
+    return true;
+}
+
+/**
+ * Replays the step backward or forward, then updates DAT/CLM
+ * of the affected tiles.
+ */
+static void undo_step_apply(struct LEVEL *lvl,struct UNDO_STEP *step,short forward)
+{
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    int i;
+    /* Objects are restored exactly, so only graphics need update */
+    jrnl->replaying=true;
+    level_edit_begin(lvl);
+    if (forward)
+    {
+      for (i=0; i<step->count; i++)
+        undo_delta_apply(lvl,&step->deltas[i],true);
+    } else
+    {
+      for (i=step->count-1; i>=0; i--)
+        undo_delta_apply(lvl,&step->deltas[i],false);
+    }
+    level_edit_end(lvl,false);
+    jrnl->replaying=false;
+}
+
+/**
+ * Returns if undo or redo can be made now. It can't be done while
+ * level edit transaction is active, or when the current step already
+ * contains changes.
+ */
+static short undo_can_replay(const struct LEVEL *lvl)
+{
+    const struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if ((jrnl==NULL)||(jrnl->replaying)||(lvl->edit_depth>0))
+      return false;
+    if ((jrnl->depth>0)&&((jrnl->cur.count>0)||(jrnl->discard)))
+      return false;
+    return true;
+}
+
+/**
+ * Undoes the last undo step.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true if a step was undone.
+ */
+short level_undo(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(!undo_can_replay(lvl)))
+      return false;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if (jrnl->pos<1)
+      return false;
+    jrnl->pos--;
+    jrnl->can_join=false;
+    undo_step_apply(lvl,&jrnl->steps[jrnl->pos],false);
+    return true;
+}
+
+/**
+ * Redoes the last undone step.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns true if a step was redone.
+ */
+short level_redo(struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(!undo_can_replay(lvl)))
+      return false;
+    struct UNDO_JOURNAL *jrnl=lvl->undo;
+    if (jrnl->pos>=jrnl->count)
+      return false;
+    jrnl->can_join=false;
+    undo_step_apply(lvl,&jrnl->steps[jrnl->pos],true);
+    jrnl->pos++;
+    return true;
+}
+
+/**
+ * Returns amount of steps which can be undone.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns the undo steps count.
+ */
+unsigned int level_undo_count(const struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return 0;
+    return lvl->undo->pos;
+}
+
+/**
+ * Returns amount of steps which can be redone.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns the redo steps count.
+ */
+unsigned int level_redo_count(const struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return 0;
+    return lvl->undo->count-lvl->undo->pos;
+}
+
+/**
+ * Returns memory used by the undo journal.
+ * @param lvl Pointer to the LEVEL structure.
+ * @return Returns the journal size in bytes.
+ */
+unsigned long level_undo_mem_usage(const struct LEVEL *lvl)
+{
+    if ((lvl==NULL)||(lvl->undo==NULL))
+      return 0;
+    const struct UNDO_JOURNAL *jrnl=lvl->undo;
+    return jrnl->mem_size+jrnl->cur.mem_size+
+        jrnl->alloc*sizeof(struct UNDO_STEP)+
+        lvl->tlsize.x*lvl->tlsize.y*sizeof(int);
+}
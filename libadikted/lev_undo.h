@@ -0,0 +1,135 @@
+/******************************************************************************/
+/** @file lev_undo.h
+ * Undo and redo journal for levels.
+ * @par Purpose:
+ *     Header file. Defines exported routines from lev_undo.c
+ * @par Comment:
+ *     None.
+ * @date     19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+
+#ifndef ADIKT_LEVUNDO_H
+#define ADIKT_LEVUNDO_H
+
+#include "globals.h"
+#include "lev_data.h"
+
+struct DK_CUSTOM_CLM;
+
+/* Default limits of the undo journal */
+#define UNDO_DEFAULT_MAX_MEM   (16*1024*1024)
+#define UNDO_DEFAULT_MAX_STEPS 256
+
+enum UNDO_DELTA_TYPE {
+    UDT_NONE          =  0,
+    UDT_TILE,
+    UDT_THING_ADD,
+    UDT_THING_DEL,
+    UDT_ACTNPT_ADD,
+    UDT_ACTNPT_DEL,
+    UDT_STLIGHT_ADD,
+    UDT_STLIGHT_DEL,
+    UDT_CUSTCLM_ADD,
+    UDT_CUSTCLM_DEL,
+    UDT_GRAFFITI_ADD,
+    UDT_GRAFFITI_DEL,
+    UDT_THING_MOD,
+};
+
+/**
+ * Slab and owners of one tile, as stored in tile delta.
+ */
+struct UNDO_TILE_STATE {
+    unsigned short slab;
+    unsigned char own[MAP_SUBNUM_Y*MAP_SUBNUM_X];
+  };
+
+/**
+ * Single change of the level. Tile deltas store the tile state before
+ * and after the step; object deltas store a copy of the added or
+ * removed object; thing modification deltas store the thing before
+ * and, right after it, the thing after the change.
+ */
+struct UNDO_DELTA {
+    unsigned char type;
+    /* Tile for tile deltas, subtile for object deltas */
+    unsigned short x;
+    unsigned short y;
+    union {
+      struct {
+        struct UNDO_TILE_STATE prev;
+        struct UNDO_TILE_STATE next;
+      } tile;
+      void *obj;
+    } d;
+  };
+
+/**
+ * Undo step - deltas of one user action, undone all at once.
+ */
+struct UNDO_STEP {
+    struct UNDO_DELTA *deltas;
+    unsigned int count;
+    unsigned int alloc;
+    /* Memory used by the step, including object copies */
+    unsigned long mem_size;
+  };
+
+/**
+ * Undo journal of a level. Steps from 0 to pos-1 can be undone,
+ * steps from pos to count-1 can be redone.
+ */
+struct UNDO_JOURNAL {
+    struct UNDO_STEP *steps;
+    unsigned int count;
+    unsigned int alloc;
+    unsigned int pos;
+    /* Step which is being recorded */
+    struct UNDO_STEP cur;
+    /* Nesting level of level_undo_begin() calls */
+    int depth;
+    /* True if the recorded step should be joined with previous one */
+    short join;
+    /* True if the last step can be extended by joining */
+    short can_join;
+    /* True if the current step can't be recorded */
+    short discard;
+    /* True while deltas are being replayed */
+    short replaying;
+    /* Index of tile delta in the current step, for every tile, or -1 */
+    int *tile_delta;
+    unsigned long mem_size;
+    unsigned long max_mem;
+    unsigned int max_steps;
+  };
+
+DLLIMPORT short level_undo_enable(struct LEVEL *lvl,unsigned long max_mem,unsigned int max_steps);
+DLLIMPORT void level_undo_disable(struct LEVEL *lvl);
+DLLIMPORT void level_undo_clear(struct LEVEL *lvl);
+DLLIMPORT short level_undo_begin(struct LEVEL *lvl);
+DLLIMPORT short level_undo_end(struct LEVEL *lvl);
+DLLIMPORT short level_undo_join_last(struct LEVEL *lvl);
+DLLIMPORT short level_undo(struct LEVEL *lvl);
+DLLIMPORT short level_redo(struct LEVEL *lvl);
+DLLIMPORT unsigned int level_undo_count(const struct LEVEL *lvl);
+DLLIMPORT unsigned int level_redo_count(const struct LEVEL *lvl);
+DLLIMPORT unsigned long level_undo_mem_usage(const struct LEVEL *lvl);
+DLLIMPORT void level_undo_rec_thing_mod(struct LEVEL *lvl,const unsigned char *prev,
+    const unsigned char *thing);
+
+/* Recording deltas; called by the level setter functions */
+void level_undo_rec_tile(struct LEVEL *lvl,unsigned int tx,unsigned int ty);
+void level_undo_rec_object(struct LEVEL *lvl,unsigned char type,
+    unsigned int sx,unsigned int sy,const unsigned char *obj);
+void level_undo_rec_custclm(struct LEVEL *lvl,unsigned char type,
+    unsigned int sx,unsigned int sy,const struct DK_CUSTOM_CLM *ccol);
+void level_undo_rec_graffiti(struct LEVEL *lvl,unsigned char type,
+    const struct DK_GRAFFITI *graf);
+
+#endif /* ADIKT_LEVUNDO_H */
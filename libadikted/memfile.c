@@ -24,6 +24,11 @@
 #include <limits.h>
 #include <time.h>
 #include "dernc.h"
+#include "enrnc.h"
+
+#if defined(PROJECT_TARGETS_WINDOWS)
+#include <windows.h>
+#endif
 
 
 /**
@@ -322,6 +327,127 @@ short memfile_readnew(struct MEMORY_FILE **mfile,const char *fname,unsigned long
     return errcode;
 }
 
+/**
+ * Replaces destination file with the source file, by renaming it.
+ * On Windows, the file is replaced by one MoveFileExA() call. MSDOS rename
+ * can't overwrite, so there the destination is removed first.
+ * @param src_fname The source file name.
+ * @param dst_fname The destination file name.
+ * @return Returns MFILE_OK, or negative error code.
+ */
+short memfile_replace_file(const char *src_fname,const char *dst_fname)
+{
+    if ((src_fname==NULL) || (dst_fname==NULL))
+        return MFILE_INTERNAL;
+#if defined(PROJECT_TARGETS_WINDOWS)
+    if (!MoveFileExA(src_fname,dst_fname,MOVEFILE_REPLACE_EXISTING))
+        return MFILE_WRITE_ERR;
+#else
+#if defined(MSDOS)
+    remove(dst_fname);
+#endif
+    if (rename(src_fname,dst_fname)!=0)
+        return MFILE_WRITE_ERR;
+#endif
+    return MFILE_OK;
+}
+
+/**
+ * Writes MEMORY_FILE content into disk, directly into given file.
+ * Should be used when the file name is a temporary one already;
+ * otherwise, memfile_write() is the safer choice.
+ * On error, the partially written file is removed.
+ * @param mfile Pointer to MEMORY_FILE structure.
+ * @param fname The output file name.
+ * @return Returns MFILE_OK, or negative error code.
+ */
+short memfile_write_direct(struct MEMORY_FILE *mfile,const char *fname)
+{
+    if ((mfile==NULL) || (fname==NULL))
+        return MFILE_INTERNAL;
+    FILE *ofp;
+    ofp = fopen(fname, "wb");
+    if (ofp==NULL)
+    {
+      mfile->errcode=MFILE_CANNOT_OPEN;
+      return mfile->errcode;
+    }
+    unsigned long wrlen;
+    wrlen=fwrite(mfile->content, 1, mfile->len, ofp);
+    /* Closing may also fail, when flushing the data */
+    if ((fclose(ofp)!=0)||(wrlen!=mfile->len))
+    {
+      remove(fname);
+      mfile->errcode=MFILE_WRITE_ERR;
+      return mfile->errcode;
+    }
+    mfile->errcode=MFILE_OK;
+    return mfile->errcode;
+}
+
+/**
+ * Writes MEMORY_FILE content into disk. The data is written into
+ * temporary file first, which then replaces the destination file.
+ * This way the destination file is never left partially written.
+ * @param mfile Pointer to MEMORY_FILE structure.
+ * @param fname The output file name.
+ * @return Returns MFILE_OK, or negative error code.
+ */
+short memfile_write(struct MEMORY_FILE *mfile,const char *fname)
+{
+    if ((mfile==NULL) || (fname==NULL))
+        return MFILE_INTERNAL;
+    char *tmp_fname;
+    tmp_fname=(char *)malloc(strlen(fname)+5);
+    if (tmp_fname==NULL)
+    {
+      mfile->errcode=MFILE_MALLOC_ERR;
+      return mfile->errcode;
+    }
+    sprintf(tmp_fname,"%s.tmp",fname);
+    if (memfile_write_direct(mfile,tmp_fname)==MFILE_OK)
+    {
+      mfile->errcode=memfile_replace_file(tmp_fname,fname);
+      if (mfile->errcode!=MFILE_OK)
+        remove(tmp_fname);
+    }
+    free(tmp_fname);
+    return mfile->errcode;
+}
+
+/**
+ * Replaces the MEMORY_FILE content with its RNC packed version.
+ * The packed content can be read back by memfile_read(), which
+ * unpacks RNC files automatically.
+ * @param mfile Pointer to MEMORY_FILE structure.
+ * @param level RNC compression level, from RNC_PACK_LEVEL_MIN
+ *     to RNC_PACK_LEVEL_MAX.
+ * @return Returns MFILE_OK, or negative error code.
+ */
+short memfile_pack(struct MEMORY_FILE *mfile,int level)
+{
+    if ((mfile==NULL)||(mfile->content==NULL))
+        return MFILE_INTERNAL;
+    unsigned long plen;
+    unsigned char *pbuf;
+    plen=rnc_pack_bound(mfile->len);
+    pbuf=(unsigned char *)malloc(plen);
+    if (pbuf==NULL)
+    {
+      mfile->errcode=MFILE_MALLOC_ERR;
+      return mfile->errcode;
+    }
+    long retcode;
+    retcode=rnc_pack(mfile->content,mfile->len,pbuf,level);
+    if (retcode<0)
+    {
+      free(pbuf);
+      mfile->errcode=MFILE_INTERNAL;
+      return mfile->errcode;
+    }
+    return memfile_set(mfile,pbuf,retcode,plen);
+}
+
 char *memfile_error(int errcode)
 {
     static char *const errors[] = {
@@ -331,6 +457,7 @@ char *memfile_error(int errcode)
 	"Wrong file size",
 	"Data read error",
 	"Internal error",
+	"Data write error",
 	"Unknown error",
     };
     if ((errcode<0)&&(errcode>=-16))
@@ -33,6 +33,7 @@
 #define MFILE_SIZE_ERR     -19
 #define MFILE_READ_ERR     -20
 #define MFILE_INTERNAL     -21
+#define MFILE_WRITE_ERR    -22
 
 struct MEMORY_FILE
 {
@@ -49,6 +50,10 @@ DLLIMPORT short memfile_free(struct MEMORY_FILE **mfile);
 DLLIMPORT unsigned char *memfile_leave_content(struct MEMORY_FILE **mfile);
 DLLIMPORT short memfile_read(struct MEMORY_FILE *mfile,const char *fname,unsigned long max_size);
 DLLIMPORT short memfile_readnew(struct MEMORY_FILE **mfile,const char *fname,unsigned long max_size);
+DLLIMPORT short memfile_write(struct MEMORY_FILE *mfile,const char *fname);
+DLLIMPORT short memfile_write_direct(struct MEMORY_FILE *mfile,const char *fname);
+DLLIMPORT short memfile_pack(struct MEMORY_FILE *mfile,int level);
+DLLIMPORT short memfile_replace_file(const char *src_fname,const char *dst_fname);
 DLLIMPORT short memfile_add(struct MEMORY_FILE *mfile,
     const unsigned char *buf,unsigned long buf_len);
 DLLIMPORT short memfile_set(struct MEMORY_FILE *mfile,
@@ -5,7 +5,9 @@
  *     Procedures for logging messages into file, and holding them
  *     to print on screen.
  * @par Comment:
- *     None.
+ *     Logged messages are gathered in a lock-free ring buffer, and written
+ *     to file by a separate flusher thread, so logging doesn't wait for
+ *     the disk.
  * @author   Tomasz Lis
  * @date     25 Apr 2008 - 29 Jul 2008
  * @par  Copying and copyrights:
@@ -19,22 +21,73 @@
 #include "msg_log.h"
 
 #include "globals.h"
+#include "lbthread.h"
 
-char *message_prv;
-char *message;
-short message_hold;
-unsigned int message_getcount;
+/* Messages shown on screen are separate for every thread */
+THREAD_LOCAL char *message_prv;
+THREAD_LOCAL char *message;
+THREAD_LOCAL short message_hold;
+THREAD_LOCAL unsigned int message_getcount;
+/* Log file is shared; set it before starting other threads */
 char *msgout_fname;
 
 /**
  * Control behaviour of message logging regarding log file open/close operations.
  * Allowed values:
- *      0 -- open and close log file with every call to log function
+ *      0 -- open and close log file with every flush of the log buffer
  *      1 -- reuse once opened log file (prevents massive 'fopen()'/'fclose()')
  */
 #define REUSE_MESSAGE_LOG_FILE_HANDLE  1
 FILE *msgout_global_fp;
 
+/**
+ * Amount of cells in the ring buffer in which logged messages wait
+ * for being written to file by the flusher thread.
+ */
+#define MESSAGE_LOG_RING_CELLS 2048
+/** Size of text in one cell; longer messages take several cells. */
+#define MESSAGE_LOG_CELL_SIZE 120
+/**
+ * Time, in milliseconds, for which the flusher thread gathers messages
+ * before writing them, unless the ring buffer gets half full.
+ */
+#define MESSAGE_LOG_FLUSH_DELAY 100
+/** Size of the buffer for formatting a message; longer ones are allocated. */
+#define MESSAGE_LOG_LINE_SIZE 1024
+
+/**
+ * Cell of the log ring buffer. The seq is set to position of the cell
+ * plus one when its text is ready to be written.
+ */
+struct MESSAGE_LOG_CELL {
+    volatile long seq;
+    unsigned int len;
+    char text[MESSAGE_LOG_CELL_SIZE];
+};
+
+/**
+ * Ring buffer of logged messages. It is lock-free for the threads which
+ * log: every message reserves consecutive cells by moving the head with
+ * compare-and-swap, then fills them and marks them as ready. Head and tail
+ * are counters of cells ever reserved and written, so head-tail is
+ * the amount of cells in use. Only the lock owner writes the ring to file.
+ */
+static struct MESSAGE_LOG_CELL *msgout_ring=NULL;
+static volatile long msgout_ring_head=0;
+static volatile long msgout_ring_tail=0;
+/** Number of threads waiting in message_log_flush(). */
+static int msgout_flush_waiting=0;
+/** Mutex held while writing the ring to file, and for waiting on conditions. */
+static struct LB_MUTEX *msgout_ring_lock=NULL;
+/** Signalled for the flusher when there are messages to write. */
+static struct LB_COND *msgout_ring_filled=NULL;
+/** Signalled by the writer when the ring contents were written. */
+static struct LB_COND *msgout_ring_drained=NULL;
+/** Flusher thread, or NULL if the messages are written synchronously. */
+static struct LB_THREAD *msgout_flusher=NULL;
+static short msgout_flusher_stop=false;
+/** Most detailed level of messages which are written to log. */
+short msgout_level=MSGLOG_DEBUG;
 
 /**
  * Get/ensure opened global log file.
@@ -72,6 +125,274 @@ static void close_log_file()
 #endif
 }
 
+/**
+ * Returns amount of ring cells reserved and not written yet.
+ */
+static unsigned long log_ring_used(void)
+{
+    return (unsigned long)lb_atomic_get(&msgout_ring_head)
+        - (unsigned long)lb_atomic_get(&msgout_ring_tail);
+}
+
+/**
+ * Writes messages waiting in the ring buffer into log file, up to
+ * the first cell which isn't ready. Must be called with the ring lock
+ * held; threads which log messages don't need the lock.
+ */
+static void log_ring_write(void)
+{
+    unsigned long pos=(unsigned long)lb_atomic_get(&msgout_ring_tail);
+    unsigned long start=pos;
+    FILE *msgout_fp=NULL;
+    while (true)
+    {
+      struct MESSAGE_LOG_CELL *cell=&msgout_ring[pos%MESSAGE_LOG_RING_CELLS];
+      if ((unsigned long)lb_atomic_get(&cell->seq)!=pos+1)
+        break;
+      if (pos==start)
+        msgout_fp = ensure_log_file();
+      /* If the file can't be opened, messages are dropped */
+      if (msgout_fp!=NULL)
+        fwrite(cell->text, 1, cell->len, msgout_fp);
+      pos++;
+    }
+    if (pos==start)
+      return;
+    if (msgout_fp!=NULL)
+      write_log_file( msgout_fp );
+    lb_atomic_set(&msgout_ring_tail,(long)pos);
+    lb_cond_broadcast(msgout_ring_drained);
+}
+
+/**
+ * The flusher thread; writes messages from the ring buffer to file,
+ * so that threads which log them don't wait for the disk.
+ */
+static void log_flusher_thread(void *arg)
+{
+    (void)arg;
+    lb_mutex_lock(msgout_ring_lock);
+    while (!msgout_flusher_stop)
+    {
+      /* Signals are sent without the lock, so they may be missed; */
+      /* waiting is limited, so missed ones only delay writing */
+      if (log_ring_used()==0)
+      {
+        lb_cond_wait_ms(msgout_ring_filled,msgout_ring_lock,MESSAGE_LOG_FLUSH_DELAY);
+        continue;
+      }
+      /* Gathering more messages, so that they're written at once */
+      if ((msgout_flush_waiting==0)&&(log_ring_used() < MESSAGE_LOG_RING_CELLS/2))
+        lb_cond_wait_ms(msgout_ring_filled,msgout_ring_lock,MESSAGE_LOG_FLUSH_DELAY);
+      log_ring_write();
+    }
+    log_ring_write();
+    lb_mutex_unlock(msgout_ring_lock);
+}
+
+/**
+ * Prepares the ring buffer and starts the flusher thread.
+ * If there are no threads, messages are written when the ring is full.
+ * @return Returns true on success, false on error.
+ */
+static short log_ring_start(void)
+{
+    if (msgout_ring==NULL)
+    {
+      msgout_ring=(struct MESSAGE_LOG_CELL *)calloc(MESSAGE_LOG_RING_CELLS,sizeof(struct MESSAGE_LOG_CELL));
+      msgout_ring_head=0;
+      msgout_ring_tail=0;
+    }
+    if (msgout_ring_lock==NULL)
+      msgout_ring_lock=lb_mutex_create();
+    if (msgout_ring_filled==NULL)
+      msgout_ring_filled=lb_cond_create();
+    if (msgout_ring_drained==NULL)
+      msgout_ring_drained=lb_cond_create();
+    if ((msgout_ring==NULL)||(msgout_ring_lock==NULL)||
+        (msgout_ring_filled==NULL)||(msgout_ring_drained==NULL))
+      return false;
+    if ((msgout_flusher==NULL)&&(lb_threads_available()))
+    {
+      msgout_flusher_stop=false;
+      msgout_flusher=lb_thread_start(log_flusher_thread,NULL);
+    }
+    return true;
+}
+
+/**
+ * Writes all messages, stops the flusher thread and frees the ring buffer.
+ */
+static void log_ring_stop(void)
+{
+    if (msgout_flusher!=NULL)
+    {
+      lb_mutex_lock(msgout_ring_lock);
+      msgout_flusher_stop=true;
+      lb_cond_signal(msgout_ring_filled);
+      lb_mutex_unlock(msgout_ring_lock);
+      lb_thread_join(&msgout_flusher);
+    } else
+    if ((msgout_ring_lock!=NULL)&&(msgout_ring!=NULL))
+    {
+      lb_mutex_lock(msgout_ring_lock);
+      log_ring_write();
+      lb_mutex_unlock(msgout_ring_lock);
+    }
+    lb_cond_free(&msgout_ring_filled);
+    lb_cond_free(&msgout_ring_drained);
+    lb_mutex_free(&msgout_ring_lock);
+    free(msgout_ring);
+    msgout_ring=NULL;
+    msgout_ring_head=0;
+    msgout_ring_tail=0;
+}
+
+/**
+ * Reserves given amount of consecutive cells in the ring buffer.
+ * Doesn't lock anything unless the ring is full; then waits until
+ * the flusher writes it, or writes it if there's no flusher.
+ * @return Returns position of the first reserved cell.
+ */
+static unsigned long log_ring_reserve(unsigned long count)
+{
+    while (true)
+    {
+      long head=lb_atomic_get(&msgout_ring_head);
+      unsigned long used=(unsigned long)head-(unsigned long)lb_atomic_get(&msgout_ring_tail);
+      if (used+count <= MESSAGE_LOG_RING_CELLS)
+      {
+        if (lb_atomic_cas(&msgout_ring_head,head,head+(long)count))
+          return (unsigned long)head;
+        continue;
+      }
+      /* The ring is full */
+      lb_mutex_lock(msgout_ring_lock);
+      if (log_ring_used()+count > MESSAGE_LOG_RING_CELLS)
+      {
+        if (msgout_flusher!=NULL)
+        {
+          lb_cond_signal(msgout_ring_filled);
+          lb_cond_wait_ms(msgout_ring_drained,msgout_ring_lock,MESSAGE_LOG_FLUSH_DELAY);
+        } else
+        {
+          log_ring_write();
+        }
+      }
+      lb_mutex_unlock(msgout_ring_lock);
+    }
+}
+
+/**
+ * Adds a message, with line ending, to the ring buffer.
+ * Waits only if the ring is full; too long messages are truncated.
+ */
+static void log_ring_put(const char *text, unsigned long len)
+{
+    /* A message may take up to quarter of the ring */
+    if (len+2 > MESSAGE_LOG_CELL_SIZE*(MESSAGE_LOG_RING_CELLS/4))
+      len=MESSAGE_LOG_CELL_SIZE*(MESSAGE_LOG_RING_CELLS/4)-2;
+    unsigned long count=(len+2+MESSAGE_LOG_CELL_SIZE-1)/MESSAGE_LOG_CELL_SIZE;
+    unsigned long first=log_ring_reserve(count);
+    unsigned long pos;
+    unsigned long i=0;
+    for (pos=first; pos<first+count; pos++)
+    {
+      struct MESSAGE_LOG_CELL *cell=&msgout_ring[pos%MESSAGE_LOG_RING_CELLS];
+      unsigned int part=0;
+      while ((part<MESSAGE_LOG_CELL_SIZE)&&(i<len+2))
+      {
+        if (i<len)
+          cell->text[part]=text[i];
+        else
+          cell->text[part]=(i==len)?'\r':'\n';
+        part++;
+        i++;
+      }
+      cell->len=part;
+      lb_atomic_set(&cell->seq,(long)(pos+1));
+    }
+    /* Waking the flusher when the ring stops being empty, or gets half full */
+    unsigned long used=(unsigned long)first+count-(unsigned long)lb_atomic_get(&msgout_ring_tail);
+    if ((msgout_flusher!=NULL)&&((used==count)||
+        ((used>=MESSAGE_LOG_RING_CELLS/2)&&(used-count<MESSAGE_LOG_RING_CELLS/2))))
+      lb_cond_signal(msgout_ring_filled);
+}
+
+/**
+ * Writes the logged messages into log file, and waits until it is done.
+ * Called automatically on errors and when logging ends; otherwise
+ * the messages are written by flusher thread.
+ */
+void message_log_flush(void)
+{
+    if (msgout_ring_lock==NULL)
+      return;
+    unsigned long end=(unsigned long)lb_atomic_get(&msgout_ring_head);
+    lb_mutex_lock(msgout_ring_lock);
+    msgout_flush_waiting++;
+    while ((long)(end-(unsigned long)lb_atomic_get(&msgout_ring_tail)) > 0)
+    {
+      if (msgout_flusher!=NULL)
+      {
+        lb_cond_signal(msgout_ring_filled);
+        lb_cond_wait_ms(msgout_ring_drained,msgout_ring_lock,MESSAGE_LOG_FLUSH_DELAY);
+      } else
+      {
+        /* Cells reserved by other threads may be not ready yet */
+        log_ring_write();
+        lb_mutex_unlock(msgout_ring_lock);
+        lb_mutex_lock(msgout_ring_lock);
+      }
+    }
+    msgout_flush_waiting--;
+    lb_mutex_unlock(msgout_ring_lock);
+}
+
+/**
+ * Formats message and adds it to the log.
+ * @param format Specifies the string pattern.
+ * @param val List of arguments used in the pattern.
+ */
+static void message_log_buffer_vl(const char *format, va_list val)
+{
+    if (msgout_ring_lock==NULL)
+      return;
+    char text[MESSAGE_LOG_LINE_SIZE];
+    va_list val_cp;
+    int len;
+    va_copy(val_cp, val);
+    len=vsnprintf(text, MESSAGE_LOG_LINE_SIZE, format, val_cp);
+    va_end(val_cp);
+    if (len<0)
+      return;
+    if (len<MESSAGE_LOG_LINE_SIZE)
+    {
+      log_ring_put(text,len);
+      return;
+    }
+    /* Message too long for the local buffer */
+    char *long_text=(char *)malloc(len+1);
+    if (long_text==NULL)
+    {
+      log_ring_put(text,MESSAGE_LOG_LINE_SIZE-1);
+      return;
+    }
+    va_copy(val_cp, val);
+    vsnprintf(long_text, len+1, format, val_cp);
+    va_end(val_cp);
+    log_ring_put(long_text,len);
+    free(long_text);
+}
+
+static void message_log_buffer(const char *format, ...)
+{
+    va_list val;
+    va_start(val, format);
+    message_log_buffer_vl(format, val);
+    va_end(val);
+}
+
 /**
  * Only logs the message, without showing on screen.
  * The va_list version - mainly for internal use.
@@ -81,15 +402,8 @@ static void close_log_file()
 void message_log_vl(const char *format, va_list val)
 {
     if (msgout_fname==NULL) return;
-    FILE *msgout_fp;
-    msgout_fp = ensure_log_file();
-    if (msgout_fp!=NULL)
-    {
-      /* Write to log file if it is opened */
-      vfprintf(msgout_fp, format, val);
-      fprintf(msgout_fp,"\r\n");
-      write_log_file( msgout_fp );
-    }
+    if (msgout_level<MSGLOG_DEBUG) return;
+    message_log_buffer_vl(format, val);
 }
 
 /**
@@ -100,19 +414,14 @@ void message_log_vl(const char *format, va_list val)
 void message_log_simp(const char *str)
 {
     if (msgout_fname==NULL) return;
-    FILE *msgout_fp;
-    msgout_fp = ensure_log_file();
-    /* Write to log file if it is opened */
-    if (msgout_fp!=NULL)
-    {
-      fprintf(msgout_fp, "%s\r\n",str);
-      write_log_file( msgout_fp );
-    }
+    message_log_buffer("%s",str);
 }
 
 /**
  * Only logs the message, without showing on screen.
  * Standard version - allows formatted message.
+ * Can be used from any thread; every message is added as a whole,
+ * so lines from different threads are not mixed.
  * @param format Specifies the string pattern.
  * @param ... List of arguments used in the pattern.
  */
@@ -125,9 +434,47 @@ void message_log(const char *format, ...)
     va_end(val);
 }
 
+/**
+ * Logs the message with given level of detail. Use it through
+ * message_log_lvl() macro, which removes calls with levels
+ * above MSGLOG_COMPILE_LEVEL at compile time.
+ * @param level Detail level of the message, from MSGLOG_* defines.
+ * @param format Specifies the string pattern.
+ * @param ... List of arguments used in the pattern.
+ */
+void message_log_at(short level,const char *format, ...)
+{
+    if ((msgout_fname==NULL)||(level>msgout_level)) return;
+    va_list val;
+    va_start(val, format);
+    message_log_buffer_vl(format, val);
+    va_end(val);
+}
+
+/**
+ * Sets the most detailed level of messages which are written to log.
+ * The level is common for all threads, so it should be set before
+ * other threads start logging.
+ * @param level New log level, from MSGLOG_* defines.
+ */
+void set_msglog_level(short level)
+{
+    msgout_level=level;
+}
+
+/**
+ * Returns the most detailed level of messages which are written to log.
+ * @return Returns log level, from MSGLOG_* defines.
+ */
+short get_msglog_level(void)
+{
+    return msgout_level;
+}
+
 /**
  * Logs the message and prints it into stderr.
  * Sets message_hold, so other messages can't overwrite it.
+ * The message and hold are of the current thread only.
  * @param format Specifies the string pattern.
  * @param ... List of arguments used in the pattern.
  */
@@ -147,8 +494,9 @@ void message_error(const char *format, ...)
     }
     vsprintf(msg, format, val);
     va_end(val);
-    /* Write to log file if it is prepared */
+    /* Write to log file if it is prepared; errors are written at once */
     message_log_simp(msg);
+    message_log_flush();
     /* Store the message */
     message_prv=message;
     message=msg;
@@ -169,6 +517,7 @@ short message_is_empty(void)
 /**
  * Logs the message and prints it into message buffer.
  * The message is set into buffer only if message_hold is not set.
+ * Every thread has its own message buffer.
  * @param format Specifies the string pattern.
  * @param ... List of arguments used in the pattern.
  */
@@ -267,6 +616,7 @@ void message_release(void)
 
 /**
  * Returns pointer to the buffer with the last message.
+ * Messages set by other threads are not visible here.
  * @return Returns pointer to the last message string.
  */
 char *message_get(void)
@@ -286,19 +636,20 @@ char *message_get_prev(void)
 
 /**
  * Sets message log file name. Rewrites it, then writes header and two
- * last messages.
+ * last messages. The log file is shared by all threads, so this should
+ * be called before other threads start using the library.
  * @param fname The file name under which log is written.
  * @return Returns true if the log was created, otherwise false.
  */
 short set_msglog_fname(char *fname)
 {
+    /* Messages logged up to now go to the previous file */
+    log_ring_stop();
+    close_log_file();
+    free(msgout_fname);
+    msgout_fname=NULL;
     if ((fname==NULL)||(fname[0]=='\0'))
-    {
-        msgout_fname=NULL;
         return false;
-    }
-
-    close_log_file();
 
     FILE *msgout_fp;
     msgout_fname=strdup(fname);
@@ -311,7 +662,9 @@ short set_msglog_fname(char *fname)
       if (message!=NULL)
         fprintf(msgout_fp,"%s\r\n",message);
       fclose(msgout_fp);
-      return true;
+      if (log_ring_start())
+        return true;
+      log_ring_stop();
     }
     free(msgout_fname);
     msgout_fname=NULL;
@@ -320,6 +673,7 @@ short set_msglog_fname(char *fname)
 
 /**
  * Clears message log variables without freeing memory (drops any pointers).
+ * Should be called once, before other threads start using the library.
  */
 void init_messages(void)
 {
@@ -332,12 +686,34 @@ void init_messages(void)
 }
 
 /**
- * Frees memory allocated for messages. The pointers are not cleared.
+ * Writes all logged messages, stops the log flusher thread and frees
+ * memory allocated for messages. Other threads must not log anymore.
  */
 void free_messages(void)
 {
+    log_ring_stop();
+    close_log_file();
+    free(msgout_fname);
+    msgout_fname=NULL;
     free(message_prv);
     free(message);
-    free(msgout_fname);
-    close_log_file();
+    message_prv=NULL;
+    message=NULL;
+    message_hold=false;
+    message_getcount=0;
+}
+
+/**
+ * Frees messages of the current thread. Should be called by
+ * every thread which used the library before it ends; the thread which
+ * called init_messages() should use free_messages() instead.
+ */
+void message_thread_end(void)
+{
+    free(message_prv);
+    free(message);
+    message_prv=NULL;
+    message=NULL;
+    message_hold=false;
+    message_getcount=0;
 }
@@ -23,8 +23,26 @@
 
 struct LEVEL;
 
+/* Detail levels of logged messages */
+#define MSGLOG_ERROR  1
+#define MSGLOG_INFO   2
+#define MSGLOG_DEBUG  3
+#define MSGLOG_TRACE  4
+
+/**
+ * Most detailed level of messages compiled in; message_log_lvl() calls
+ * with higher level are removed by the compiler.
+ */
+#ifndef MSGLOG_COMPILE_LEVEL
+#define MSGLOG_COMPILE_LEVEL MSGLOG_TRACE
+#endif
+
+#define message_log_lvl(level, ...) \
+    do { if ((level)<=MSGLOG_COMPILE_LEVEL) message_log_at(level, __VA_ARGS__); } while (0)
+
 DLLIMPORT void init_messages(void);
 DLLIMPORT void free_messages(void);
+DLLIMPORT void message_thread_end(void);
 
 DLLIMPORT void message_error(const char *format, ...);
 DLLIMPORT void message_info(const char *format, ...);
@@ -39,6 +57,10 @@ DLLIMPORT unsigned int message_getcount_get(void);
 DLLIMPORT void message_log(const char *format, ...);
 DLLIMPORT void message_log_simp(const char *str);
 DLLIMPORT void message_log_vl(const char *format, va_list val);
+DLLIMPORT void message_log_at(short level,const char *format, ...);
+DLLIMPORT void message_log_flush(void);
+DLLIMPORT void set_msglog_level(short level);
+DLLIMPORT short get_msglog_level(void);
 
 DLLIMPORT short set_msglog_fname(char *fname);
 
@@ -301,14 +301,13 @@ mt_state		mt_default_state;
  * To generate double-precision random numbers, we need to divide the result
  * of mts_lrand or mts_llrand by 2^32 or 2^64, respectively.  The quickest
  * way to do that on most machines is to multiply by the inverses of those
- * numbers.  However, I don't trust the compiler to correctly convert the
- * corresponding decimal constant.  So we will compute the correct number at
- * run time as part of initialization, which will produce a nice exact
- * result.
+ * numbers.  Both are powers of two, so dividing by the exactly representable
+ * 2^32 gives an exact result at compile time.
  */
-double			mt_32_to_double;
+double			mt_32_to_double = 1.0 / 4294967296.0;
 					/* Multiplier to convert long to dbl */
-double			mt_64_to_double;
+double			mt_64_to_double =
+			  1.0 / 4294967296.0 / 4294967296.0;
 					/* Mult'r to cvt long long to dbl */
 
 /*
@@ -325,29 +324,15 @@ static uint32_t	matrix_decider[2] =
  * Mark a PRNG's state as having been initialized.  This is the only
  * way to set that field nonzero; that way we can be sure that the
  * constants are set properly before the PRNG is used.
- *
- * As a side effect, set up some constants that the PRNG assumes are
- * valid.  These are calculated at initialization time rather than
- * being written as decimal constants because I frankly don't trust
- * the compiler's ASCII conversion routines.
  */
 void mts_mark_initialized(
     mt_state*		state)		/* State vector to mark initialized */
     {
-    int			i;		/* Power of 2 being calculated */
-
     /*
-     * Figure out the proper multiplier for long-to-double conversion.  We
-     * don't worry too much about efficiency, since the assumption is that
-     * initialization is vastly rarer than generation of random numbers.
+     * The multipliers for long-to-double conversion are powers of two,
+     * so they're set exactly at compile time.  Computing them here made
+     * seeding of separate states from many threads race on them.
      */
-    mt_32_to_double = 1.0;
-    for (i = 0;  i < BIT_WIDTH;  i++)
-	mt_32_to_double /= 2.0;
-    mt_64_to_double = mt_32_to_double;
-    for (i = 0;  i < BIT_WIDTH;  i++)
-	mt_64_to_double /= 2.0;
-
     state->initialized = 1;
     }
 
@@ -95,9 +95,16 @@ const unsigned short dir_rot_270[]={
       IDIR_SW,IDIR_WEST,IDIR_NW,IDIR_SOUTH,IDIR_CENTR,IDIR_NORTH,
       IDIR_SE,IDIR_EAST,IDIR_NE, };
 
-short fill_reinforced_corner=true;
-short frail_columns_near_short=true;
-short frail_columns_near_tall=true;
+/* Options copied from LEVOPTIONS by create_columns_for_slab(), per thread */
+THREAD_LOCAL short fill_reinforced_corner=true;
+THREAD_LOCAL short frail_columns_near_short=true;
+THREAD_LOCAL short frail_columns_near_tall=true;
+
+/* Classification of the surrounding which columns are currently made for */
+static THREAD_LOCAL struct SLAB_SURR_CLASS surr_cls;
+static THREAD_LOCAL unsigned char *surr_cls_slb=NULL;
+static THREAD_LOCAL unsigned char *surr_cls_own=NULL;
+static THREAD_LOCAL short surr_cls_valid=false;
 
 /*
  * Returns custom column type name as text
@@ -112,17 +119,26 @@ char *get_custom_column_fullname(unsigned short idx)
 }
 
 /*
- * Executes custom column filling function with given index
+ * Executes custom column filling function with given index.
+ * Generator state is per thread, so threads may fill columns at once.
  */
 short fill_custom_column_data(unsigned short idx,struct COLUMN_REC *clm_recs[9],
         unsigned char *surr_slb,unsigned char *surr_own, unsigned char **surr_tng)
 {
+    surr_cls_slb=surr_slb;
+    surr_cls_own=surr_own;
+    surr_cls_valid=false;
     custom_columns_gen[idx](clm_recs,surr_slb,surr_own,surr_tng);
+    surr_cls_slb=NULL;
+    surr_cls_own=NULL;
     return true;
 }
 
 /*
  * Fills up 9 CLM entries needed for given slab with specified surroundings.
+ * Generator options are taken from optns at every call, and kept
+ * separately for every thread; so threads may create columns at the same
+ * time, even for levels with different options.
  */
 void create_columns_for_slab(struct COLUMN_REC *clm_recs[9],struct LEVOPTIONS *optns,
         unsigned char *surr_slb,unsigned char *surr_own, unsigned char **surr_tng)
@@ -130,6 +146,9 @@ void create_columns_for_slab(struct COLUMN_REC *clm_recs[9],struct LEVOPTIONS *o
   unsigned short slab=surr_slb[IDIR_CENTR];
   frail_columns_near_short=((optns->frail_columns&1)==1);
   frail_columns_near_tall=((optns->frail_columns&2)==2);
+  surr_cls_slb=surr_slb;
+  surr_cls_own=surr_own;
+  surr_cls_valid=false;
   switch (slab)
   {
     case SLAB_TYPE_ROCK:
@@ -256,6 +275,8 @@ void create_columns_for_slab(struct COLUMN_REC *clm_recs[9],struct LEVOPTIONS *o
       create_columns_slb_purple_path(clm_recs,surr_slb,surr_own,surr_tng);
       break;
     }
+  surr_cls_slb=NULL;
+  surr_cls_own=NULL;
 }
 
 /*
@@ -269,6 +290,116 @@ short surrnd_not_enemy(unsigned char *surr_own, short direction)
     return false;
 }
 
+/*
+ * Returns the room corner direction array for given 'same' mask.
+ */
+static const unsigned short *surr_corner_direction(unsigned short same)
+{
+    const unsigned short se3=(1<<IDIR_EAST)|(1<<IDIR_SE)|(1<<IDIR_SOUTH);
+    const unsigned short sw3=(1<<IDIR_SOUTH)|(1<<IDIR_SW)|(1<<IDIR_WEST);
+    const unsigned short nw3=(1<<IDIR_WEST)|(1<<IDIR_NW)|(1<<IDIR_NORTH);
+    const unsigned short ne3=(1<<IDIR_NORTH)|(1<<IDIR_NE)|(1<<IDIR_EAST);
+    const unsigned short se2=(1<<IDIR_EAST)|(1<<IDIR_SOUTH);
+    const unsigned short sw2=(1<<IDIR_SOUTH)|(1<<IDIR_WEST);
+    const unsigned short nw2=(1<<IDIR_WEST)|(1<<IDIR_NORTH);
+    const unsigned short ne2=(1<<IDIR_NORTH)|(1<<IDIR_EAST);
+    if ((same&se3)==se3) return dir_rot_000;
+    if ((same&sw3)==sw3) return dir_rot_090;
+    if ((same&nw3)==nw3) return dir_rot_180;
+    if ((same&ne3)==ne3) return dir_rot_270;
+    if ((same&se2)==se2) return dir_rot_000;
+    if ((same&sw2)==sw2) return dir_rot_090;
+    if ((same&nw2)==nw2) return dir_rot_180;
+    if ((same&ne2)==ne2) return dir_rot_270;
+    return dir_rot_000;
+}
+
+/*
+ * Returns the room edge direction array for given 'same' mask.
+ */
+static const unsigned short *surr_edge_direction(unsigned short same)
+{
+    const unsigned short e5=(1<<IDIR_NORTH)|(1<<IDIR_NE)|(1<<IDIR_EAST)|(1<<IDIR_SE)|(1<<IDIR_SOUTH);
+    const unsigned short s5=(1<<IDIR_EAST)|(1<<IDIR_SE)|(1<<IDIR_SOUTH)|(1<<IDIR_SW)|(1<<IDIR_WEST);
+    const unsigned short w5=(1<<IDIR_SOUTH)|(1<<IDIR_SW)|(1<<IDIR_WEST)|(1<<IDIR_NW)|(1<<IDIR_NORTH);
+    const unsigned short n5=(1<<IDIR_WEST)|(1<<IDIR_NW)|(1<<IDIR_NORTH)|(1<<IDIR_NE)|(1<<IDIR_EAST);
+    const unsigned short e3=(1<<IDIR_NORTH)|(1<<IDIR_EAST)|(1<<IDIR_SOUTH);
+    const unsigned short s3=(1<<IDIR_EAST)|(1<<IDIR_SOUTH)|(1<<IDIR_WEST);
+    const unsigned short w3=(1<<IDIR_SOUTH)|(1<<IDIR_WEST)|(1<<IDIR_NORTH);
+    const unsigned short n3=(1<<IDIR_WEST)|(1<<IDIR_NORTH)|(1<<IDIR_EAST);
+    if ((same&e5)==e5) return dir_rot_000;
+    if ((same&s5)==s5) return dir_rot_090;
+    if ((same&w5)==w5) return dir_rot_180;
+    if ((same&n5)==n5) return dir_rot_270;
+    if ((same&e3)==e3) return dir_rot_000;
+    if ((same&s3)==s3) return dir_rot_090;
+    if ((same&w3)==w3) return dir_rot_180;
+    if ((same&n3)==n3) return dir_rot_270;
+    return dir_rot_000;
+}
+
+/*
+ * Classifies slabs around the central one. Computing all the masks at once
+ * allows column generators to use bit tests instead of calling
+ * the slab_is_*() functions for every direction again and again.
+ * surr_own may be NULL, then all slabs are treated as having central owner.
+ */
+void classify_slab_surround(struct SLAB_SURR_CLASS *cls,
+        const unsigned char *surr_slb,const unsigned char *surr_own)
+{
+    unsigned short slab=surr_slb[IDIR_CENTR];
+    memset(cls,0,sizeof(struct SLAB_SURR_CLASS));
+    int i;
+    for (i=0;i<9;i++)
+    {
+      unsigned short bit=(1<<i);
+      unsigned short surr=surr_slb[i];
+      short own_same=true;
+      short own_friend=true;
+      if (surr_own!=NULL)
+      {
+        own_same=(surr_own[i]==surr_own[IDIR_CENTR]);
+        own_friend=own_same||(surr_own[i]>=PLAYER_UNSET);
+      }
+      if ((surr==slab)&&(own_same)) cls->same|=bit;
+      if (own_friend) cls->friendly|=bit;
+      if (slab_is_room(surr)) cls->room|=bit;
+      if (slab_is_wall(surr)) cls->wall|=bit;
+      if (slab_is_door(surr)) cls->door|=bit;
+      if (slab_is_tall_unclmabl(surr)) cls->tall_unclmabl|=bit;
+      if (slab_is_short_unclmabl(surr)) cls->short_unclmabl|=bit;
+      if (surr==SLAB_TYPE_WATER) cls->water|=bit;
+      if (surr==SLAB_TYPE_LAVA) cls->lava|=bit;
+      if ((cls->room&bit)||slab_is_space(surr)) cls->short_slb|=bit;
+      if ((cls->tall_unclmabl|cls->wall)&bit) cls->tall|=bit;
+      if ((cls->door&bit)||(surr==SLAB_TYPE_CLAIMED)) cls->claimedgnd|=bit;
+    }
+    cls->corner_dir=surr_corner_direction(cls->same);
+    cls->edge_dir=surr_edge_direction(cls->same);
+}
+
+/*
+ * Returns classification of given surrounding. If columns are being created
+ * for this surrounding, the classification is computed only once per slab;
+ * otherwise it is computed at every call. The result is stored per thread,
+ * and is valid until next call from the same thread.
+ */
+const struct SLAB_SURR_CLASS *get_slab_surr_class(unsigned char *surr_slb,unsigned char *surr_own)
+{
+    if ((surr_slb==surr_cls_slb)&&(surr_own==surr_cls_own))
+    {
+      if (!surr_cls_valid)
+      {
+        classify_slab_surround(&surr_cls,surr_slb,surr_own);
+        surr_cls_valid=true;
+      }
+      return &surr_cls;
+    }
+    classify_slab_surround(&surr_cls,surr_slb,surr_own);
+    surr_cls_valid=false;
+    return &surr_cls;
+}
+
 /*
  * A helper function for using surr_tng array
  */
@@ -458,6 +589,7 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
   const unsigned short dir_a[]={IDIR_WEST, IDIR_NORTH, IDIR_EAST, IDIR_SOUTH};
   const unsigned short dir_b[]={IDIR_NORTH, IDIR_EAST, IDIR_SOUTH, IDIR_WEST};
   const unsigned short dir_c[]={IDIR_NW, IDIR_NE, IDIR_SE, IDIR_SW};
+  const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
   int i;
   /*Filling matrix */
   for (i=0;i<9;i++)
@@ -479,10 +611,10 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
     else
       fill_column_earthground(clm_recs[dir_c[i]], surr_own[IDIR_CENTR]);
     /* If we're surrounded by our wall, and there is something short also - red brick */
-    if (((slab_is_wall(surr_slb[dir_a[i]])&&surrnd_not_enemy(surr_own,dir_a[i]))
-       &&((slab_is_short(surr_slb[dir_b[i]]))||(!surrnd_not_enemy(surr_own,dir_b[i]))))
-       ||((slab_is_wall(surr_slb[dir_b[i]])&&surrnd_not_enemy(surr_own,dir_b[i]))
-       &&((slab_is_short(surr_slb[dir_a[i]]))||(!surrnd_not_enemy(surr_own,dir_a[i])))))
+    if (((SURR_BIT(cls->wall,dir_a[i])&&SURR_BIT(cls->friendly,dir_a[i]))
+       &&((SURR_BIT(cls->short_slb,dir_b[i]))||(!SURR_BIT(cls->friendly,dir_b[i]))))
+       ||((SURR_BIT(cls->wall,dir_b[i])&&SURR_BIT(cls->friendly,dir_b[i]))
+       &&((SURR_BIT(cls->short_slb,dir_a[i]))||(!SURR_BIT(cls->friendly,dir_a[i])))))
     {
       /*Note: can't use modify_liquid_surrounding() because more than one cube changes near water */
       /*corner columns */
@@ -493,23 +625,23 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
           place_column_wall_redsmbrick_dkbtm(clm_recs[dir_c[i]], surr_own[IDIR_CENTR]);
     } else
     /* If we're surrounded by our wall, and there are doors in front - red brick, but without relief */
-    if (((slab_is_wall(surr_slb[dir_a[i]])&&surrnd_not_enemy(surr_own,dir_a[i]))
-       &&((slab_is_door(surr_slb[dir_b[i]]))||(!surrnd_not_enemy(surr_own,dir_b[i]))))
-       ||((slab_is_wall(surr_slb[dir_b[i]])&&surrnd_not_enemy(surr_own,dir_b[i]))
-       &&((slab_is_door(surr_slb[dir_a[i]]))||(!surrnd_not_enemy(surr_own,dir_a[i])))))
+    if (((SURR_BIT(cls->wall,dir_a[i])&&SURR_BIT(cls->friendly,dir_a[i]))
+       &&((SURR_BIT(cls->door,dir_b[i]))||(!SURR_BIT(cls->friendly,dir_b[i]))))
+       ||((SURR_BIT(cls->wall,dir_b[i])&&SURR_BIT(cls->friendly,dir_b[i]))
+       &&((SURR_BIT(cls->door,dir_a[i]))||(!SURR_BIT(cls->friendly,dir_a[i])))))
     {
         place_column_wall_redsmbrick_dkbtm(clm_recs[dir_c[i]], surr_own[IDIR_CENTR]);
-        if (slab_is_door(surr_slb[dir_a[i]]))
+        if (SURR_BIT(cls->door,dir_a[i]))
           allow_relief[dir_a[i]]=false;
-        if (slab_is_door(surr_slb[dir_b[i]]))
+        if (SURR_BIT(cls->door,dir_b[i]))
           allow_relief[dir_b[i]]=false;
     } else
     /* if we're surrouned with unowned tall thing on _both_ sides, fill with dirt */
-    if ((slab_is_tall_unclmabl(surr_slb[dir_a[i]])&&slab_is_tall_unclmabl(surr_slb[dir_b[i]]))
-      ||(((slab_is_tall(surr_slb[dir_a[i]])&&surrnd_not_enemy(surr_own,dir_a[i]))
-      &&(slab_is_tall(surr_slb[dir_b[i]])&& surrnd_not_enemy(surr_own,dir_b[i])))))
+    if ((SURR_BIT(cls->tall_unclmabl,dir_a[i])&&SURR_BIT(cls->tall_unclmabl,dir_b[i]))
+      ||(((SURR_BIT(cls->tall,dir_a[i])&&SURR_BIT(cls->friendly,dir_a[i]))
+      &&(SURR_BIT(cls->tall,dir_b[i])&& SURR_BIT(cls->friendly,dir_b[i])))))
     {
-      if ((fill_reinforced_corner)&&(slab_is_short(surr_slb[dir_c[i]]))
+      if ((fill_reinforced_corner)&&(SURR_BIT(cls->short_slb,dir_c[i]))
           &&(!(surr_slb[dir_c[i]]==SLAB_TYPE_PATH)))
       {
         if (fill_reinforced_corner==1)
@@ -545,8 +677,8 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
   }
   /*These cannot be taken in simple 'for' loop, because different directions uses */
   /* different fill_column_wall_redsmbrick_* functions. */
-  if ((slab_is_wall(surr_slb[IDIR_NORTH])&&surrnd_not_enemy(surr_own,IDIR_NORTH))
-    ||slab_is_tall_unclmabl(surr_slb[IDIR_NORTH]))
+  if ((SURR_BIT(cls->wall,IDIR_NORTH)&&SURR_BIT(cls->friendly,IDIR_NORTH))
+    ||SURR_BIT(cls->tall_unclmabl,IDIR_NORTH))
   {
     fill_column_earth(clm_recs[IDIR_NORTH],surr_own[IDIR_CENTR]);
     allow_relief[IDIR_NORTH]=false;
@@ -567,8 +699,8 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
     place_column_wall_redsmbrick_b(clm_recs[IDIR_NORTH], surr_own[IDIR_CENTR]);
   }
 
-  if ((slab_is_wall(surr_slb[IDIR_EAST])&&surrnd_not_enemy(surr_own,IDIR_EAST))
-    ||slab_is_tall_unclmabl(surr_slb[IDIR_EAST]))
+  if ((SURR_BIT(cls->wall,IDIR_EAST)&&SURR_BIT(cls->friendly,IDIR_EAST))
+    ||SURR_BIT(cls->tall_unclmabl,IDIR_EAST))
   {
     fill_column_earth(clm_recs[IDIR_EAST],surr_own[IDIR_CENTR]);
     allow_relief[IDIR_EAST]=false;
@@ -589,8 +721,8 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
       place_column_wall_redsmbrick_b(clm_recs[IDIR_EAST], surr_own[IDIR_CENTR]);
   }
 
-  if ((slab_is_wall(surr_slb[IDIR_SOUTH])&&surrnd_not_enemy(surr_own,IDIR_SOUTH))
-    ||slab_is_tall_unclmabl(surr_slb[IDIR_SOUTH]))
+  if ((SURR_BIT(cls->wall,IDIR_SOUTH)&&SURR_BIT(cls->friendly,IDIR_SOUTH))
+    ||SURR_BIT(cls->tall_unclmabl,IDIR_SOUTH))
   {
     fill_column_earth(clm_recs[IDIR_SOUTH],surr_own[IDIR_CENTR]);
     allow_relief[IDIR_SOUTH]=false;
@@ -611,8 +743,8 @@ void create_columns_slb_wallbrick(struct COLUMN_REC *clm_recs[9], short *allow_r
       place_column_wall_redsmbrick_c(clm_recs[IDIR_SOUTH], surr_own[IDIR_CENTR]);
   }
 
-  if ((slab_is_wall(surr_slb[IDIR_WEST])&&surrnd_not_enemy(surr_own,IDIR_WEST))
-    ||slab_is_tall_unclmabl(surr_slb[IDIR_WEST]))
+  if ((SURR_BIT(cls->wall,IDIR_WEST)&&SURR_BIT(cls->friendly,IDIR_WEST))
+    ||SURR_BIT(cls->tall_unclmabl,IDIR_WEST))
   {
     fill_column_earth(clm_recs[IDIR_WEST],surr_own[IDIR_CENTR]);
     allow_relief[IDIR_WEST]=false;
@@ -647,21 +779,22 @@ void fill_columns_slb_roomrelief(struct COLUMN_REC *clm_recs[9], short *allow_re
   const unsigned short dir_c[]={IDIR_SW,   IDIR_NE,   IDIR_SE,   IDIR_SE};
   const unsigned short dir_d[]={IDIR_NORTH,IDIR_WEST, IDIR_NORTH,IDIR_WEST,};
   const unsigned short dir_e[]={IDIR_SOUTH,IDIR_EAST, IDIR_SOUTH,IDIR_EAST,};
+  const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
   int i;
   for (i=0;i<4;i++)
   {
     unsigned short slab=surr_slb[dir_b[i]];
-    if ((allow_relief[dir_b[i]])&&(slab_is_room(slab)))
+    if ((allow_relief[dir_b[i]])&&(SURR_BIT(cls->room,dir_b[i])))
     {
       /*TODO: check edge and corner if they're set properly */
       short corner=false;
       short edge=false;
       /* 'edge' means that the wall starts/ends/changes direction after current slab */
-      if (((!slab_is_short(surr_slb[dir_d[i]]))&&(surrnd_not_enemy(surr_own,dir_d[i])))
-        ||((!slab_is_short(surr_slb[dir_e[i]]))&&(surrnd_not_enemy(surr_own,dir_e[i]))))
+      if (((!SURR_BIT(cls->short_slb,dir_d[i]))&&(SURR_BIT(cls->friendly,dir_d[i])))
+        ||((!SURR_BIT(cls->short_slb,dir_e[i]))&&(SURR_BIT(cls->friendly,dir_e[i]))))
         edge=true;
       /* 'corner' means that the room ends after current slab */
-      if ((!slab_is_room(surr_slb[dir_a[i]]))||(!slab_is_room(surr_slb[dir_c[i]])))
+      if ((!SURR_BIT(cls->room,dir_a[i]))||(!SURR_BIT(cls->room,dir_c[i])))
         corner=true;
       if (fill_side_columns_room_relief(clm_recs[dir_a[i]],clm_recs[dir_b[i]],
           clm_recs[dir_c[i]],slab,surr_own[IDIR_CENTR],corner,edge))
@@ -860,6 +993,7 @@ void create_columns_slb_wall_force_relief_splatbody(struct COLUMN_REC *clm_recs[
 {
     const unsigned short dir_a[]={IDIR_NW,   IDIR_NE,   IDIR_SE,   IDIR_SW};
     const unsigned short dir_b[]={IDIR_WEST, IDIR_NORTH,IDIR_EAST, IDIR_SOUTH};
+    const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
     /* Filling the wall with brick & cobblestones on edges */
     int i;
     for (i=0;i<4;i++)
@@ -871,27 +1005,27 @@ void create_columns_slb_wall_force_relief_splatbody(struct COLUMN_REC *clm_recs[
     /* Finding best orientation for the relief */
     const unsigned short *dir;
     short draw_oposite;
-    if (slab_is_short(surr_slb[IDIR_WEST]) && slab_is_short(surr_slb[IDIR_NORTH]))
+    if (SURR_BIT(cls->short_slb,IDIR_WEST) && SURR_BIT(cls->short_slb,IDIR_NORTH))
     {
       dir=dir_rot_000;
       draw_oposite=false;
     } else
-    if (slab_is_short(surr_slb[IDIR_EAST]) && slab_is_short(surr_slb[IDIR_SOUTH]))
+    if (SURR_BIT(cls->short_slb,IDIR_EAST) && SURR_BIT(cls->short_slb,IDIR_SOUTH))
     {
       dir=dir_rot_180;
       draw_oposite=false;
     } else
-    if (slab_is_short(surr_slb[IDIR_EAST]) && slab_is_short(surr_slb[IDIR_WEST]))
+    if (SURR_BIT(cls->short_slb,IDIR_EAST) && SURR_BIT(cls->short_slb,IDIR_WEST))
     {
       dir=dir_rot_090;
       draw_oposite=true;
     } else
-    if (slab_is_short(surr_slb[IDIR_NORTH]) && slab_is_short(surr_slb[IDIR_SOUTH]))
+    if (SURR_BIT(cls->short_slb,IDIR_NORTH) && SURR_BIT(cls->short_slb,IDIR_SOUTH))
     {
       dir=dir_rot_000;
       draw_oposite=true;
     } else
-    if (slab_is_short(surr_slb[IDIR_EAST]) || slab_is_short(surr_slb[IDIR_SOUTH]))
+    if (SURR_BIT(cls->short_slb,IDIR_EAST) || SURR_BIT(cls->short_slb,IDIR_SOUTH))
     {
       dir=dir_rot_180;
       draw_oposite=false;
@@ -1118,6 +1252,7 @@ void create_columns_slb_claimed(struct COLUMN_REC *clm_recs[9],
   const unsigned short dir_a[]={IDIR_WEST, IDIR_NORTH, IDIR_EAST, IDIR_SOUTH};
   const unsigned short dir_b[]={IDIR_NORTH, IDIR_EAST, IDIR_SOUTH, IDIR_WEST};
   const unsigned short dir_c[]={IDIR_NW, IDIR_NE, IDIR_SE, IDIR_SW};
+  const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
 
   /*Center */
   fill_column_claimedgnd_centr(clm_recs[IDIR_CENTR], surr_own[IDIR_CENTR]);
@@ -1129,12 +1264,12 @@ void create_columns_slb_claimed(struct COLUMN_REC *clm_recs[9],
      fill_column_rec_sim(clm_recs[dir_c[i]], 0, 0x0ce,
          0x07f, 0x0, 0x0, 0x0, 0x0, 0, 0, 0);
 
-    if (slab_is_claimedgnd(surr_slb[dir_a[i]])&&surrnd_not_enemy(surr_own,dir_a[i])&&
-        slab_is_claimedgnd(surr_slb[dir_b[i]])&&surrnd_not_enemy(surr_own,dir_b[i]))
+    if (SURR_BIT(cls->claimedgnd,dir_a[i])&&SURR_BIT(cls->friendly,dir_a[i])&&
+        SURR_BIT(cls->claimedgnd,dir_b[i])&&SURR_BIT(cls->friendly,dir_b[i]))
     { /*Surrounded by our area */
        clm_recs[dir_c[i]]->c[0]=0x07e +rnd(3);
     } else
-    if (slab_is_claimedgnd(surr_slb[dir_a[i]])&&surrnd_not_enemy(surr_own,dir_a[i]))
+    if (SURR_BIT(cls->claimedgnd,dir_a[i])&&SURR_BIT(cls->friendly,dir_a[i]))
     { /*our on side A only */
         switch (dir_c[i])
         {
@@ -1152,7 +1287,7 @@ void create_columns_slb_claimed(struct COLUMN_REC *clm_recs[9],
            break;
         }
     } else
-    if (slab_is_claimedgnd(surr_slb[dir_b[i]])&&surrnd_not_enemy(surr_own,dir_b[i]))
+    if (SURR_BIT(cls->claimedgnd,dir_b[i])&&SURR_BIT(cls->friendly,dir_b[i]))
     { /*our on side B only */
         switch (dir_c[i])
         {
@@ -1195,7 +1330,7 @@ void create_columns_slb_claimed(struct COLUMN_REC *clm_recs[9],
     fill_column_rec_sim(clm_recs[dir_a[i]], 0, 0x0ce,
          0x07f, 0x0, 0x0, 0x0, 0x0, 0, 0, 0);
 
-    if (slab_is_claimedgnd(surr_slb[dir_a[i]])&&surrnd_not_enemy(surr_own,dir_a[i]))
+    if (SURR_BIT(cls->claimedgnd,dir_a[i])&&SURR_BIT(cls->friendly,dir_a[i]))
     {
        clm_recs[dir_a[i]]->c[0]=0x07e +rnd(3);
     } else
@@ -1504,21 +1639,22 @@ void modify_frail_columns(struct COLUMN_REC *clm_recs[9],
     const unsigned short dir_a[]={IDIR_WEST, IDIR_NORTH, IDIR_EAST, IDIR_SOUTH};
     const unsigned short dir_b[]={IDIR_NORTH, IDIR_EAST, IDIR_SOUTH, IDIR_WEST};
     const unsigned short dir_c[]={IDIR_NW, IDIR_NE, IDIR_SE, IDIR_SW};
+    const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
     /*This gives smaller probability of column change if there are no adjacent tall slabs */
     int base_prob=33;
-    if (slab_is_tall_unclmabl(surr_slb[IDIR_WEST])||slab_is_tall_unclmabl(surr_slb[IDIR_NORTH])||
-       slab_is_tall_unclmabl(surr_slb[IDIR_EAST])||slab_is_tall_unclmabl(surr_slb[IDIR_SOUTH]))
+    if (SURR_BIT(cls->tall_unclmabl,IDIR_WEST)||SURR_BIT(cls->tall_unclmabl,IDIR_NORTH)||
+       SURR_BIT(cls->tall_unclmabl,IDIR_EAST)||SURR_BIT(cls->tall_unclmabl,IDIR_SOUTH))
        base_prob=66;
     int i;
     /*Let's take all corners at once, in a loop */
     for (i=0;i<4;i++)
     {
       /* All the changes near short unclaimable slabs */
-      if (slab_is_short_unclmabl(surr_slb[dir_a[i]]) &&
-          slab_is_short_unclmabl(surr_slb[dir_b[i]]) && (frail_columns_near_short))
+      if (SURR_BIT(cls->short_unclmabl,dir_a[i]) &&
+          SURR_BIT(cls->short_unclmabl,dir_b[i]) && (frail_columns_near_short))
       {
           if ((surr_slb[dir_a[i]]==SLAB_TYPE_PATH)&&(surr_slb[dir_b[i]]==SLAB_TYPE_PATH)&&
-              slab_is_tall(surr_slb[dir_c[i]]))
+              SURR_BIT(cls->tall,dir_c[i]))
           {
             /* Path on both sides, and tall diagonal slabs - in this case we shouldn't */
             /* modify the columns, as this may cause imps to stuck */
@@ -1541,8 +1677,8 @@ void modify_frail_columns(struct COLUMN_REC *clm_recs[9],
       } else
       /* All the changes near tall unclaimable slabs */
       /* These are mods by Tomasz Lis - originally tall slabs do not affect others */
-      if (slab_is_tall_unclmabl(surr_slb[dir_a[i]]) &&
-          slab_is_tall_unclmabl(surr_slb[dir_b[i]]) && (frail_columns_near_tall))
+      if (SURR_BIT(cls->tall_unclmabl,dir_a[i]) &&
+          SURR_BIT(cls->tall_unclmabl,dir_b[i]) && (frail_columns_near_tall))
       {
           /* Replacing part of gold/gems with dirt if it is near */
           if ((surr_slb[IDIR_CENTR]!=SLAB_TYPE_EARTH)&&(surr_slb[IDIR_CENTR]!=SLAB_TYPE_TORCHDIRT)&&
@@ -1615,33 +1751,36 @@ short modify_liquid_surrounding_advncd(struct COLUMN_REC *clm_recs[9],
   const unsigned short dir_a[]={IDIR_WEST, IDIR_NORTH, IDIR_EAST, IDIR_SOUTH};
   const unsigned short dir_b[]={IDIR_NORTH, IDIR_EAST, IDIR_SOUTH, IDIR_WEST};
   const unsigned short dir_c[]={IDIR_NW, IDIR_NE, IDIR_SE, IDIR_SW};
-  unsigned short slab=surr_slb[IDIR_CENTR];
-  unsigned char ownr=surr_own[IDIR_CENTR];
   /*initial tests */
   if ((liq_level<0)||(liq_level>7)) return false;
   if (surr_slb==NULL) return false;
+  const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(
+      (unsigned char *)surr_slb,(unsigned char *)surr_own);
+  /*only the side slabs may affect columns */
+  const unsigned short sides=(1<<IDIR_NORTH)|(1<<IDIR_EAST)|(1<<IDIR_SOUTH)|(1<<IDIR_WEST);
+  if (((cls->water|cls->lava)&sides)==0) return false;
   short result=false;
   int i;
   /*corner columns */
   for (i=0;i<4;i++)
   {
-    if ((surr_slb[dir_a[i]]==SLAB_TYPE_WATER)||(surr_slb[dir_b[i]]==SLAB_TYPE_WATER))
+    if (SURR_BIT(cls->water,dir_a[i])||SURR_BIT(cls->water,dir_b[i]))
     {
-        if ((surr_slb[dir_a[i]]==slab)&&(surr_own[dir_a[i]]==ownr))
+        if (SURR_BIT(cls->same,dir_a[i]))
          clm_recs[dir_c[i]]->c[liq_level]=water_cube[dir_b[i]];
         else
-        if ((surr_slb[dir_b[i]]==slab)&&(surr_own[dir_b[i]]==ownr))
+        if (SURR_BIT(cls->same,dir_b[i]))
          clm_recs[dir_c[i]]->c[liq_level]=water_cube[dir_a[i]];
         else
          clm_recs[dir_c[i]]->c[liq_level]=water_cube[dir_c[i]];
        result=true;
     } else
-    if ((surr_slb[dir_a[i]]==SLAB_TYPE_LAVA)||(surr_slb[dir_b[i]]==SLAB_TYPE_LAVA))
+    if (SURR_BIT(cls->lava,dir_a[i])||SURR_BIT(cls->lava,dir_b[i]))
     {
-        if ((surr_slb[dir_a[i]]==slab)&&(surr_own[dir_a[i]]==ownr))
+        if (SURR_BIT(cls->same,dir_a[i]))
          clm_recs[dir_c[i]]->c[liq_level]=lava_cube[dir_b[i]];
         else
-        if ((surr_slb[dir_b[i]]==slab)&&(surr_own[dir_b[i]]==ownr))
+        if (SURR_BIT(cls->same,dir_b[i]))
          clm_recs[dir_c[i]]->c[liq_level]=lava_cube[dir_a[i]];
         else
          clm_recs[dir_c[i]]->c[liq_level]=lava_cube[dir_c[i]];
@@ -1651,12 +1790,12 @@ short modify_liquid_surrounding_advncd(struct COLUMN_REC *clm_recs[9],
   /*And the edge columns */
   for (i=0;i<4;i++)
   {
-    if ((surr_slb[dir_a[i]]==SLAB_TYPE_WATER))
+    if (SURR_BIT(cls->water,dir_a[i]))
     {
        clm_recs[dir_a[i]]->c[liq_level]=water_cube[dir_a[i]];
        result=true;
     } else
-    if ((surr_slb[dir_a[i]]==SLAB_TYPE_LAVA))
+    if (SURR_BIT(cls->lava,dir_a[i]))
     {
        clm_recs[dir_a[i]]->c[liq_level]=lava_cube[dir_a[i]];
        result=true;
@@ -1671,37 +1810,8 @@ short modify_liquid_surrounding_advncd(struct COLUMN_REC *clm_recs[9],
  */
 unsigned short *get_room_corner_direction_indices(unsigned char *surr_slb,unsigned char *surr_own)
 {
-    unsigned short slab=surr_slb[IDIR_CENTR];
-    unsigned char ownr=surr_own[IDIR_CENTR];
-    if (((surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr)))
-      return (unsigned short *)dir_rot_000;
-    if (((surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr)))
-      return (unsigned short *)dir_rot_090;
-    if (((surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr)))
-      return (unsigned short *)dir_rot_180;
-    if (((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr)))
-      return (unsigned short *)dir_rot_270;
-    if (((surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr)))
-      return (unsigned short *)dir_rot_000;
-    if (((surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr)))
-      return (unsigned short *)dir_rot_090;
-    if (((surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr)))
-      return (unsigned short *)dir_rot_180;
-    if (((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr)))
-      return (unsigned short *)dir_rot_270;
-  return (unsigned short *)dir_rot_000;
+    const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
+    return (unsigned short *)cls->corner_dir;
 }
 
 /*
@@ -1710,70 +1820,32 @@ unsigned short *get_room_corner_direction_indices(unsigned char *surr_slb,unsign
  */
 unsigned short *get_room_edge_direction_indices(unsigned char *surr_slb,unsigned char *surr_own)
 {
-    unsigned short slab=surr_slb[IDIR_CENTR];
-    unsigned char ownr=surr_own[IDIR_CENTR];
-
-  if (((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr)))
-    return (unsigned short *)dir_rot_000;
-  if (((surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr)))
-    return (unsigned short *)dir_rot_090;
-  if (((surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr)))
-    return (unsigned short *)dir_rot_180;
-  if (((surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr)))
-    return (unsigned short *)dir_rot_270;
-
-  if (((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr)))
-    return (unsigned short *)dir_rot_000;
-  if (((surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr)))
-    return (unsigned short *)dir_rot_090;
-  if (((surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr)))
-    return (unsigned short *)dir_rot_180;
-  if (((surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr)))
-    return (unsigned short *)dir_rot_270;
-
-  return (unsigned short *)dir_rot_000;
+    const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
+    return (unsigned short *)cls->edge_dir;
 }
 
 void create_columns_slb_room(cr_clm_func cr_floor,cr_clm_func cr_edge,
         cr_clm_func cr_corner,cr_clm_func cr_inside,cr_clm_func cr_nearinsd,
         struct COLUMN_REC *clm_recs[9], unsigned char *surr_slb,unsigned char *surr_own, unsigned char **surr_tng)
 {
-  unsigned short slab=surr_slb[IDIR_CENTR];
-  unsigned char ownr=surr_own[IDIR_CENTR];
+  const unsigned short sides=(1<<IDIR_NORTH)|(1<<IDIR_EAST)|(1<<IDIR_SOUTH)|(1<<IDIR_WEST);
+  const unsigned short corners=(1<<IDIR_NE)|(1<<IDIR_SE)|(1<<IDIR_SW)|(1<<IDIR_NW);
+  const unsigned short edge5[]={
+      (1<<IDIR_NORTH)|(1<<IDIR_NE)|(1<<IDIR_EAST)|(1<<IDIR_SE)|(1<<IDIR_SOUTH),
+      (1<<IDIR_EAST)|(1<<IDIR_SE)|(1<<IDIR_SOUTH)|(1<<IDIR_SW)|(1<<IDIR_WEST),
+      (1<<IDIR_SOUTH)|(1<<IDIR_SW)|(1<<IDIR_WEST)|(1<<IDIR_NW)|(1<<IDIR_NORTH),
+      (1<<IDIR_WEST)|(1<<IDIR_NW)|(1<<IDIR_NORTH)|(1<<IDIR_NE)|(1<<IDIR_EAST), };
+  /*For corners, two sides are same and the other two are surely something else */
+  const unsigned short corner2[]={
+      (1<<IDIR_NORTH)|(1<<IDIR_EAST), (1<<IDIR_EAST)|(1<<IDIR_SOUTH),
+      (1<<IDIR_SOUTH)|(1<<IDIR_WEST), (1<<IDIR_WEST)|(1<<IDIR_NORTH), };
+  const struct SLAB_SURR_CLASS *cls=get_slab_surr_class(surr_slb,surr_own);
+  unsigned short same=cls->same;
+  int i;
   /*Checking if completely surrounded */
-  if ((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-      (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-      (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-      (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr))
+  if ((same&sides)==sides)
   {
-      if  ((surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) &&
-           (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) &&
-           (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) &&
-           (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr))
+      if ((same&corners)==corners)
       {
           cr_inside(clm_recs,surr_slb,surr_own,surr_tng);
       } else
@@ -1785,58 +1857,23 @@ void create_columns_slb_room(cr_clm_func cr_floor,cr_clm_func cr_edge,
       return;
   }
   /*If not completely, maybe we're surrounded from 3 sides (5 with corners)? */
-  if (((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr)) ||
-      ((surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-       (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) &&
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr)) ||
-      ((surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-       (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) &&
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr)) ||
-      ((surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-       (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr) &&
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-       (surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) &&
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr)))
+  for (i=0;i<4;i++)
   {
+    if ((same&edge5[i])==edge5[i])
+    {
       cr_edge(clm_recs,surr_slb,surr_own,surr_tng);
       return;
+    }
   }
   /*If still nothing, maybe we have same surround from two sides and 1 corner, */
   /* and another two are surely something else */
-  if (((surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-/*       (surr_slb[IDIR_NE]==slab)&&(surr_own[IDIR_NE]==ownr) && */
-       (surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-      ((surr_slb[IDIR_SOUTH]!=slab)||(surr_own[IDIR_SOUTH]!=ownr)) &&
-      ((surr_slb[IDIR_WEST]!=slab)||(surr_own[IDIR_WEST]!=ownr))) ||
-
-      ((surr_slb[IDIR_EAST]==slab)&&(surr_own[IDIR_EAST]==ownr) &&
-/*       (surr_slb[IDIR_SE]==slab)&&(surr_own[IDIR_SE]==ownr) && */
-       (surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-      ((surr_slb[IDIR_NORTH]!=slab)||(surr_own[IDIR_NORTH]!=ownr)) &&
-      ((surr_slb[IDIR_WEST]!=slab)||(surr_own[IDIR_WEST]!=ownr))) ||
-
-      ((surr_slb[IDIR_SOUTH]==slab)&&(surr_own[IDIR_SOUTH]==ownr) &&
-/*       (surr_slb[IDIR_SW]==slab)&&(surr_own[IDIR_SW]==ownr) && */
-       (surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-      ((surr_slb[IDIR_NORTH]!=slab)||(surr_own[IDIR_NORTH]!=ownr)) &&
-      ((surr_slb[IDIR_EAST]!=slab)||(surr_own[IDIR_EAST]!=ownr))) ||
-
-      ((surr_slb[IDIR_WEST]==slab)&&(surr_own[IDIR_WEST]==ownr) &&
-/*       (surr_slb[IDIR_NW]==slab)&&(surr_own[IDIR_NW]==ownr) && */
-       (surr_slb[IDIR_NORTH]==slab)&&(surr_own[IDIR_NORTH]==ownr) &&
-      ((surr_slb[IDIR_SOUTH]!=slab)||(surr_own[IDIR_SOUTH]!=ownr)) &&
-      ((surr_slb[IDIR_EAST]!=slab)||(surr_own[IDIR_EAST]!=ownr))))
+  for (i=0;i<4;i++)
   {
+    if ((same&sides)==corner2[i])
+    {
       cr_corner(clm_recs,surr_slb,surr_own,surr_tng);
       return;
+    }
   }
   /*If nothing found - just draw floor of this room */
   cr_floor(clm_recs,surr_slb,surr_own,surr_tng);
@@ -33,6 +33,33 @@ struct DK_CUSTOM_CLM {
 typedef void (*cr_clm_func)(struct COLUMN_REC *clm_recs[9],
         unsigned char *surr_slb,unsigned char *surr_own, unsigned char **surr_tng);
 
+/*
+ * Classification of slab surrounding, computed once per slab.
+ * Every mask has bit (1<<IDIR_*) set if the slab in that direction
+ * matches the condition.
+ */
+struct SLAB_SURR_CLASS {
+    /* Same slab and owner as the central one */
+    unsigned short same;
+    /* Owned by the central slab owner, or unowned */
+    unsigned short friendly;
+    unsigned short room;
+    unsigned short wall;
+    unsigned short door;
+    unsigned short tall;
+    unsigned short tall_unclmabl;
+    unsigned short short_slb;
+    unsigned short short_unclmabl;
+    unsigned short claimedgnd;
+    unsigned short water;
+    unsigned short lava;
+    /* Direction arrays for room corners and edges */
+    const unsigned short *corner_dir;
+    const unsigned short *edge_dir;
+  };
+
+#define SURR_BIT(mask,dir) (((mask)>>(dir))&1)
+
 DLLIMPORT unsigned short column_wib_entry(struct COLUMN_REC *clm_rec,
     struct COLUMN_REC *clm_rec_n,struct COLUMN_REC *clm_rec_w,struct COLUMN_REC *clm_rec_nw);
 DLLIMPORT short column_wib_animate(unsigned int clm);
@@ -281,5 +308,8 @@ void create_columns_slb_rockcaped_claimcave(struct COLUMN_REC *clm_recs[9],
         unsigned char *surr_slb,unsigned char *surr_own, unsigned char **surr_tng);
 
 short surrnd_not_enemy(unsigned char *surr_own, short direction);
+void classify_slab_surround(struct SLAB_SURR_CLASS *cls,
+        const unsigned char *surr_slb,const unsigned char *surr_own);
+const struct SLAB_SURR_CLASS *get_slab_surr_class(unsigned char *surr_slb,unsigned char *surr_own);
 
 #endif /* ADIKT_OBJCOLMN_H */
@@ -26,6 +26,10 @@
 #include "bulcommn.h"
 #include "arr_utils.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 const char *cube_fullnames[]={
  "empty cube",          "standard earth 1",    "standard earth 2",    "standard earth 3",   /*000 */
  "earth bright top L",  "earth bright top C",  "earth bright top R",  "earth n/water L",
@@ -168,6 +172,23 @@ const unsigned short animated_cubes[]={
       0x0201, 0x0202, 0x0203, /*unknown - are used in template (?!) */
 };
 
+/* Cube property bits, stored in cube_props[] */
+#define CUBEPROP_WIB_ANIMATE   0x01
+#define CUBEPROP_ANIMATED      0x02
+/* Size of the cube properties table; covers all cubes from the arrays above */
+#define CUBE_PROPS_COUNT       0x0400
+
+/* Properties of cubes; cube_props_verify() checks that they agree
+ * with the arrays above */
+static const unsigned char cube_props[CUBE_PROPS_COUNT]={
+    [0x0201]          = CUBEPROP_ANIMATED,
+    [0x0202]          = CUBEPROP_ANIMATED,
+    [0x0203]          = CUBEPROP_ANIMATED,
+    [CUBE_ANI_WATER]  = CUBEPROP_WIB_ANIMATE|CUBEPROP_ANIMATED,
+    [CUBE_ANI_LAVADK] = CUBEPROP_WIB_ANIMATE|CUBEPROP_ANIMATED,
+    [CUBE_ANI_LAVABR] = CUBEPROP_WIB_ANIMATE|CUBEPROP_ANIMATED,
+};
+
 /*
  * Creates empty COLUMN_REC structure, sets default values inside
 */
@@ -335,41 +356,10 @@ void get_clm_entry(struct COLUMN_REC *clm_rec, const unsigned char *clmentry)
  */
 short compare_column_recs(struct COLUMN_REC *clm_rec1, struct COLUMN_REC *clm_rec2)
 {
-  if (clm_rec1->height != clm_rec2->height)
-    return false;
-  if (clm_rec1->solid != clm_rec2->solid)
-    return false;
-  if (clm_rec1->lintel != clm_rec2->lintel)
-    return false;
-  /*unsigned short height=clm_rec1->height;*/
-  unsigned int solid=clm_rec1->solid;
-  if (clm_rec1->base!=clm_rec2->base)
-    return false;
-  if ((solid&1))
-    if (clm_rec1->c[0]!=clm_rec2->c[0])
-      return false;
-  if ((solid&2))
-    if (clm_rec1->c[1]!=clm_rec2->c[1])
-      return false;
-  if ((solid&4))
-    if (clm_rec1->c[2]!=clm_rec2->c[2])
-      return false;
-  if ((solid&8))
-    if (clm_rec1->c[3]!=clm_rec2->c[3])
-      return false;
-  if ((solid&16))
-    if (clm_rec1->c[4]!=clm_rec2->c[4])
-      return false;
-  if ((solid&32))
-    if (clm_rec1->c[5]!=clm_rec2->c[5])
-      return false;
-  if ((solid&64))
-    if (clm_rec1->c[6]!=clm_rec2->c[6])
-      return false;
-  if ((solid&128))
-    if (clm_rec1->c[7]!=clm_rec2->c[7])
-      return false;
-  return true;
+  struct COLUMN_KEY key1,key2;
+  clm_rec_to_key(&key1,clm_rec1);
+  clm_rec_to_key(&key2,clm_rec2);
+  return compare_column_keys(&key1,&key2);
 }
 
 /*
@@ -377,78 +367,204 @@ short compare_column_recs(struct COLUMN_REC *clm_rec1, struct COLUMN_REC *clm_re
  */
 short compare_column_entries(const unsigned char *clmentry1, const unsigned char *clmentry2)
 {
-   /*comparing 'lintel' and 'height', but not 'permanent' */
-    if ((clmentry1[2]&0x0fe)!=(clmentry2[2]&0x0fe))
-        return false;
-    /* Comparing 'solid' and 'base' */
-    if (memcmp(clmentry1+3,clmentry2+3,4)!=0)
+  struct COLUMN_KEY key;
+  clm_entry_to_key(&key,clmentry1);
+  return compare_column_entry_key(clmentry2,&key);
+}
+
+/*
+ * Clears the key bytes which don't affect the column look.
+ */
+static void column_key_normalize(struct COLUMN_KEY *key)
+{
+    unsigned char *x=key->b;
+    unsigned int solid;
+    int i;
+    /* USE counter, permanent flag and orientation */
+    x[0]=0;
+    x[1]=0;
+    x[2]&=0x0fe;
+    x[7]=0;
+    /* Cubes not marked in the solid mask */
+    solid=x[3];
+    for (i=0;i<8;i++)
+    {
+      if ((solid&(1<<i))==0)
+      {
+        x[8+(i<<1)]=0;
+        x[9+(i<<1)]=0;
+      }
+    }
+}
+
+/*
+ * Creates packed column key from raw CLM entry.
+ */
+void clm_entry_to_key(struct COLUMN_KEY *key, const unsigned char *clmentry)
+{
+    memcpy(key->b,clmentry,COLUMN_KEY_SIZE);
+    column_key_normalize(key);
+}
+
+/*
+ * Creates packed column key from COLUMN_REC.
+ */
+void clm_rec_to_key(struct COLUMN_KEY *key, const struct COLUMN_REC *clm_rec)
+{
+    unsigned char *x=key->b;
+    int i;
+    x[0]=0;
+    x[1]=0;
+    x[2]=((clm_rec->lintel&7)<<1)+((clm_rec->height&15)<<4);
+    x[3]=clm_rec->solid&255;
+    x[4]=(clm_rec->solid>>8)&255;
+    x[5]=clm_rec->base&255;
+    x[6]=(clm_rec->base>>8)&255;
+    x[7]=0;
+    for (i=0;i<8;i++)
+    {
+      x[8+(i<<1)]=clm_rec->c[i]&255;
+      x[9+(i<<1)]=(clm_rec->c[i]>>8)&255;
+    }
+    column_key_normalize(key);
+}
+
+/*
+ * Determines if the two packed column keys are identical.
+ */
+short compare_column_keys(const struct COLUMN_KEY *key1, const struct COLUMN_KEY *key2)
+{
+#if defined(__SSE2__)
+    __m128i a,b;
+    a=_mm_loadu_si128((const __m128i *)key1->b);
+    b=_mm_loadu_si128((const __m128i *)key2->b);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a,b))!=0x0ffff)
         return false;
-    /* Comparing cube values */
-    if (memcmp(clmentry1+8,clmentry2+8,15)!=0)
+    a=_mm_loadl_epi64((const __m128i *)(key1->b+16));
+    b=_mm_loadl_epi64((const __m128i *)(key2->b+16));
+    return (_mm_movemask_epi8(_mm_cmpeq_epi8(a,b))==0x0ffff);
+#else
+    return (memcmp(key1->b,key2->b,COLUMN_KEY_SIZE)==0);
+#endif
+}
+
+/*
+ * Determines if raw CLM entry looks identically to the column
+ * represented by given key. The entry is not unpacked.
+ */
+short compare_column_entry_key(const unsigned char *clmentry, const struct COLUMN_KEY *key)
+{
+    struct COLUMN_KEY ekey;
+    /* Quick reject on height, lintel, solid and base */
+    if (((clmentry[2]&0x0fe)!=key->b[2])||(memcmp(clmentry+3,key->b+3,4)!=0))
         return false;
-    return true;
+    clm_entry_to_key(&ekey,clmentry);
+    return compare_column_keys(&ekey,key);
 }
 
-unsigned short compute_clm_rec_height(const struct COLUMN_REC *clm_rec)
+/*
+ * Returns 64-bit hash of the packed column key.
+ * Equal keys always have equal hashes.
+ */
+unsigned long long hash_column_key(const struct COLUMN_KEY *key)
+{
+    unsigned long long h;
+    int i;
+    h=0x9e3779b97f4a7c15ULL;
+    for (i=0;i<COLUMN_KEY_SIZE;i+=8)
+    {
+      unsigned long long w;
+      memcpy(&w,key->b+i,8);
+      h^=w;
+      h*=0xff51afd7ed558ccdULL;
+      h^=(h>>32);
+    }
+    h^=(h>>29);
+    h*=0xc4ceb9fe1a85ec53ULL;
+    h^=(h>>32);
+    return h;
+}
+
+/*
+ * Computes height of a column with given cubes.
+ */
+static unsigned short compute_cubes_height(unsigned int base,const unsigned int *c)
 {
-    if (clm_rec==NULL) return 0;
     /*First test - 3 free bottom columns makes height at the bottom. */
-    if ((clm_rec->c[0]==0) && (clm_rec->c[1]==0) && (clm_rec->c[2]==0))
+    if ((c[0]==0) && (c[1]==0) && (c[2]==0))
       return 0;
-    if ((clm_rec->c[1]==0) && (clm_rec->c[2]==0) && (clm_rec->c[3]==0))
+    if ((c[1]==0) && (c[2]==0) && (c[3]==0))
       return 1;
-    if ((clm_rec->c[2]==0) && (clm_rec->c[3]==0) && (clm_rec->c[4]==0))
+    if ((c[2]==0) && (c[3]==0) && (c[4]==0))
       return 2;
-    if ((clm_rec->c[3]==0) && (clm_rec->c[4]==0) && (clm_rec->c[5]==0))
+    if ((c[3]==0) && (c[4]==0) && (c[5]==0))
       return 3;
     /*Door when they are opening/open */
-    if ((clm_rec->c[0]==0x094) && (clm_rec->c[1]==0x0))
+    if ((c[0]==0x094) && (c[1]==0x0))
       return 1;
     /*Strange iron door from map 67 (that's probably wrong entry - but the warn message for it annoys me) */
-    if ((clm_rec->base==0x0b1) && (clm_rec->c[0]==0x0) && (clm_rec->c[1]==0x17c))
+    if ((base==0x0b1) && (c[0]==0x0) && (c[1]==0x17c))
       return 0;
-    if ((clm_rec->c[7]!=0))
-      return 8;
-    if ((clm_rec->c[6]!=0))
-      return 7;
-    if ((clm_rec->c[5]!=0))
-      return 6;
-    if ((clm_rec->c[4]!=0))
-      return 5;
-    if ((clm_rec->c[3]!=0))
-      return 4;
-    if ((clm_rec->c[2]!=0))
-      return 3;
-    if ((clm_rec->c[1]!=0))
-      return 2;
-    if ((clm_rec->c[0]!=0))
-      return 1;
+    int i;
+    for (i=7;i>=0;i--)
+    {
+      if (c[i]!=0)
+        return i+1;
+    }
     return 0;
 }
 
-unsigned short compute_clm_rec_solid(const struct COLUMN_REC *clm_rec)
+/*
+ * Computes solid mask of a column with given cubes.
+ */
+static unsigned short compute_cubes_solid(const unsigned int *c)
 {
-    if (clm_rec==NULL) return 0;
     unsigned short solid=0;
-    if ((clm_rec->c[7]!=0))
-      solid|=128;
-    if ((clm_rec->c[6]!=0))
-      solid|=64;
-    if ((clm_rec->c[5]!=0))
-      solid|=32;
-    if ((clm_rec->c[4]!=0))
-      solid|=16;
-    if ((clm_rec->c[3]!=0))
-      solid|=8;
-    if ((clm_rec->c[2]!=0))
-      solid|=4;
-    if ((clm_rec->c[1]!=0))
-      solid|=2;
-    if ((clm_rec->c[0]!=0))
-      solid|=1;
+    int i;
+    for (i=0;i<8;i++)
+    {
+      if (c[i]!=0)
+        solid|=(1<<i);
+    }
     return solid;
 }
 
+unsigned short compute_clm_rec_height(const struct COLUMN_REC *clm_rec)
+{
+    if (clm_rec==NULL) return 0;
+    return compute_cubes_height(clm_rec->base,clm_rec->c);
+}
+
+unsigned short compute_clm_rec_solid(const struct COLUMN_REC *clm_rec)
+{
+    if (clm_rec==NULL) return 0;
+    return compute_cubes_solid(clm_rec->c);
+}
+
+/*
+ * Computes proper height of the raw CLM entry from its cubes.
+ */
+unsigned short compute_clm_entry_height(const unsigned char *clmentry)
+{
+    unsigned int c[8];
+    int i;
+    for (i=0;i<8;i++)
+      c[i]=read_int16_le_buf(clmentry+8+(i<<1));
+    return compute_cubes_height(read_int16_le_buf(clmentry+5),c);
+}
+
+/*
+ * Computes proper solid mask of the raw CLM entry from its cubes.
+ */
+unsigned short compute_clm_entry_solid(const unsigned char *clmentry)
+{
+    unsigned int c[8];
+    int i;
+    for (i=0;i<8;i++)
+      c[i]=read_int16_le_buf(clmentry+8+(i<<1));
+    return compute_cubes_solid(c);
+}
+
 unsigned int get_clm_entry_use(const unsigned char *clmentry)
 {
     return (unsigned int)clmentry[0]+(clmentry[1]<<8);
@@ -540,47 +656,93 @@ short clm_rec_copy(struct COLUMN_REC *dest_rec,const struct COLUMN_REC *src_rec)
  */
 short clm_verify_entry(const unsigned char *clmentry, char *err_msg)
 {
-  struct COLUMN_REC *clm_rec;
-  clm_rec=create_column_rec();
-  get_clm_entry(clm_rec, clmentry);
   int i;
   for (i=0;i<9;i++)
   {
     unsigned int cube;
     if (i==0)
-      cube=clm_rec->base;
+      cube=get_clm_entry_base(clmentry);
     else
-      cube=clm_rec->c[i-1];
+      cube=read_int16_le_buf(clmentry+6+(i<<1));
     if ((cube>CUBE_MAX_INDEX)&&(!is_animated_cube(cube)))
     {
         sprintf(err_msg,"Cube entry %d too large (%u>%d)",i,cube,CUBE_MAX_INDEX);
         return VERIF_WARN;
     }
   }
-  unsigned int prop_solid=compute_clm_rec_solid(clm_rec);
-  if (clm_rec->solid != prop_solid)
+  unsigned int prop_solid=compute_clm_entry_solid(clmentry);
+  if (get_clm_entry_solid(clmentry) != prop_solid)
   {
         sprintf(err_msg,"Solid property should be %u",prop_solid);
         return VERIF_WARN;
   }
-  unsigned int prop_height=compute_clm_rec_height(clm_rec);
-  if (clm_rec->height != prop_height)
+  unsigned int prop_height=compute_clm_entry_height(clmentry);
+  if (get_clm_entry_height(clmentry) != prop_height)
   {
         sprintf(err_msg,"Height property should be %u",prop_height);
         return VERIF_WARN;
   }
-  free_column_rec(clm_rec);
   return VERIF_OK;
 }
 
+/*
+ * Verifies the cube properties table against wib_columns_animate
+ * and animated_cubes arrays.
+ */
+short cube_props_verify(char *err_msg)
+{
+    unsigned int cube;
+    for (cube=0;cube<CUBE_PROPS_COUNT;cube++)
+    {
+      unsigned char prop=0;
+      if (arr_ushort_pos(wib_columns_animate,cube,
+          sizeof(wib_columns_animate)/sizeof(unsigned short))>=0)
+        prop|=CUBEPROP_WIB_ANIMATE;
+      if (arr_ushort_pos(animated_cubes,cube,
+          sizeof(animated_cubes)/sizeof(unsigned short))>=0)
+        prop|=CUBEPROP_ANIMATED;
+      if (cube_props[cube]!=prop)
+      {
+        sprintf(err_msg,"Cube %04x properties are %02x, should be %02x",
+            cube,(unsigned int)cube_props[cube],(unsigned int)prop);
+        return VERIF_ERROR;
+      }
+    }
+    return VERIF_OK;
+}
+
+/*
+ * Returns property bits of given cube.
+ */
+static unsigned char get_cube_props(unsigned int cube)
+{
+    if (cube>=CUBE_PROPS_COUNT)
+      return 0;
+    return cube_props[cube];
+}
+
 /*
  * Returns if the column should be animated (contains water or lava, or similar)
  */
 short cube_wib_animate(unsigned int cube)
 {
-    int array_count=sizeof(wib_columns_animate)/sizeof(unsigned short);
-    int idx=arr_ushort_pos(wib_columns_animate,cube,array_count);
-    if (idx>=0) return true;
+    return ((get_cube_props(cube)&CUBEPROP_WIB_ANIMATE)!=0);
+}
+
+/*
+ * Returns if the CLM entry contains cubes which should be animated
+ */
+short clm_entry_wib_animate(const unsigned char *clmentry)
+{
+    if (cube_wib_animate(get_clm_entry_base(clmentry)))
+      return true;
+    unsigned short solid=get_clm_entry_solid(clmentry);
+    int i;
+    for (i=0;i<8;i++)
+    {
+      if ((solid&(1<<i))&&(cube_wib_animate(read_int16_le_buf(clmentry+(i<<1)+8))))
+        return true;
+    }
     return false;
 }
 
@@ -589,10 +751,7 @@ short cube_wib_animate(unsigned int cube)
  */
 short is_animated_cube(unsigned int cube)
 {
-    int array_count=sizeof(animated_cubes)/sizeof(unsigned short);
-    int idx=arr_ushort_pos(animated_cubes,cube,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_cube_props(cube)&CUBEPROP_ANIMATED)!=0);
 }
 
 /*
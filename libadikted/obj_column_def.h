@@ -46,6 +46,17 @@ struct COLUMN_REC {
     unsigned int c[8];
   };
 
+/**
+ * Packed column key - the CLM entry with all bytes which don't affect
+ * the column look cleared. These are USE counter, permanent flag,
+ * orientation and cubes not marked in the solid mask. Two columns
+ * look identically if their keys are equal.
+ */
+#define COLUMN_KEY_SIZE 24
+struct COLUMN_KEY {
+    unsigned char b[COLUMN_KEY_SIZE];
+  };
+
 /* Functions for maintaining COLUMN_REC structure */
 
 DLLIMPORT struct COLUMN_REC *create_column_rec(void);
@@ -75,6 +86,14 @@ DLLIMPORT short clm_rec_copy(struct COLUMN_REC *dest_rec,const struct COLUMN_REC
 DLLIMPORT void set_clm_entry(unsigned char *clmentry, struct COLUMN_REC *clm_rec);
 DLLIMPORT void get_clm_entry(struct COLUMN_REC *clm_rec, const unsigned char *clmentry);
 
+/* Packed column keys, for comparing and hashing columns */
+
+DLLIMPORT void clm_entry_to_key(struct COLUMN_KEY *key, const unsigned char *clmentry);
+DLLIMPORT void clm_rec_to_key(struct COLUMN_KEY *key, const struct COLUMN_REC *clm_rec);
+DLLIMPORT short compare_column_keys(const struct COLUMN_KEY *key1, const struct COLUMN_KEY *key2);
+DLLIMPORT short compare_column_entry_key(const unsigned char *clmentry, const struct COLUMN_KEY *key);
+DLLIMPORT unsigned long long hash_column_key(const struct COLUMN_KEY *key);
+
 /* Functions for working directly on clmentry, without converting to clm_rec */
 
 DLLIMPORT short compare_column_entries(const unsigned char *clmentry1, const unsigned char *clmentry2);
@@ -87,10 +106,14 @@ DLLIMPORT unsigned short get_clm_entry_height(const unsigned char *clmentry);
 DLLIMPORT unsigned short get_clm_entry_solid(const unsigned char *clmentry);
 DLLIMPORT unsigned short get_clm_entry_base(const unsigned char *clmentry);
 DLLIMPORT unsigned short get_clm_entry_topcube(const unsigned char *clmentry);
+DLLIMPORT unsigned short compute_clm_entry_height(const unsigned char *clmentry);
+DLLIMPORT unsigned short compute_clm_entry_solid(const unsigned char *clmentry);
 
 
 short clm_verify_entry(const unsigned char *clmentry, char *err_msg);
+DLLIMPORT short cube_props_verify(char *err_msg);
 DLLIMPORT short cube_wib_animate(unsigned int cube);
+DLLIMPORT short clm_entry_wib_animate(const unsigned char *clmentry);
 DLLIMPORT short is_animated_cube(unsigned int cube);
 unsigned short column_wib_entry(struct COLUMN_REC *clm_rec,
     struct COLUMN_REC *clm_rec_n,struct COLUMN_REC *clm_rec_w,struct COLUMN_REC *clm_rec_nw);
@@ -24,6 +24,7 @@
 #include "obj_things.h"
 #include "bulcommn.h"
 #include "arr_utils.h"
+#include "rng.h"
 
 char const SLB_UNKN_LTEXT[]="Unknown slab";
 char const SLB_ROCK_LTEXT[]="Rock";
@@ -115,6 +116,66 @@ const unsigned short slabs_doors[]={
     SLAB_TYPE_DOORMAGIC1, SLAB_TYPE_DOORMAGIC2,
 };
 
+/* Slab property bits; the predicates below read them from slab_props[].
+ * Slabs without any of the UNCLMABL bits are claimable. */
+#define SLBPROP_ROOM           0x0001
+#define SLBPROP_DOOR           0x0002
+#define SLBPROP_WALL           0x0004
+#define SLBPROP_WEALTH         0x0008
+#define SLBPROP_SPACE          0x0010
+#define SLBPROP_LIQUID         0x0020
+#define SLBPROP_TALL_UNCLMABL  0x0040
+#define SLBPROP_SHORT_UNCLMABL 0x0080
+#define SLBPROP_SHORT          0x0100
+#define SLBPROP_TALL           0x0200
+#define SLBPROP_SHORT_CLMABL   0x0400
+#define SLBPROP_CLAIMEDGND     0x0800
+#define SLBPROP_ALLOWS_TORCH   0x1000
+#define SLAB_PROPS_COUNT       256
+
+/* Properties of every slab type; slab_props_verify() checks that they
+ * agree with the slabs_* arrays */
+static const unsigned short slab_props[SLAB_PROPS_COUNT]={
+    [SLAB_TYPE_ROCK]        = SLBPROP_TALL_UNCLMABL|SLBPROP_TALL,
+    [SLAB_TYPE_GOLD]        = SLBPROP_WEALTH|SLBPROP_TALL_UNCLMABL|SLBPROP_TALL,
+    [SLAB_TYPE_EARTH]       = SLBPROP_TALL_UNCLMABL|SLBPROP_TALL,
+    [SLAB_TYPE_TORCHDIRT]   = SLBPROP_TALL_UNCLMABL|SLBPROP_TALL,
+    [SLAB_TYPE_WALLDRAPE]   = SLBPROP_WALL|SLBPROP_TALL,
+    [SLAB_TYPE_WALLTORCH]   = SLBPROP_WALL|SLBPROP_TALL,
+    [SLAB_TYPE_WALLWTWINS]  = SLBPROP_WALL|SLBPROP_TALL,
+    [SLAB_TYPE_WALLWWOMAN]  = SLBPROP_WALL|SLBPROP_TALL,
+    [SLAB_TYPE_WALLPAIRSHR] = SLBPROP_WALL|SLBPROP_TALL,
+    [SLAB_TYPE_PATH]        = SLBPROP_SPACE|SLBPROP_SHORT_UNCLMABL|SLBPROP_SHORT|SLBPROP_ALLOWS_TORCH,
+    [SLAB_TYPE_CLAIMED]     = SLBPROP_SPACE|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND|SLBPROP_ALLOWS_TORCH,
+    [SLAB_TYPE_LAVA]        = SLBPROP_SPACE|SLBPROP_LIQUID|SLBPROP_SHORT_UNCLMABL|SLBPROP_SHORT,
+    [SLAB_TYPE_WATER]       = SLBPROP_SPACE|SLBPROP_LIQUID|SLBPROP_SHORT_UNCLMABL|SLBPROP_SHORT,
+    [SLAB_TYPE_PORTAL]      = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_TREASURE]    = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_LIBRARY]     = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_PRISONCASE]  = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_TORTURE]     = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_TRAINING]    = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_DUNGHEART]   = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_WORKSHOP]    = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_SCAVENGER]   = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_TEMPLE]      = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_GRAVEYARD]   = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_HATCHERY]    = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_LAIR]        = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_BARRACKS]    = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_DOORWOOD1]   = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORWOOD2]   = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORBRACE1]  = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORBRACE2]  = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORIRON1]   = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORIRON2]   = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORMAGIC1]  = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_DOORMAGIC2]  = SLBPROP_DOOR|SLBPROP_SHORT_CLMABL|SLBPROP_CLAIMEDGND,
+    [SLAB_TYPE_BRIDGE]      = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+    [SLAB_TYPE_GEMS]        = SLBPROP_WEALTH|SLBPROP_TALL_UNCLMABL|SLBPROP_TALL,
+    [SLAB_TYPE_GUARDPOST]   = SLBPROP_ROOM|SLBPROP_SHORT|SLBPROP_SHORT_CLMABL,
+};
+
 const char *all_slabs_fullnames[]={
 
      SLB_ROCK_LTEXT,SLB_GOLD_LTEXT,              /*00 */
@@ -194,6 +255,7 @@ void update_slab_owners(struct LEVEL *lvl)
 short place_room_rndpos(struct LEVEL *lvl, __attribute__((unused)) const unsigned short rslab,
     __attribute__((unused)) const unsigned char rown, __attribute__((unused)) const struct IPOINT_2D *rsize)
 {
+    struct RNG_STREAM *prev_rng=rng_stream_bind(&(lvl->rng));
     int surrnd_size=20;
     /*struct IPOINT_2D rpos;*/
     while (surrnd_size>4)
@@ -216,6 +278,7 @@ short place_room_rndpos(struct LEVEL *lvl, __attribute__((unused)) const unsigne
       surrnd_size--;
     }
     /* If we're here, this means we couldn't find place for heart. */
+    rng_stream_bind(prev_rng);
     return false;
 }
 
@@ -309,31 +372,86 @@ int slab_siblings_oftype(struct LEVEL *lvl,int x,int y,unsigned short slab_type)
     return amount;
 }
 
+/*
+ * Sets given property bit for all slabs listed in an array.
+ */
+static void slab_props_mark(unsigned short *props,const unsigned short *slabs,
+    int count,unsigned short prop)
+{
+    int i;
+    for (i=0;i<count;i++)
+      if (slabs[i]<SLAB_PROPS_COUNT)
+        props[slabs[i]]|=prop;
+}
+
+/*
+ * Verifies the slab properties table. Basic properties should be the ones
+ * from slabs_* arrays, the others should be combinations of basic ones.
+ */
+short slab_props_verify(char *err_msg)
+{
+    unsigned short props[SLAB_PROPS_COUNT];
+    int i;
+    memset(props,0,sizeof(props));
+    slab_props_mark(props,slabs_rooms,sizeof(slabs_rooms)/sizeof(unsigned short),SLBPROP_ROOM);
+    slab_props_mark(props,slabs_doors,sizeof(slabs_doors)/sizeof(unsigned short),SLBPROP_DOOR);
+    slab_props_mark(props,slabs_walls,sizeof(slabs_walls)/sizeof(unsigned short),SLBPROP_WALL);
+    slab_props_mark(props,slabs_wealth,sizeof(slabs_wealth)/sizeof(unsigned short),SLBPROP_WEALTH);
+    slab_props_mark(props,slabs_space,sizeof(slabs_space)/sizeof(unsigned short),SLBPROP_SPACE);
+    slab_props_mark(props,slabs_liquid,sizeof(slabs_liquid)/sizeof(unsigned short),SLBPROP_LIQUID);
+    slab_props_mark(props,slabs_tall_unclmabl,sizeof(slabs_tall_unclmabl)/sizeof(unsigned short),
+        SLBPROP_TALL_UNCLMABL);
+    slab_props_mark(props,slabs_short_unclmabl,sizeof(slabs_short_unclmabl)/sizeof(unsigned short),
+        SLBPROP_SHORT_UNCLMABL);
+    for (i=0;i<SLAB_PROPS_COUNT;i++)
+    {
+      unsigned short prop=props[i];
+      /*Rooms are short, but there are also other short things */
+      if (prop&(SLBPROP_ROOM|SLBPROP_SPACE))
+        prop|=SLBPROP_SHORT;
+      if (prop&(SLBPROP_TALL_UNCLMABL|SLBPROP_WALL))
+        prop|=SLBPROP_TALL;
+      if ((prop&SLBPROP_DOOR)||(i==SLAB_TYPE_CLAIMED))
+        prop|=SLBPROP_CLAIMEDGND;
+      /*Rooms are short and usually claimed */
+      if (prop&(SLBPROP_ROOM|SLBPROP_CLAIMEDGND))
+        prop|=SLBPROP_SHORT_CLMABL;
+      if ((prop&(SLBPROP_SHORT|SLBPROP_ROOM|SLBPROP_LIQUID))==SLBPROP_SHORT)
+        prop|=SLBPROP_ALLOWS_TORCH;
+      if (slab_props[i]!=prop)
+      {
+        sprintf(err_msg,"Slab %d properties are %04x, should be %04x",
+            i,(unsigned int)slab_props[i],(unsigned int)prop);
+        return VERIF_ERROR;
+      }
+    }
+    return VERIF_OK;
+}
+
+/*
+ * Returns property bits of given slab type. Slab types beyond the table
+ * are not listed in any array, so they have no properties.
+ */
+static unsigned short get_slab_props(unsigned short slab_type)
+{
+    if (slab_type>=SLAB_PROPS_COUNT)
+      return 0;
+    return slab_props[slab_type];
+}
+
 short slab_is_room(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_rooms)/sizeof(unsigned short);
-    /*All rooms are listed in slabs_rooms array */
-    int idx=arr_ushort_pos(slabs_rooms,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_ROOM)!=0);
 }
 
 short slab_is_door(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_doors)/sizeof(unsigned short);
-    /*All doors are listed in slabs_doors array */
-    int idx=arr_ushort_pos(slabs_doors,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_DOOR)!=0);
 }
 
 short slab_is_wall(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_walls)/sizeof(unsigned short);
-    /*All walls are listed in slabs_walls array */
-    int idx=arr_ushort_pos(slabs_walls,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_WALL)!=0);
 }
 
 unsigned short get_random_wall_slab(void)
@@ -346,86 +464,52 @@ unsigned short get_random_wall_slab(void)
 
 short slab_is_wealth(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_wealth)/sizeof(unsigned short);
-    int idx=arr_ushort_pos(slabs_wealth,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_WEALTH)!=0);
 }
 
 short slab_is_space(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_space)/sizeof(unsigned short);
-    /*All such things are listed in slabs_space array */
-    int idx=arr_ushort_pos(slabs_space,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_SPACE)!=0);
 }
 
 short slab_is_liquid(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_liquid)/sizeof(unsigned short);
-    /*All such things are listed in slabs_liquid array */
-    int idx=arr_ushort_pos(slabs_liquid,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_LIQUID)!=0);
 }
 
 short slab_is_tall_unclmabl(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_tall_unclmabl)/sizeof(unsigned short);
-    /*All such things are listed in slabs_tall_unclmabl array */
-    int idx=arr_ushort_pos(slabs_tall_unclmabl,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_TALL_UNCLMABL)!=0);
 }
 
 short slab_is_short_unclmabl(unsigned short slab_type)
 {
-     int array_count=sizeof(slabs_short_unclmabl)/sizeof(unsigned short);
-    /*All such things are listed in slabs_x array */
-    int idx=arr_ushort_pos(slabs_short_unclmabl,slab_type,array_count);
-    if (idx>=0) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_SHORT_UNCLMABL)!=0);
 }
 
 short slab_is_short(unsigned short slab_type)
 {
-    /*Rooms are short */
-    if (slab_is_room(slab_type)) return true;
-    /*But there are also other short things */
-    if (slab_is_space(slab_type)) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_SHORT)!=0);
 }
 
 short slab_is_tall(unsigned short slab_type)
 {
-    if (slab_is_tall_unclmabl(slab_type)) return true;
-    if (slab_is_wall(slab_type)) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_TALL)!=0);
 }
 
 short slab_is_short_clmabl(unsigned short slab_type)
 {
-    /*Rooms are short and usually claimed */
-    if (slab_is_room(slab_type)) return true;
-    /*But there are also other claimed things */
-    if (slab_is_door(slab_type)) return true;
-    if (slab_type==SLAB_TYPE_CLAIMED) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_SHORT_CLMABL)!=0);
 }
 
 short slab_is_claimedgnd(unsigned short slab_type)
 {
-    if (slab_is_door(slab_type)) return true;
-    if (slab_type==SLAB_TYPE_CLAIMED) return true;
-    return false;
+    return ((get_slab_props(slab_type)&SLBPROP_CLAIMEDGND)!=0);
 }
 
 short slab_is_clmabl(unsigned short slab_type)
 {
-    if (slab_is_short_unclmabl(slab_type)) return false;
-    if (slab_is_tall_unclmabl(slab_type)) return false;
-    return true;
+    return ((get_slab_props(slab_type)&(SLBPROP_SHORT_UNCLMABL|SLBPROP_TALL_UNCLMABL))==0);
 }
 
 /*
@@ -433,10 +517,7 @@ short slab_is_clmabl(unsigned short slab_type)
  */
 short slab_allows_torch(unsigned short slab_type)
 {
-    if (!slab_is_short(slab_type)) return false;
-    if (slab_is_room(slab_type)) return false;
-    if (slab_is_liquid(slab_type)) return false;
-    return true;
+    return ((get_slab_props(slab_type)&SLBPROP_ALLOWS_TORCH)!=0);
 }
 
 /*
@@ -133,6 +133,7 @@ DLLIMPORT short slab_is_liquid(unsigned short slab_type);
 DLLIMPORT short slab_allows_torch(unsigned short slab_type);
 DLLIMPORT short slab_needs_adjacent_torch(unsigned short slab_type);
 DLLIMPORT short slab_verify_entry(unsigned short slab_type, char *err_msg);
+DLLIMPORT short slab_props_verify(char *err_msg);
 DLLIMPORT char *get_slab_fullname(unsigned short slb_type);
 DLLIMPORT unsigned short get_random_wall_slab(void);
 
@@ -205,6 +205,230 @@ const unsigned char items_doorboxes[]={
 const unsigned char items_torches[]={
       ITEM_SUBTYPE_TORCHUN, ITEM_SUBTYPE_TORCH, };
 
+/* Item property bits; every bit means the subtype is listed in one items_* array */
+#define ITMPROP_SPELLBOOK    0x00000001
+#define ITMPROP_DNGSPECBOX   0x00000002
+#define ITMPROP_CRTRLAIR     0x00000004
+#define ITMPROP_TRAPBOX      0x00000008
+#define ITMPROP_DOORBOX      0x00000010
+#define ITMPROP_STATUE       0x00000020
+#define ITMPROP_FOOD         0x00000040
+#define ITMPROP_GOLD         0x00000080
+#define ITMPROP_TORCH        0x00000100
+#define ITMPROP_HEARTFLAME   0x00000200
+#define ITMPROP_POLEBAR      0x00000400
+#define ITMPROP_LIT_THING    0x00000800
+#define ITMPROP_SPINNINGTNG  0x00001000
+#define ITMPROP_NULLTNG      0x00002000
+#define ITMPROP_ITEMEFFECT   0x00004000
+#define ITMPROP_WRKSHOPBOX   0x00008000
+#define ITMPROP_TORCHCNDL    0x00010000
+#define ITMPROP_ROOMEQUIP    0x00020000
+#define ITMPROP_PWHAND       0x00040000
+#define ITMPROP_DNCRUCIAL    0x00080000
+#define ITMPROP_FURNITURE    0x00100000
+
+/* Properties of every item subtype; item_props_verify() checks that they
+ * agree with the items_* arrays */
+static const unsigned long item_props[256]={
+    [ITEM_SUBTYPE_NULL]      = ITMPROP_NULLTNG,
+    [ITEM_SUBTYPE_BARREL]    = ITMPROP_FURNITURE,
+    [ITEM_SUBTYPE_TORCH]     = ITMPROP_TORCH|ITMPROP_LIT_THING|ITMPROP_TORCHCNDL,
+    [ITEM_SUBTYPE_GOLDCHEST] = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_TEMPLESTA] = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_DNHEART]   = ITMPROP_DNCRUCIAL,
+    [ITEM_SUBTYPE_GOLD]      = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_TORCHUN]   = ITMPROP_TORCH|ITMPROP_TORCHCNDL,
+    [ITEM_SUBTYPE_STATUEWO]  = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_CHICKNGRW] = ITMPROP_FOOD,
+    [ITEM_SUBTYPE_CHICKN]    = ITMPROP_FOOD,
+    [ITEM_SUBTYPE_SPELLHOE]  = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLIMP]  = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLMUST] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLSLAP] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLSOE]  = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLCTA]  = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLCAVI] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLHEAL] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLHLDA] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLLIGH] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLSPDC] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLPROT] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLCONC] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_NULL1]     = ITMPROP_NULLTNG,
+    [ITEM_SUBTYPE_NULL2]     = ITMPROP_NULLTNG,
+    [ITEM_SUBTYPE_ANVIL]     = ITMPROP_FURNITURE,
+    [ITEM_SUBTYPE_PRISONBAR] = ITMPROP_POLEBAR,
+    [ITEM_SUBTYPE_CANDLSTCK] = ITMPROP_LIT_THING|ITMPROP_TORCHCNDL,
+    [ITEM_SUBTYPE_GRAVSTONE] = ITMPROP_ROOMEQUIP,
+    [ITEM_SUBTYPE_STATUHORN] = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_TRAINPOST] = ITMPROP_ROOMEQUIP,
+    [ITEM_SUBTYPE_TORTSPIKE] = ITMPROP_ROOMEQUIP,
+    [ITEM_SUBTYPE_TEMPLESPN] = ITMPROP_ITEMEFFECT,
+    [ITEM_SUBTYPE_POTION1]   = ITMPROP_FURNITURE,
+    [ITEM_SUBTYPE_POTION2]   = ITMPROP_FURNITURE,
+    [ITEM_SUBTYPE_POTION3]   = ITMPROP_FURNITURE,
+    [ITEM_SUBTYPE_PWHAND]    = ITMPROP_PWHAND,
+    [ITEM_SUBTYPE_PWHANDGRB] = ITMPROP_PWHAND,
+    [ITEM_SUBTYPE_PWHANDWHP] = ITMPROP_PWHAND,
+    [ITEM_SUBTYPE_CHICKNSTB] = ITMPROP_FOOD,
+    [ITEM_SUBTYPE_CHICKNWOB] = ITMPROP_FOOD,
+    [ITEM_SUBTYPE_CHICKNCRK] = ITMPROP_FOOD,
+    [ITEM_SUBTYPE_GOLDL]     = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_SPINNKEY]  = ITMPROP_SPINNINGTNG,
+    [ITEM_SUBTYPE_SPELLDISE] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLCHKN] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLDWAL] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_SPELLTBMB] = ITMPROP_SPELLBOOK,
+    [ITEM_SUBTYPE_HEROGATE]  = ITMPROP_DNCRUCIAL,
+    [ITEM_SUBTYPE_SPINNKEY2] = ITMPROP_SPINNINGTNG,
+    [ITEM_SUBTYPE_ARMOUR]    = ITMPROP_ITEMEFFECT,
+    [ITEM_SUBTYPE_GLDHOARD1] = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_GLDHOARD2] = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_GLDHOARD3] = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_GLDHOARD4] = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_GLDHOARD5] = ITMPROP_GOLD,
+    [ITEM_SUBTYPE_LAIRWIZRD] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRBARBR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRARCHR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRMONK]  = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRDWRFA] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRKNGHT] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRAVATR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRTUNLR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRWITCH] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRGIANT] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRFAIRY] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRTHEFT] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRSAMUR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRHORNY] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRSKELT] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRGOBLN] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRDRAGN] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRDEMSP] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRFLY]   = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRDKMIS] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRSORCR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRBILDM] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRIMP]   = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRBUG]   = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRVAMP]  = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRSPIDR] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRHLHND] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRGHOST] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_LAIRTENTC] = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_SPREVMAP]  = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPRESURCT] = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPTRANSFR] = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPSTEALHR] = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPMULTPLY] = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPINCLEV]  = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPMKSAFE]  = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPHIDNWRL] = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_TBBOULDER] = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBALARM]   = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBPOISONG] = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBLIGHTNG] = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBWRDOFPW] = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBLAVA]    = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBDUMMY2]  = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBDUMMY3]  = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBDUMMY4]  = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBDUMMY5]  = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBDUMMY6]  = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_TBDUMMY7]  = ITMPROP_TRAPBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_DBWOOD]    = ITMPROP_DOORBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_DBBRACE]   = ITMPROP_DOORBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_DBSTEEL]   = ITMPROP_DOORBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_DBMAGIC]   = ITMPROP_DOORBOX|ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_WBITEM]    = ITMPROP_WRKSHOPBOX,
+    [ITEM_SUBTYPE_HEARTFLMR] = ITMPROP_HEARTFLAME,
+    [ITEM_SUBTYPE_DISEASE]   = ITMPROP_ITEMEFFECT,
+    [ITEM_SUBTYPE_SCAVNGEYE] = ITMPROP_ROOMEQUIP,
+    [ITEM_SUBTYPE_WRKSHPMCH] = ITMPROP_ROOMEQUIP,
+    [ITEM_SUBTYPE_GURDFLAGR] = ITMPROP_POLEBAR,
+    [ITEM_SUBTYPE_GURDFLAGB] = ITMPROP_POLEBAR,
+    [ITEM_SUBTYPE_GURDFLAGG] = ITMPROP_POLEBAR,
+    [ITEM_SUBTYPE_GURDFLAGY] = ITMPROP_POLEBAR,
+    [ITEM_SUBTYPE_FLAGPOST]  = ITMPROP_POLEBAR,
+    [ITEM_SUBTYPE_HEARTFLMB] = ITMPROP_HEARTFLAME,
+    [ITEM_SUBTYPE_HEARTFLMG] = ITMPROP_HEARTFLAME,
+    [ITEM_SUBTYPE_HEARTFLMY] = ITMPROP_HEARTFLAME,
+    [ITEM_SUBTYPE_PWSIGHT]   = ITMPROP_PWHAND,
+    [ITEM_SUBTYPE_PWLIGHTNG] = ITMPROP_PWHAND,
+    [ITEM_SUBTYPE_TORTURER]  = ITMPROP_ROOMEQUIP,
+    [ITEM_SUBTYPE_LAIRORC]   = ITMPROP_CRTRLAIR,
+    [ITEM_SUBTYPE_PWHANDGLD] = ITMPROP_PWHAND,
+    [ITEM_SUBTYPE_SPINNCOIN] = ITMPROP_SPINNINGTNG,
+    [ITEM_SUBTYPE_STATUE2]   = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_STATUE3]   = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_STATUE4]   = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_STATUE5]   = ITMPROP_STATUE,
+    [ITEM_SUBTYPE_SPCUSTOM]  = ITMPROP_DNGSPECBOX,
+    [ITEM_SUBTYPE_SPELLARMG] = ITMPROP_SPELLBOOK,
+};
+
+/*
+ * Sets given property bit for all item subtypes listed in an array.
+ */
+static void item_props_mark(unsigned long *props,const unsigned char *items,
+    int count,unsigned long prop)
+{
+    int i;
+    for (i=0;i<count;i++)
+      props[items[i]]|=prop;
+}
+
+/*
+ * Verifies the item properties table. The items_* arrays are still
+ * the place where categories are defined.
+ */
+short item_props_verify(char *err_msg)
+{
+    unsigned long props[256];
+    int i;
+    memset(props,0,sizeof(props));
+    item_props_mark(props,items_spellbooks,sizeof(items_spellbooks),ITMPROP_SPELLBOOK);
+    item_props_mark(props,items_specboxes,sizeof(items_specboxes),ITMPROP_DNGSPECBOX);
+    item_props_mark(props,items_crtrlairs,sizeof(items_crtrlairs),ITMPROP_CRTRLAIR);
+    item_props_mark(props,items_trapbxs,sizeof(items_trapbxs),ITMPROP_TRAPBOX);
+    item_props_mark(props,items_doorboxes,sizeof(items_doorboxes),ITMPROP_DOORBOX);
+    item_props_mark(props,items_statues,sizeof(items_statues),ITMPROP_STATUE);
+    item_props_mark(props,items_food,sizeof(items_food),ITMPROP_FOOD);
+    item_props_mark(props,items_gold,sizeof(items_gold),ITMPROP_GOLD);
+    item_props_mark(props,items_torches,sizeof(items_torches),ITMPROP_TORCH);
+    item_props_mark(props,items_heartflames,sizeof(items_heartflames),ITMPROP_HEARTFLAME);
+    item_props_mark(props,items_polebars,sizeof(items_polebars),ITMPROP_POLEBAR);
+    item_props_mark(props,items_litthings,sizeof(items_litthings),ITMPROP_LIT_THING);
+    item_props_mark(props,items_spinnthings,sizeof(items_spinnthings),ITMPROP_SPINNINGTNG);
+    item_props_mark(props,items_nullthings,sizeof(items_nullthings),ITMPROP_NULLTNG);
+    item_props_mark(props,items_effcts,sizeof(items_effcts),ITMPROP_ITEMEFFECT);
+    item_props_mark(props,items_wrkshpbxs,sizeof(items_wrkshpbxs),ITMPROP_WRKSHOPBOX);
+    item_props_mark(props,items_torchcandls,sizeof(items_torchcandls),ITMPROP_TORCHCNDL);
+    item_props_mark(props,items_roomequip,sizeof(items_roomequip),ITMPROP_ROOMEQUIP);
+    item_props_mark(props,items_pwhand,sizeof(items_pwhand),ITMPROP_PWHAND);
+    item_props_mark(props,items_dncrucial,sizeof(items_dncrucial),ITMPROP_DNCRUCIAL);
+    item_props_mark(props,items_furniture,sizeof(items_furniture),ITMPROP_FURNITURE);
+    for (i=0;i<256;i++)
+    {
+      if (item_props[i]!=props[i])
+      {
+        sprintf(err_msg,"Item subtype %d properties are %06lx, should be %06lx",
+            i,item_props[i],props[i]);
+        return VERIF_ERROR;
+      }
+    }
+    return VERIF_OK;
+}
+
+/*
+ * Returns property bits of given item subtype.
+ */
+static unsigned long get_item_props(const unsigned char stype_idx)
+{
+    return item_props[stype_idx];
+}
+
 typedef unsigned int (*thing_subtype_counter)(void);
 
 const is_thing_subtype thing_subtype_tests[]={
@@ -675,9 +899,13 @@ char *get_thing_type_shortname(const unsigned short type_idx)
        return "unkn!";
 }
 
+/*
+ * Returns full name of thing subtype. The text is in a buffer separate
+ * for every thread, valid until next call from the same thread.
+ */
 char *get_thing_subtype_fullname(const unsigned short type_idx,const unsigned short stype_idx)
 {
-  static char buffer[LINEMSG_SIZE];
+  static THREAD_LOCAL char buffer[LINEMSG_SIZE];
   switch (type_idx)
   {
   case THING_TYPE_ITEM:
@@ -914,8 +1142,7 @@ short is_spellbook(const unsigned char *thing)
  */
 short is_spellbook_stype(const unsigned char stype_idx)
 {
-    if (get_spellbook_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_SPELLBOOK)!=0);
 }
 
 int get_spellbook_arridx(const unsigned char stype_idx)
@@ -988,8 +1215,7 @@ short is_dngspecbox(const unsigned char *thing)
  */
 short is_dngspecbox_stype(const unsigned char stype_idx)
 {
-    if (get_dngspecbox_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_DNGSPECBOX)!=0);
 }
 
 int get_dngspecbox_arridx(const unsigned char stype_idx)
@@ -1062,8 +1288,7 @@ short is_crtrlair(const unsigned char *thing)
  */
 short is_crtrlair_stype(const unsigned char stype_idx)
 {
-    if (get_crtrlair_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_CRTRLAIR)!=0);
 }
 
 int get_crtrlair_arridx(const unsigned char stype_idx)
@@ -1136,8 +1361,7 @@ short is_trapbox(const unsigned char *thing)
  */
 short is_trapbox_stype(const unsigned char stype_idx)
 {
-    if (get_trapbox_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_TRAPBOX)!=0);
 }
 
 int get_trapbox_arridx(const unsigned char stype_idx)
@@ -1310,8 +1534,7 @@ short is_doorbox(const unsigned char *thing)
  */
 short is_doorbox_stype(const unsigned char stype_idx)
 {
-    if (get_doorbox_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_DOORBOX)!=0);
 }
 
 int get_doorbox_arridx(const unsigned char stype_idx)
@@ -1516,8 +1739,7 @@ short is_statue(const unsigned char *thing)
  */
 short is_statue_stype(const unsigned char stype_idx)
 {
-    if (get_statue_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_STATUE)!=0);
 }
 
 int get_statue_arridx(const unsigned char stype_idx)
@@ -1590,8 +1812,7 @@ short is_food(const unsigned char *thing)
  */
 short is_food_stype(const unsigned char stype_idx)
 {
-    if (get_food_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_FOOD)!=0);
 }
 
 int get_food_arridx(const unsigned char stype_idx)
@@ -1658,8 +1879,7 @@ short is_gold(const unsigned char *thing)
 
 short is_gold_stype(const unsigned char stype_idx)
 {
-    if (get_gold_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_GOLD)!=0);
 }
 
 int get_gold_arridx(const unsigned char stype_idx)
@@ -1729,8 +1949,7 @@ short is_torch(const unsigned char *thing)
 
 short is_torch_stype(const unsigned char stype_idx)
 {
-    if (get_torch_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_TORCH)!=0);
 }
 
 int get_torch_arridx(const unsigned char stype_idx)
@@ -1800,8 +2019,7 @@ short is_heartflame(const unsigned char *thing)
 
 short is_heartflame_stype(const unsigned char stype_idx)
 {
-    if (get_heartflame_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_HEARTFLAME)!=0);
 }
 
 int get_heartflame_arridx(const unsigned char stype_idx)
@@ -1876,8 +2094,7 @@ short is_polebar(const unsigned char *thing)
 
 short is_polebar_stype(const unsigned char stype_idx)
 {
-    if (get_polebar_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_POLEBAR)!=0);
 }
 
 int get_polebar_arridx(const unsigned char stype_idx)
@@ -1918,8 +2135,7 @@ short is_lit_thing(const unsigned char *thing)
 
 short is_lit_thing_stype(const unsigned char stype_idx)
 {
-    if (get_lit_thing_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_LIT_THING)!=0);
 }
 
 int get_lit_thing_arridx(const unsigned char stype_idx)
@@ -1993,8 +2209,7 @@ short is_spinningtng(const unsigned char *thing)
 
 short is_spinningtng_stype(const unsigned char stype_idx)
 {
-    if (get_spinningtng_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_SPINNINGTNG)!=0);
 }
 
 int get_spinningtng_arridx(const unsigned char stype_idx)
@@ -2072,8 +2287,7 @@ short is_nulltng(const unsigned char *thing)
 
 short is_nulltng_stype(const unsigned char stype_idx)
 {
-    if (get_nulltng_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_NULLTNG)!=0);
 }
 
 int get_nulltng_arridx(const unsigned char stype_idx)
@@ -2122,8 +2336,7 @@ short is_itemeffect(const unsigned char *thing)
 
 short is_itemeffect_stype(const unsigned char stype_idx)
 {
-    if (get_itemeffect_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_ITEMEFFECT)!=0);
 }
 
 int get_itemeffect_arridx(const unsigned char stype_idx)
@@ -2167,8 +2380,7 @@ short is_wrkshopbox(const unsigned char *thing)
 
 short is_wrkshopbox_stype(const unsigned char stype_idx)
 {
-    if (get_wrkshopbox_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_WRKSHOPBOX)!=0);
 }
 
 int get_wrkshopbox_arridx(const unsigned char stype_idx)
@@ -2212,8 +2424,7 @@ short is_torchcndl(const unsigned char *thing)
 
 short is_torchcndl_stype(const unsigned char stype_idx)
 {
-    if (get_torchcndl_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_TORCHCNDL)!=0);
 }
 
 int get_torchcndl_arridx(const unsigned char stype_idx)
@@ -2257,8 +2468,7 @@ short is_roomequip(const unsigned char *thing)
 
 short is_roomequip_stype(const unsigned char stype_idx)
 {
-    if (get_roomequip_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_ROOMEQUIP)!=0);
 }
 
 int get_roomequip_arridx(const unsigned char stype_idx)
@@ -2302,8 +2512,7 @@ short is_pwhand(const unsigned char *thing)
 
 short is_pwhand_stype(const unsigned char stype_idx)
 {
-    if (get_pwhand_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_PWHAND)!=0);
 }
 
 int get_pwhand_arridx(const unsigned char stype_idx)
@@ -2347,8 +2556,7 @@ short is_dncrucial(const unsigned char *thing)
 
 short is_dncrucial_stype(const unsigned char stype_idx)
 {
-    if (get_dncrucial_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_DNCRUCIAL)!=0);
 }
 
 int get_dncrucial_arridx(const unsigned char stype_idx)
@@ -2396,8 +2604,7 @@ short is_furniture(const unsigned char *thing)
  */
 short is_furniture_stype(const unsigned char stype_idx)
 {
-    if (get_furniture_arridx(stype_idx)<0) return false;
-    return true;
+    return ((get_item_props(stype_idx)&ITMPROP_FURNITURE)!=0);
 }
 
 int get_furniture_arridx(const unsigned char stype_idx)
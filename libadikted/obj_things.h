@@ -429,6 +429,7 @@ DLLIMPORT unsigned char get_dncrucial_arritm(const int arr_itm);
 DLLIMPORT unsigned int get_dncrucial_count(void);
 /* This one always returns false */
 DLLIMPORT short is_false_stype(const unsigned char stype_idx);
+DLLIMPORT short item_props_verify(char *err_msg);
 
 /* Additional functions - not categorization */
 DLLIMPORT short is_trapbox(const unsigned char *thing);
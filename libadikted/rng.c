@@ -4,6 +4,9 @@
  */
 
 #include "rng.h"
+#include "lbthread.h"
+
+static unsigned long long rng_mix64(unsigned long long z);
 
 
 #ifdef RNG_MT
@@ -17,21 +20,60 @@
 
     #include "mtwist/mtwist.h"
 
+    /**
+     * Generator state is separate for every thread, so threads
+     * processing different levels don't share it.
+     */
+    static THREAD_LOCAL mt_state rng_state;
+
+    /**
+     * Seed of the first thread which used the generator. Other threads
+     * start from seeds derived from it and from their number, so they
+     * don't all repeat the same sequence.
+     */
+    static unsigned int rng_base_seed = 4357;
+    static volatile long rng_threads_count = 0;
+    static THREAD_LOCAL long rng_thread_num = 0;
+
+    /**
+     * Returns number of the current thread, counting from 1
+     * in order of first use of the generator.
+     */
+    static long rng_thread_number() {
+        if (rng_thread_num == 0)
+            rng_thread_num = lb_atomic_inc(&rng_threads_count);
+        return rng_thread_num;
+    }
+
+    static void rng_seed_thread() {
+        unsigned long long num = rng_thread_number();
+        unsigned int seed = rng_base_seed;
+        if (num > 1)
+            seed = (unsigned int)(rng_mix64(((unsigned long long)seed << 32) + num) >> 32);
+        mts_seed32( &rng_state, seed );
+    }
 
     unsigned int rng_rand_max() {
         return 4294967295;                      /** 2^32 - 1 **/
     }
 
     void rng_srand( unsigned int seed ) {
-        mt_seed32( seed );
+        if (rng_thread_number() == 1)
+            rng_base_seed = seed;
+        mts_seed32( &rng_state, seed );
     }
 
     unsigned int rng_srand_random() {
-        return mt_goodseed();
+        unsigned int seed = mts_goodseed( &rng_state );
+        if (rng_thread_number() == 1)
+            rng_base_seed = seed;
+        return seed;
     }
 
-    unsigned int rng_rand() {
-        return mt_lrand();
+    static unsigned int rng_base_rand() {
+        if (!rng_state.initialized)
+            rng_seed_thread();
+        return mts_lrand( &rng_state );
     }
 
 #else
@@ -57,8 +99,85 @@
         return seed;
     }
 
-    unsigned int rng_rand() {
+    static unsigned int rng_base_rand() {
         return rand();
     }
 
 #endif /* RNG_MT */
+
+
+/**
+ * Stream which rng_rand() draws from, instead of the thread generator.
+ */
+static THREAD_LOCAL struct RNG_STREAM *rng_bound_stream = NULL;
+
+/**
+ * Mixes bits of a 64-bit value; finalizer of the SplitMix64 generator.
+ */
+static unsigned long long rng_mix64(unsigned long long z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+#define RNG_GOLDEN_GAMMA 0x9e3779b97f4a7c15ULL
+
+/**
+ * Seeds a random number stream. Streams with the same seed
+ * produce the same sequence on any platform.
+ */
+void rng_stream_seed(struct RNG_STREAM *strm, unsigned long long seed)
+{
+    strm->key = rng_mix64(seed + RNG_GOLDEN_GAMMA);
+    strm->ctr = 0;
+}
+
+/**
+ * Derives independent child stream from a parent stream.
+ * Only the parent seed is used, not its position - so the child depends
+ * on the parent seed and the id only, and children can be made in any order.
+ */
+void rng_stream_split(struct RNG_STREAM *child, const struct RNG_STREAM *parent,
+    unsigned long long id)
+{
+    child->key = rng_mix64(parent->key ^ rng_mix64(id + RNG_GOLDEN_GAMMA));
+    child->ctr = 0;
+}
+
+/**
+ * Moves the stream forward by given amount of numbers.
+ * The generator is counter-based, so this takes constant time.
+ */
+void rng_stream_skip(struct RNG_STREAM *strm, unsigned long long count)
+{
+    strm->ctr += count;
+}
+
+/**
+ * Returns next 32-bit number from the stream.
+ */
+unsigned int rng_stream_rand(struct RNG_STREAM *strm)
+{
+    strm->ctr++;
+    return (unsigned int)(rng_mix64(strm->key + strm->ctr*RNG_GOLDEN_GAMMA) >> 32);
+}
+
+/**
+ * Makes rng_rand() and rnd() in the current thread draw from given stream.
+ * NULL restores the thread generator. Returns the previously bound
+ * stream, so that bindings can be nested.
+ */
+struct RNG_STREAM *rng_stream_bind(struct RNG_STREAM *strm)
+{
+    struct RNG_STREAM *prev = rng_bound_stream;
+    rng_bound_stream = strm;
+    return prev;
+}
+
+unsigned int rng_rand() {
+    if (rng_bound_stream == NULL)
+        return rng_base_rand();
+    unsigned long long range = (unsigned long long)rng_rand_max() + 1;
+    return (unsigned int)(rng_stream_rand(rng_bound_stream) % range);
+}
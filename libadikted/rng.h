@@ -20,14 +20,52 @@
  */
 DLLIMPORT unsigned int rng_rand_max();
 
+/**
+ * Initialize RNG of the current thread with given seed.
+ * With Mersenne Twister, every thread has its own generator. A thread
+ * which didn't seed it starts from a seed derived from the one given
+ * to the first thread, so the first thread should seed before starting
+ * other threads. The stdlib.h backend has one generator for all threads,
+ * and isn't safe to use from more than one.
+ */
 DLLIMPORT void rng_srand( unsigned int seed );
 
 /**
  * Initialize RNG with 'unpredictable' seed. Return the seed.
+ * Affects the current thread, like rng_srand().
  */
 DLLIMPORT unsigned int rng_srand_random();
 
+/**
+ * Returns next number from the generator of current thread,
+ * or from the stream bound to it by rng_stream_bind().
+ */
 DLLIMPORT unsigned int rng_rand();
 
+/**
+ * Deterministic random number stream. It is counter-based - every number
+ * is computed from the key and position - so a stream can be skipped
+ * forward and split into independent sub-streams at no cost.
+ * Stream functions use only the given stream, so threads may use
+ * separate streams at the same time.
+ */
+struct RNG_STREAM {
+    unsigned long long key;
+    unsigned long long ctr;
+  };
+
+DLLIMPORT void rng_stream_seed(struct RNG_STREAM *strm, unsigned long long seed);
+DLLIMPORT void rng_stream_split(struct RNG_STREAM *child, const struct RNG_STREAM *parent,
+    unsigned long long id);
+DLLIMPORT void rng_stream_skip(struct RNG_STREAM *strm, unsigned long long count);
+DLLIMPORT unsigned int rng_stream_rand(struct RNG_STREAM *strm);
+
+/**
+ * Binds stream to the current thread; rng_rand() then draws from it.
+ * Other threads are not affected. The stream must not be used
+ * by another thread while bound.
+ */
+DLLIMPORT struct RNG_STREAM *rng_stream_bind(struct RNG_STREAM *strm);
+
 
 #endif /* ADIKT_RNG_H */
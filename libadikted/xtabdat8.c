@@ -306,14 +306,35 @@ short free_datfile_data(struct DATFILE *datf)
 int read_dattab_images(struct IMAGELIST *images,unsigned long *readcount,struct TABFILE *tabf,struct DATFILE *datf,const int verbose)
 {
     images->count=tabf->count;
+    images->arena=NULL;
+    images->arena_size=0;
+    images->arena_used=0;
+    images->premul_arena=NULL;
     images->items=malloc(sizeof(struct IMAGEITEM)*(images->count));
     if (!images->items)
     {
         if (verbose) msgprintf(" Error - cannot allocate %lu bytes of memory.\n",(unsigned long)(sizeof(struct IMAGEITEM)*images->count));
+        images->count=0;
         return 1;
     }
-    /*Looping through images */
+    /*Sizing one buffer for all the images */
     unsigned long picnum;
+    unsigned long pixels=0;
+    for (picnum=0;picnum<images->count;picnum++)
+    {
+        struct TABFILE_ITEM *tabitem=&(tabf->items[picnum]);
+        if (tabitem->offset < datf->filelength)
+            pixels+=tabitem->width*tabitem->height;
+    }
+    if (alloc_images_arena(images,pixels)!=XTABDAT8_OK)
+    {
+        if (verbose) msgprintf(" Error - cannot allocate %lu bytes of memory.\n",2*pixels);
+        free(images->items);
+        images->items=NULL;
+        images->count=0;
+        return 1;
+    }
+    /*Looping through images */
     unsigned long errnum=0;
     unsigned long skipnum=0;
     for (picnum=0;picnum<images->count;picnum++)
@@ -324,6 +345,8 @@ int read_dattab_images(struct IMAGELIST *images,unsigned long *readcount,struct
         item->height=0;
         item->data=NULL;
         item->alpha=NULL;
+        item->premul=NULL;
+        item->premul_alpha=NULL;
        	if (verbose) msgprintf("\rPreparing picture%6lu from %06lx, %ux%u...",picnum,tabitem->offset,tabitem->width,tabitem->height);
         if (tabitem->offset >= datf->filelength)
             {
@@ -339,7 +362,7 @@ int read_dattab_images(struct IMAGELIST *images,unsigned long *readcount,struct
             }
         unsigned long readedsize;
         int retcode;
-        retcode=read_dat_image_idx(item,&readedsize,datf,tabitem->offset,tabitem->width,tabitem->height);
+        retcode=read_dat_image_arena(images,item,&readedsize,datf,tabitem->offset,tabitem->width,tabitem->height);
         *readcount+=readedsize;
         if ((retcode&XTABDAT8_COLOUR_LEAK))
         {  
@@ -359,43 +382,63 @@ int read_dattab_images(struct IMAGELIST *images,unsigned long *readcount,struct
 int free_dattab_images(struct IMAGELIST *images)
 {
     unsigned long picnum;
-    for (picnum=0;picnum<images->count;picnum++)
+    if (images->arena==NULL)
     {
-        struct IMAGEITEM *item=&(images->items[picnum]);
-        free(item->data);
-        free(item->alpha);
+        for (picnum=0;picnum<images->count;picnum++)
+        {
+            struct IMAGEITEM *item=&(images->items[picnum]);
+            free(item->data);
+            free(item->alpha);
+        }
     }
+    free(images->arena);
+    images->arena=NULL;
+    images->arena_size=0;
+    images->arena_used=0;
+    free(images->premul_arena);
+    images->premul_arena=NULL;
     free(images->items);
     images->items=NULL;
     images->count=0;
     return true;
 }
 
-int read_dat_image_idx(struct IMAGEITEM *image,unsigned long *readedsize,
-    const struct DATFILE *datf,const unsigned long off,
-    const unsigned int width,const unsigned int height)
+/*
+ * Allocates one buffer for data and alpha of all images in the list.
+ * All data planes are at start of the buffer, and alpha planes after them,
+ * so the whole buffer is cleared to transparent with two memsets.
+ * Returns XTABDAT8_OK, or XTABDAT8_MALLOC_ERR if there's not enough memory.
+ */
+short alloc_images_arena(struct IMAGELIST *images,unsigned long pixels)
 {
-    /*Filling image structure */
+    images->arena_used=0;
+    images->arena_size=pixels;
+    /* Allocating at least one byte, so that NULL means error */
+    images->arena=malloc(2*pixels+1);
+    if (images->arena==NULL)
     {
-        image->width=width;
-        image->height=height;
-        unsigned long imgsize=width*height;
-        image->data=malloc(imgsize);
-        image->alpha=malloc(imgsize);
-        if ((image->data==NULL)||(image->alpha==NULL))
-            return XTABDAT8_NOMEMORY;
-        unsigned long i;
-        for (i=0;i<imgsize;i++)
-        {
-            /* Select color index when transparent */
-            image->data[i]=0;
-            image->alpha[i]=255;
-        }
+        images->arena_size=0;
+        return XTABDAT8_MALLOC_ERR;
     }
+    /* Select color index when transparent */
+    memset(images->arena,0,pixels);
+    memset(images->arena+pixels,255,pixels);
+    return XTABDAT8_OK;
+}
+
+/*
+ * Decodes RLE image from DAT file into cleared data and alpha buffers.
+ * Runs which fit in the picture are copied at once; other runs are
+ * processed pixel by pixel, to handle colour leaks the same way as always.
+ */
+static int decode_dat_image_idx(unsigned char *data,unsigned char *alpha,
+    unsigned long *readedsize,const struct DATFILE *datf,const unsigned long off,
+    const unsigned int width,const unsigned int height)
+{
     /*Code of error, if any occured */
     int errorcode=0;
     /*Counter of readed bytes */
-    long endoff=off;
+    unsigned long endoff=off;
     /*Position in buffer on height */
     unsigned int r=0;
     /*position in buffer on width */
@@ -417,6 +460,14 @@ int read_dat_image_idx(struct IMAGEITEM *image,unsigned long *readedsize,
        	{
             c=0;
            	r++;
+        } else
+        if ((c+g <= width)&&(endoff+g <= datf->filelength))
+        {
+            /*The whole run is inside picture */
+            memcpy(data+(width*r)+c,datf->data+endoff,g);
+            memset(alpha+(width*r)+c,0,g);
+            endoff+=g;
+            c+=g;
         } else /*being here means that g>0 */
         {
             int i;
@@ -443,8 +494,8 @@ int read_dat_image_idx(struct IMAGEITEM *image,unsigned long *readedsize,
                     /*No leak error */
                     if (endoff < datf->filelength)
                     {
-                        image->data[(width*r)+c]=datf->data[endoff];
-                        image->alpha[(width*r)+c]=0;
+                        data[(width*r)+c]=datf->data[endoff];
+                        alpha[(width*r)+c]=0;
                     }
                     else
                     {
@@ -460,6 +511,49 @@ int read_dat_image_idx(struct IMAGEITEM *image,unsigned long *readedsize,
 	return errorcode;
 }
 
+int read_dat_image_idx(struct IMAGEITEM *image,unsigned long *readedsize,
+    const struct DATFILE *datf,const unsigned long off,
+    const unsigned int width,const unsigned int height)
+{
+    /*Filling image structure */
+    image->width=width;
+    image->height=height;
+    image->premul=NULL;
+    image->premul_alpha=NULL;
+    unsigned long imgsize=width*height;
+    image->data=malloc(imgsize);
+    image->alpha=malloc(imgsize);
+    if ((image->data==NULL)||(image->alpha==NULL))
+        return XTABDAT8_NOMEMORY;
+    /* Select color index when transparent */
+    memset(image->data,0,imgsize);
+    memset(image->alpha,255,imgsize);
+    return decode_dat_image_idx(image->data,image->alpha,readedsize,datf,off,width,height);
+}
+
+/*
+ * Decodes image from DAT file, placing it in the images list buffer.
+ * The buffer must be allocated by alloc_images_arena() first.
+ */
+int read_dat_image_arena(struct IMAGELIST *images,struct IMAGEITEM *image,
+    unsigned long *readedsize,const struct DATFILE *datf,const unsigned long off,
+    const unsigned int width,const unsigned int height)
+{
+    unsigned long imgsize=width*height;
+    *readedsize=0;
+    if (images->arena_used+imgsize > images->arena_size)
+        return XTABDAT8_NOMEMORY;
+    /*Filling image structure */
+    image->width=width;
+    image->height=height;
+    image->premul=NULL;
+    image->premul_alpha=NULL;
+    image->data=images->arena+images->arena_used;
+    image->alpha=images->arena+images->arena_size+images->arena_used;
+    images->arena_used+=imgsize;
+    return decode_dat_image_idx(image->data,image->alpha,readedsize,datf,off,width,height);
+}
+
 int read_dattab_encimages(struct ENCIMAGELIST *images,unsigned long *readcount,
     const struct TABFILE *tabf,const struct DATFILE *datf,const int verbose)
 {
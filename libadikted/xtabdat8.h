@@ -27,6 +27,7 @@
 
 /* Error returns */
 
+#define XTABDAT8_OK          0
 #define XTABDAT8_COLOUR_LEAK 2
 #define XTABDAT8_ENDOFBUFFER 4
 #define XTABDAT8_NOMEMORY    8
@@ -87,11 +88,23 @@ struct IMAGEITEM {
     unsigned int height;
     unsigned char *data;
     unsigned char *alpha;
+    /* Premultiplied colours, 3 values per pixel: blue, green, red */
+    /* multiplied by opacity; NULL if not prepared */
+    unsigned short *premul;
+    /* Alpha values repeated for the 3 premultiplied colours */
+    unsigned char *premul_alpha;
        };
 
 struct IMAGELIST {
     unsigned long count;
     struct IMAGEITEM *items;
+    /* Single block for data and alpha of all items, or NULL if every */
+    /* item has its own buffers */
+    unsigned char *arena;
+    unsigned long arena_size;
+    unsigned long arena_used;
+    /* Single block for premultiplied colours of all items */
+    unsigned char *premul_arena;
        };
 
 /* Routines */
@@ -111,6 +124,10 @@ DLLIMPORT int free_dattab_images(struct IMAGELIST *images);
 DLLIMPORT int read_dat_image_idx(struct IMAGEITEM *image,unsigned long *readedsize,
     const struct DATFILE *datf,const unsigned long off,
     const unsigned int width,const unsigned int height);
+DLLIMPORT short alloc_images_arena(struct IMAGELIST *images,unsigned long pixels);
+DLLIMPORT int read_dat_image_arena(struct IMAGELIST *images,struct IMAGEITEM *image,
+    unsigned long *readedsize,const struct DATFILE *datf,const unsigned long off,
+    const unsigned int width,const unsigned int height);
 
 DLLIMPORT int read_dattab_encimages(struct ENCIMAGELIST *images,unsigned long *readcount,
     const struct TABFILE *tabf,const struct DATFILE *datf,const int verbose);
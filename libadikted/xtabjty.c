@@ -490,14 +490,35 @@ int read_jtytab_images(struct IMAGELIST *images,unsigned long *readcount,
     const struct JTYTABFILE *jtabf,const struct DATFILE *jtyf,const int verbose)
 {
     images->count=jtabf->count;
+    images->arena=NULL;
+    images->arena_size=0;
+    images->arena_used=0;
+    images->premul_arena=NULL;
     images->items=malloc(sizeof(struct IMAGEITEM)*(images->count));
     if (images->items==NULL)
     {
         if (verbose) msgprintf(" Error - cannot allocate %lu bytes of memory.\n",(unsigned long)(sizeof(struct IMAGEITEM)*images->count));
+        images->count=0;
         return 1;
     }
-    /*Looping through images */
+    /*Sizing one buffer for all the images */
     unsigned long picnum;
+    unsigned long pixels=0;
+    for (picnum=0;picnum<images->count;picnum++)
+    {
+        struct JTYTAB_ITEM *jtabitem=&(jtabf->items[picnum]);
+        if (jtabitem->offset < jtyf->filelength)
+            pixels+=jtabitem->width*jtabitem->height;
+    }
+    if (alloc_images_arena(images,pixels)!=XTABDAT8_OK)
+    {
+        if (verbose) msgprintf(" Error - cannot allocate %lu bytes of memory.\n",2*pixels);
+        free(images->items);
+        images->items=NULL;
+        images->count=0;
+        return 1;
+    }
+    /*Looping through images */
     unsigned long errnum=0;
     unsigned long skipnum=0;
     for (picnum=0;picnum<images->count;picnum++)
@@ -508,6 +529,8 @@ int read_jtytab_images(struct IMAGELIST *images,unsigned long *readcount,
         item->height=0;
         item->data=NULL;
         item->alpha=NULL;
+        item->premul=NULL;
+        item->premul_alpha=NULL;
        	if (verbose) msgprintf("\rPreparing picture%6lu from %06lx, %ux%u...",picnum,jtabitem->offset,jtabitem->width,jtabitem->height);
         if (jtabitem->offset >= jtyf->filelength)
             {
@@ -523,7 +546,7 @@ int read_jtytab_images(struct IMAGELIST *images,unsigned long *readcount,
             }
         unsigned long readedsize;
         int retcode;
-        retcode=read_dat_image_idx(item,&readedsize,jtyf,jtabitem->offset,jtabitem->width,jtabitem->height);
+        retcode=read_dat_image_arena(images,item,&readedsize,jtyf,jtabitem->offset,jtabitem->width,jtabitem->height);
         *readcount+=readedsize;
         if ((retcode&XTABDAT8_COLOUR_LEAK))
         {  
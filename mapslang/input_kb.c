@@ -56,6 +56,26 @@ unsigned int get_key(void)
     return ret;
 }
 
+/*
+ * Returns true if there is a key waiting to be retrieved by get_key().
+ * Doesn't wait for the key.
+ */
+short key_pending(void)
+{
+    if (!input_initied) return false;
+    return (SLang_input_pending(0)>0);
+}
+
+/*
+ * Waits until a key is pressed, but no longer than given amount
+ * of tenths of a second. Returns true if there is a key waiting.
+ */
+short key_wait(unsigned int tenths)
+{
+    if (!input_initied) return false;
+    return (SLang_input_pending(tenths)>0);
+}
+
 /*
  * Get a string, in the "minibuffer". Return true on success, false
  * on break. Possibly syntax-highlight the entered string for
@@ -195,6 +195,8 @@
 
 int get_str(char *prompt, char *buf);
 unsigned int get_key(void);
+short key_pending(void);
+short key_wait(unsigned int tenths);
 short input_init(void);
 short input_done(void);
 void speaker_beep(void);
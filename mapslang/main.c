@@ -291,6 +291,8 @@ int main(int argc, char **argv)
     //set_msglog_fname("aaa.log");
     // create object for storing map
     level_init(&(workdata.lvl),MFV_DKGOLD,NULL);
+    // every key press becomes an undo step
+    level_undo_enable(workdata.lvl,UNDO_DEFAULT_MAX_MEM,UNDO_DEFAULT_MAX_STEPS);
     //testing new map capabilities
     //struct UPOINT_3D mapsize={100,100,1};
     //level_init(&(workdata.lvl),MFV_DKXPAND,&mapsize);
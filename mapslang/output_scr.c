@@ -28,6 +28,26 @@
 short screen_initied=false;
 struct DRAW_DATA drawdata;
 
+// Shadow of the cells written by screen_putcell(); only cells which differ
+// from it are sent to SLang. Any other write invalidates the cells it covers.
+#define SCREEN_CELL_INVALID 0xffffffffUL
+#define SCREEN_RUN_MAXLEN   256
+static unsigned long *cell_chr=NULL;
+static int *cell_color=NULL;
+static int cell_rows=0;
+static int cell_cols=0;
+// Pending run of changed cells with same color, not yet sent to SLang
+static char run_buf[SCREEN_RUN_MAXLEN];
+static int run_len=0;
+static int run_row=0;
+static int run_col=0;
+static int run_color=0;
+// Position and color the caller expects SLang to be at after screen_putcell()
+static int put_row=0;
+static int put_col=0;
+static int put_color=0;
+static short put_desync=false;
+
 #if defined(unix) && !defined(GO32)
 int sigwinch (int sigtype);
 volatile int safe_update, update_required;
@@ -75,54 +95,194 @@ static void get_screen_size (void)
 #endif
 }
 
+/*
+ * Resizes the shadow cell buffer to current screen size; all cells
+ * are marked invalid, so the next screen_putcell() writes them.
+ */
+static void screen_cells_realloc(void)
+{
+    int rows=SLtt_Screen_Rows;
+    int cols=SLtt_Screen_Cols;
+    if ((rows<0)||(cols<0)) { rows=0; cols=0; }
+    free(cell_chr);
+    free(cell_color);
+    cell_chr=malloc(rows*cols*sizeof(unsigned long)+1);
+    cell_color=malloc(rows*cols*sizeof(int)+1);
+    if ((cell_chr==NULL)||(cell_color==NULL))
+    {
+      free(cell_chr); cell_chr=NULL;
+      free(cell_color); cell_color=NULL;
+      rows=0; cols=0;
+    }
+    cell_rows=rows;
+    cell_cols=cols;
+    run_len=0;
+    put_desync=false;
+    int i;
+    for (i=0;i<rows*cols;i++)
+      cell_chr[i]=SCREEN_CELL_INVALID;
+}
+
+/*
+ * Marks shadow cells in given row, from column col_beg to col_end-1,
+ * as invalid. Used after writing to screen without screen_putcell().
+ */
+static void screen_cells_invalidate(int row,int col_beg,int col_end)
+{
+    if ((row<0)||(row>=cell_rows)) return;
+    if (col_beg<0) col_beg=0;
+    if (col_end>cell_cols) col_end=cell_cols;
+    unsigned long *chr=cell_chr+row*cell_cols;
+    int i;
+    for (i=col_beg;i<col_end;i++)
+      chr[i]=SCREEN_CELL_INVALID;
+}
+
+/*
+ * Sends the pending run of changed cells to SLang.
+ */
+static void screen_cells_flush_run(void)
+{
+    if (run_len<1) return;
+    SLsmg_gotorc(run_row,run_col);
+    SLsmg_set_color(run_color);
+    SLsmg_write_nchars(run_buf,run_len);
+    run_len=0;
+}
+
+/*
+ * Makes SLang state consistent with what the caller expects after
+ * screen_putcell(). Needs to be called before any direct SLang write.
+ */
+static void screen_cells_sync(void)
+{
+    if (!put_desync) return;
+    screen_cells_flush_run();
+    SLsmg_gotorc(put_row,put_col);
+    SLsmg_set_color(put_color);
+    put_desync=false;
+}
+
 void set_cursor_pos(int row,int col)
 {
   if (!screen_initied) return;
+  screen_cells_sync();
   SLsmg_gotorc (row,col);
 }
 
 void screen_setcolor(int idx)
 {
   if (!screen_initied) return;
+  screen_cells_sync();
   SLsmg_set_color(idx);
 }
 
 void screen_printf(char *format, ...)
 {
     if (!screen_initied) return;
+    screen_cells_sync();
+    int row=SLsmg_get_row();
+    int col=SLsmg_get_column();
     va_list val;
     va_start(val, format);
     SLsmg_vprintf(format, val);
     va_end(val);
+    screen_cells_invalidate(row,col,SLsmg_get_column());
 }
 
 void screen_printf_toeol(char *format, ...)
 {
     if (!screen_initied) return;
+    screen_cells_sync();
+    int row=SLsmg_get_row();
+    int col=SLsmg_get_column();
     va_list val;
     va_start(val, format);
     SLsmg_vprintf(format, val);
     va_end(val);
     SLsmg_erase_eol();
+    screen_cells_invalidate(row,col,cell_cols);
 }
 
 void screen_printchr(unsigned long dst)
 {
     if (!screen_initied) return;
+    screen_cells_sync();
+    int row=SLsmg_get_row();
+    int col=SLsmg_get_column();
     SLsmg_write_char(dst);
+    screen_cells_invalidate(row,col,col+1);
+}
+
+/*
+ * Writes a character at given position and color, but only if the cell
+ * was changed since it was last written this way. Changed cells in one row
+ * with same color are batched and sent to SLang in one call.
+ * After the call, cursor is placed right after the cell, like with
+ * set_cursor_pos(), screen_setcolor() and screen_printchr() sequence.
+ */
+void screen_putcell(int row,int col,int color,unsigned long chr)
+{
+    if (!screen_initied) return;
+    put_row=row;
+    put_col=col+1;
+    put_color=color;
+    put_desync=true;
+    if ((row<0)||(row>=cell_rows)||(col<0)||(col>=cell_cols))
+      return;
+    int idx=row*cell_cols+col;
+    if ((cell_chr[idx]==chr)&&(cell_color[idx]==color))
+      return;
+    cell_chr[idx]=chr;
+    cell_color[idx]=color;
+    // Multibyte characters can't be batched
+    if (chr>127)
+    {
+      screen_cells_flush_run();
+      SLsmg_gotorc(row,col);
+      SLsmg_set_color(color);
+      SLsmg_write_char(chr);
+      return;
+    }
+    if ((run_len>0)&&((run_row!=row)||(run_col+run_len!=col)||
+        (run_color!=color)||(run_len>=SCREEN_RUN_MAXLEN)))
+      screen_cells_flush_run();
+    if (run_len==0)
+    {
+      run_row=row;
+      run_col=col;
+      run_color=color;
+    }
+    run_buf[run_len]=(char)chr;
+    run_len++;
+}
+
+void screen_fill_region(int row,int col,int nrows,int ncols,unsigned long chr)
+{
+    if (!screen_initied) return;
+    screen_cells_sync();
+    SLsmg_fill_region(row,col,nrows,ncols,chr);
+    int i;
+    for (i=row;i<row+nrows;i++)
+      screen_cells_invalidate(i,col,col+ncols);
 }
 
 void screen_clear(void)
 {
     if (!screen_initied) return;
+    screen_cells_sync();
     SLsmg_gotorc(0,0);
     SLsmg_erase_eos();
     //SLsmg_cls();
+    int i;
+    for (i=0;i<cell_rows;i++)
+      screen_cells_invalidate(i,0,cell_cols);
 }
 
 void screen_refresh(void)
 {
     if (!screen_initied) return;
+    screen_cells_sync();
     SLsmg_refresh();
 }
 
@@ -245,6 +405,7 @@ void screen_init(void)
 
         SLtt_set_color (PRINT_COLOR_TILESET + i, buf, fg_color[i], bg_color[i]);
     }
+    screen_cells_realloc();
     screen_initied=true;
 }
 
@@ -350,6 +511,7 @@ void screen_reinit_and_update(void)
     SLsmg_reset_smg();
     get_screen_size();
     SLsmg_init_smg();
+    screen_cells_realloc();
     draw_levscr(drawdata.scrmode,drawdata.workdata);
 }
 
@@ -362,5 +524,11 @@ void screen_done(void)
     set_cursor_visibility(true);
     SLsmg_reset_smg();
     screen_initied=false;
+    free(cell_chr);
+    cell_chr=NULL;
+    free(cell_color);
+    cell_color=NULL;
+    cell_rows=0;
+    cell_cols=0;
 }
 
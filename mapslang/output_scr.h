@@ -102,6 +102,8 @@ void screen_setcolor(int idx);
 void screen_printchr(unsigned long dst);
 void screen_printf(char *format, ...);
 void screen_printf_toeol(char *format, ...);
+void screen_putcell(int row,int col,int color,unsigned long chr);
+void screen_fill_region(int row,int col,int nrows,int ncols,unsigned long chr);
 void screen_draw_hline(int posy,int posx,int length,short border_style);
 void screen_draw_vline(int posy,int posx,int length,short border_style);
 void screen_draw_window(int posy,int posx,int sizey,int sizex,int border_size,short border_style);
@@ -24,6 +24,7 @@
 #include <math.h>
 #include <string.h>
 #include "libadikted/adikted.h"
+#include "libadikted/lbthread.h"
 #include "var_utils.h"
 #include "output_scr.h"
 #include "input_kb.h"
@@ -153,10 +154,9 @@ void init_levscr_basics(struct SCRMODE_DATA **scrmode,struct WORKMODE_DATA *work
         if (workdata->mapmode->brighten[i]==NULL)
           die("init_levscr: Out of memory");
       }
-        if (!level_init(&(workdata->mapmode->preview),MFV_DKGOLD,NULL))
-          die("init_levscr: Error creating preview structure");
     }
     clear_mapmode(workdata->mapmode);
+    level_set_obj_hook(workdata->lvl,brighten_obj_hook,workdata->mapmode);
     // optns - options which are copied to level structure
     workdata->optns=(struct LEVOPTIONS *)malloc(sizeof(struct LEVOPTIONS));
     if (workdata->optns==NULL)
@@ -206,8 +206,6 @@ void init_levscr_modes(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workda
     init_mdrwrk(scrmode,workdata);
     // Init script generator in script mode
     init_scrptgen(scrmode,workdata);
-    // Copy options into level preview structure
-    level_set_options(workdata->mapmode->preview,workdata->optns);
     // Note: the modes which are not initied here, are initied earlier
     // in init_levscr_basics
     message_log(" init_levscr_modes: finished");
@@ -235,6 +233,7 @@ void clear_mapmode(struct MAPMODE_DATA *mapmode)
     set_painting_disab(mapmode);
     mapmode->paintownr=PLAYER_UNSET;
     mapmode->paintroom=SLAB_TYPE_ROCK;
+    mapmode->paintundo=false;
     mapmode->screen.x=0;
     mapmode->screen.y=0;
     mapmode->map.x=0;
@@ -250,8 +249,6 @@ void clear_mapmode(struct MAPMODE_DATA *mapmode)
     mapmode->eetype=EE_NONE;
     clear_highlight(mapmode);
     clear_brighten(mapmode);
-    level_free(mapmode->preview);
-    level_clear(mapmode->preview);
 }
 
 void clear_infopanel(struct INFOPANEL_DATA *ipanel)
@@ -276,6 +273,8 @@ void free_levscr(struct SCRMODE_DATA **scrmode,struct WORKMODE_DATA *workdata)
     // Main screen variables
     message_log(" free_levscr: mode variables freed");
     //Freeing mapmode structure
+    if (workdata->lvl!=NULL)
+      level_set_obj_hook(workdata->lvl,NULL,NULL);
     if (workdata->mapmode->hilight!=NULL)
     {
       int i;
@@ -283,8 +282,15 @@ void free_levscr(struct SCRMODE_DATA **scrmode,struct WORKMODE_DATA *workdata)
           free(workdata->mapmode->hilight[i]);
       free(workdata->mapmode->hilight);
     }
-    level_free(workdata->mapmode->preview);
-    level_deinit(&(workdata->mapmode->preview));
+    if (workdata->mapmode->brighten!=NULL)
+    {
+      int i;
+      for (i=0; i<workdata->mapmode->tlsize.y; i++)
+          free(workdata->mapmode->brighten[i]);
+      free(workdata->mapmode->brighten);
+    }
+    free_map_preview_cache();
+    free_map_save(workdata);
     free(workdata->mapmode);
     workdata->mapmode=NULL;
     free((*scrmode)->automated_commands);
@@ -322,9 +328,10 @@ void set_tile_highlight(struct MAPMODE_DATA *mapmode, unsigned int tx, unsigned
 short get_tile_brighten(struct MAPMODE_DATA *mapmode, unsigned int tx, unsigned int ty)
 {
     if (mapmode->brighten==NULL) return false;
+    if (!mapmode->show_obj_range) return false;
     //Bounding position
     if ((tx>=mapmode->tlsize.x)||(ty>=mapmode->tlsize.y)) return false;
-    return mapmode->brighten[tx][ty];
+    return (mapmode->brighten[tx][ty]>0);
 }
 
 /*
@@ -350,9 +357,14 @@ void clear_brighten(struct MAPMODE_DATA *mapmode)
     int i,k;
     for (k=0;k<mapmode->tlsize.y;k++)
       for (i=0;i<mapmode->tlsize.x;i++)
-        mapmode->brighten[i][k]=false;
+        mapmode->brighten[i][k]=0;
 }
 
+/*
+ * Recomputes the object range coverage by sweeping through all objects.
+ * This is slow on big maps; it is needed only after loading the map,
+ * later the coverage is updated by brighten_obj_hook().
+ */
 void update_brighten(struct LEVEL *lvl,struct MAPMODE_DATA *mapmode)
 {
     //Estimating number of objects we'll have to compute
@@ -362,9 +374,8 @@ void update_brighten(struct LEVEL *lvl,struct MAPMODE_DATA *mapmode)
     if (ranged_obj>96)
       popup_show("Updating object ranges for whole map","Sweeping through all objects can take some time. Please wait...");
     const int arr_entries_x=mapmode->tlsize.x*MAP_SUBNUM_X;
-    const int arr_entries_y=mapmode->tlsize.x*MAP_SUBNUM_Y;
+    const int arr_entries_y=mapmode->tlsize.y*MAP_SUBNUM_Y;
     clear_brighten(mapmode);
-    if (!mapmode->show_obj_range) return;
     int curr_sx, curr_sy, i;
     for (curr_sx=0; curr_sx < arr_entries_x; curr_sx++)
       for (curr_sy=0; curr_sy < arr_entries_y; curr_sy++)
@@ -373,10 +384,7 @@ void update_brighten(struct LEVEL *lvl,struct MAPMODE_DATA *mapmode)
           for (i=last_obj; i>=0; i--)
           {
             unsigned char *thing=get_thing(lvl,curr_sx,curr_sy,i);
-            if (is_effectgen(thing))
-            {
-              set_brighten_for_thing(mapmode,thing);
-            }
+            set_brighten_for_thing(mapmode,thing);
           }
           last_obj=get_actnpt_subnums(lvl,curr_sx,curr_sy)-1;
           for (i=last_obj; i>=0; i--)
@@ -393,34 +401,92 @@ void update_brighten(struct LEVEL *lvl,struct MAPMODE_DATA *mapmode)
       }
 }
 
+/*
+ * Adds or subtracts range of an object which is added to or removed
+ * from the level, by user or by automatic objects update in any mode.
+ * Registered as level object hook, with mapmode as data.
+ */
+void brighten_obj_hook(struct LEVEL *lvl,short obj_type,
+    const unsigned char *obj,int delta,void *data)
+{
+    struct MAPMODE_DATA *mapmode=(struct MAPMODE_DATA *)data;
+    unsigned char *ranged_obj=(unsigned char *)obj;
+    switch (obj_type)
+    {
+    case OBJECT_TYPE_THING:
+      if (delta>0)
+        set_brighten_for_thing(mapmode,ranged_obj);
+      else
+        unset_brighten_for_thing(mapmode,ranged_obj);
+      break;
+    case OBJECT_TYPE_ACTNPT:
+      if (delta>0)
+        set_brighten_for_actnpt(mapmode,ranged_obj);
+      else
+        unset_brighten_for_actnpt(mapmode,ranged_obj);
+      break;
+    case OBJECT_TYPE_STLIGHT:
+      if (delta>0)
+        set_brighten_for_stlight(mapmode,ranged_obj);
+      else
+        unset_brighten_for_stlight(mapmode,ranged_obj);
+      break;
+    }
+}
+
 void set_brighten_for_thing(struct MAPMODE_DATA *mapmode,unsigned char *thing)
 {
   if (thing==NULL) return;
-  if (!mapmode->show_obj_range) return;
-  set_brighten_for_range(mapmode,get_thing_subtile_x(thing),
-      get_thing_subtile_y(thing),get_thing_range_adv(thing));
+  if (!is_effectgen(thing)) return;
+  change_brighten_for_range(mapmode,get_thing_subtile_x(thing),
+      get_thing_subtile_y(thing),get_thing_range_adv(thing),1);
 }
 
 void set_brighten_for_actnpt(struct MAPMODE_DATA *mapmode,unsigned char *actnpt)
 {
   if (actnpt==NULL) return;
-  if (!mapmode->show_obj_range) return;
-  set_brighten_for_range(mapmode,get_actnpt_subtile_x(actnpt),
-      get_actnpt_subtile_y(actnpt),get_actnpt_range_adv(actnpt));
+  change_brighten_for_range(mapmode,get_actnpt_subtile_x(actnpt),
+      get_actnpt_subtile_y(actnpt),get_actnpt_range_adv(actnpt),1);
 }
 
 void set_brighten_for_stlight(struct MAPMODE_DATA *mapmode,unsigned char *stlight)
 {
   if (stlight==NULL) return;
-  if (!mapmode->show_obj_range) return;
-  set_brighten_for_range(mapmode,get_stlight_subtile_x(stlight),
-      get_stlight_subtile_y(stlight),get_stlight_range_adv(stlight));
+  change_brighten_for_range(mapmode,get_stlight_subtile_x(stlight),
+      get_stlight_subtile_y(stlight),get_stlight_range_adv(stlight),1);
+}
+
+void unset_brighten_for_thing(struct MAPMODE_DATA *mapmode,unsigned char *thing)
+{
+  if (thing==NULL) return;
+  if (!is_effectgen(thing)) return;
+  change_brighten_for_range(mapmode,get_thing_subtile_x(thing),
+      get_thing_subtile_y(thing),get_thing_range_adv(thing),-1);
+}
+
+void unset_brighten_for_actnpt(struct MAPMODE_DATA *mapmode,unsigned char *actnpt)
+{
+  if (actnpt==NULL) return;
+  change_brighten_for_range(mapmode,get_actnpt_subtile_x(actnpt),
+      get_actnpt_subtile_y(actnpt),get_actnpt_range_adv(actnpt),-1);
 }
 
-void set_brighten_for_range(struct MAPMODE_DATA *mapmode,
-    unsigned int pos_x,unsigned int pos_y,unsigned int rng)
+void unset_brighten_for_stlight(struct MAPMODE_DATA *mapmode,unsigned char *stlight)
 {
-  unsigned int til_rng=rng/MAP_SUBNUM_X+((rng%MAP_SUBNUM_X)>0);
+  if (stlight==NULL) return;
+  change_brighten_for_range(mapmode,get_stlight_subtile_x(stlight),
+      get_stlight_subtile_y(stlight),get_stlight_range_adv(stlight),-1);
+}
+
+/*
+ * Adds (or subtracts, if delta is negative) one object range footprint
+ * to the coverage counters. Range is given in subtile/256 units.
+ */
+void change_brighten_for_range(struct MAPMODE_DATA *mapmode,
+    unsigned int pos_x,unsigned int pos_y,unsigned int rng,int delta)
+{
+  // Range footprint in tiles; one tile more to cover rounding
+  unsigned int til_rng=((rng>>8)+1)/MAP_SUBNUM_X+1;
   int tx_start,tx_end;
   tx_start=(pos_x/MAP_SUBNUM_X)-til_rng;
   tx_end=(pos_x/MAP_SUBNUM_X)+til_rng+1;
@@ -439,7 +505,11 @@ void set_brighten_for_range(struct MAPMODE_DATA *mapmode,
       float sy=ty*MAP_SUBNUM_Y+1;
       float distance=sqrt(pow((float)pos_x-sx,2)+pow((float)pos_y-sy,2))*256.f;
       if (distance<=rng)
-        mapmode->brighten[tx][ty]=true;
+      {
+        mapmode->brighten[tx][ty]+=delta;
+        if (mapmode->brighten[tx][ty]<0)
+          mapmode->brighten[tx][ty]=0;
+      }
     }
 }
 
@@ -1043,15 +1113,15 @@ int get_draw_map_tile_char(const struct MAPMODE_DATA *mapmode,const struct LEVEL
 void draw_map_area(struct SCRMODE_DATA *scrmode,struct MAPMODE_DATA *mapmode,struct LEVEL *lvl,short show_ground,short show_rooms,short show_things)
 {
     int i, k;
+    // Map cells are written with screen_putcell(), so only cells which
+    // changed since previous frame are really sent to the terminal.
     for (k=0; k<scrmode->rows; k++)
     {
-      screen_setcolor(PRINT_COLOR_LGREY_ON_BLACK);
-      set_cursor_pos(k,0);
       int ty=mapmode->map.y+k;
       if (ty >= mapmode->tlsize.y)
       {
           for (i=0; i<scrmode->cols; i++)
-            screen_printchr(' ');
+            screen_putcell(k,i,PRINT_COLOR_LGREY_ON_BLACK,' ');
       }
       else
       {
@@ -1084,18 +1154,16 @@ void draw_map_area(struct SCRMODE_DATA *scrmode,struct MAPMODE_DATA *mapmode,str
               {
                   brighten_bg=false;
               }
-              screen_setcolor(get_draw_map_tile_color(scrmode,mapmode,lvl,tx,ty,has_ccol,darken_fg,brighten_bg));
               out_ch=get_draw_map_tile_char(mapmode,lvl,tx,ty,show_ground,show_rooms,show_things,(g>=0));
-              screen_printchr(out_ch);
+              screen_putcell(k,i,get_draw_map_tile_color(scrmode,mapmode,lvl,tx,ty,has_ccol,darken_fg,brighten_bg),out_ch);
             } else
             {
-              screen_printchr(' ');
+              screen_putcell(k,i,PRINT_COLOR_LGREY_ON_BLACK,' ');
             }
           }
       }
-      screen_setcolor(PRINT_COLOR_YELLOW_ON_BLUE);
-      screen_printchr(' ');
-      screen_printchr(' ');
+      screen_putcell(k,scrmode->cols,PRINT_COLOR_YELLOW_ON_BLUE,' ');
+      screen_putcell(k,scrmode->cols+1,PRINT_COLOR_YELLOW_ON_BLUE,' ');
       screen_setcolor(PRINT_COLOR_LGREY_ON_BLACK);
       screen_printf_toeol("");
     }
@@ -1284,12 +1352,27 @@ void proc_key(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
         finished=true;
         return;
       }
+      // Finish saving on separate thread as soon as it's done
+      while ((map_save_running())&&(!key_wait(1)))
+      {
+        if (map_save_finish(workdata,false))
+          draw_levscr(scrmode,workdata);
+      }
+      // Use the time before next key is pressed for prefetching; if threads
+      // are available, this only passes the maps to the prefetching thread
+      if ((scrmode->mode==MD_LMAP)||(scrmode->mode==MD_SMAP))
+      {
+        while ((!key_pending())&&(prefetch_map_preview(scrmode,workdata)));
+      }
       g = get_key();
     }
     // Decoding "universal keys" - global actions
     // which should work in every screen
     //Performing actions, or sending the keycode elswhere
     message_log(" proc_key: got keycode %u",g);
+    // Changes made by one key stroke are undone together
+    short painting=is_painting_enab(workdata->mapmode);
+    level_undo_begin(workdata->lvl);
     switch (g)
     {
     case KEY_F1:
@@ -1334,6 +1417,12 @@ void proc_key(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
     case KEY_CTRL_E:
       action_enter_texture_mode(scrmode,workdata);
       break;
+    case KEY_CTRL_Z:
+      action_undo(scrmode,workdata);
+      break;
+    case KEY_CTRL_Y:
+      action_redo(scrmode,workdata);
+      break;
 
     default:
       {
@@ -1342,6 +1431,12 @@ void proc_key(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
         actions[scrmode->mode%MODES_COUNT](scrmode,workdata,g);
       };break;
     }
+    // Strokes made while painting are joined into one undo step
+    struct MAPMODE_DATA *mapmode=workdata->mapmode;
+    if ((painting)&&(is_painting_enab(mapmode))&&(mapmode->paintundo))
+      level_undo_join_last(workdata->lvl);
+    short stored=level_undo_end(workdata->lvl);
+    mapmode->paintundo=(is_painting_enab(mapmode))&&((mapmode->paintundo)||(stored));
     inc_info_usr_cmds_count(workdata->lvl);
     message_log(" proc_key: finished");
 }
@@ -1679,6 +1774,11 @@ void action_quit_program(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *work
     }
     message_log(" proc_key: setting finished to true");
     //TODO: maybe we should ask to save unsaved data?
+    if (map_save_running())
+    {
+      popup_show("Saving map","Writing map files. Please wait...");
+      map_save_finish(workdata,true);
+    }
     finished=true;
 //    actions[scrmode->mode%MODES_COUNT](KEY_CTRL_Q); // Grotty but it'll work
 }
@@ -1703,6 +1803,7 @@ void action_load_map_quick(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *wo
     if (strlen(get_lvl_fname(workdata->lvl))>0)
     {
           popup_show("Reloading map","Reading map files. Please wait...");
+          map_save_finish(workdata,true);
           free_map(workdata->lvl);
           set_lvl_savfname(workdata->lvl,"");
           user_load_map(workdata->lvl,true);
@@ -1724,6 +1825,127 @@ void action_enter_mapsave_mode(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA
     mdstart[MD_SMAP](scrmode,workdata);
 }
 
+// Map saving on a separate thread. The map is saved from a snapshot
+// of the level, so it can be edited while the files are written.
+struct MAP_SAVE_TASK {
+    struct LEVEL *snap;
+    short prior_save;
+    short result;
+    short finished;
+    char msg[LINEMSG_SIZE];
+  };
+
+static struct MAP_SAVE_TASK map_save_task;
+static struct LB_THREAD *map_save_thread=NULL;
+static struct LB_MUTEX *map_save_lock=NULL;
+
+static void map_save_thread_func(void *arg)
+{
+    struct MAP_SAVE_TASK *task=(struct MAP_SAVE_TASK *)arg;
+    short result=user_save_map(task->snap,task->prior_save);
+    // Messages are separate for every thread; passing the last one
+    char *msg=message_get();
+    lb_mutex_lock(map_save_lock);
+    task->result=result;
+    if (msg!=NULL)
+    {
+      strncpy(task->msg,msg,LINEMSG_SIZE-1);
+      task->msg[LINEMSG_SIZE-1]='\0';
+    }
+    task->finished=true;
+    lb_mutex_unlock(map_save_lock);
+    message_thread_end();
+}
+
+/*
+ * Returns true if the map is being saved on separate thread.
+ */
+short map_save_running(void)
+{
+    return (map_save_thread!=NULL);
+}
+
+/*
+ * Finishes saving the map on separate thread: updates the level and shows
+ * the result. If wait is false, does nothing until the files are written.
+ * Returns true if the saving was finished.
+ */
+short map_save_finish(struct WORKMODE_DATA *workdata,short wait)
+{
+    if (map_save_thread==NULL)
+      return false;
+    if (!wait)
+    {
+      lb_mutex_lock(map_save_lock);
+      short finished=map_save_task.finished;
+      lb_mutex_unlock(map_save_lock);
+      if (!finished)
+        return false;
+    }
+    lb_thread_join(&map_save_thread);
+    if (workdata->lvl!=NULL)
+    {
+      if (map_save_task.result>=ERR_NONE)
+      {
+        level_snapshot_saved(workdata->lvl,map_save_task.snap);
+        message_info("Map \"%s\" saved", get_lvl_savfname(map_save_task.snap));
+      } else
+      if (map_save_task.msg[0]!='\0')
+      {
+        message_error("%s",map_save_task.msg);
+      } else
+      {
+        message_error("Map \"%s\" not saved", get_lvl_savfname(map_save_task.snap));
+      }
+    }
+    level_snapshot_free(&map_save_task.snap);
+    return true;
+}
+
+/*
+ * Waits for the map saving on separate thread, and frees its lock.
+ */
+void free_map_save(struct WORKMODE_DATA *workdata)
+{
+    map_save_finish(workdata,true);
+    lb_mutex_free(&map_save_lock);
+}
+
+/*
+ * Saves the map on separate thread, from a snapshot of the level.
+ * If the thread can't be started, the map is saved at once.
+ * Previous saving is finished first.
+ */
+void user_save_map_background(struct WORKMODE_DATA *workdata,short prior_save)
+{
+    struct LEVEL *snap=NULL;
+    if (map_save_thread!=NULL)
+    {
+      popup_show("Saving map","Writing map files. Please wait...");
+      map_save_finish(workdata,true);
+    }
+    if (map_save_lock==NULL)
+      map_save_lock=lb_mutex_create();
+    if (map_save_lock!=NULL)
+      snap=level_snapshot_create(workdata->lvl);
+    if (snap!=NULL)
+    {
+      memset(&map_save_task,0,sizeof(struct MAP_SAVE_TASK));
+      map_save_task.snap=snap;
+      map_save_task.prior_save=prior_save;
+      map_save_thread=lb_thread_start(map_save_thread_func,&map_save_task);
+      if (map_save_thread!=NULL)
+      {
+        message_info("Saving map \"%s\"...", get_lvl_savfname(workdata->lvl));
+        return;
+      }
+      level_snapshot_free(&map_save_task.snap);
+    }
+    popup_show("Saving map","Writing map files. Please wait...");
+    user_save_map(workdata->lvl,prior_save);
+    message_info("Map \"%s\" saved", get_lvl_savfname(workdata->lvl));
+}
+
 void action_save_map_quick(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 {
     if (is_simple_mode(scrmode->mode))
@@ -1733,9 +1955,7 @@ void action_save_map_quick(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *wo
     }
     if (strlen(get_lvl_savfname(workdata->lvl))>0)
     {
-        popup_show("Saving map","Writing map files. Please wait...");
-        user_save_map(workdata->lvl,0);
-        message_info("Map \"%s\" saved", get_lvl_savfname(workdata->lvl));
+        user_save_map_background(workdata,0);
     } else
     {
           message_error("Map name is empty, please save as.");
@@ -1750,6 +1970,7 @@ void action_create_new_map(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *wo
         return;
     }
     popup_show("Clearing map","Generating empty map. Please wait...");
+    map_save_finish(workdata,true);
     free_map(workdata->lvl);
     start_new_map(workdata->lvl);
     clear_highlight(workdata->mapmode);
@@ -1766,6 +1987,7 @@ void action_create_random_backgnd(struct SCRMODE_DATA *scrmode,struct WORKMODE_D
         return;
     }
     popup_show("Randomizing map","Generating random map. Please wait...");
+    map_save_finish(workdata,true);
     free_map(workdata->lvl);
     generate_random_map(workdata->lvl);
     clear_highlight(workdata->mapmode);
@@ -1798,6 +2020,38 @@ void action_toggle_datclm_aupdate(struct SCRMODE_DATA *scrmode,struct WORKMODE_D
         message_info_force("Auto DAT/CLM/WIB update disabled - manual with \"u\"");
 }
 
+void action_undo(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
+{
+    if (is_simple_mode(scrmode->mode))
+    {
+        message_info("Go back to map view first.");
+        return;
+    }
+    if (!level_undo(workdata->lvl))
+    {
+        message_info("Nothing to undo.");
+        return;
+    }
+    workdata->mapmode->paintundo=false;
+    message_info("Undone; %u more steps to undo.",level_undo_count(workdata->lvl));
+}
+
+void action_redo(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
+{
+    if (is_simple_mode(scrmode->mode))
+    {
+        message_info("Go back to map view first.");
+        return;
+    }
+    if (!level_redo(workdata->lvl))
+    {
+        message_info("Nothing to redo.");
+        return;
+    }
+    workdata->mapmode->paintundo=false;
+    message_info("Redone; %u more steps to redo.",level_redo_count(workdata->lvl));
+}
+
 void action_enter_script_mode(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 {
     if (is_simple_mode(scrmode->mode))
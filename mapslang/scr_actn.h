@@ -143,6 +143,8 @@ struct MAPMODE_DATA {
     short paintmode;
     unsigned char paintownr;
     unsigned short paintroom;
+    // Is the last undo step a paint stroke, which next strokes can join
+    short paintundo;
     // Location of cursor on screen (where appropriate)
     struct IPOINT_2D screen;
     // Location of top left corner of screen in map (where appropriate)
@@ -151,7 +153,7 @@ struct MAPMODE_DATA {
     struct IRECT_2D markr;
     // Highlighted squares
     int **hilight;
-    // Brightened squares
+    // Brightened squares; counts ranged objects which reach every tile
     int **brighten;
     // Which subtile is being considered in thing and data modes
     struct IPOINT_2D subtl;
@@ -170,8 +172,6 @@ struct MAPMODE_DATA {
     short eetype;
     // Will the preview of level be visible?
     short level_preview;
-    // Preview of a level, used when opening a level
-    struct LEVEL *preview;
   };
 
 struct WORKMODE_DATA {
@@ -222,10 +222,16 @@ void action_generate_bitmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *w
 void action_enter_search_mode(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_enter_script_mode(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_toggle_datclm_aupdate(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
+void action_undo(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
+void action_redo(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_toggle_compass_rose(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_create_new_map(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_create_random_backgnd(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_save_map_quick(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
+short map_save_running(void);
+short map_save_finish(struct WORKMODE_DATA *workdata,short wait);
+void user_save_map_background(struct WORKMODE_DATA *workdata,short prior_save);
+void free_map_save(struct WORKMODE_DATA *workdata);
 void action_enter_mapsave_mode(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_load_map_quick(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void action_enter_mapload_mode(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
@@ -309,10 +315,15 @@ short get_tile_brighten(struct MAPMODE_DATA *mapmode, unsigned int tx, unsigned
 void set_tile_brighten(struct MAPMODE_DATA *mapmode, unsigned int tx, unsigned int ty, short nval);
 void clear_brighten(struct MAPMODE_DATA *mapmode);
 void update_brighten(struct LEVEL *lvl,struct MAPMODE_DATA *mapmode);
+void brighten_obj_hook(struct LEVEL *lvl,short obj_type,
+    const unsigned char *obj,int delta,void *data);
 void set_brighten_for_thing(struct MAPMODE_DATA *mapmode,unsigned char *thing);
 void set_brighten_for_actnpt(struct MAPMODE_DATA *mapmode,unsigned char *actnpt);
 void set_brighten_for_stlight(struct MAPMODE_DATA *mapmode,unsigned char *stlight);
-void set_brighten_for_range(struct MAPMODE_DATA *mapmode,
-    unsigned int pos_x,unsigned int pos_y,unsigned int rng);
+void unset_brighten_for_thing(struct MAPMODE_DATA *mapmode,unsigned char *thing);
+void unset_brighten_for_actnpt(struct MAPMODE_DATA *mapmode,unsigned char *actnpt);
+void unset_brighten_for_stlight(struct MAPMODE_DATA *mapmode,unsigned char *stlight);
+void change_brighten_for_range(struct MAPMODE_DATA *mapmode,
+    unsigned int pos_x,unsigned int pos_y,unsigned int rng,int delta);
 
 #endif // ADIKT_SCRACTN_H
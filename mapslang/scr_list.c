@@ -21,7 +21,11 @@
 
 #include "scr_list.h"
 
+#include <sys/stat.h>
 #include "libadikted/adikted.h"
+#include "libadikted/lbthread.h"
+#include "libadikted/memfile.h"
+#include "libadikted/lbfileio.h"
 #include "output_scr.h"
 #include "input_kb.h"
 #include "scr_actn.h"
@@ -406,10 +410,13 @@ void actions_crcrtr(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
           struct IPOINT_2D subpos;
           get_map_subtile_pos(workdata->mapmode,&subpos);
           unsigned char *thing;
+          unsigned char prev[SIZEOF_DK_TNG_REC];
           thing=tng_makecreature(scrmode,workdata,subpos.x,subpos.y,workdata->list->pos+1);
+          memcpy(prev,thing,SIZEOF_DK_TNG_REC);
           set_thing_subtile_h(thing,1);
           set_thing_level(thing,workdata->list->val1);
-          set_thing_owner(thing,workdata->list->val2);
+          level_undo_rec_thing_mod(workdata->lvl,prev,thing);
+          thing_set_owner(workdata->lvl,thing,workdata->list->val2);
           mdend[MD_CRTR](scrmode,workdata);
         }; break;
         default:
@@ -508,9 +515,9 @@ void actions_mdcclm(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
                 clm_recs[k*3+i]=cclm_recs[k*3+i]->rec;
               }
             //Retrieving parameters from LEVEL structure - the slab and its surrounding
-            unsigned char *surr_slb=(unsigned char *)malloc(9*sizeof(unsigned char));
-            unsigned char *surr_own=(unsigned char *)malloc(9*sizeof(unsigned char));
-            unsigned char **surr_tng=(unsigned char **)malloc(9*sizeof(unsigned char *));
+            unsigned char surr_slb[9];
+            unsigned char surr_own[9];
+            unsigned char *surr_tng[9];
             get_slab_surround(surr_slb,surr_own,surr_tng,workdata->lvl,tx,ty);
             fill_custom_column_data(workdata->list->pos,clm_recs,surr_slb,surr_own,surr_tng);
             for (k=0;k<3;k++)
@@ -815,7 +822,7 @@ void actions_editem(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
           if (index_func!=NULL)
               real_index=index_func(workdata->list->pos);
           if (real_index>=0)
-            set_thing_subtype(workdata->list->ptr,real_index);
+            thing_set_subtype(workdata->lvl,workdata->list->ptr,real_index);
           mdend[MD_EITM](scrmode,workdata);
           if (real_index<0)
           {
@@ -867,12 +874,16 @@ void actions_edcrtr(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
           message_info("Creature edit cancelled");
           break;
         case KEY_ENTER:
-          set_thing_subtype(workdata->list->ptr,workdata->list->pos+1);
+        {
+          unsigned char prev[SIZEOF_DK_TNG_REC];
+          thing_set_subtype(workdata->lvl,workdata->list->ptr,workdata->list->pos+1);
+          memcpy(prev,workdata->list->ptr,SIZEOF_DK_TNG_REC);
           set_thing_level(workdata->list->ptr,workdata->list->val1);
-          set_thing_owner(workdata->list->ptr,workdata->list->val2);
+          level_undo_rec_thing_mod(workdata->lvl,prev,workdata->list->ptr);
+          thing_set_owner(workdata->lvl,workdata->list->ptr,workdata->list->val2);
           mdend[MD_ECRT](scrmode,workdata);
           message_info("Creature properties changed");
-          break;
+        }; break;
         default:
           message_info("Unrecognized edit creature key code: %d",key);
           speaker_beep();
@@ -902,8 +913,8 @@ void actions_edefct(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
           message_info("Effect Generator edit cancelled");
           break;
         case KEY_ENTER:
-          set_thing_subtype(workdata->list->ptr,workdata->list->pos+1);
-          set_thing_owner(workdata->list->ptr,workdata->list->val2);
+          thing_set_subtype(workdata->lvl,workdata->list->ptr,workdata->list->pos+1);
+          thing_set_owner(workdata->lvl,workdata->list->ptr,workdata->list->val2);
           mdend[MD_EFCT](scrmode,workdata);
           message_info("Effect Generator properties changed");
           break;
@@ -936,8 +947,8 @@ void actions_edtrap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
           message_info("Trap edit cancelled");
           break;
         case KEY_ENTER:
-          set_thing_subtype(workdata->list->ptr,workdata->list->pos+1);
-          set_thing_owner(workdata->list->ptr,workdata->list->val2);
+          thing_set_subtype(workdata->lvl,workdata->list->ptr,workdata->list->pos+1);
+          thing_set_owner(workdata->lvl,workdata->list->ptr,workdata->list->val2);
           mdend[MD_ETRP](scrmode,workdata);
           message_info("Trap properties changed");
           break;
@@ -1206,6 +1217,474 @@ char *get_listview_map_fname(unsigned short pos_idx)
     return map_fname;
 }
 
+// Cached previews of maps from the load/save list. Every entry is a small
+// thumbnail of slabs and tile owners, decoded straight from the SLB and OWN
+// files; no LEVEL is loaded. Entries are valid as long as the files have
+// the same modification time and size. Maps near the list position are
+// prefetched by a separate thread.
+#define MAP_PREVIEW_CACHE_SIZE 32
+#define MAP_PREVIEW_PREFETCH    4
+// Every thumbnail tile represents a square of this many map tiles
+#define MAP_PREVIEW_THUMB_SCALE 2
+
+struct MAP_PREVIEW_FSTAT {
+    time_t slb_mtime;
+    time_t own_mtime;
+    long slb_size;
+    long own_size;
+  };
+
+struct MAP_PREVIEW_THUMB {
+    char *fname;
+    struct MAP_PREVIEW_FSTAT fstat;
+    short result;
+    struct UPOINT_2D size;
+    unsigned char *slb;
+    unsigned char *own;
+    unsigned long last_used;
+  };
+
+static struct MAP_PREVIEW_THUMB map_preview_cache[MAP_PREVIEW_CACHE_SIZE];
+static unsigned long map_preview_usage=0;
+// Map file name of the preview which is now displayed
+static char map_preview_fname[DISKPATH_SIZE]="";
+// Prefetching thread; the lock guards the cache and variables below
+static struct LB_MUTEX *map_preview_lock=NULL;
+static struct LB_COND *map_preview_cond=NULL;
+static struct LB_THREAD *map_preview_thread=NULL;
+static char *map_preview_wanted[2*MAP_PREVIEW_PREFETCH];
+static short map_preview_quit=false;
+static int map_preview_posted_pos=-1;
+
+static void map_preview_cache_lock(void)
+{
+    if (map_preview_lock!=NULL)
+      lb_mutex_lock(map_preview_lock);
+}
+
+static void map_preview_cache_unlock(void)
+{
+    if (map_preview_lock!=NULL)
+      lb_mutex_unlock(map_preview_lock);
+}
+
+/*
+ * Gets modification time and size of given map file.
+ * Returns false if the file doesn't exist.
+ */
+static short map_preview_file_stat(const char *lvl_fname,const char *fext,time_t *mtime,long *size)
+{
+    char *fname;
+    struct stat st;
+    fname=(char *)malloc(strlen(lvl_fname)+strlen(fext)+3);
+    if (fname==NULL) return false;
+    sprintf(fname,"%s.%s",lvl_fname,fext);
+    short result=(stat(fname,&st)==0);
+    free(fname);
+    if (result)
+    {
+      (*mtime)=st.st_mtime;
+      (*size)=st.st_size;
+    } else
+    {
+      (*mtime)=0;
+      (*size)=-1;
+    }
+    return result;
+}
+
+/*
+ * Finds cache entry for map file name prefix. If fstat isn't NULL, the entry
+ * is returned only if the files weren't modified since it was stored.
+ * The cache must be locked. Returns index of the entry, or -1 if not found.
+ */
+static int map_preview_cache_find(const char *lvl_fname,const struct MAP_PREVIEW_FSTAT *fstat)
+{
+    int i;
+    for (i=0; i<MAP_PREVIEW_CACHE_SIZE; i++)
+    {
+      struct MAP_PREVIEW_THUMB *thumb=&map_preview_cache[i];
+      if ((thumb->fname==NULL)||(strcmp(thumb->fname,lvl_fname)!=0))
+        continue;
+      if ((fstat!=NULL)&&(memcmp(&thumb->fstat,fstat,sizeof(struct MAP_PREVIEW_FSTAT))!=0))
+        return -1;
+      thumb->last_used=++map_preview_usage;
+      return i;
+    }
+    return -1;
+}
+
+/*
+ * Stores the thumbnail in the cache, replacing entry with the same name
+ * or the least recently used one. Grids of the thumbnail are moved into
+ * the cache. The cache must be locked.
+ */
+static void map_preview_cache_store(struct MAP_PREVIEW_THUMB *new_thumb)
+{
+    int i,idx;
+    idx=0;
+    for (i=0; i<MAP_PREVIEW_CACHE_SIZE; i++)
+    {
+      struct MAP_PREVIEW_THUMB *thumb=&map_preview_cache[i];
+      if ((thumb->fname!=NULL)&&(strcmp(thumb->fname,new_thumb->fname)==0))
+      {
+        idx=i;
+        break;
+      }
+      if (thumb->last_used < map_preview_cache[idx].last_used)
+        idx=i;
+    }
+    struct MAP_PREVIEW_THUMB *thumb=&map_preview_cache[idx];
+    free(thumb->fname);
+    free(thumb->slb);
+    free(thumb->own);
+    memcpy(thumb,new_thumb,sizeof(struct MAP_PREVIEW_THUMB));
+    thumb->last_used=++map_preview_usage;
+    memset(new_thumb,0,sizeof(struct MAP_PREVIEW_THUMB));
+}
+
+/*
+ * Returns how distinctive the tile is. When downsampling, the most
+ * distinctive tile of every square is kept, so corridors don't vanish.
+ */
+static int map_preview_tile_rank(unsigned short slab,unsigned char owner)
+{
+    if (slab==SLAB_TYPE_ROCK) return 0;
+    if (slab_is_tall(slab)) return (owner!=PLAYER_UNSET)?2:1;
+    return (owner!=PLAYER_UNSET)?4:3;
+}
+
+/*
+ * Decodes thumbnail of the map from its SLB and OWN files. Only square
+ * maps are supported - the size is computed from SLB file length.
+ * Uses no LEVEL, so it can be executed by the prefetching thread.
+ * Returns ERR_NONE on success, error code on failure.
+ */
+static short map_preview_thumb_decode(struct MAP_PREVIEW_THUMB *thumb,const char *lvl_fname)
+{
+    struct MEMORY_FILE *slb_mem;
+    struct MEMORY_FILE *own_mem;
+    char *fname;
+    short result;
+    fname=(char *)malloc(strlen(lvl_fname)+5);
+    if (fname==NULL) return ERR_CANT_MALLOC;
+    sprintf(fname,"%s.slb",lvl_fname);
+    result=memfile_readnew(&slb_mem,fname,MAX_FILE_SIZE);
+    if (result!=MFILE_OK)
+    {
+      free(fname);
+      return ERR_FILE_BADDATA;
+    }
+    sprintf(fname,"%s.own",lvl_fname);
+    result=memfile_readnew(&own_mem,fname,MAX_FILE_SIZE);
+    free(fname);
+    if (result!=MFILE_OK)
+    {
+      memfile_free(&slb_mem);
+      return ERR_FILE_BADDATA;
+    }
+    // Map size; the OWN file has 3 subtiles per tile, and one more
+    unsigned int tl_size=1;
+    while (2*tl_size*tl_size < slb_mem->len)
+      tl_size++;
+    unsigned int own_size=tl_size*MAP_SUBNUM_X+1;
+    if ((2*tl_size*tl_size!=slb_mem->len)||(own_size*own_size!=own_mem->len))
+    {
+      memfile_free(&slb_mem);
+      memfile_free(&own_mem);
+      return ERR_FILE_BADDATA;
+    }
+    thumb->size.x=(tl_size+MAP_PREVIEW_THUMB_SCALE-1)/MAP_PREVIEW_THUMB_SCALE;
+    thumb->size.y=thumb->size.x;
+    thumb->slb=(unsigned char *)malloc(thumb->size.x*thumb->size.y);
+    thumb->own=(unsigned char *)malloc(thumb->size.x*thumb->size.y);
+    if ((thumb->slb==NULL)||(thumb->own==NULL))
+    {
+      memfile_free(&slb_mem);
+      memfile_free(&own_mem);
+      return ERR_CANT_MALLOC;
+    }
+    unsigned int x,y,tx,ty;
+    for (y=0; y<thumb->size.y; y++)
+      for (x=0; x<thumb->size.x; x++)
+      {
+        int best_rank=-1;
+        unsigned short best_slab=SLAB_TYPE_ROCK;
+        unsigned char best_owner=PLAYER_UNSET;
+        for (ty=y*MAP_PREVIEW_THUMB_SCALE; (ty<(y+1)*MAP_PREVIEW_THUMB_SCALE)&&(ty<tl_size); ty++)
+          for (tx=x*MAP_PREVIEW_THUMB_SCALE; (tx<(x+1)*MAP_PREVIEW_THUMB_SCALE)&&(tx<tl_size); tx++)
+          {
+            unsigned short slab=read_int16_le_buf(slb_mem->content+2*(ty*tl_size+tx));
+            unsigned char owner=own_mem->content[(ty*MAP_SUBNUM_Y+1)*own_size+tx*MAP_SUBNUM_X+1];
+            if (slab>255) slab=SLAB_TYPE_ROCK;
+            int rank=map_preview_tile_rank(slab,owner);
+            if (rank>best_rank)
+            {
+              best_rank=rank;
+              best_slab=slab;
+              best_owner=owner;
+            }
+          }
+        thumb->slb[y*thumb->size.x+x]=best_slab;
+        thumb->own[y*thumb->size.x+x]=best_owner;
+      }
+    memfile_free(&slb_mem);
+    memfile_free(&own_mem);
+    return ERR_NONE;
+}
+
+/*
+ * Makes sure the cache has valid thumbnail of the map; decodes it if
+ * the map files changed or weren't decoded yet. Locks the cache by itself,
+ * and keeps it unlocked while decoding.
+ * Returns false if the map files don't exist, true otherwise.
+ * Sets *decoded if the thumbnail had to be decoded.
+ */
+static short map_preview_fetch(const char *lvl_fname,short *decoded)
+{
+    struct MAP_PREVIEW_FSTAT fstat;
+    struct MAP_PREVIEW_THUMB thumb;
+    (*decoded)=false;
+    short exists=map_preview_file_stat(lvl_fname,"slb",&fstat.slb_mtime,&fstat.slb_size);
+    exists&=map_preview_file_stat(lvl_fname,"own",&fstat.own_mtime,&fstat.own_size);
+    if (!exists)
+      return false;
+    map_preview_cache_lock();
+    int idx=map_preview_cache_find(lvl_fname,&fstat);
+    map_preview_cache_unlock();
+    if (idx>=0)
+      return true;
+    memset(&thumb,0,sizeof(struct MAP_PREVIEW_THUMB));
+    thumb.fname=strdup(lvl_fname);
+    if (thumb.fname==NULL)
+      return true;
+    thumb.fstat=fstat;
+    thumb.result=map_preview_thumb_decode(&thumb,lvl_fname);
+    if (thumb.result!=ERR_NONE)
+    {
+      // Failed decoding is cached too, so it isn't repeated
+      free(thumb.slb);
+      free(thumb.own);
+      thumb.slb=NULL;
+      thumb.own=NULL;
+      thumb.size.x=0;
+      thumb.size.y=0;
+    }
+    map_preview_cache_lock();
+    map_preview_cache_store(&thumb);
+    map_preview_cache_unlock();
+    (*decoded)=true;
+    return true;
+}
+
+/*
+ * The prefetching thread. Decodes thumbnails of the wanted maps,
+ * and waits for more when there's nothing left.
+ */
+static void map_preview_prefetch_thread(void *arg)
+{
+    lb_mutex_lock(map_preview_lock);
+    while (!map_preview_quit)
+    {
+      char *fname=NULL;
+      int i;
+      for (i=0; i<2*MAP_PREVIEW_PREFETCH; i++)
+      {
+        if (map_preview_wanted[i]!=NULL)
+        {
+          fname=map_preview_wanted[i];
+          map_preview_wanted[i]=NULL;
+          break;
+        }
+      }
+      if (fname==NULL)
+      {
+        lb_cond_wait(map_preview_cond,map_preview_lock);
+        continue;
+      }
+      lb_mutex_unlock(map_preview_lock);
+      short decoded;
+      map_preview_fetch(fname,&decoded);
+      free(fname);
+      lb_mutex_lock(map_preview_lock);
+    }
+    lb_mutex_unlock(map_preview_lock);
+    message_thread_end();
+}
+
+/*
+ * Starts the prefetching thread if it isn't running yet.
+ * Returns false if threads aren't available.
+ */
+static short map_preview_thread_start(void)
+{
+    if (map_preview_thread!=NULL)
+      return true;
+    if (!lb_threads_available())
+      return false;
+    map_preview_lock=lb_mutex_create();
+    map_preview_cond=lb_cond_create();
+    map_preview_quit=false;
+    if ((map_preview_lock!=NULL)&&(map_preview_cond!=NULL))
+      map_preview_thread=lb_thread_start(map_preview_prefetch_thread,NULL);
+    if (map_preview_thread==NULL)
+    {
+      lb_cond_free(&map_preview_cond);
+      lb_mutex_free(&map_preview_lock);
+      return false;
+    }
+    return true;
+}
+
+/*
+ * Displays thumbnail of the selected map in the map area.
+ * The thumbnail is scrolled together with the map.
+ */
+static void draw_map_preview(struct SCRMODE_DATA *scrmode,struct MAPMODE_DATA *mapmode)
+{
+    const struct MAP_PREVIEW_THUMB *thumb=NULL;
+    int i,k;
+    map_preview_cache_lock();
+    int idx=map_preview_cache_find(map_preview_fname,NULL);
+    if ((idx>=0)&&(map_preview_cache[idx].result==ERR_NONE))
+      thumb=&map_preview_cache[idx];
+    for (k=0; k<scrmode->rows; k++)
+    {
+      int y=mapmode->map.y/MAP_PREVIEW_THUMB_SCALE+k;
+      for (i=0; i<scrmode->cols; i++)
+      {
+        int x=mapmode->map.x/MAP_PREVIEW_THUMB_SCALE+i;
+        if ((thumb!=NULL)&&(x<thumb->size.x)&&(y<thumb->size.y))
+        {
+          unsigned char slab=thumb->slb[y*thumb->size.x+x];
+          unsigned char owner=thumb->own[y*thumb->size.x+x];
+          unsigned long out_ch;
+          short darken_fg=(slab==SLAB_TYPE_ROCK)||(slab==SLAB_TYPE_LAVA);
+          if (mapmode->slbkey==NULL)
+            out_ch='@';
+          else
+            out_ch=mapmode->slbkey[slab];
+          screen_putcell(k,i,get_screen_color_owned(owner,false,darken_fg,false),out_ch);
+        } else
+        {
+          screen_putcell(k,i,PRINT_COLOR_LGREY_ON_BLACK,' ');
+        }
+      }
+      screen_putcell(k,scrmode->cols,PRINT_COLOR_YELLOW_ON_BLUE,' ');
+      screen_putcell(k,scrmode->cols+1,PRINT_COLOR_YELLOW_ON_BLUE,' ');
+      screen_setcolor(PRINT_COLOR_LGREY_ON_BLACK);
+      screen_printf_toeol("");
+    }
+    map_preview_cache_unlock();
+}
+
+/*
+ * Selects map with given name for the preview, and makes sure its
+ * thumbnail is in the cache. Returns true if the preview is available.
+ */
+static short select_map_preview(struct WORKMODE_DATA *workdata,char *namefmt)
+{
+    short decoded;
+    if (!format_map_fname(map_preview_fname,namefmt,workdata->optns->levels_path))
+    {
+      map_preview_fname[0]='\0';
+      return false;
+    }
+    if (!map_preview_fetch(map_preview_fname,&decoded))
+      return false;
+    map_preview_cache_lock();
+    int idx=map_preview_cache_find(map_preview_fname,NULL);
+    short result=(idx>=0)&&(map_preview_cache[idx].result==ERR_NONE);
+    map_preview_cache_unlock();
+    return result;
+}
+
+/*
+ * Prefetches into cache the maps near current list position.
+ * If threads are available, the maps are passed to the prefetching
+ * thread, and false is returned at once. Otherwise, one of the maps
+ * is decoded here; maps which files don't exist are skipped.
+ * Returns true if a map was decoded, false if there's nothing to do.
+ */
+short prefetch_map_preview(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
+{
+    short lprev_flag=(scrmode->mode==MD_SMAP)?LPREV_SAVE:LPREV_LOAD;
+    if ((workdata->mapmode->level_preview&lprev_flag) != lprev_flag)
+      return false;
+    short threaded=map_preview_thread_start();
+    if ((threaded)&&(map_preview_posted_pos==workdata->list->pos))
+      return false;
+    char fname[DISKPATH_SIZE];
+    int i;
+    if (threaded)
+    {
+      lb_mutex_lock(map_preview_lock);
+      for (i=0; i<2*MAP_PREVIEW_PREFETCH; i++)
+      {
+        free(map_preview_wanted[i]);
+        map_preview_wanted[i]=NULL;
+      }
+    }
+    for (i=1; i<=2*MAP_PREVIEW_PREFETCH; i++)
+    {
+      // Order of checking: +1,-1,+2,-2,...
+      int pos=workdata->list->pos + ((i&1)?((i+1)>>1):-(i>>1));
+      if ((pos<1)||(pos>9999))
+        continue;
+      if (!format_map_fname(fname,get_listview_map_fname(pos),workdata->optns->levels_path))
+        continue;
+      if (threaded)
+      {
+        map_preview_wanted[i-1]=strdup(fname);
+      } else
+      {
+        short decoded;
+        map_preview_fetch(fname,&decoded);
+        if (decoded)
+          return true;
+      }
+    }
+    if (threaded)
+    {
+      map_preview_posted_pos=workdata->list->pos;
+      lb_cond_signal(map_preview_cond);
+      lb_mutex_unlock(map_preview_lock);
+    }
+    return false;
+}
+
+/*
+ * Stops the prefetching thread, and frees all cached map previews.
+ */
+void free_map_preview_cache(void)
+{
+    int i;
+    if (map_preview_thread!=NULL)
+    {
+      lb_mutex_lock(map_preview_lock);
+      map_preview_quit=true;
+      lb_cond_signal(map_preview_cond);
+      lb_mutex_unlock(map_preview_lock);
+      lb_thread_join(&map_preview_thread);
+      lb_cond_free(&map_preview_cond);
+      lb_mutex_free(&map_preview_lock);
+    }
+    for (i=0; i<2*MAP_PREVIEW_PREFETCH; i++)
+    {
+      free(map_preview_wanted[i]);
+      map_preview_wanted[i]=NULL;
+    }
+    map_preview_posted_pos=-1;
+    for (i=0; i<MAP_PREVIEW_CACHE_SIZE; i++)
+    {
+      struct MAP_PREVIEW_THUMB *thumb=&map_preview_cache[i];
+      free(thumb->fname);
+      free(thumb->slb);
+      free(thumb->own);
+      memset(thumb,0,sizeof(struct MAP_PREVIEW_THUMB));
+    }
+}
+
 short start_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 {
     message_log(" start_mdlmap: starting");
@@ -1215,8 +1694,8 @@ short start_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
     scrmode->usrinput[0]='\0';
     scrmode->usrinput_pos=0;
     workdata->list->pos=0;
-    level_free(workdata->mapmode->preview);
-    level_clear(workdata->mapmode->preview);
+    map_preview_fname[0]='\0';
+    map_preview_posted_pos=-1;
     message_log(" start_mdlmap: completed");
     return result;
 }
@@ -1229,12 +1708,10 @@ void end_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 
 void draw_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 {
-    struct LEVEL *draw_lvl;
     if ((workdata->mapmode->level_preview&LPREV_LOAD) == LPREV_LOAD)
-        draw_lvl=workdata->mapmode->preview;
+        draw_map_preview(scrmode,workdata->mapmode);
     else
-        draw_lvl=workdata->lvl;
-    draw_map_area(scrmode,workdata->mapmode,draw_lvl,true,true,false);
+        draw_map_area(scrmode,workdata->mapmode,workdata->lvl,true,true,false);
     draw_rpanel_list(get_listview_map_fname,scrmode,workdata->mapmode,
         workdata->list,0,9999,12);
     display_rpanel_bottom(scrmode,workdata);
@@ -1283,6 +1760,7 @@ void actions_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
               message_error("Wrong file name - can't load map");
               break;
             }
+            map_save_finish(workdata,true);
             free_map(workdata->lvl);
             format_lvl_savfname(workdata->lvl,"");
             user_load_map(workdata->lvl,true);
@@ -1297,10 +1775,9 @@ void actions_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
     }
     if (load_preview)
     {
-      format_lvl_fname(workdata->mapmode->preview,scrmode->usrinput);
       if ((workdata->mapmode->level_preview&LPREV_LOAD) == LPREV_LOAD)
       {
-        if (load_map_preview(workdata->mapmode->preview) == ERR_NONE)
+        if (select_map_preview(workdata,scrmode->usrinput))
           message_info("Map \"%s\" preview loaded",scrmode->usrinput);
       }
     }
@@ -1315,8 +1792,8 @@ short start_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
     scrmode->usrinput[0]='\0';
     scrmode->usrinput_pos=0;
     workdata->list->pos=0;
-    level_free(workdata->mapmode->preview);
-    level_clear(workdata->mapmode->preview);
+    map_preview_fname[0]='\0';
+    map_preview_posted_pos=-1;
     message_log(" start_mdsmap: completed");
     return result;
 }
@@ -1329,12 +1806,10 @@ void end_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 
 void draw_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 {
-    struct LEVEL *draw_lvl;
     if ((workdata->mapmode->level_preview&LPREV_SAVE) == LPREV_SAVE)
-        draw_lvl=workdata->mapmode->preview;
+        draw_map_preview(scrmode,workdata->mapmode);
     else
-        draw_lvl=workdata->lvl;
-    draw_map_area(scrmode,workdata->mapmode,draw_lvl,true,true,false);
+        draw_map_area(scrmode,workdata->mapmode,workdata->lvl,true,true,false);
     draw_rpanel_list(get_listview_map_fname,scrmode,workdata->mapmode,
         workdata->list,0,9999,12);
     display_rpanel_bottom(scrmode,workdata);
@@ -1376,7 +1851,6 @@ void actions_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
         case KEY_ENTER:
           {
 
-            popup_show("Saving map","Writing map files. Please wait...");
             short fname_ok=format_lvl_savfname(workdata->lvl,scrmode->usrinput);
             mdend[MD_LMAP](scrmode,workdata);
             if (!fname_ok)
@@ -1384,8 +1858,7 @@ void actions_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
               message_error("Map saving cancelled");
               break;
             }
-            user_save_map(workdata->lvl,1);
-            message_info("Map \"%s\" saved", get_lvl_savfname(workdata->lvl));
+            user_save_map_background(workdata,1);
           };break;
         default:
           message_info("Unrecognized \"%s\" key code: %d",longmodenames[MD_SMAP],key);
@@ -1394,10 +1867,9 @@ void actions_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,
     }
     if (load_preview)
     {
-      format_lvl_fname(workdata->mapmode->preview,scrmode->usrinput);
       if ((workdata->mapmode->level_preview&LPREV_SAVE) == LPREV_SAVE)
       {
-        if (load_map_preview(workdata->mapmode->preview) == ERR_NONE)
+        if (select_map_preview(workdata,scrmode->usrinput))
           message_info("Map \"%s\" preview loaded",scrmode->usrinput);
       }
     }
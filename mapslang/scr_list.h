@@ -117,6 +117,8 @@ void draw_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void actions_mdlmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,int key);
 void draw_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
 void actions_mdsmap(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,int key);
+short prefetch_map_preview(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata);
+void free_map_preview_cache(void);
 
 //Functions - actions and screen, lower level
 short actions_list(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,int key);
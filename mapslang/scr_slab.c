@@ -366,7 +366,7 @@ void slb_next_graffiti_orient(struct LEVEL *lvl,int graf_idx)
     }
     unsigned short new_orient=get_orientation_next(graf->orient);
     graffiti_clear_from_columns(lvl,graf_idx);
-    short result=set_graffiti_orientation(graf,lvl,new_orient);
+    short result=graffiti_set_orientation(lvl,graf_idx,new_orient);
     graffiti_update_columns(lvl,graf_idx);
     if (!result)
     {
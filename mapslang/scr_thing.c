@@ -97,7 +97,10 @@ void tng_change_custom(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workda
     unsigned short newnum = num + delta;
     if ((newnum >= 0) && (newnum < 255))
     {
+        unsigned char prev[SIZEOF_DK_TNG_REC];
+        memcpy(prev,thing,SIZEOF_DK_TNG_REC);
         set_thing_level(thing,newnum);
+        level_undo_rec_thing_mod(workdata->lvl,prev,thing);
         char *oper;
         if (newnum>num)
           oper="increased";
@@ -200,7 +203,6 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
           actnpt_add(workdata->lvl,thing);
           message_info("Added action point %d",(unsigned int)get_actnpt_number(thing));
           set_visited_obj_lastof(workdata,OBJECT_TYPE_ACTNPT);
-          set_brighten_for_actnpt(workdata->mapmode,thing);
           inc_info_usr_creatobj_count(workdata->lvl);
           break;
         case KEY_SHIFT_L: // Add static light
@@ -208,7 +210,6 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
           stlight_add(workdata->lvl,thing);
           message_info("Added static light");
           set_visited_obj_lastof(workdata,OBJECT_TYPE_STLIGHT);
-          set_brighten_for_stlight(workdata->mapmode,thing);
           inc_info_usr_creatobj_count(workdata->lvl);
           break;
         case KEY_K: // Copy thing to clipboard
@@ -251,15 +252,12 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
                 thing = create_thing_copy(workdata->lvl,subpos.x,subpos.y,clip_itm->data);
                 thing_add(workdata->lvl,thing);
                 message_info("Thing pasted from clipboard at subtile %d,%d",subpos.x,subpos.y);
-                if (is_effectgen(thing))
-                    set_brighten_for_thing(workdata->mapmode,thing);
                 set_visited_obj_lastof(workdata,OBJECT_TYPE_THING);
                 inc_info_usr_creatobj_count(workdata->lvl);
                 break;
             case OBJECT_TYPE_ACTNPT:
                 thing = create_actnpt_copy(subpos.x,subpos.y,clip_itm->data);
                 actnpt_add(workdata->lvl,thing);
-                set_brighten_for_actnpt(workdata->mapmode,thing);
                 message_info("Action point pasted from clipboard at subtile %d,%d",subpos.x,subpos.y);
                 set_visited_obj_lastof(workdata,OBJECT_TYPE_ACTNPT);
                 inc_info_usr_creatobj_count(workdata->lvl);
@@ -268,7 +266,6 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
                 thing = create_stlight_copy(subpos.x,subpos.y,clip_itm->data);
                 stlight_add(workdata->lvl,thing);
                 message_info("Static light pasted from clipboard at subtile %d,%d",subpos.x,subpos.y);
-                set_brighten_for_stlight(workdata->mapmode,thing);
                 set_visited_obj_lastof(workdata,OBJECT_TYPE_STLIGHT);
                 inc_info_usr_creatobj_count(workdata->lvl);
                 break;
@@ -290,7 +287,6 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
           update_obj_subpos_and_height_for_whole_map(workdata->lvl);
           message_info("Auto-maintained TNG entries updated, %u added, %u removed.",
               stats->things_added-prev_tng_add,stats->things_removed-prev_tng_rmv);
-          workdata->mdtng->obj_ranges_changed=true;
           change_visited_tile(workdata);
           };break;
         case KEY_CTRL_D: // Delete all things which can be auto-created.
@@ -301,7 +297,6 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
           remove_automade_obj_for_whole_map(workdata->lvl);
           message_info("All %u auto-maintained or noncrucial objects removed.",
               stats->things_removed-prev_tng_rmv+prev_lgt-get_lgt_total_count(workdata->lvl));
-          workdata->mdtng->obj_ranges_changed=true;
           change_visited_tile(workdata);
           };break;
         case KEY_V: // Verify whole map
@@ -350,7 +345,7 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
             {
             case OBJECT_TYPE_THING:
               thing = get_object(workdata->lvl,subpos.x,subpos.y,visiting_z);
-              set_thing_owner(thing,get_owner_next(get_thing_owner(thing)));
+              thing_set_owner(workdata->lvl,thing,get_owner_next(get_thing_owner(thing)));
               message_info("Object owner switched");
               break;
             default:
@@ -367,7 +362,7 @@ void actions_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
             {
             case OBJECT_TYPE_THING:
               thing = get_object(workdata->lvl,subpos.x,subpos.y,visiting_z);
-              if (switch_thing_subtype(thing,(key==KEY_SHIFT_S)))
+              if (thing_switch_subtype(workdata->lvl,thing,(key==KEY_SHIFT_S)))
               {
                 message_info("Thing type switched to next.");
               } else
@@ -455,7 +450,6 @@ short start_mdtng(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata)
 {
     workdata->mapmode->mark=false;
     change_visited_tile(workdata);
-    workdata->mdtng->obj_ranges_changed=true;
     scrmode->usrinput_type=SI_NONE;
     scrmode->mode=MD_TNG;
     inc_info_usr_mdswtch_count(workdata->lvl);
@@ -1148,7 +1142,6 @@ unsigned char *tng_makeeffectgen(struct SCRMODE_DATA *scrmode,struct WORKMODE_DA
     thing_add(workdata->lvl,thing);
     message_info("Effect Generator added to map at (%d,%d)",sx,sy);
     set_visited_obj_lastof(workdata,OBJECT_TYPE_THING);
-    set_brighten_for_thing(workdata->mapmode,thing);
     inc_info_usr_creatobj_count(workdata->lvl);
     return thing;
 }
@@ -1245,14 +1238,19 @@ void tng_change_height(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workda
       set_stlight_subtpos_h(obj,subheight);
       break;
     case OBJECT_TYPE_ACTNPT:
+      unset_brighten_for_actnpt(workdata->mapmode,obj);
       set_actnpt_range_subtile(obj,height);
       set_actnpt_range_subtpos(obj,subheight);
       set_brighten_for_actnpt(workdata->mapmode,obj);
       break;
     case OBJECT_TYPE_THING:
-      set_thing_subtile_h(obj,height);
-      set_thing_subtpos_h(obj,subheight);
-      break;
+      {
+        unsigned char prev[SIZEOF_DK_TNG_REC];
+        memcpy(prev,obj,SIZEOF_DK_TNG_REC);
+        set_thing_subtile_h(obj,height);
+        set_thing_subtpos_h(obj,subheight);
+        level_undo_rec_thing_mod(workdata->lvl,prev,obj);
+      };break;
     }
 }
 
@@ -1329,29 +1327,27 @@ void tng_change_range(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdat
     switch (obj_type)
     {
     case OBJECT_TYPE_STLIGHT:
+      unset_brighten_for_stlight(workdata->mapmode,obj);
       set_stlight_range_subtile(obj,rng);
       set_stlight_range_subtpos(obj,subrng);
-      if (delta_range>0)
-          set_brighten_for_stlight(workdata->mapmode,obj);
-      else
-          workdata->mdtng->obj_ranges_changed=true;
+      set_brighten_for_stlight(workdata->mapmode,obj);
       break;
     case OBJECT_TYPE_ACTNPT:
+      unset_brighten_for_actnpt(workdata->mapmode,obj);
       set_actnpt_range_subtile(obj,rng);
       set_actnpt_range_subtpos(obj,subrng);
-      if (delta_range>0)
-          set_brighten_for_actnpt(workdata->mapmode,obj);
-      else
-          workdata->mdtng->obj_ranges_changed=true;
+      set_brighten_for_actnpt(workdata->mapmode,obj);
       break;
     case OBJECT_TYPE_THING:
-      set_thing_range_subtile(obj,rng);
-      set_thing_range_subtpos(obj,subrng);
-      if (delta_range>0)
-          set_brighten_for_thing(workdata->mapmode,obj);
-      else
-          workdata->mdtng->obj_ranges_changed=true;
-      break;
+      {
+        unsigned char prev[SIZEOF_DK_TNG_REC];
+        memcpy(prev,obj,SIZEOF_DK_TNG_REC);
+        unset_brighten_for_thing(workdata->mapmode,obj);
+        set_thing_range_subtile(obj,rng);
+        set_thing_range_subtpos(obj,subrng);
+        set_brighten_for_thing(workdata->mapmode,obj);
+        level_undo_rec_thing_mod(workdata->lvl,prev,obj);
+      };break;
     }
 }
 
@@ -1404,17 +1400,14 @@ void action_delete_object(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *wor
     case OBJECT_TYPE_STLIGHT:
         object_del(workdata->lvl,subpos.x,subpos.y,visiting_z);
         message_info_force("Static light deleted.");
-        workdata->mdtng->obj_ranges_changed=true;
         break;
     case OBJECT_TYPE_ACTNPT:
         object_del(workdata->lvl,subpos.x,subpos.y,visiting_z);
         message_info_force("Action point deleted.");
-        workdata->mdtng->obj_ranges_changed=true;
         break;
     case OBJECT_TYPE_THING:
         object_del(workdata->lvl,subpos.x,subpos.y,visiting_z);
         message_info_force("Thing deleted.");
-        workdata->mdtng->obj_ranges_changed=true;
         break;
     default:
         message_error("Nothing to delete.");
@@ -1443,7 +1436,10 @@ void action_inc_object_level(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *
             unsigned short crtr_lev=get_thing_level(thing);
             if (crtr_lev<9)
             {
+                unsigned char prev[SIZEOF_DK_TNG_REC];
+                memcpy(prev,thing,SIZEOF_DK_TNG_REC);
                 set_thing_level(thing,crtr_lev+1);
+                level_undo_rec_thing_mod(workdata->lvl,prev,thing);
                 message_info("Creature level increased.");
             } else
                 message_error("Creature level limit reached.");
@@ -1456,7 +1452,7 @@ void action_inc_object_level(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *
         {
             message_error("Dungeon Heart has no alternative.");
         } else
-        if (switch_thing_subtype(thing,true))
+        if (thing_switch_subtype(workdata->lvl,thing,true))
         {
             message_info("Item type switched to next.");
         } else
@@ -1510,7 +1506,10 @@ void action_dec_object_level(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *
             unsigned short crtr_lev=get_thing_level(thing);
             if (crtr_lev>0)
             {
+                unsigned char prev[SIZEOF_DK_TNG_REC];
+                memcpy(prev,thing,SIZEOF_DK_TNG_REC);
                 set_thing_level(thing,crtr_lev-1);
+                level_undo_rec_thing_mod(workdata->lvl,prev,thing);
                 message_info("Creature level decreased.");
             } else
             message_error("Creature level limit reached.");
@@ -1523,7 +1522,7 @@ void action_dec_object_level(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *
         {
             message_error("Dungeon Heart has no alternative.");
         } else
-        if (switch_thing_subtype(thing,false))
+        if (thing_switch_subtype(workdata->lvl,thing,false))
         {
             message_info("Item type switched to previous.");
         } else
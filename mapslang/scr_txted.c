@@ -119,6 +119,7 @@ void actions_scrpt(struct SCRMODE_DATA *scrmode,struct WORKMODE_DATA *workdata,i
         struct DK_SCRIPT *scrpt=get_lvl_script(workdata->lvl);
         recompute_script_levels(scrpt);
         short retcode=recompose_script(scrpt,&(workdata->optns->script));
+        mark_lvl_changed(workdata->lvl,LCF_TXT);
         if (retcode)
           message_info("Script recomposed successfully");
         else
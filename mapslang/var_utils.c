@@ -87,6 +87,8 @@ void done(struct SCRMODE_DATA **scrmode,struct WORKMODE_DATA *workdata)
 {
     if (workdata!=NULL)
     {
+        // The map being saved shares data with the level
+        map_save_finish(workdata,true);
         if (workdata->lvl!=NULL)
           level_deinit(&(workdata->lvl));
         if (scrmode!=NULL)